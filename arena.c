@@ -0,0 +1,598 @@
+// Battle-royale arena: hundreds or thousands of bot snakes on one large board.
+//
+//   gcc -O2 -pthread arena.c -o arena
+//   ./arena [-n snakes] [-t threads] [-k ticks] [-l level] [-s seed] [-r]
+//
+// The rules are multiplayer.c's move_snake generalized to any number of snakes:
+// walls and bodies (any snake's, including your own) kill, and heads that reach
+// the same cell on the same tick are settled by length: the strictly longest snake
+// survives and every other one dies. The outcome never depends on the order snakes
+// are processed in, so any thread count gives the same game for the same seed.
+//
+// The board is stored chunk by chunk (ARENA_CHUNK x ARENA_CHUNK cells, contiguous
+// in memory) and each tick runs in three parallel passes:
+//   1. steer:   per chunk of heads, bots pick a direction and find their target cell
+//   2. resolve: per chunk of target cells, head-to-head conflicts are settled
+//   3. move:    per snake, heads and tails are written to the board
+// with single-threaded bookkeeping (bucketing, food, respawns) in between.
+
+#include "async_log.h"
+#include "levels.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LEVELS_FILE "levels.pak"
+
+#define ARENA_CHUNK_BITS 4
+#define ARENA_CHUNK (1 << ARENA_CHUNK_BITS)      // Chunk side in cells
+#define ARENA_CHUNK_CELLS (ARENA_CHUNK * ARENA_CHUNK)
+#define ARENA_DEFAULT_WIDTH 256                  // Open board size when no level is given
+#define ARENA_DEFAULT_HEIGHT 192
+#define ARENA_MAX_SNAKES 16000
+#define ARENA_MAX_THREADS 64
+#define ARENA_MAX_LENGTH 256                     // Body ring size; snakes stop growing here
+#define ARENA_SPAWN_LENGTH 3
+#define ARENA_SPAWN_ATTEMPTS 1000
+#define ARENA_FOOD_PER_SNAKE 2
+#define ARENA_FOOD_DROP 3                        // A dead snake leaves food on every third segment
+#define ARENA_RESPAWN_TICKS 20                   // With -r, the dead return after this many ticks
+
+// Board cells: 0 is empty, then food, wall, and snake ids offset by ARENA_SNAKE_BASE
+#define ARENA_EMPTY 0
+#define ARENA_FOOD 1
+#define ARENA_WALL 2
+#define ARENA_SNAKE_BASE 3
+
+typedef struct {
+    int16_t x, y;
+} ArenaPoint;
+
+typedef struct {
+    ArenaPoint body[ARENA_MAX_LENGTH]; // Ring buffer, body[head] is the head
+    int head;
+    int length;
+    int8_t dx, dy;
+    bool alive;
+    bool dying;      // Killed this tick; its body is cleared in the move pass
+    bool eating;     // Target cell holds food
+    int targetChunk; // Chunk of the cell the head moves into, -1 if it hits something
+    int deadSince;   // Tick it died on
+    uint32_t score;
+    uint64_t rng;
+} ArenaSnake;
+
+typedef struct Arena Arena;
+
+typedef struct {
+    Arena *arena;
+    int index;
+    pthread_t thread;
+    // Resolve pass scratch, indexed by cell within a chunk
+    int bestLength[ARENA_CHUNK_CELLS];
+    int bestCount[ARENA_CHUNK_CELLS];
+} ArenaWorker;
+
+struct Arena {
+    int width, height;           // Board size in cells
+    int chunksX, chunksY;
+    uint16_t *cells;             // Chunk-major: chunk after chunk, rows within a chunk
+
+    ArenaSnake *snakes;
+    int snakeCount;
+    int foodTarget;              // Food kept on the board
+    int foodCount;
+    bool respawn;
+    int tick;
+    uint64_t rng;                // Food and respawn placement; only used single-threaded
+
+    // Snakes bucketed by chunk, in id order within each chunk (counting sort)
+    int *headStart, *headList;   // By the chunk the head is in
+    int *targetStart, *targetList; // By the chunk the head moves into
+    int *cursor;                 // Sort scratch, one per chunk
+
+    // Worker pool; worker 0 is the calling thread
+    ArenaWorker workers[ARENA_MAX_THREADS];
+    int threadCount;
+    pthread_barrier_t start, done;
+    int pass;                    // Pass the workers run next, or ARENA_PASS_QUIT
+};
+
+enum {
+    ARENA_PASS_STEER,
+    ARENA_PASS_RESOLVE,
+    ARENA_PASS_MOVE,
+    ARENA_PASS_QUIT
+};
+
+static uint64_t arena_rand(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int arena_rand_range(uint64_t *state, int range) {
+    return (int)((arena_rand(state) >> 33) % (uint64_t)range);
+}
+
+static int chunk_of(const Arena *arena, int x, int y) {
+    return (y >> ARENA_CHUNK_BITS) * arena->chunksX + (x >> ARENA_CHUNK_BITS);
+}
+
+// Position of a cell in the chunk-major board
+static size_t cell_index(const Arena *arena, int x, int y) {
+    return (size_t)chunk_of(arena, x, y) * ARENA_CHUNK_CELLS +
+           ((y & (ARENA_CHUNK - 1)) << ARENA_CHUNK_BITS) + (x & (ARENA_CHUNK - 1));
+}
+
+static uint16_t cell_get(const Arena *arena, int x, int y) {
+    if (x < 0 || x >= arena->width || y < 0 || y >= arena->height) return ARENA_WALL;
+    return arena->cells[cell_index(arena, x, y)];
+}
+
+static void cell_set(Arena *arena, int x, int y, uint16_t value) {
+    arena->cells[cell_index(arena, x, y)] = value;
+}
+
+static bool cell_free(uint16_t cell) {
+    return cell == ARENA_EMPTY || cell == ARENA_FOOD;
+}
+
+static ArenaPoint snake_segment(const ArenaSnake *snake, int i) {
+    return snake->body[(snake->head - i + ARENA_MAX_LENGTH) % ARENA_MAX_LENGTH];
+}
+
+// Put a snake down with its head at (x, y) moving dx, dy, if the cells are free
+static bool place_snake(Arena *arena, int id, int x, int y, int dx, int dy) {
+    for (int i = -1; i < ARENA_SPAWN_LENGTH; i++) { // One free cell ahead as well
+        if (cell_get(arena, x - dx * i, y - dy * i) != ARENA_EMPTY) return false;
+    }
+
+    ArenaSnake *snake = &arena->snakes[id];
+    snake->length = ARENA_SPAWN_LENGTH;
+    snake->head = ARENA_SPAWN_LENGTH - 1;
+    snake->dx = (int8_t)dx;
+    snake->dy = (int8_t)dy;
+    snake->alive = true;
+    snake->dying = false;
+    for (int i = 0; i < ARENA_SPAWN_LENGTH; i++) {
+        ArenaPoint p = {(int16_t)(x - dx * i), (int16_t)(y - dy * i)};
+        snake->body[snake->head - i] = p;
+        cell_set(arena, p.x, p.y, (uint16_t)(id + ARENA_SNAKE_BASE));
+    }
+    return true;
+}
+
+static bool spawn_random(Arena *arena, int id) {
+    static const int directions[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    for (int attempt = 0; attempt < ARENA_SPAWN_ATTEMPTS; attempt++) {
+        int x = arena_rand_range(&arena->rng, arena->width);
+        int y = arena_rand_range(&arena->rng, arena->height);
+        const int *d = directions[arena_rand_range(&arena->rng, 4)];
+        if (place_snake(arena, id, x, y, d[0], d[1])) return true;
+    }
+    return false;
+}
+
+static void spawn_food(Arena *arena) {
+    for (int attempt = 0; attempt < ARENA_SPAWN_ATTEMPTS && arena->foodCount < arena->foodTarget; attempt++) {
+        int x = arena_rand_range(&arena->rng, arena->width);
+        int y = arena_rand_range(&arena->rng, arena->height);
+        if (cell_get(arena, x, y) == ARENA_EMPTY) {
+            cell_set(arena, x, y, ARENA_FOOD);
+            arena->foodCount++;
+        }
+    }
+}
+
+static int bucket_chunk(const Arena *arena, const ArenaSnake *snake, bool byTarget) {
+    if (!snake->alive) return -1;
+    if (byTarget) return snake->targetChunk;
+    ArenaPoint head = snake->body[snake->head];
+    return chunk_of(arena, head.x, head.y);
+}
+
+// Counting sort of the live snakes by chunk; ids stay in order inside each chunk
+static void bucket_snakes(Arena *arena, int *start, int *list, bool byTarget) {
+    int chunks = arena->chunksX * arena->chunksY;
+    memset(start, 0, sizeof(int) * (size_t)(chunks + 1));
+
+    for (int id = 0; id < arena->snakeCount; id++) {
+        int chunk = bucket_chunk(arena, &arena->snakes[id], byTarget);
+        if (chunk >= 0) start[chunk + 1]++;
+    }
+    for (int c = 0; c < chunks; c++) start[c + 1] += start[c];
+
+    int *cursor = arena->cursor;
+    memcpy(cursor, start, sizeof(int) * (size_t)chunks);
+    for (int id = 0; id < arena->snakeCount; id++) {
+        int chunk = bucket_chunk(arena, &arena->snakes[id], byTarget);
+        if (chunk >= 0) list[cursor[chunk]++] = id;
+    }
+}
+
+// Pick a direction for one bot: never into something solid if it can help it,
+// food first, then the move with the most room after it, straight on ties
+static void steer_bot(const Arena *arena, ArenaSnake *snake) {
+    ArenaPoint head = snake->body[snake->head];
+    int options[3][2] = {
+        {snake->dx, snake->dy},   // Straight
+        {snake->dy, -snake->dx},  // Left
+        {-snake->dy, snake->dx}   // Right
+    };
+    int bestScore = -1, best = 0;
+
+    for (int i = 0; i < 3; i++) {
+        int x = head.x + options[i][0], y = head.y + options[i][1];
+        uint16_t cell = cell_get(arena, x, y);
+        if (!cell_free(cell)) continue;
+
+        int room = cell_free(cell_get(arena, x + 1, y)) + cell_free(cell_get(arena, x - 1, y)) +
+                   cell_free(cell_get(arena, x, y + 1)) + cell_free(cell_get(arena, x, y - 1));
+        int score = (cell == ARENA_FOOD ? 64 : 0) + room * 8 + (i == 0 ? 4 : 0) + arena_rand_range(&snake->rng, 4);
+        if (score > bestScore) {
+            bestScore = score;
+            best = i;
+        }
+    }
+    snake->dx = (int8_t)options[best][0];
+    snake->dy = (int8_t)options[best][1];
+}
+
+// Pass 1, one chunk of heads: steer, then die on anything solid or record the target.
+// Only reads the board.
+static void steer_chunk(Arena *arena, int chunk) {
+    for (int i = arena->headStart[chunk]; i < arena->headStart[chunk + 1]; i++) {
+        ArenaSnake *snake = &arena->snakes[arena->headList[i]];
+        steer_bot(arena, snake);
+
+        ArenaPoint head = snake->body[snake->head];
+        int x = head.x + snake->dx, y = head.y + snake->dy;
+        uint16_t cell = cell_get(arena, x, y);
+        if (cell_free(cell)) {
+            snake->targetChunk = chunk_of(arena, x, y);
+            snake->eating = cell == ARENA_FOOD;
+        } else {
+            snake->targetChunk = -1;
+            snake->dying = true;
+        }
+    }
+}
+
+// Pass 2, one chunk of target cells: of the heads entering a cell, only a strictly
+// longest one survives. Two scans, so the result does not depend on visiting order.
+static void resolve_chunk(Arena *arena, ArenaWorker *worker, int chunk) {
+    int first = arena->targetStart[chunk], last = arena->targetStart[chunk + 1];
+    if (last - first < 2) return;
+
+    for (int i = first; i < last; i++) {
+        ArenaSnake *snake = &arena->snakes[arena->targetList[i]];
+        ArenaPoint head = snake->body[snake->head];
+        int cell = (int)(cell_index(arena, head.x + snake->dx, head.y + snake->dy) % ARENA_CHUNK_CELLS);
+        worker->bestLength[cell] = 0;
+        worker->bestCount[cell] = 0;
+    }
+    for (int i = first; i < last; i++) {
+        ArenaSnake *snake = &arena->snakes[arena->targetList[i]];
+        ArenaPoint head = snake->body[snake->head];
+        int cell = (int)(cell_index(arena, head.x + snake->dx, head.y + snake->dy) % ARENA_CHUNK_CELLS);
+        if (snake->length > worker->bestLength[cell]) {
+            worker->bestLength[cell] = snake->length;
+            worker->bestCount[cell] = 1;
+        } else if (snake->length == worker->bestLength[cell]) {
+            worker->bestCount[cell]++;
+        }
+    }
+    for (int i = first; i < last; i++) {
+        ArenaSnake *snake = &arena->snakes[arena->targetList[i]];
+        ArenaPoint head = snake->body[snake->head];
+        int cell = (int)(cell_index(arena, head.x + snake->dx, head.y + snake->dy) % ARENA_CHUNK_CELLS);
+        if (snake->length < worker->bestLength[cell] || worker->bestCount[cell] > 1) {
+            snake->dying = true;
+        }
+    }
+}
+
+// Pass 3, one snake: every cell written belongs to this snake or is its unique
+// target, so snakes can move in parallel without locks
+static void move_snake(Arena *arena, int id) {
+    ArenaSnake *snake = &arena->snakes[id];
+    if (!snake->alive) return;
+
+    if (snake->dying) {
+        for (int i = 0; i < snake->length; i++) {
+            ArenaPoint p = snake_segment(snake, i);
+            cell_set(arena, p.x, p.y, i % ARENA_FOOD_DROP == ARENA_FOOD_DROP - 1 ? ARENA_FOOD : ARENA_EMPTY);
+        }
+        snake->alive = false;
+        return;
+    }
+
+    ArenaPoint head = snake->body[snake->head];
+    ArenaPoint next = {(int16_t)(head.x + snake->dx), (int16_t)(head.y + snake->dy)};
+    bool grow = snake->eating && snake->length < ARENA_MAX_LENGTH;
+    if (!grow) {
+        ArenaPoint tail = snake_segment(snake, snake->length - 1);
+        cell_set(arena, tail.x, tail.y, ARENA_EMPTY);
+    } else {
+        snake->length++;
+    }
+    if (snake->eating) snake->score++;
+
+    snake->head = (snake->head + 1) % ARENA_MAX_LENGTH;
+    snake->body[snake->head] = next;
+    cell_set(arena, next.x, next.y, (uint16_t)(id + ARENA_SNAKE_BASE));
+}
+
+// Share of a chunk pass for one worker: whole chunks, split by how many snakes they hold
+static void run_chunk_pass(Arena *arena, ArenaWorker *worker, const int *start, bool resolve) {
+    int chunks = arena->chunksX * arena->chunksY;
+    int total = start[chunks];
+    int from = (int)((long long)total * worker->index / arena->threadCount);
+    int to = (int)((long long)total * (worker->index + 1) / arena->threadCount);
+
+    for (int c = 0; c < chunks; c++) {
+        if (start[c] < from || start[c] >= to || start[c] == start[c + 1]) continue;
+        if (resolve) {
+            resolve_chunk(arena, worker, c);
+        } else {
+            steer_chunk(arena, c);
+        }
+    }
+}
+
+static void run_pass(Arena *arena, ArenaWorker *worker) {
+    switch (arena->pass) {
+        case ARENA_PASS_STEER:
+            run_chunk_pass(arena, worker, arena->headStart, false);
+            break;
+        case ARENA_PASS_RESOLVE:
+            run_chunk_pass(arena, worker, arena->targetStart, true);
+            break;
+        case ARENA_PASS_MOVE: {
+            int from = arena->snakeCount * worker->index / arena->threadCount;
+            int to = arena->snakeCount * (worker->index + 1) / arena->threadCount;
+            for (int id = from; id < to; id++) move_snake(arena, id);
+            break;
+        }
+    }
+}
+
+static void *worker_main(void *data) {
+    ArenaWorker *worker = data;
+    Arena *arena = worker->arena;
+
+    while (true) {
+        pthread_barrier_wait(&arena->start);
+        if (arena->pass == ARENA_PASS_QUIT) break;
+        run_pass(arena, worker);
+        pthread_barrier_wait(&arena->done);
+    }
+    return NULL;
+}
+
+// Run one pass on every worker, the calling thread included, and wait for all of them
+static void parallel_pass(Arena *arena, int pass) {
+    arena->pass = pass;
+    pthread_barrier_wait(&arena->start);
+    run_pass(arena, &arena->workers[0]);
+    pthread_barrier_wait(&arena->done);
+}
+
+static void arena_tick(Arena *arena) {
+    bucket_snakes(arena, arena->headStart, arena->headList, false);
+    parallel_pass(arena, ARENA_PASS_STEER);
+
+    bucket_snakes(arena, arena->targetStart, arena->targetList, true);
+    parallel_pass(arena, ARENA_PASS_RESOLVE);
+
+    // Eaten food is decided before anyone moves, so count it here
+    for (int id = 0; id < arena->snakeCount; id++) {
+        ArenaSnake *snake = &arena->snakes[id];
+        if (snake->alive && !snake->dying && snake->eating) arena->foodCount--;
+        if (snake->alive && snake->dying) {
+            snake->deadSince = arena->tick;
+            arena->foodCount += snake->length / ARENA_FOOD_DROP;
+        }
+    }
+    parallel_pass(arena, ARENA_PASS_MOVE);
+
+    arena->tick++;
+    if (arena->respawn) {
+        for (int id = 0; id < arena->snakeCount; id++) {
+            ArenaSnake *snake = &arena->snakes[id];
+            if (!snake->alive && arena->tick - snake->deadSince >= ARENA_RESPAWN_TICKS) {
+                spawn_random(arena, id);
+            }
+        }
+    }
+    spawn_food(arena);
+}
+
+static bool arena_init(Arena *arena, int snakeCount, int threadCount, const LevelHeader *level, uint64_t seed) {
+    memset(arena, 0, sizeof(*arena));
+    arena->width = level ? level->width : ARENA_DEFAULT_WIDTH;
+    arena->height = level ? level->height : ARENA_DEFAULT_HEIGHT;
+    arena->chunksX = (arena->width + ARENA_CHUNK - 1) / ARENA_CHUNK;
+    arena->chunksY = (arena->height + ARENA_CHUNK - 1) / ARENA_CHUNK;
+    arena->snakeCount = snakeCount;
+    arena->threadCount = threadCount;
+    arena->rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    int chunks = arena->chunksX * arena->chunksY;
+    arena->cells = calloc((size_t)chunks * ARENA_CHUNK_CELLS, sizeof(uint16_t));
+    arena->snakes = calloc((size_t)snakeCount, sizeof(ArenaSnake));
+    arena->headStart = malloc(sizeof(int) * (size_t)(chunks + 1));
+    arena->targetStart = malloc(sizeof(int) * (size_t)(chunks + 1));
+    arena->headList = malloc(sizeof(int) * (size_t)snakeCount);
+    arena->targetList = malloc(sizeof(int) * (size_t)snakeCount);
+    arena->cursor = malloc(sizeof(int) * (size_t)chunks);
+    if (!arena->cells || !arena->snakes || !arena->headStart || !arena->targetStart ||
+        !arena->headList || !arena->targetList || !arena->cursor) {
+        return false;
+    }
+
+    // Padding cells past the board edge count as walls
+    for (int y = 0; y < arena->chunksY * ARENA_CHUNK; y++) {
+        for (int x = 0; x < arena->chunksX * ARENA_CHUNK; x++) {
+            bool wall = x >= arena->width || y >= arena->height ||
+                        (level && level_bit(level_walls(level), level->width, x, y));
+            if (wall) cell_set(arena, x, y, ARENA_WALL);
+        }
+    }
+
+    // The level's own spawn points first, then anywhere there is room
+    int placed = 0;
+    for (int id = 0; id < snakeCount; id++) {
+        ArenaSnake *snake = &arena->snakes[id];
+        snake->rng = (seed + 1) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)id + 1) * 0xBF58476D1CE4E5B9ULL;
+        snake->deadSince = -ARENA_RESPAWN_TICKS;
+
+        bool ok = false;
+        if (level && id < level->spawnCount) {
+            const LevelSpawn *spawn = &level_spawns(level)[id];
+            ok = place_snake(arena, id, spawn->x, spawn->y, spawn->dx, spawn->dy);
+        }
+        if (!ok) ok = spawn_random(arena, id);
+        placed += ok;
+    }
+    if (placed < snakeCount) {
+        log_warn("Only %d of %d snakes fit on the board", placed, snakeCount);
+    }
+
+    arena->foodTarget = snakeCount * ARENA_FOOD_PER_SNAKE;
+    spawn_food(arena);
+
+    if (pthread_barrier_init(&arena->start, NULL, (unsigned)threadCount) != 0 ||
+        pthread_barrier_init(&arena->done, NULL, (unsigned)threadCount) != 0) {
+        return false;
+    }
+    for (int i = 0; i < threadCount; i++) {
+        arena->workers[i].arena = arena;
+        arena->workers[i].index = i;
+        if (i > 0 && pthread_create(&arena->workers[i].thread, NULL, worker_main, &arena->workers[i]) != 0) {
+            log_error("Could not start worker %d", i);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void arena_destroy(Arena *arena) {
+    if (arena->threadCount > 1) {
+        arena->pass = ARENA_PASS_QUIT;
+        pthread_barrier_wait(&arena->start);
+        for (int i = 1; i < arena->threadCount; i++) pthread_join(arena->workers[i].thread, NULL);
+    }
+    pthread_barrier_destroy(&arena->start);
+    pthread_barrier_destroy(&arena->done);
+    free(arena->cells);
+    free(arena->snakes);
+    free(arena->headStart);
+    free(arena->targetStart);
+    free(arena->headList);
+    free(arena->targetList);
+    free(arena->cursor);
+}
+
+static int count_alive(const Arena *arena) {
+    int alive = 0;
+    for (int id = 0; id < arena->snakeCount; id++) alive += arena->snakes[id].alive;
+    return alive;
+}
+
+// FNV-1a over the board and scores, to compare runs across thread counts
+static uint64_t arena_checksum(const Arena *arena) {
+    uint64_t hash = 1469598103934665603ULL;
+    size_t cells = (size_t)arena->chunksX * arena->chunksY * ARENA_CHUNK_CELLS;
+    for (size_t i = 0; i < cells; i++) hash = (hash ^ arena->cells[i]) * 1099511628211ULL;
+    for (int id = 0; id < arena->snakeCount; id++) hash = (hash ^ arena->snakes[id].score) * 1099511628211ULL;
+    return hash;
+}
+
+static double seconds_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int snakeCount = 1000;
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int ticks = 1000;
+    int levelIndex = -1;
+    uint64_t seed = 1;
+    bool respawn = false;
+
+    int option;
+    while ((option = getopt(argc, argv, "n:t:k:l:s:r")) != -1) {
+        switch (option) {
+            case 'n': snakeCount = atoi(optarg); break;
+            case 't': threadCount = atoi(optarg); break;
+            case 'k': ticks = atoi(optarg); break;
+            case 'l': levelIndex = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'r': respawn = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-n snakes] [-t threads] [-k ticks] [-l level] [-s seed] [-r]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (snakeCount < 1 || snakeCount > ARENA_MAX_SNAKES) {
+        fprintf(stderr, "snakes must be 1..%d\n", ARENA_MAX_SNAKES);
+        return 1;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > ARENA_MAX_THREADS) threadCount = ARENA_MAX_THREADS;
+    log_init();
+
+    // Levels are optional; -l picks one from the pack, otherwise the board is open
+    LevelPack pack;
+    const LevelHeader *level = NULL;
+    if (levelIndex >= 0) {
+        if (!level_pack_open(&pack, LEVELS_FILE) || (level = level_pack_get(&pack, levelIndex)) == NULL) {
+            fprintf(stderr, "No level %d in %s\n", levelIndex, LEVELS_FILE);
+            return 1;
+        }
+    }
+
+    static Arena arena;
+    if (!arena_init(&arena, snakeCount, threadCount, level, seed)) {
+        fprintf(stderr, "Could not set up the arena\n");
+        return 1;
+    }
+    arena.respawn = respawn;
+    printf("%d snakes on %dx%d (%d chunks), %d threads\n", snakeCount, arena.width, arena.height,
+           arena.chunksX * arena.chunksY, threadCount);
+
+    double start = seconds_now();
+    long long snakeMoves = 0;
+    for (int t = 0; t < ticks; t++) {
+        int alive = count_alive(&arena);
+        if (alive <= 1 && !respawn) break;
+        snakeMoves += alive;
+        arena_tick(&arena);
+    }
+    double elapsed = seconds_now() - start;
+
+    int winner = -1;
+    uint32_t best = 0;
+    for (int id = 0; id < snakeCount; id++) {
+        if (arena.snakes[id].score > best || winner < 0) {
+            best = arena.snakes[id].score;
+            winner = id;
+        }
+    }
+    printf("%d ticks in %.3fs (%.0f ticks/s, %.1fM snake moves/s), %d alive\n", arena.tick, elapsed,
+           elapsed > 0 ? arena.tick / elapsed : 0.0, elapsed > 0 ? snakeMoves / elapsed / 1e6 : 0.0,
+           count_alive(&arena));
+    printf("Top score %u by snake %d, checksum %016llx\n", best, winner, (unsigned long long)arena_checksum(&arena));
+
+    arena_destroy(&arena);
+    if (level) level_pack_close(&pack);
+    return 0;
+}
@@ -0,0 +1,312 @@
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+// Logging that never blocks the thread that logs, shared by every program.
+//
+//   log_init();                          // once, at the top of main
+//   log_info("Reloaded %s", path);       // or log_debug / log_warn / log_error
+//
+// A call formats its message straight into a slot of the calling thread's own ring
+// and publishes it with one atomic store; there are no locks and no system calls.
+// A thread takes a free ring the first time it logs and hands it back when it
+// exits, so any number of threads can log over a run as long as no more than
+// LOG_MAX_THREADS of them are alive at once. A background thread merges
+// the rings in time order and writes them out, so a slow terminal or a full pipe
+// only ever holds up that thread. If a ring is full the message is dropped and
+// counted rather than waited for; the count is reported when the log closes.
+//
+// Environment:
+//   SNAKE_LOG        file to append to instead of stderr
+//   SNAKE_LOG_LEVEL  debug, info (default), warn or error
+//
+// log_init() registers log_shutdown() with atexit(), which waits for messages other
+// threads are in the middle of logging and writes out whatever is still queued.
+// Before log_init(), after log_shutdown(), and on systems without POSIX threads,
+// messages are written directly as they come.
+
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#define ASYNC_LOG_THREADED 1
+#endif
+
+#define LOG_MAX_THREADS 16 // Threads that can log at once; more are dropped
+#define LOG_RING_SIZE 128  // Records per thread (power of two)
+#define LOG_TEXT_SIZE 240  // Longer messages are cut short
+#define LOG_IDLE_WAIT 10   // ms the writer sleeps when every ring is empty
+
+typedef enum {
+    LOG_DEBUG,
+    LOG_INFO,
+    LOG_WARN,
+    LOG_ERROR
+} LogLevel;
+
+typedef struct {
+    uint64_t time;  // Wall clock, ns since the epoch
+    uint8_t level;
+    char text[LOG_TEXT_SIZE];
+} LogRecord;
+
+// Single-producer (the owning thread), single-consumer (the writer) ring
+typedef struct {
+    LogRecord records[LOG_RING_SIZE];
+    atomic_uint head; // Next record to write out; only the writer moves it
+    atomic_uint tail; // Next free record; only the owner moves it
+    atomic_ulong dropped;
+    atomic_bool owned; // A live thread logs into it
+} LogRing;
+
+static struct {
+    LogRing rings[LOG_MAX_THREADS];
+    atomic_ulong unregistered; // Messages from threads that found every ring taken
+    atomic_bool running;       // The writer thread is up
+    atomic_bool stopping;
+    atomic_int writers;        // Threads writing into a ring, which log_shutdown() waits out
+    LogLevel level;
+    _Atomic(FILE *) out;
+#ifdef ASYNC_LOG_THREADED
+    pthread_t writer;
+    pthread_key_t ringKey; // Hands a thread's ring back when it exits
+#endif
+} log_state;
+
+static _Thread_local LogRing *log_ring;
+
+#ifdef ASYNC_LOG_THREADED
+static pthread_mutex_t log_direct_lock = PTHREAD_MUTEX_INITIALIZER; // Direct writes against closing the file
+#endif
+
+static const char *const log_level_names[] = {"DEBUG", "INFO ", "WARN ", "ERROR"};
+static const char *const log_level_keys[] = {"debug", "info", "warn", "error"}; // SNAKE_LOG_LEVEL
+
+static inline uint64_t log_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// One line: local time to the millisecond, level, message
+static inline void log_emit(FILE *out, const LogRecord *record) {
+    time_t seconds = (time_t)(record->time / 1000000000u);
+    struct tm local;
+#ifdef ASYNC_LOG_THREADED
+    localtime_r(&seconds, &local);
+#else
+    local = *localtime(&seconds);
+#endif
+    fprintf(out, "%02d:%02d:%02d.%03d %s %s\n", local.tm_hour, local.tm_min, local.tm_sec,
+            (int)(record->time / 1000000u % 1000u), log_level_names[record->level], record->text);
+}
+
+static inline void log_record_format(LogRecord *record, LogLevel level, const char *format, va_list args) {
+    record->time = log_clock();
+    record->level = (uint8_t)level;
+    vsnprintf(record->text, sizeof(record->text), format, args);
+
+    // One record, one line
+    size_t length = strlen(record->text);
+    while (length > 0 && record->text[length - 1] == '\n') record->text[--length] = '\0';
+}
+
+#ifdef ASYNC_LOG_THREADED
+// Thread exit: the ring goes back for another thread to take. Whatever is still
+// queued in it is written out as usual, and the next owner carries on after it.
+static void log_ring_release(void *ring) {
+    log_ring = NULL;
+    atomic_store_explicit(&((LogRing *)ring)->owned, false, memory_order_release);
+}
+
+// The calling thread's ring, taking a free one if it has none yet: preferably one
+// the writer has emptied, so short-lived threads do not pile up in the same ring
+static inline LogRing *log_thread_ring(void) {
+    for (int pass = 0; log_ring == NULL && pass < 2; pass++) {
+        for (int i = 0; log_ring == NULL && i < LOG_MAX_THREADS; i++) {
+            LogRing *ring = &log_state.rings[i];
+            bool owned = false;
+            if (pass == 0 && atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+                                 atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+                continue;
+            }
+            if (atomic_compare_exchange_strong_explicit(&ring->owned, &owned, true, memory_order_acquire,
+                                                        memory_order_relaxed)) {
+                log_ring = ring;
+                pthread_setspecific(log_state.ringKey, log_ring);
+            }
+        }
+    }
+    return log_ring;
+}
+
+// Write out every queued record, oldest first across all threads. Returns how many.
+static inline int log_drain(FILE *out) {
+    int count = LOG_MAX_THREADS;
+    unsigned heads[LOG_MAX_THREADS], tails[LOG_MAX_THREADS];
+    for (int i = 0; i < count; i++) {
+        heads[i] = atomic_load_explicit(&log_state.rings[i].head, memory_order_relaxed);
+        tails[i] = atomic_load_explicit(&log_state.rings[i].tail, memory_order_acquire);
+    }
+
+    int written = 0;
+    while (true) {
+        int oldest = -1;
+        for (int i = 0; i < count; i++) {
+            if (heads[i] != tails[i] &&
+                (oldest < 0 || log_state.rings[i].records[heads[i] % LOG_RING_SIZE].time <
+                                   log_state.rings[oldest].records[heads[oldest] % LOG_RING_SIZE].time)) {
+                oldest = i;
+            }
+        }
+        if (oldest < 0) break;
+
+        LogRing *ring = &log_state.rings[oldest];
+        log_emit(out, &ring->records[heads[oldest] % LOG_RING_SIZE]);
+        heads[oldest]++;
+        atomic_store_explicit(&ring->head, heads[oldest], memory_order_release);
+        written++;
+    }
+    if (written > 0) fflush(out);
+    return written;
+}
+
+// Writer thread; `data` is the file to write to
+static void *log_writer_main(void *data) {
+    FILE *out = data;
+    while (true) {
+        bool stopping = atomic_load(&log_state.stopping);
+        if (log_drain(out) == 0) {
+            if (stopping) break;
+            struct timespec wait = {0, LOG_IDLE_WAIT * 1000000L};
+            nanosleep(&wait, NULL);
+        }
+    }
+    return NULL;
+}
+#endif
+
+// Direct write, for when there is no writer thread
+static inline void log_write_now(LogLevel level, const char *format, va_list args) {
+    LogRecord record;
+    log_record_format(&record, level, format, args);
+#ifdef ASYNC_LOG_THREADED
+    pthread_mutex_lock(&log_direct_lock);
+#endif
+    FILE *out = atomic_load(&log_state.out);
+    if (out == NULL) out = stderr;
+    log_emit(out, &record);
+    fflush(out);
+#ifdef ASYNC_LOG_THREADED
+    pthread_mutex_unlock(&log_direct_lock);
+#endif
+}
+
+static inline void log_vwrite(LogLevel level, const char *format, va_list args) {
+    if (level < log_state.level) return;
+
+#ifdef ASYNC_LOG_THREADED
+    // Counted in before looking at `running`, so log_shutdown() either sees this
+    // call and waits for its record to land, or this call sees the log shut down
+    atomic_fetch_add(&log_state.writers, 1);
+    if (atomic_load(&log_state.running)) {
+        LogRing *ring = log_thread_ring();
+        unsigned tail = ring ? atomic_load_explicit(&ring->tail, memory_order_relaxed) : 0;
+        if (ring == NULL) {
+            atomic_fetch_add(&log_state.unregistered, 1);
+        } else if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) == LOG_RING_SIZE) {
+            atomic_fetch_add(&ring->dropped, 1);
+        } else {
+            log_record_format(&ring->records[tail % LOG_RING_SIZE], level, format, args);
+            atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+        }
+        atomic_fetch_sub(&log_state.writers, 1);
+        return;
+    }
+    atomic_fetch_sub(&log_state.writers, 1);
+    log_write_now(level, format, args);
+#else
+    log_write_now(level, format, args);
+#endif
+}
+
+#if defined(__GNUC__)
+__attribute__((format(printf, 2, 3)))
+#endif
+static inline void log_write(LogLevel level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_vwrite(level, format, args);
+    va_end(args);
+}
+
+#define log_debug(...) log_write(LOG_DEBUG, __VA_ARGS__)
+#define log_info(...) log_write(LOG_INFO, __VA_ARGS__)
+#define log_warn(...) log_write(LOG_WARN, __VA_ARGS__)
+#define log_error(...) log_write(LOG_ERROR, __VA_ARGS__)
+
+// Write out what is still queued, stop the writer and close the file. Safe to call
+// more than once, and while other threads log; later messages are written
+// directly to stderr.
+static inline void log_shutdown(void) {
+#ifdef ASYNC_LOG_THREADED
+    bool running = atomic_exchange(&log_state.running, false);
+
+    // Messages already on their way into a ring get there first; anything logged
+    // from here on is written directly, and never to the file being closed
+    while (atomic_load(&log_state.writers) > 0) sched_yield();
+    pthread_mutex_lock(&log_direct_lock);
+    FILE *out = atomic_exchange(&log_state.out, NULL);
+    pthread_mutex_unlock(&log_direct_lock);
+
+    if (running) {
+        atomic_store(&log_state.stopping, true);
+        pthread_join(log_state.writer, NULL);
+        log_drain(out); // Anything published while the writer was stopping
+
+        unsigned long dropped = atomic_load(&log_state.unregistered);
+        for (int i = 0; i < LOG_MAX_THREADS; i++) dropped += atomic_load(&log_state.rings[i].dropped);
+        if (dropped > 0) fprintf(out, "(%lu log messages dropped)\n", dropped);
+    }
+#else
+    FILE *out = atomic_exchange(&log_state.out, NULL);
+#endif
+    if (out && out != stderr) fclose(out);
+}
+
+// Start the writer. Returns false if it could not be started, in which case
+// messages are written directly.
+static inline bool log_init(void) {
+    const char *level = getenv("SNAKE_LOG_LEVEL");
+    log_state.level = LOG_INFO;
+    if (level) {
+        for (int l = LOG_DEBUG; l <= LOG_ERROR; l++) {
+            if (strcmp(level, log_level_keys[l]) == 0) log_state.level = (LogLevel)l;
+        }
+    }
+
+    const char *path = getenv("SNAKE_LOG");
+    FILE *out = path ? fopen(path, "a") : NULL;
+    if (out == NULL) out = stderr;
+    atomic_store(&log_state.out, out);
+    atexit(log_shutdown);
+
+#ifdef ASYNC_LOG_THREADED
+    atomic_store(&log_state.stopping, false);
+    if (pthread_key_create(&log_state.ringKey, log_ring_release) != 0) return false;
+    if (pthread_create(&log_state.writer, NULL, log_writer_main, out) != 0) return false;
+    atomic_store_explicit(&log_state.running, true, memory_order_release);
+    return true;
+#else
+    return false;
+#endif
+}
+
+#endif
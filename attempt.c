@@ -6,6 +6,11 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "async_log.h"
+#include "metrics.h"
+#include "pool.h"
+#include "turns.h"
+
 // Original grid dimensions
 #define CELL_SIZE 20
 #define GRID_WIDTH 32  // 640 / 20
@@ -33,6 +38,15 @@
 // Highscore file name
 #define HIGHSCORE_FILE "highscore.dat"
 
+// A snake that fills the whole board needs one segment per cell
+#define MAX_SNAKE_LENGTH (GRID_WIDTH * GRID_HEIGHT)
+
+// Random probes place_food makes before falling back to a free-cell scan
+#define FOOD_PLACE_ATTEMPTS 64
+
+// Number of distinct boards whose Hamiltonian cycle is kept around
+#define CYCLE_CACHE_SIZE 4
+
 // Game states
 typedef enum {
     MENU,
@@ -45,7 +59,7 @@ typedef struct {
 } Segment;
 
 typedef struct {
-    Segment body[100]; 
+    Segment body[MAX_SNAKE_LENGTH]; 
     int length;
     int dx, dy;
     bool alive;
@@ -61,6 +75,24 @@ typedef struct {
     bool hover;
 } Button;
 
+// A Hamiltonian cycle over the free cells of a board
+typedef struct {
+    bool valid;
+    int width, height;
+    unsigned long long obstacleHash; // Hash of the obstacle layout the cycle was built for
+    bool blocked[MAX_SNAKE_LENGTH];  // That obstacle layout, to confirm a hash match
+    int length;                      // Number of cells on the cycle
+    int order[MAX_SNAKE_LENGTH];     // Cycle position -> cell (y * width + x)
+    int index[MAX_SNAKE_LENGTH];     // Cell -> cycle position, -1 for blocked cells
+} HamCycle;
+
+// Solver that follows a Hamiltonian cycle and takes safe shortcuts along it
+typedef struct {
+    bool enabled;
+    const HamCycle *cycle;
+    int direction; // +1 walks the cycle forwards, -1 walks it backwards
+} Autopilot;
+
 // Function prototypes
 void draw_grid(SDL_Renderer *renderer);
 void draw_snake(SDL_Renderer *renderer, Snake *snake);
@@ -68,22 +100,32 @@ void draw_food(SDL_Renderer *renderer, Food *food);
 void draw_segment(SDL_Renderer *renderer, int x, int y, char segment, int width, int height, int thickness);
 void draw_digit(SDL_Renderer *renderer, int x, int y, int digit, int width, int height, int thickness);
 void draw_score(SDL_Renderer *renderer, int score, int highscore, TTF_Font *font);
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, const LatencyStats *input, const LatencyStats *frames);
 void move_snake(Snake *snake);
 bool check_food_collision(Snake *snake, Food *food);
-void place_food(Food *food, Snake *snake);
+bool place_food(Food *food, Snake *snake);
 void grow_snake(Snake *snake);
+unsigned long long hash_obstacles(int width, int height, const bool *blocked);
+bool build_ham_cycle(HamCycle *cycle, int width, int height, const bool *blocked);
+const HamCycle *get_ham_cycle(int width, int height, const bool *blocked);
+void autopilot_engage(Autopilot *pilot, Snake *snake);
+void autopilot_steer(Autopilot *pilot, Snake *snake, Food *food);
+int run_solver_stress(int games);
 void init_button(Button *button, int x, int y, const char *text);
 void draw_button(SDL_Renderer *renderer, Button *button, TTF_Font *font);
 bool is_point_in_rect(int x, int y, SDL_Rect *rect);
 void draw_text(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
 void draw_text_centered(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
 void draw_welcome_screen(SDL_Renderer *renderer, Button *playButton, TTF_Font *font, int highscore);
-void draw_game_over_screen(SDL_Renderer *renderer, int score, int highscore, Button *playAgainButton, Button *exitButton, TTF_Font *font);
+void draw_game_over_screen(SDL_Renderer *renderer, int score, int highscore, bool perfect, Button *playAgainButton, Button *exitButton, TTF_Font *font);
 void reset_game(Snake *snake, Food *food, int *score);
 void draw_ui_area(SDL_Renderer *renderer, int score, int highscore, TTF_Font *font);
 int load_highscore(void);
 void save_highscore(int score);
 
+// Total number of random probes place_food had to retry
+unsigned long food_place_retries = 0;
+
 // Main function remains at the bottom
 
 void draw_grid(SDL_Renderer *renderer) {
@@ -260,6 +302,21 @@ void draw_score(SDL_Renderer *renderer, int score, int highscore, TTF_Font *font
     draw_ui_area(renderer, score, highscore, font);
 }
 
+// F3 overlay along the bottom: key press to screen, and time between frames
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, const LatencyStats *input, const LatencyStats *frames) {
+    SDL_Color white = {255, 255, 255, 255};
+    char line[128];
+    
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_Rect box = {0, WINDOW_HEIGHT - 50, WINDOW_WIDTH, 50};
+    SDL_RenderFillRect(renderer, &box);
+    
+    latency_format(input, "input to photon", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 48, white);
+    latency_format(frames, "frame", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 25, white);
+}
+
 void move_snake(Snake *snake) {
     // Move body segments
     for (int i = snake->length - 1; i > 0; i--) {
@@ -289,26 +346,47 @@ bool check_food_collision(Snake *snake, Food *food) {
     return (snake->body[0].x == food->x && snake->body[0].y == food->y);
 }
 
-void place_food(Food *food, Snake *snake) {
-    bool valid_position;
+// Place food on a free cell; returns false when the snake fills the board
+bool place_food(Food *food, Snake *snake) {
+    static bool occupied[MAX_SNAKE_LENGTH];
+    memset(occupied, 0, sizeof(occupied));
+    for (int i = 0; i < snake->length; i++) {
+        occupied[snake->body[i].y * GRID_WIDTH + snake->body[i].x] = true;
+    }
     
-    do {
-        valid_position = true;
-        food->x = rand() % GRID_WIDTH;
-        food->y = rand() % GRID_HEIGHT;
+    // Random probing is cheap while the board is mostly empty
+    for (int attempt = 0; attempt < FOOD_PLACE_ATTEMPTS; attempt++) {
+        int x = rand() % GRID_WIDTH;
+        int y = rand() % GRID_HEIGHT;
         
-        // Check if food is not on the snake
-        for (int i = 0; i < snake->length; i++) {
-            if (food->x == snake->body[i].x && food->y == snake->body[i].y) {
-                valid_position = false;
-                break;
-            }
+        if (!occupied[y * GRID_WIDTH + x]) {
+            food->x = x;
+            food->y = y;
+            return true;
         }
-    } while (!valid_position);
+        food_place_retries++;
+    }
+    
+    // Nearly full board: pick uniformly among the remaining free cells
+    int free_cells = MAX_SNAKE_LENGTH - snake->length;
+    if (free_cells <= 0) {
+        return false;
+    }
+    
+    int pick = rand() % free_cells;
+    for (int cell = 0; cell < MAX_SNAKE_LENGTH; cell++) {
+        if (!occupied[cell] && pick-- == 0) {
+            food->x = cell % GRID_WIDTH;
+            food->y = cell / GRID_WIDTH;
+            return true;
+        }
+    }
+    
+    return false;
 }
 
 void grow_snake(Snake *snake) {
-    if (snake->length < 100) {
+    if (snake->length < MAX_SNAKE_LENGTH) {
         // The new segment is initially placed at the same position as the last segment
         // It will move correctly in the next frame
         snake->body[snake->length] = snake->body[snake->length - 1];
@@ -316,6 +394,315 @@ void grow_snake(Snake *snake) {
     }
 }
 
+// FNV-1a hash of the blocked cells, used as part of the cycle cache key
+unsigned long long hash_obstacles(int width, int height, const bool *blocked) {
+    unsigned long long hash = 1469598103934665603ULL;
+    if (!blocked) return hash;
+    
+    for (int cell = 0; cell < width * height; cell++) {
+        if (blocked[cell]) {
+            hash ^= (unsigned long long)cell;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+// Build a Hamiltonian cycle for the board.
+// Rows are swept in a zigzag with column 0 kept free as the way back to the start
+// (or the transposed pattern when only the width is even). Boards with obstacles
+// or two odd dimensions are rejected.
+bool build_ham_cycle(HamCycle *cycle, int width, int height, const bool *blocked) {
+    cycle->valid = false;
+    cycle->width = width;
+    cycle->height = height;
+    cycle->obstacleHash = hash_obstacles(width, height, blocked);
+    cycle->length = 0;
+    
+    if (width < 2 || height < 2 || width * height > MAX_SNAKE_LENGTH) return false;
+    for (int cell = 0; cell < width * height; cell++) {
+        cycle->blocked[cell] = blocked && blocked[cell];
+    }
+    if (height % 2 != 0 && width % 2 != 0) return false;
+    
+    if (blocked) {
+        for (int cell = 0; cell < width * height; cell++) {
+            if (blocked[cell]) return false;
+        }
+    }
+    
+    // Sweep along the "major" axis and return along the first line of the minor axis
+    bool rows = (height % 2 == 0);
+    int major = rows ? width : height;
+    int minor = rows ? height : width;
+    
+    // The start cell sits on the return line
+    cycle->order[cycle->length++] = 0;
+    
+    for (int m = 0; m < minor; m++) {
+        for (int k = 0; k < major - 1; k++) {
+            int along = (m % 2 == 0) ? k + 1 : major - 1 - k;
+            int x = rows ? along : m;
+            int y = rows ? m : along;
+            cycle->order[cycle->length++] = y * width + x;
+        }
+    }
+    for (int m = minor - 1; m > 0; m--) {
+        int x = rows ? 0 : m;
+        int y = rows ? m : 0;
+        cycle->order[cycle->length++] = y * width + x;
+    }
+    
+    for (int cell = 0; cell < width * height; cell++) {
+        cycle->index[cell] = -1;
+    }
+    for (int i = 0; i < cycle->length; i++) {
+        cycle->index[cycle->order[i]] = i;
+    }
+    
+    cycle->valid = true;
+    return true;
+}
+
+// True if the cycle was built for exactly this obstacle layout, whose hash is `hash`.
+// The hash only rules layouts out quickly; two layouts can share one.
+static bool same_obstacles(const HamCycle *cycle, unsigned long long hash, int width, int height, const bool *blocked) {
+    if (cycle->width != width || cycle->height != height || cycle->obstacleHash != hash) return false;
+    if (width < 2 || height < 2 || width * height > MAX_SNAKE_LENGTH) return true; // Never valid
+    
+    for (int cell = 0; cell < width * height; cell++) {
+        if (cycle->blocked[cell] != (blocked && blocked[cell])) return false;
+    }
+    return true;
+}
+
+// Return the cached cycle for this board, building it on first use.
+// Restarts on the same board reuse the cached cycle for free.
+const HamCycle *get_ham_cycle(int width, int height, const bool *blocked) {
+    static HamCycle cache[CYCLE_CACHE_SIZE];
+    static int cached = 0;
+    static int next_slot = 0;
+    
+    unsigned long long hash = hash_obstacles(width, height, blocked);
+    for (int i = 0; i < cached; i++) {
+        if (same_obstacles(&cache[i], hash, width, height, blocked)) {
+            return cache[i].valid ? &cache[i] : NULL;
+        }
+    }
+    
+    // Evict the oldest entry once the cache is full
+    HamCycle *slot = &cache[next_slot];
+    next_slot = (next_slot + 1) % CYCLE_CACHE_SIZE;
+    if (cached < CYCLE_CACHE_SIZE) cached++;
+    
+    build_ham_cycle(slot, width, height, blocked);
+    return slot->valid ? slot : NULL;
+}
+
+// Position of a cell along the cycle in the direction the snake travels
+static int cycle_position(const Autopilot *pilot, int x, int y) {
+    const HamCycle *cycle = pilot->cycle;
+    int pos = cycle->index[y * cycle->width + x];
+    return pilot->direction > 0 ? pos : (cycle->length - pos) % cycle->length;
+}
+
+// Forward distance from cycle position a to b
+static int cycle_distance(const HamCycle *cycle, int a, int b) {
+    return (b - a + cycle->length) % cycle->length;
+}
+
+// Look up the cycle and pick the travel direction that matches the snake's body
+void autopilot_engage(Autopilot *pilot, Snake *snake) {
+    pilot->cycle = get_ham_cycle(GRID_WIDTH, GRID_HEIGHT, NULL);
+    pilot->direction = 1;
+    if (!pilot->cycle || snake->length < 2) return;
+    
+    int head = cycle_position(pilot, snake->body[0].x, snake->body[0].y);
+    int neck = cycle_position(pilot, snake->body[1].x, snake->body[1].y);
+    if (cycle_distance(pilot->cycle, neck, head) != 1) {
+        pilot->direction = -1;
+    }
+}
+
+// True if the body runs forwards along the cycle from tail to head without
+// wrapping past itself, so every cell ahead of the head up to the tail is free.
+// Shortcuts keep this true, but a body steered by hand before the autopilot
+// took over need not be.
+static bool body_on_cycle(const Autopilot *pilot, const Snake *snake) {
+    const HamCycle *cycle = pilot->cycle;
+    int span = 0;
+    int next = cycle_position(pilot, snake->body[snake->length - 1].x, snake->body[snake->length - 1].y);
+    
+    for (int i = snake->length - 2; i >= 0; i--) {
+        int pos = cycle_position(pilot, snake->body[i].x, snake->body[i].y);
+        span += cycle_distance(cycle, next, pos); // 0 for the doubled tail after eating
+        if (span >= cycle->length) return false;
+        next = pos;
+    }
+    return true;
+}
+
+static const int pilot_dirs[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+
+// Play a copy of the snake forwards: one move in direction `d`, then along the
+// cycle. Returns -1 once its body lies along the cycle, otherwise how many moves
+// it lived (up to `limit`).
+static int rejoin_moves(const Autopilot *pilot, const Snake *snake, const Food *food, int d, int limit) {
+    static Snake copy;
+    copy = *snake;
+    Food target = *food;
+    bool eaten = false;
+    
+    for (int moves = 0; moves < limit; moves++) {
+        copy.dx = pilot_dirs[d][0];
+        copy.dy = pilot_dirs[d][1];
+        move_snake(&copy);
+        if (!copy.alive) return moves;
+        if (!eaten && check_food_collision(&copy, &target)) {
+            grow_snake(&copy);
+            eaten = true;
+        }
+        if (body_on_cycle(pilot, &copy)) return -1;
+        
+        int head = cycle_position(pilot, copy.body[0].x, copy.body[0].y);
+        for (d = 0; d < 4; d++) {
+            int x = copy.body[0].x + pilot_dirs[d][0];
+            int y = copy.body[0].y + pilot_dirs[d][1];
+            if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) continue;
+            if (cycle_distance(pilot->cycle, head, cycle_position(pilot, x, y)) == 1) break;
+        }
+    }
+    return limit;
+}
+
+// True if, after moving in direction `d`, the head has a path to the tail
+// through free cells. The snake can then at least keep following its tail.
+static bool tail_reachable(const Snake *snake, int d) {
+    static bool seen[MAX_SNAKE_LENGTH];
+    static int queue[MAX_SNAKE_LENGTH];
+    int x = snake->body[0].x + pilot_dirs[d][0];
+    int y = snake->body[0].y + pilot_dirs[d][1];
+    if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) return false;
+    
+    // Body after the move: the old tail cell comes free, the old head does not
+    memset(seen, 0, sizeof(seen));
+    for (int i = 0; i < snake->length - 1; i++) {
+        seen[snake->body[i].y * GRID_WIDTH + snake->body[i].x] = true;
+    }
+    if (seen[y * GRID_WIDTH + x]) return false;
+    
+    const Segment *tail = &snake->body[snake->length - 2];
+    int head = 0, count = 0;
+    queue[count++] = y * GRID_WIDTH + x;
+    seen[y * GRID_WIDTH + x] = true;
+    while (head < count) {
+        int cell = queue[head++];
+        int cx = cell % GRID_WIDTH, cy = cell / GRID_WIDTH;
+        for (int n = 0; n < 4; n++) {
+            int nx = cx + pilot_dirs[n][0], ny = cy + pilot_dirs[n][1];
+            if (nx < 0 || nx >= GRID_WIDTH || ny < 0 || ny >= GRID_HEIGHT) continue;
+            if (nx == tail->x && ny == tail->y) return true;
+            if (seen[ny * GRID_WIDTH + nx]) continue;
+            seen[ny * GRID_WIDTH + nx] = true;
+            queue[count++] = ny * GRID_WIDTH + nx;
+        }
+    }
+    return false;
+}
+
+// Steer a body that is off the cycle back onto it: take the first move from
+// which following the cycle gets there alive. Failing that, keep a way to the
+// tail open and live as long as possible, and try again next move.
+static void autopilot_rejoin(Autopilot *pilot, Snake *snake, Food *food) {
+    int limit = snake->length + 2; // A body length along the cycle, plus food eaten
+    int best = -1;
+    int best_score = -1;
+    
+    for (int d = 0; d < 4; d++) {
+        if (pilot_dirs[d][0] == -snake->dx && pilot_dirs[d][1] == -snake->dy) continue;
+        
+        int moves = rejoin_moves(pilot, snake, food, d, limit);
+        if (moves < 0) {
+            best = d;
+            break;
+        }
+        int score = moves + (tail_reachable(snake, d) ? limit : 0);
+        if (score > best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+    
+    snake->dx = pilot_dirs[best][0];
+    snake->dy = pilot_dirs[best][1];
+}
+
+// Choose the next direction: follow the cycle, but jump ahead along it when the
+// jump cannot cut the snake off from its own tail
+void autopilot_steer(Autopilot *pilot, Snake *snake, Food *food) {
+    const HamCycle *cycle = pilot->cycle;
+    if (!cycle) return;
+    
+    // Shortcuts are only safe while the body lies along the cycle
+    if (!body_on_cycle(pilot, snake)) {
+        autopilot_rejoin(pilot, snake, food);
+        return;
+    }
+    
+    int n = cycle->length;
+    int head = cycle_position(pilot, snake->body[0].x, snake->body[0].y);
+    int tail = cycle_position(pilot, snake->body[snake->length - 1].x, snake->body[snake->length - 1].y);
+    int target = cycle_position(pilot, food->x, food->y);
+    
+    int to_tail = cycle_distance(cycle, head, tail);
+    int to_food = cycle_distance(cycle, head, target);
+    
+    // Keep a safety buffer for the segment gained from the next food
+    int empty = n - snake->length - 1;
+    int budget = to_tail - 4;
+    if (empty < n / 2) {
+        budget = 0; // Past half full there is no room to cut corners
+    } else if (to_food < to_tail) {
+        budget -= 1;
+        if ((to_tail - to_food) * 4 > empty) budget -= 10;
+    }
+    if (budget > to_food) budget = to_food;
+    if (budget < 1) budget = 1;
+    
+    int best = -1;
+    int best_distance = 0;
+    
+    for (int d = 0; d < 4; d++) {
+        int x = snake->body[0].x + pilot_dirs[d][0];
+        int y = snake->body[0].y + pilot_dirs[d][1];
+        if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) continue;
+        
+        int distance = cycle_distance(cycle, head, cycle_position(pilot, x, y));
+        if (distance == 0 || distance > budget) continue;
+        
+        // With the body along the cycle, anything between head and tail along it
+        // is free, so only the body itself needs checking
+        bool blocked = false;
+        for (int i = 1; i < snake->length - 1; i++) {
+            if (snake->body[i].x == x && snake->body[i].y == y) {
+                blocked = true;
+                break;
+            }
+        }
+        if (blocked) continue;
+        
+        if (distance > best_distance) {
+            best_distance = distance;
+            best = d;
+        }
+    }
+    
+    if (best >= 0) {
+        snake->dx = pilot_dirs[best][0];
+        snake->dy = pilot_dirs[best][1];
+    }
+}
+
 // Initialize a button
 void init_button(Button *button, int x, int y, const char *text) {
     button->rect.x = x;
@@ -409,18 +796,26 @@ void draw_welcome_screen(SDL_Renderer *renderer, Button *playButton, TTF_Font *f
 }
 
 // Draw game over screen with SDL_ttf, now including high score display
-void draw_game_over_screen(SDL_Renderer *renderer, int score, int highscore, Button *playAgainButton, Button *exitButton, TTF_Font *font) {
+void draw_game_over_screen(SDL_Renderer *renderer, int score, int highscore, bool perfect, Button *playAgainButton, Button *exitButton, TTF_Font *font) {
     // Semi-transparent overlay
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
     SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
     SDL_RenderFillRect(renderer, &overlay);
     
-    // Game over text
-    SDL_Color red = {255, 0, 0, 255};
-    draw_text_centered(renderer, font, "GAME OVER", 
-                     WINDOW_WIDTH / 2, 
-                     WINDOW_HEIGHT / 4 - 20, 
-                     red);
+    // Game over text (a snake that fills the board has won)
+    if (perfect) {
+        SDL_Color green = {0, 255, 0, 255};
+        draw_text_centered(renderer, font, "BOARD CLEARED!", 
+                         WINDOW_WIDTH / 2, 
+                         WINDOW_HEIGHT / 4 - 20, 
+                         green);
+    } else {
+        SDL_Color red = {255, 0, 0, 255};
+        draw_text_centered(renderer, font, "GAME OVER", 
+                         WINDOW_WIDTH / 2, 
+                         WINDOW_HEIGHT / 4 - 20, 
+                         red);
+    }
     
     // Score text
     char score_text[32];
@@ -470,15 +865,76 @@ void reset_game(Snake *snake, Food *food, int *score) {
     *score = 0;
 }
 
-int main() {
+// Headless stress run: the solver plays complete games as fast as it can.
+// Drives grow_snake up to MAX_SNAKE_LENGTH and place_food on a nearly full board.
+int run_solver_stress(int games) {
+    Snake snake;
+    Food food;
+    int score = 0;
+    Autopilot pilot = {true, NULL, 1};
+    int cleared = 0;
+    long total_ticks = 0;
+    clock_t start = clock();
+    
+    for (int game = 0; game < games; game++) {
+        reset_game(&snake, &food, &score);
+        autopilot_engage(&pilot, &snake);
+        if (!pilot.cycle) {
+            printf("No Hamiltonian cycle for a %dx%d board\n", GRID_WIDTH, GRID_HEIGHT);
+            return 1;
+        }
+        
+        // Following the cycle reaches any food within one lap
+        long max_ticks = (long)MAX_SNAKE_LENGTH * MAX_SNAKE_LENGTH;
+        long ticks = 0;
+        bool won = false;
+        
+        while (snake.alive && ticks < max_ticks) {
+            autopilot_steer(&pilot, &snake, &food);
+            move_snake(&snake);
+            ticks++;
+            
+            if (snake.alive && check_food_collision(&snake, &food)) {
+                grow_snake(&snake);
+                score += 10;
+                if (!place_food(&food, &snake)) {
+                    won = true;
+                    break;
+                }
+            }
+        }
+        
+        total_ticks += ticks;
+        if (won) cleared++;
+        printf("Game %d: length %d/%d, score %d, %ld ticks%s\n", game + 1, snake.length,
+               MAX_SNAKE_LENGTH, score, ticks, won ? " (board cleared)" : "");
+    }
+    
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Cleared %d/%d boards, %ld ticks in %.2fs (%.0f ticks/s), %lu food placement retries\n",
+           cleared, games, total_ticks, seconds, seconds > 0 ? total_ticks / seconds : 0.0,
+           food_place_retries);
+    return cleared == games ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    // Headless solver stress mode: ./attempt --solver-stress [games]
+    if (argc > 1 && strcmp(argv[1], "--solver-stress") == 0) {
+        srand(time(NULL));
+        return run_solver_stress(argc > 2 ? atoi(argv[2]) : 10);
+    }
+    
+    log_init();
+    metrics_start("attempt");
+    
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        log_error("SDL could not initialize! SDL_Error: %s", SDL_GetError());
         return 1;
     }
     
     // Initialize SDL_ttf
     if (TTF_Init() < 0) {
-        printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+        log_error("SDL_ttf could not initialize! SDL_ttf Error: %s", TTF_GetError());
         SDL_Quit();
         return 1;
     }
@@ -486,7 +942,7 @@ int main() {
     SDL_Window *window = SDL_CreateWindow("Snake Game", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                           WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_SHOWN);
     if (!window) {
-        printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Window could not be created! SDL_Error: %s", SDL_GetError());
         TTF_Quit();
         SDL_Quit();
         return 1;
@@ -494,7 +950,7 @@ int main() {
 
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (!renderer) {
-        printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Renderer could not be created! SDL_Error: %s", SDL_GetError());
         SDL_DestroyWindow(window);
         TTF_Quit();
         SDL_Quit();
@@ -504,7 +960,7 @@ int main() {
     // Load font - using DejaVuSans.ttf from the correct path
     TTF_Font *font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 24);
     if (!font) {
-        printf("Failed to load font! SDL_ttf Error: %s\n", TTF_GetError());
+        log_error("Failed to load font! SDL_ttf Error: %s", TTF_GetError());
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         TTF_Quit();
@@ -515,7 +971,7 @@ int main() {
     // Load a smaller font for the score using the same DejaVuSans.ttf
     TTF_Font *small_font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 18);
     if (!small_font) {
-        printf("Failed to load small font! SDL_ttf Error: %s\n", TTF_GetError());
+        log_warn("Failed to load small font! SDL_ttf Error: %s", TTF_GetError());
         small_font = font; // Use main font if small font fails to load
     }
 
@@ -558,9 +1014,18 @@ int main() {
     int score = 0;
     int mouseX, mouseY;
     
+    // Hamiltonian-cycle solver, toggled with TAB
+    Autopilot autopilot = {false, NULL, 1};
+    
     // Game speed control
     Uint32 lastUpdateTime = 0;
     const int UPDATE_INTERVAL = 150; // milliseconds between updates
+    
+    // Arrow keys wait here for their tick; F3 shows how long they take to reach the screen
+    TurnQueue turns = {0};
+    static LatencyStats inputLatency, frameTimes;
+    bool showProfiler = false;
+    Uint32 lastPresent = 0;
 
     while (running) {
         // Handle events
@@ -587,39 +1052,50 @@ int main() {
                     if (gameState == MENU && is_point_in_rect(mouseX, mouseY, &playButton.rect)) {
                         gameState = PLAYING;
                         reset_game(&snake, &food, &score);
+                        turn_queue_clear(&turns);
+                        if (autopilot.enabled) {
+                            autopilot_engage(&autopilot, &snake);
+                        }
                     } else if (gameState == GAME_OVER) {
                         if (is_point_in_rect(mouseX, mouseY, &playAgainButton.rect)) {
                             gameState = PLAYING;
                             reset_game(&snake, &food, &score);
+                            turn_queue_clear(&turns);
+                            if (autopilot.enabled) {
+                                autopilot_engage(&autopilot, &snake);
+                            }
                         } else if (is_point_in_rect(mouseX, mouseY, &exitButton.rect)) {
                             running = 0;
                         }
                     }
                 }
+            } else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3) {
+                showProfiler = !showProfiler;
             } else if (event.type == SDL_KEYDOWN && gameState == PLAYING) {
+                // Steering by hand takes over from the solver
+                if (event.key.keysym.sym != SDLK_TAB && event.key.keysym.sym != SDLK_ESCAPE) {
+                    autopilot.enabled = false;
+                }
+                
+                // Turns are queued and taken one per tick; 180-degree turns are dropped
                 switch (event.key.keysym.sym) {
                     case SDLK_UP:
-                        if (snake.dy == 0) { // Prevent 180-degree turns
-                            snake.dx = 0;
-                            snake.dy = -1;
-                        }
+                        turn_queue_push(&turns, snake.dx, snake.dy, 0, -1, event.key.timestamp);
                         break;
                     case SDLK_DOWN:
-                        if (snake.dy == 0) {  
-                            snake.dx = 0;
-                            snake.dy = 1;
-                        }
+                        turn_queue_push(&turns, snake.dx, snake.dy, 0, 1, event.key.timestamp);
                         break;
                     case SDLK_LEFT:
-                        if (snake.dx == 0) {  
-                            snake.dx = -1;
-                            snake.dy = 0;
-                        }
+                        turn_queue_push(&turns, snake.dx, snake.dy, -1, 0, event.key.timestamp);
                         break;
                     case SDLK_RIGHT:
-                        if (snake.dx == 0) {  
-                            snake.dx = 1;
-                            snake.dy = 0;
+                        turn_queue_push(&turns, snake.dx, snake.dy, 1, 0, event.key.timestamp);
+                        break;
+                    case SDLK_TAB:
+                        autopilot.enabled = !autopilot.enabled;
+                        if (autopilot.enabled) {
+                            turn_queue_clear(&turns);
+                            autopilot_engage(&autopilot, &snake);
                         }
                         break;
                     case SDLK_ESCAPE:
@@ -635,14 +1111,27 @@ int main() {
         // Update game state at fixed intervals
         if (gameState == PLAYING && currentTime - lastUpdateTime >= UPDATE_INTERVAL) {
             lastUpdateTime = currentTime;
+            uint64_t tickStart = metrics_clock();
+            alloc_watch_begin();
             if (snake.alive) {
+                Uint32 pressed;
+                if (turn_queue_take(&turns, &snake.dx, &snake.dy, &pressed)) {
+                    latency_turn_taken(&inputLatency, pressed);
+                }
+                if (autopilot.enabled) {
+                    autopilot_steer(&autopilot, &snake, &food);
+                }
                 move_snake(&snake);
                 
                 // Check food collision
                 if (check_food_collision(&snake, &food)) {
                     grow_snake(&snake);
-                    place_food(&food, &snake);
                     score += 10;
+                    
+                    // No free cell left means the snake filled the board
+                    if (!place_food(&food, &snake)) {
+                        snake.alive = false;
+                    }
                 }
             } else {
                 gameState = GAME_OVER;
@@ -653,7 +1142,10 @@ int main() {
                     save_highscore(highscore);
                 }
             }
+            alloc_watch_end("a tick");
+            metrics_tick(tickStart);
         }
+        metrics_game(score, snake.length, food_place_retries, autopilot.enabled ? "AUTOPILOT" : "CLASSIC");
 
         // Render based on game state
         switch (gameState) {
@@ -675,11 +1167,23 @@ int main() {
                 
             case GAME_OVER:
                 // Keep the game screen visible in the background
-                draw_game_over_screen(renderer, score, highscore, &playAgainButton, &exitButton, font);
+                draw_game_over_screen(renderer, score, highscore, snake.length == MAX_SNAKE_LENGTH,
+                                      &playAgainButton, &exitButton, font);
                 break;
         }
 
+        if (showProfiler) {
+            draw_profiler(renderer, small_font, &inputLatency, &frameTimes);
+        }
+
         SDL_RenderPresent(renderer);
+        metrics_frame();
+        
+        // Every turn taken so far is on screen now
+        Uint32 presentTime = SDL_GetTicks();
+        latency_presented(&inputLatency, presentTime);
+        if (lastPresent != 0) latency_record(&frameTimes, presentTime - lastPresent);
+        lastPresent = presentTime;
         
         // Cap the frame rate
         SDL_Delay(16); // ~60 FPS
@@ -1,15 +1,24 @@
 #include <SDL.h>
 #include <SDL_ttf.h>
+#include "challenge_rules.h"
+#include "async_log.h"
+#include "metrics.h"
+#include "pool.h"
+#include "turns.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stddef.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
 
-// Original grid dimensions
+// Original grid dimensions (GRID_WIDTH x GRID_HEIGHT cells, see challenge_rules.h)
 #define CELL_SIZE 20
-#define GRID_WIDTH 32  // 640 / 20
-#define GRID_HEIGHT 24 // 480 / 20
 
 // UI dimensions
 #define UI_HEIGHT 60  // Height of the UI area above the grid
@@ -34,9 +43,33 @@
 #define CHECKBOX_SIZE 20
 #define CHECKBOX_PADDING 10
 
-// Max number of obstacles and foods
-#define MAX_OBSTACLES 30
-#define MAX_FOODS 5
+// Renderer
+#define FRAME_INTERVAL 16 // ms between redraws (~60 FPS)
+
+// Handcrafted maps built by mklevels
+#define LEVELS_FILE "levels.pak"
+
+// Mode definitions, watched for changes while the game runs
+#define MODES_FILE "modes.cfg"
+#define MODES_DIR "."
+
+// Suspended round, written whenever the window loses focus or closes mid-game
+#define SAVE_FILE "challenge.sav"
+#define SAVE_MAGIC "SNSV"
+#define SAVE_VERSION 2
+
+// Video export: Y4M files written by a background encoder thread
+#define EXPORT_QUEUE_SIZE 8 // Frames waiting for the encoder; live capture drops frames beyond this
+#define EXPORT_FPS 60
+
+// Simulation thread
+#define INPUT_QUEUE_SIZE 64   // Commands in flight from the main thread (power of two)
+#define SIM_IDLE_WAIT 100     // ms the sim thread sleeps when nothing is scheduled
+#define SNAPSHOT_FRESH 4      // Flag in SnapshotBuffer.middle: holds an unread snapshot
+
+// Virtual clock speeds, in game ms per 1000 real ms
+#define CLOCK_RATE_COUNT 8
+#define CLOCK_RATE_NORMAL 3 // Index of 1x in clock_rates
 
 // Game states
 typedef enum {
@@ -45,74 +78,137 @@ typedef enum {
     GAME_OVER
 } GameState;
 
-// Game feature flags
 typedef struct {
-    bool movingFruit;
-    bool multiFruit;
-    bool timed;
-    bool obstacles;
-    bool speed;
-    bool chaos;
-} GameFeatures;
+    SDL_Rect rect;
+    char text[30];
+    bool hover;
+    bool checked;  // For checkboxes
+    bool isCheckbox;
+} Button;
 
+// Per-game virtual clock. All game logic runs on this time, which starts at 0 when
+// a game begins and only moves forward while the game is running.
 typedef struct {
-    int x, y;
-} Segment;
+    Uint32 now;      // Virtual ms since the game started
+    Uint32 lastReal; // Wall-clock time the clock was last advanced at
+    Uint32 carry;    // Leftover fraction of a virtual ms, in 1/1000 ms
+    int rateIndex;   // Index into clock_rates
+    bool paused;
+} GameClock;
+
+// Everything the main thread asks of the simulation thread
+typedef enum {
+    SIM_START,      // Begin a round with features, level and seed
+    SIM_STOP,       // Abandon the round (back to the menu)
+    SIM_TURN,       // Steer the snake to dx, dy
+    SIM_PAUSE,      // Toggle the game clock's pause
+    SIM_CLOCK_RATE, // Change the clock speed by `value` steps (0: back to 1x)
+    SIM_SUSPEND,    // Pause the round and write it to SAVE_FILE
+    SIM_RESUME,     // Continue the round in `save` (the sim thread frees it)
+    SIM_QUIT
+} SimCommandType;
 
 typedef struct {
-    Segment body[100]; 
-    int length;
+    SimCommandType type;
     int dx, dy;
-    bool alive;
-} Snake;
+    Uint32 timestamp; // SIM_TURN: when the key was pressed
+    int value;
+    GameFeatures features;
+    const LevelHeader *level;
+    Uint64 seed;
+    int gameId;
+    struct SaveState *save;
+} SimCommand;
+
+// Flat image of a round in progress, written and read in one piece. Pointers in
+// `config` are cleared on save and rebuilt on load; everything else, including the
+// PRNG and every timer, comes back exactly as it was.
+typedef struct SaveState {
+    char magic[4];                     // SAVE_MAGIC
+    Uint32 version;                    // SAVE_VERSION
+    Uint32 size;                       // sizeof(SaveState), catches layout changes between builds
+    Sint32 levelIndex;                 // Level pack entry, -1 for the open board
+    char levelName[LEVEL_NAME_LENGTH]; // Must still match, in case the pack was rebuilt
+    Sint32 score;
+    Snake snake;
+    GameConfig config;
+    Scheduler scheduler;
+    GameClock clock;
+} SaveState;
 
+// Single-producer (main thread), single-consumer (sim thread) ring
 typedef struct {
-    int x, y;
-    int value;   // Point value
-    int type;    // Visual type
-    bool moving; // Whether it moves
-    int dx, dy;  // Direction for moving fruits
-} Food;
+    SimCommand items[INPUT_QUEUE_SIZE];
+    SDL_atomic_t head; // Next slot to read; only the sim thread moves it
+    SDL_atomic_t tail; // Next slot to write; only the main thread moves it
+} InputQueue;
 
+// Immutable copy of the game state for the renderer
 typedef struct {
-    int x, y;
-    int dx, dy;  // Direction for moving obstacles
-    bool moving; // Whether it moves
-} Obstacle;
+    Snake snake;
+    GameConfig config;
+    int score;
+    int gameId;   // Round this snapshot belongs to
+    bool playing; // False once the round has ended
+    bool paused;
+    int rateIndex;
+    Uint32 turnsTaken;  // Queued turns the snake has made so far
+    Uint32 turnPressed; // Key press time of the newest of them
+} GameSnapshot;
 
+// Triple buffer: the sim thread writes `back`, the renderer reads `front`, and the
+// two swap through `middle` so neither ever waits or sees a half-written snapshot
 typedef struct {
-    SDL_Rect rect;
-    char text[30];
-    bool hover;
-    bool checked;  // For checkboxes
-    bool isCheckbox;
-} Button;
+    GameSnapshot buffers[3];
+    SDL_atomic_t middle; // Buffer index, plus SNAPSHOT_FRESH when it is newer than `front`
+    int back;            // Sim thread only
+    int front;           // Render thread only
+} SnapshotBuffer;
 
 typedef struct {
-    bool timed;
-    int timeRemaining; // In seconds
-    int maxTime;       // Starting time
-    
-    bool hasObstacles;
-    Obstacle obstacles[MAX_OBSTACLES];
-    int obstacleCount;
-    bool movingObstacles;
-    int obstacleMoveInterval;
-    Uint32 lastObstacleMove;
-    
-    bool movingFruit;
-    int fruitMoveInterval; // How often the fruit moves (in milliseconds)
-    Uint32 lastFruitMove;  // Time of last fruit movement
-    
-    bool multiFruit;
-    Food foods[MAX_FOODS];
-    int foodCount;
-    
-    bool speed;
-    int updateDelay; // Basic snake speed
-    
-    char modeName[50]; // Name of the current mode configuration
-} GameConfig;
+    InputQueue input;
+    SnapshotBuffer snapshots;
+    SDL_sem *wake; // Posted with every command so the sim thread reacts at once
+    SDL_Thread *thread;
+    
+    // Owned by the sim thread
+    Snake snake;
+    GameConfig config;
+    Scheduler scheduler;
+    GameClock clock;
+    int score;
+    int gameId;
+    bool playing;
+    TurnQueue turns; // Arrow keys waiting for their snake step
+    Uint32 turnsTaken;
+    Uint32 turnPressed;
+} Simulation;
+
+// Frames read back from the offscreen target, handed to the encoder thread
+typedef struct {
+    Uint32 *frames[EXPORT_QUEUE_SIZE]; // ARGB8888, WINDOW_WIDTH x WINDOW_HEIGHT
+    int head;                          // Oldest queued frame
+    int count;                         // Frames queued or being encoded
+    bool stopping;
+    SDL_mutex *lock;
+    SDL_cond *queued; // A frame was queued, or the exporter is stopping
+    SDL_cond *freed;  // The encoder finished a frame
+    SDL_Thread *thread;
+    FILE *file;
+    Uint8 *yuv; // Encoder's I420 conversion buffer
+    int written;
+    int dropped;
+} FrameExporter;
+
+// Mode parameters for the next round
+ModeTable modes;
+
+// Levels from LEVELS_FILE; empty if it could not be loaded
+LevelPack levelPack;
+
+static const Uint32 clock_rates[CLOCK_RATE_COUNT] = {
+    250, 500, 750, 1000, 2000, 10000, 100000, 1000000 // 0.25x slow motion up to 1000x
+};
 
 // Function prototypes
 void draw_grid(SDL_Renderer *renderer);
@@ -122,12 +218,8 @@ void draw_obstacles(SDL_Renderer *renderer, GameConfig *config);
 void draw_segment(SDL_Renderer *renderer, int x, int y, char segment, int width, int height, int thickness);
 void draw_digit(SDL_Renderer *renderer, int x, int y, int digit, int width, int height, int thickness);
 void draw_score(SDL_Renderer *renderer, int score, TTF_Font *font);
-void move_snake(Snake *snake);
-bool check_food_collision(Snake *snake, Food *food);
-bool check_obstacle_collision(Snake *snake, GameConfig *config);
-void place_food(Food *food, Snake *snake, GameConfig *config);
-void place_obstacles(GameConfig *config, Snake *snake);
-void grow_snake(Snake *snake);
+int next_playable_level(int current);
+void draw_walls(SDL_Renderer *renderer, GameConfig *config);
 void init_button(Button *button, int x, int y, const char *text, bool isCheckbox);
 void draw_button(SDL_Renderer *renderer, Button *button, TTF_Font *font);
 void draw_checkbox(SDL_Renderer *renderer, Button *checkbox, TTF_Font *font);
@@ -135,16 +227,34 @@ bool is_point_in_rect(int x, int y, SDL_Rect *rect);
 void draw_text(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
 void draw_text_centered(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
 void draw_challenge_menu(SDL_Renderer *renderer, Button checkboxes[], int checkboxCount, 
-    Button *chaosButton, Button *playButton, Button *exitButton, TTF_Font *font);
+    Button *chaosButton, Button *levelButton, Button *playButton, Button *exitButton, TTF_Font *font);
 void draw_game_over_screen(SDL_Renderer *renderer, int score, Button *playAgainButton, Button *exitButton, TTF_Font *font);
-void reset_game(Snake *snake, GameConfig *config, int *score);
 void draw_ui_area(SDL_Renderer *renderer, int score, GameConfig *config, TTF_Font *font);
-void move_foods(GameConfig *config);
-void move_obstacles(GameConfig *config);
-void configure_game(GameConfig *config, GameFeatures *features, Snake *snake);
-void initialize_multi_fruits(GameConfig *config, Snake *snake);
-void update_game(Snake *snake, GameConfig *config, int *score, Uint32 currentTime);
-void generate_mode_name(GameConfig *config, GameFeatures *features);
+int mode_watch_open(void);
+bool mode_watch_changed(int fd);
+void clock_start(GameClock *clock, Uint32 realNow);
+Uint32 clock_advance(GameClock *clock, Uint32 realNow);
+void clock_set_rate(GameClock *clock, int rateIndex, Uint32 realNow);
+void clock_toggle_pause(GameClock *clock, Uint32 realNow);
+Uint32 clock_real_delay(GameClock *clock, Uint32 virtualDelay);
+void steer_simulated(Snake *snake, GameConfig *config);
+int run_simulation(Uint64 seed, int games, int levelIndex);
+Simulation *sim_create(void);
+void sim_destroy(Simulation *sim);
+void sim_send(Simulation *sim, const SimCommand *command);
+const GameSnapshot *sim_latest(Simulation *sim);
+void save_capture(SaveState *save, const Snake *snake, const GameConfig *config,
+    const Scheduler *scheduler, const GameClock *clock, int score);
+bool save_write(const char *path, const SaveState *save);
+bool save_read(const char *path, SaveState *save);
+void draw_playing(SDL_Renderer *renderer, const Snake *snake, const GameConfig *config, int score,
+    bool paused, int rateIndex, TTF_Font *font);
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, int fps, const LatencyStats *input, const LatencyStats *frames);
+FrameExporter *exporter_open(const char *path);
+bool exporter_capture(FrameExporter *exporter, SDL_Renderer *renderer, bool wait);
+void exporter_close(FrameExporter *exporter);
+SDL_Texture *create_capture_target(SDL_Renderer *renderer);
+int run_export(Uint64 seed, int levelIndex, const char *path);
 
 // Drawing functions
 void draw_grid(SDL_Renderer *renderer) {
@@ -217,6 +327,20 @@ void draw_food(SDL_Renderer *renderer, Food *food) {
     SDL_RenderFillRect(renderer, &rect);
 }
 
+void draw_walls(SDL_Renderer *renderer, GameConfig *config) {
+    if (!config->level) return;
+    
+    SDL_SetRenderDrawColor(renderer, 70, 70, 110, 255);
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        for (int x = 0; x < GRID_WIDTH; x++) {
+            if (cell_is_wall(config, x, y)) {
+                SDL_Rect rect = {x * CELL_SIZE, y * CELL_SIZE + UI_HEIGHT, CELL_SIZE, CELL_SIZE};
+                SDL_RenderFillRect(renderer, &rect);
+            }
+        }
+    }
+}
+
 void draw_obstacles(SDL_Renderer *renderer, GameConfig *config) {
     if (!config->hasObstacles) return;
     
@@ -334,167 +458,6 @@ void draw_score(SDL_Renderer *renderer, int score, TTF_Font *font) {
     draw_ui_area(renderer, score, &config, font);
 }
 
-// Game logic functions
-void move_snake(Snake *snake) {
-    // Move body segments
-    for (int i = snake->length - 1; i > 0; i--) {
-        snake->body[i] = snake->body[i - 1];
-    }
-    
-    // Move head
-    snake->body[0].x += snake->dx;
-    snake->body[0].y += snake->dy;
-
-    // Check wall collision
-    if (snake->body[0].x < 0 || snake->body[0].x >= GRID_WIDTH ||
-        snake->body[0].y < 0 || snake->body[0].y >= GRID_HEIGHT) {
-        snake->alive = false;
-    }
-    
-    // Check self collision
-    for (int i = 1; i < snake->length; i++) {
-        if (snake->body[0].x == snake->body[i].x && snake->body[0].y == snake->body[i].y) {
-            snake->alive = false;
-            break;
-        }
-    }
-}
-
-bool check_food_collision(Snake *snake, Food *food) {
-    return (snake->body[0].x == food->x && snake->body[0].y == food->y);
-}
-
-bool check_obstacle_collision(Snake *snake, GameConfig *config) {
-    if (!config->hasObstacles) return false;
-    
-    for (int i = 0; i < config->obstacleCount; i++) {
-        if (snake->body[0].x == config->obstacles[i].x && 
-            snake->body[0].y == config->obstacles[i].y) {
-            return true;
-        }
-    }
-    return false;
-}
-
-void place_food(Food *food, Snake *snake, GameConfig *config) {
-    bool valid_position = false;
-    int x, y;
-    
-    while (!valid_position) {
-        x = rand() % GRID_WIDTH;
-        y = rand() % GRID_HEIGHT;
-        valid_position = true;
-        
-        // Check if the position is not occupied by the snake
-        for (int i = 0; i < snake->length; i++) {
-            if (x == snake->body[i].x && y == snake->body[i].y) {
-                valid_position = false;
-                break;
-            }
-        }
-        
-        // Check if the position is not occupied by an obstacle
-        if (valid_position && config->hasObstacles) {
-            for (int i = 0; i < config->obstacleCount; i++) {
-                if (x == config->obstacles[i].x && y == config->obstacles[i].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
-        }
-        
-        // Check if the position is not occupied by another food item
-        if (valid_position && config->multiFruit) {
-            for (int i = 0; i < config->foodCount; i++) {
-                if (x == config->foods[i].x && y == config->foods[i].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
-        }
-    }
-    
-    food->x = x;
-    food->y = y;
-    
-    // For moving fruit
-    if (config->movingFruit && food->moving) {
-        // Randomly assign an initial direction
-        do {
-            food->dx = (rand() % 3) - 1; // -1, 0, or 1
-            food->dy = (rand() % 3) - 1; // -1, 0, or 1
-        } while (food->dx == 0 && food->dy == 0); // Ensure it's not stationary
-    }
-}
-
-void place_obstacles(GameConfig *config, Snake *snake) {
-    if (!config->hasObstacles) return;
-    
-    config->obstacleCount = rand() % (MAX_OBSTACLES / 2) + (MAX_OBSTACLES / 2); // 15-30 obstacles
-    
-    for (int i = 0; i < config->obstacleCount; i++) {
-        bool valid_position = false;
-        int x, y;
-        
-        while (!valid_position) {
-            x = rand() % GRID_WIDTH;
-            y = rand() % GRID_HEIGHT;
-            valid_position = true;
-            
-            // Check if the position is not occupied by the snake
-            for (int j = 0; j < snake->length; j++) {
-                if (x == snake->body[j].x && y == snake->body[j].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
-            
-            // Check if the position is not occupied by food
-            for (int j = 0; j < config->foodCount; j++) {
-                if (x == config->foods[j].x && y == config->foods[j].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
-            
-            // Check if the position is not occupied by another obstacle
-            for (int j = 0; j < i; j++) {
-                if (x == config->obstacles[j].x && y == config->obstacles[j].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
-            
-            // Make sure there's enough space around the snake's head
-            if (abs(x - snake->body[0].x) < 3 && abs(y - snake->body[0].y) < 3) {
-                valid_position = false;
-            }
-        }
-        
-        config->obstacles[i].x = x;
-        config->obstacles[i].y = y;
-        
-        // For moving obstacles
-        if (config->movingObstacles && rand() % 3 == 0) { // 1/3 chance to be moving
-            config->obstacles[i].moving = true;
-            // Randomly assign an initial direction
-            do {
-                config->obstacles[i].dx = (rand() % 3) - 1; // -1, 0, or 1
-                config->obstacles[i].dy = (rand() % 3) - 1; // -1, 0, or 1
-            } while (config->obstacles[i].dx == 0 && config->obstacles[i].dy == 0);
-        } else {
-            config->obstacles[i].moving = false;
-        }
-    }
-}
-
-void grow_snake(Snake *snake) {
-    if (snake->length < 100) {
-        snake->body[snake->length] = snake->body[snake->length - 1];
-        snake->length++;
-    }
-}
-
 void init_button(Button *button, int x, int y, const char *text, bool isCheckbox) {
     if (isCheckbox) {
         button->rect.x = x;
@@ -601,7 +564,7 @@ void draw_text_centered(SDL_Renderer *renderer, TTF_Font *font, const char *text
     SDL_DestroyTexture(texture);
 }
 void draw_challenge_menu(SDL_Renderer *renderer, Button checkboxes[], int checkboxCount, 
-    Button *chaosButton, Button *playButton, Button *exitButton, TTF_Font *font) {
+    Button *chaosButton, Button *levelButton, Button *playButton, Button *exitButton, TTF_Font *font) {
 // Draw background
 SDL_SetRenderDrawColor(renderer, 20, 20, 30, 255);
 SDL_RenderClear(renderer);
@@ -618,6 +581,9 @@ draw_checkbox(renderer, &checkboxes[i], font);
 // Draw chaos button
 draw_button(renderer, chaosButton, font);
 
+// Draw level selector
+draw_button(renderer, levelButton, font);
+
 // Draw play and exit buttons
 draw_button(renderer, playButton, font);
 draw_button(renderer, exitButton, font);
@@ -641,293 +607,874 @@ void draw_game_over_screen(SDL_Renderer *renderer, int score, Button *playAgainB
     draw_button(renderer, exitButton, font);
 }
 
-void reset_game(Snake *snake, GameConfig *config, int *score) {
-    // Reset snake
-    snake->length = 3;
-    snake->body[0].x = GRID_WIDTH / 2;
-    snake->body[0].y = GRID_HEIGHT / 2;
-    snake->body[1].x = GRID_WIDTH / 2 - 1;
-    snake->body[1].y = GRID_HEIGHT / 2;
-    snake->body[2].x = GRID_WIDTH / 2 - 2;
-    snake->body[2].y = GRID_HEIGHT / 2;
-    snake->dx = 1;
-    snake->dy = 0;
-    snake->alive = true;
-    
-    // Reset score
-    *score = 0;
-    
-    // Reset time for timed mode
-    if (config->timed) {
-        config->timeRemaining = config->maxTime;
+// Next level after `current` that can be played here, or -1 for the open board
+int next_playable_level(int current) {
+    for (int i = current + 1; i < level_pack_count(&levelPack); i++) {
+        if (level_fits_board(level_pack_get(&levelPack, i))) return i;
+    }
+    return -1;
+}
+
+// Start a new game's clock at virtual time 0, keeping the chosen speed
+void clock_start(GameClock *clock, Uint32 realNow) {
+    clock->now = 0;
+    clock->lastReal = realNow;
+    clock->carry = 0;
+    clock->paused = false;
+}
+
+// Move virtual time forward by the wall-clock time since the last call, scaled by the rate
+Uint32 clock_advance(GameClock *clock, Uint32 realNow) {
+    Uint32 elapsed = realNow - clock->lastReal;
+    clock->lastReal = realNow;
+    if (clock->paused) return clock->now;
+    
+    Uint64 scaled = (Uint64)elapsed * clock_rates[clock->rateIndex] + clock->carry;
+    clock->now += (Uint32)(scaled / 1000);
+    clock->carry = (Uint32)(scaled % 1000);
+    return clock->now;
+}
+
+void clock_set_rate(GameClock *clock, int rateIndex, Uint32 realNow) {
+    if (rateIndex < 0 || rateIndex >= CLOCK_RATE_COUNT) return;
+    clock_advance(clock, realNow); // Time so far still counts at the old rate
+    clock->rateIndex = rateIndex;
+}
+
+void clock_toggle_pause(GameClock *clock, Uint32 realNow) {
+    clock_advance(clock, realNow);
+    clock->paused = !clock->paused;
+}
+
+// Wall-clock ms until `virtualDelay` game ms have passed (rounded up so we never wake early)
+Uint32 clock_real_delay(GameClock *clock, Uint32 virtualDelay) {
+    Uint32 rate = clock_rates[clock->rateIndex];
+    Uint64 needed = (Uint64)virtualDelay * 1000;
+    if (needed <= clock->carry) return 0;
+    return (Uint32)((needed - clock->carry + rate - 1) / rate);
+}
+
+// Watch the directory rather than the file, since editors usually save by replacing it.
+// Returns -1 where inotify is unavailable; the file is then only read at startup.
+int mode_watch_open(void) {
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+    if (inotify_add_watch(fd, MODES_DIR, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+// Drain pending events without blocking; true if MODES_FILE was written or replaced
+bool mode_watch_changed(int fd) {
+    bool changed = false;
+#ifdef __linux__
+    if (fd < 0) return false;
+    
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (char *p = buffer; p < buffer + length; ) {
+            struct inotify_event *event = (struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, MODES_FILE) == 0) {
+                changed = true;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#else
+    (void)fd;
+#endif
+    return changed;
+}
+
+// Deterministic stand-in for the player in headless runs: take the safe turn that
+// gets closest to the nearest fruit
+void steer_simulated(Snake *snake, GameConfig *config) {
+    static const int dirs[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+    int bestScore = -1000000;
+    int bestDx = snake->dx, bestDy = snake->dy;
+    
+    for (int d = 0; d < 4; d++) {
+        int dx = dirs[d][0], dy = dirs[d][1];
+        if (dx == -snake->dx && dy == -snake->dy) continue; // No reversing
+        
+        int x = snake->body[0].x + dx;
+        int y = snake->body[0].y + dy;
+        if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) continue;
+        if (cell_is_wall(config, x, y)) continue;
+        
+        bool blocked = false;
+        for (int i = 0; i < snake->length - 1 && !blocked; i++) {
+            blocked = (snake->body[i].x == x && snake->body[i].y == y);
+        }
+        if (config->hasObstacles) {
+            for (int i = 0; i < config->obstacleCount && !blocked; i++) {
+                blocked = (config->obstacles[i].x == x && config->obstacles[i].y == y);
+            }
+        }
+        if (blocked) continue;
+        
+        int nearest = GRID_WIDTH + GRID_HEIGHT;
+        for (int i = 0; i < config->foodCount; i++) {
+            int dist = abs(config->foods[i].x - x) + abs(config->foods[i].y - y);
+            if (dist < nearest) nearest = dist;
+        }
+        
+        int score = -nearest * 2 + (dx == snake->dx && dy == snake->dy); // Ties keep going straight
+        if (score > bestScore) {
+            bestScore = score;
+            bestDx = dx;
+            bestDy = dy;
+        }
+    }
+    
+    snake->dx = bestDx;
+    snake->dy = bestDy;
+}
+
+// Headless chaos-mode games driven purely by the virtual clock, as fast as the CPU allows.
+// The same seed always produces the same scores and end times. The round hash after
+// every snake step is chained into a state hash, so two runs that differ on any
+// tick report different hashes; the hash the rules kept is checked against one
+// computed from scratch at the end of every game.
+int run_simulation(Uint64 seed, int games, int levelIndex) {
+    Snake snake = {0};
+    GameConfig config;
+    GameFeatures features = {true, true, true, true, true, true};
+    Scheduler scheduler;
+    int score = 0;
+    Uint64 checksum = 0;
+    Uint64 stateHash = 0;
+    int hashErrors = 0;
+    Uint64 virtualTotal = 0;
+    clock_t start = clock();
+    
+    for (int game = 0; game < games; game++) {
+        configure_game(&config, &features, &modes);
+        select_level(&config, level_pack_get(&levelPack, levelIndex));
+        game_seed(&config, seed + game);
+        reset_game(&snake, &config, &score);
+        schedule_game(&scheduler, &config, 0);
+        
+        // Jump straight from one deadline to the next instead of waiting for it
+        Timer *timer;
+        while (snake.alive) {
+            timer = scheduler_poll(&scheduler, scheduler_next_deadline(&scheduler));
+            if (timer == NULL) continue;
+            bool snakeStep = timer->kind == TIMER_SNAKE;
+            if (snakeStep) {
+                steer_simulated(&snake, &config);
+            }
+            handle_timer(timer, &snake, &config, &score);
+            if (snakeStep) stateHash = zobrist_mix(stateHash ^ round_hash(&snake, &config));
+        }
+        
+        if (config.hash != round_rehash(&snake, &config, score)) {
+            log_error("Game %d: the rules lost track of the round hash", game + 1);
+            hashErrors++;
+        }
+        
+        virtualTotal += scheduler.now;
+        checksum = checksum * 1000003 + (Uint64)score * 65536 + scheduler.now;
+        printf("Game %d: score %d, length %d, ended at %.3fs (%s), hash %016llx\n", game + 1, score, snake.length,
+               scheduler.now / 1000.0, config.timeRemaining <= 0 ? "time up" : "crashed",
+               (unsigned long long)round_hash(&snake, &config));
+    }
+    
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("Simulated %.1fs of game time in %.3fs (%.0fx real time), checksum %016llx, state hash %016llx\n",
+           virtualTotal / 1000.0, seconds, seconds > 0 ? virtualTotal / 1000.0 / seconds : 0.0,
+           (unsigned long long)checksum, (unsigned long long)stateHash);
+    return hashErrors > 0;
+}
+
+// The board while a round is in progress
+void draw_playing(SDL_Renderer *renderer, const Snake *snake, const GameConfig *config, int score,
+    bool paused, int rateIndex, TTF_Font *font) {
+    draw_ui_area(renderer, score, (GameConfig *)config, font);
+    draw_grid(renderer);
+    draw_walls(renderer, (GameConfig *)config);
+    
+    // Draw all food items
+    for (int i = 0; i < config->foodCount; i++) {
+        draw_food(renderer, (Food *)&config->foods[i]);
     }
     
-    // Place obstacles
+    // Draw obstacles if enabled
     if (config->hasObstacles) {
-        place_obstacles(config, snake);
+        draw_obstacles(renderer, (GameConfig *)config);
     }
     
-    // Place food items
-    if (config->multiFruit) {
-        initialize_multi_fruits(config, snake);
-    } else {
-        config->foodCount = 1;
-        config->foods[0].type = 0;  // Regular food
-        config->foods[0].value = 1;
-        config->foods[0].moving = config->movingFruit;
-        place_food(&config->foods[0], snake, config);
+    // Draw snake
+    draw_snake(renderer, (Snake *)snake);
+    
+    // Show when the game clock is not running at normal speed
+    if (paused) {
+        SDL_Color yellow = {255, 220, 0, 255};
+        draw_text_centered(renderer, font, "PAUSED", WINDOW_WIDTH / 2, 
+                           UI_HEIGHT + GRID_HEIGHT * CELL_SIZE / 2, yellow);
+    } else if (rateIndex != CLOCK_RATE_NORMAL) {
+        char speed_text[16];
+        sprintf(speed_text, "x%g", clock_rates[rateIndex] / 1000.0);
+        SDL_Color yellow = {255, 220, 0, 255};
+        draw_text(renderer, font, speed_text, WINDOW_WIDTH - 110, UI_HEIGHT + 5, yellow);
     }
 }
 
-void move_foods(GameConfig *config) {
-    if (!config->movingFruit) return;
+// F3 overlay along the bottom: frame rate, key press to screen, time between frames
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, int fps, const LatencyStats *input, const LatencyStats *frames) {
+    SDL_Color white = {255, 255, 255, 255};
+    char line[128];
+    
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_Rect box = {0, WINDOW_HEIGHT - 66, WINDOW_WIDTH, 66};
+    SDL_RenderFillRect(renderer, &box);
+    
+    sprintf(line, "FPS: %d", fps);
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 64, white);
+    latency_format(input, "input to photon", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 43, white);
+    latency_format(frames, "frame", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 22, white);
+}
+
+// Convert one ARGB frame to I420 (full-range BT.601) and append it to the file
+static void encode_frame(FrameExporter *exporter, const Uint32 *pixels) {
+    Uint8 *yPlane = exporter->yuv;
+    Uint8 *uPlane = yPlane + WINDOW_WIDTH * WINDOW_HEIGHT;
+    Uint8 *vPlane = uPlane + (WINDOW_WIDTH / 2) * (WINDOW_HEIGHT / 2);
+    
+    for (int y = 0; y < WINDOW_HEIGHT; y++) {
+        for (int x = 0; x < WINDOW_WIDTH; x++) {
+            Uint32 p = pixels[y * WINDOW_WIDTH + x];
+            int r = (p >> 16) & 255, g = (p >> 8) & 255, b = p & 255;
+            yPlane[y * WINDOW_WIDTH + x] = (Uint8)((77 * r + 150 * g + 29 * b + 128) >> 8);
+        }
+    }
     
-    for (int i = 0; i < config->foodCount; i++) {
-        if (config->foods[i].moving) {
-            int new_x = config->foods[i].x + config->foods[i].dx;
-            int new_y = config->foods[i].y + config->foods[i].dy;
-            
-            // Check if the food would go out of bounds and change direction if needed
-            if (new_x < 0 || new_x >= GRID_WIDTH) {
-                config->foods[i].dx *= -1;
-                new_x = config->foods[i].x + config->foods[i].dx;
-            }
-            
-            if (new_y < 0 || new_y >= GRID_HEIGHT) {
-                config->foods[i].dy *= -1;
-                new_y = config->foods[i].y + config->foods[i].dy;
-            }
-            
-            // Check if the food would collide with an obstacle
-            bool collision = false;
-            if (config->hasObstacles) {
-                for (int j = 0; j < config->obstacleCount; j++) {
-                    if (new_x == config->obstacles[j].x && new_y == config->obstacles[j].y) {
-                        collision = true;
-                        break;
-                    }
-                }
-            }
-            
-            // If no collision, update the position
-            if (!collision) {
-                config->foods[i].x = new_x;
-                config->foods[i].y = new_y;
-            } else {
-                // Otherwise, change direction
-                config->foods[i].dx *= -1;
-                config->foods[i].dy *= -1;
+    // Chroma from the average of each 2x2 block
+    for (int y = 0; y < WINDOW_HEIGHT / 2; y++) {
+        for (int x = 0; x < WINDOW_WIDTH / 2; x++) {
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++) {
+                Uint32 p = pixels[(y * 2 + i / 2) * WINDOW_WIDTH + x * 2 + i % 2];
+                r += (p >> 16) & 255;
+                g += (p >> 8) & 255;
+                b += p & 255;
             }
+            int u = (-43 * r - 85 * g + 128 * b + (128 << 10) + 512) >> 10;
+            int v = (128 * r - 107 * g - 21 * b + (128 << 10) + 512) >> 10;
+            uPlane[y * (WINDOW_WIDTH / 2) + x] = (Uint8)(u > 255 ? 255 : u);
+            vPlane[y * (WINDOW_WIDTH / 2) + x] = (Uint8)(v > 255 ? 255 : v);
         }
     }
+    
+    fputs("FRAME\n", exporter->file);
+    fwrite(exporter->yuv, 1, WINDOW_WIDTH * WINDOW_HEIGHT * 3 / 2, exporter->file);
 }
 
-void move_obstacles(GameConfig *config) {
-    if (!config->movingObstacles) return;
+static int exporter_thread_main(void *data) {
+    FrameExporter *exporter = data;
     
-    for (int i = 0; i < config->obstacleCount; i++) {
-        if (config->obstacles[i].moving) {
-            int new_x = config->obstacles[i].x + config->obstacles[i].dx;
-            int new_y = config->obstacles[i].y + config->obstacles[i].dy;
-            
-            // Check if the obstacle would go out of bounds and change direction if needed
-            if (new_x < 0 || new_x >= GRID_WIDTH) {
-                config->obstacles[i].dx *= -1;
-                new_x = config->obstacles[i].x + config->obstacles[i].dx;
-            }
-            
-            if (new_y < 0 || new_y >= GRID_HEIGHT) {
-                config->obstacles[i].dy *= -1;
-                new_y = config->obstacles[i].y + config->obstacles[i].dy;
-            }
-            
-            // Check for collisions with other obstacles
-            bool collision = false;
-            for (int j = 0; j < config->obstacleCount; j++) {
-                if (i != j && new_x == config->obstacles[j].x && new_y == config->obstacles[j].y) {
-                    collision = true;
-                    break;
-                }
-            }
-            
-            // Check for collisions with food
-            for (int j = 0; j < config->foodCount; j++) {
-                if (new_x == config->foods[j].x && new_y == config->foods[j].y) {
-                    collision = true;
-                    break;
-                }
-            }
-            
-            // If no collision, update the position
-            if (!collision) {
-                config->obstacles[i].x = new_x;
-                config->obstacles[i].y = new_y;
-            } else {
-                // Otherwise, change direction
-                config->obstacles[i].dx *= -1;
-                config->obstacles[i].dy *= -1;
-            }
+    SDL_LockMutex(exporter->lock);
+    while (true) {
+        while (exporter->count == 0 && !exporter->stopping) {
+            SDL_CondWait(exporter->queued, exporter->lock);
         }
+        if (exporter->count == 0) break; // Stopping and drained
+        
+        // The oldest frame belongs to the encoder until it is released below
+        Uint32 *pixels = exporter->frames[exporter->head];
+        SDL_UnlockMutex(exporter->lock);
+        encode_frame(exporter, pixels);
+        SDL_LockMutex(exporter->lock);
+        
+        exporter->head = (exporter->head + 1) % EXPORT_QUEUE_SIZE;
+        exporter->count--;
+        exporter->written++;
+        SDL_CondSignal(exporter->freed);
     }
+    SDL_UnlockMutex(exporter->lock);
+    return 0;
 }
 
-void configure_game(GameConfig *config, GameFeatures *features, Snake *snake) {
-    // Reset config to defaults
-    memset(config, 0, sizeof(GameConfig));
-    
-    // Apply feature settings
-    config->movingFruit = features->movingFruit;
-    config->multiFruit = features->multiFruit;
-    config->timed = features->timed;
-    config->hasObstacles = features->obstacles;
-    config->movingObstacles = features->obstacles && features->movingFruit; // Only if both are selected
-    
-    // Set base speed
-    if (features->speed) {
-        config->updateDelay = 100; // Faster speed
-    } else {
-        config->updateDelay = 150; // Normal speed
+// Start writing a Y4M video to `path`. Returns NULL if the file or thread cannot be created.
+FrameExporter *exporter_open(const char *path) {
+    FrameExporter *exporter = calloc(1, sizeof(FrameExporter));
+    if (exporter == NULL) return NULL;
+    
+    bool ok = true;
+    for (int i = 0; i < EXPORT_QUEUE_SIZE && ok; i++) {
+        exporter->frames[i] = malloc(sizeof(Uint32) * WINDOW_WIDTH * WINDOW_HEIGHT);
+        ok = exporter->frames[i] != NULL;
     }
-    
-    // Configure timed mode
-    if (config->timed) {
-        config->maxTime = 60; // 60 seconds
-        config->timeRemaining = config->maxTime;
+    exporter->yuv = ok ? malloc(WINDOW_WIDTH * WINDOW_HEIGHT * 3 / 2) : NULL;
+    exporter->file = exporter->yuv ? fopen(path, "wb") : NULL;
+    exporter->lock = SDL_CreateMutex();
+    exporter->queued = SDL_CreateCond();
+    exporter->freed = SDL_CreateCond();
+    
+    if (exporter->file && exporter->lock && exporter->queued && exporter->freed) {
+        fprintf(exporter->file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                WINDOW_WIDTH, WINDOW_HEIGHT, EXPORT_FPS);
+        exporter->thread = SDL_CreateThread(exporter_thread_main, "exporter", exporter);
     }
     
-    // Configure food movement
-    if (config->movingFruit) {
-        config->fruitMoveInterval = 500; // Move every 500ms
+    if (exporter->thread == NULL) {
+        if (exporter->file) fclose(exporter->file);
+        if (exporter->lock) SDL_DestroyMutex(exporter->lock);
+        if (exporter->queued) SDL_DestroyCond(exporter->queued);
+        if (exporter->freed) SDL_DestroyCond(exporter->freed);
+        for (int i = 0; i < EXPORT_QUEUE_SIZE; i++) free(exporter->frames[i]);
+        free(exporter->yuv);
+        free(exporter);
+        return NULL;
+    }
+    return exporter;
+}
+
+// Read the current render target into the next free frame and queue it. With `wait`
+// false a full queue drops the frame, so live play never stalls on the encoder.
+bool exporter_capture(FrameExporter *exporter, SDL_Renderer *renderer, bool wait) {
+    SDL_LockMutex(exporter->lock);
+    while (wait && exporter->count == EXPORT_QUEUE_SIZE) {
+        SDL_CondWait(exporter->freed, exporter->lock);
+    }
+    if (exporter->count == EXPORT_QUEUE_SIZE) {
+        exporter->dropped++;
+        SDL_UnlockMutex(exporter->lock);
+        return false;
     }
+    int slot = (exporter->head + exporter->count) % EXPORT_QUEUE_SIZE;
+    SDL_UnlockMutex(exporter->lock);
     
-    // Configure obstacle movement
-    if (config->movingObstacles) {
-        config->obstacleMoveInterval = 800; // Move every 800ms
+    // Only this thread queues frames, so the free slot stays ours while we fill it
+    if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, exporter->frames[slot],
+                             WINDOW_WIDTH * (int)sizeof(Uint32)) != 0) {
+        return false;
     }
     
-    // Generate a name for this mode configuration
-    generate_mode_name(config, features);
+    SDL_LockMutex(exporter->lock);
+    exporter->count++;
+    SDL_CondSignal(exporter->queued);
+    SDL_UnlockMutex(exporter->lock);
+    return true;
 }
 
-void initialize_multi_fruits(GameConfig *config, Snake *snake) {
-    if (!config->multiFruit) {
-        config->foodCount = 1;
-        config->foods[0].type = 0;  // Regular food
-        config->foods[0].value = 1;
-        config->foods[0].moving = config->movingFruit;
-        place_food(&config->foods[0], snake, config);
-        return;
+// Encode everything still queued, then close the file
+void exporter_close(FrameExporter *exporter) {
+    SDL_LockMutex(exporter->lock);
+    exporter->stopping = true;
+    SDL_CondSignal(exporter->queued);
+    SDL_UnlockMutex(exporter->lock);
+    SDL_WaitThread(exporter->thread, NULL);
+    
+    log_info("Exported %d frames (%d dropped)", exporter->written, exporter->dropped);
+    fclose(exporter->file);
+    SDL_DestroyMutex(exporter->lock);
+    SDL_DestroyCond(exporter->queued);
+    SDL_DestroyCond(exporter->freed);
+    for (int i = 0; i < EXPORT_QUEUE_SIZE; i++) free(exporter->frames[i]);
+    free(exporter->yuv);
+    free(exporter);
+}
+
+// Offscreen texture the size of the window, to draw into while capturing
+SDL_Texture *create_capture_target(SDL_Renderer *renderer) {
+    return SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                             WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+// Render a simulated game offscreen into a video at normal speed, as fast as the
+// machine allows. The same seed and level always give the same clip.
+int run_export(Uint64 seed, int levelIndex, const char *path) {
+    if (SDL_Init(SDL_INIT_VIDEO) != 0 || TTF_Init() != 0) {
+        log_error("SDL Error: %s", SDL_GetError());
+        return 1;
+    }
+    
+    // Nothing is ever shown, but the renderer still needs a window
+    SDL_Window *window = SDL_CreateWindow("Snake Export", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                          WINDOW_WIDTH, WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+    SDL_Renderer *renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_TARGETTEXTURE) : NULL;
+    SDL_Texture *target = renderer ? create_capture_target(renderer) : NULL;
+    TTF_Font *font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 24);
+    FrameExporter *exporter = target && font ? exporter_open(path) : NULL;
+    if (exporter == NULL) {
+        log_error("Could not set up the export: %s", SDL_GetError());
+        if (font) TTF_CloseFont(font);
+        if (target) SDL_DestroyTexture(target);
+        if (renderer) SDL_DestroyRenderer(renderer);
+        if (window) SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
     }
+    SDL_SetRenderTarget(renderer, target);
     
-    // For multi-fruit mode, place 3-5 fruits
-    config->foodCount = rand() % 3 + 3; // 3-5 fruits
+    Snake snake = {0};
+    GameConfig config;
+    GameFeatures features = {true, true, true, true, true, true};
+    Scheduler scheduler;
+    int score = 0;
     
-    for (int i = 0; i < config->foodCount; i++) {
-        config->foods[i].type = rand() % 4; // 0-3 different types
-        
-        // Set point value based on type
-        switch (config->foods[i].type) {
-            case 0: config->foods[i].value = 1; break;  // Regular
-            case 1: config->foods[i].value = 2; break;  // Bonus
-            case 2: config->foods[i].value = 3; break;  // Special
-            case 3: config->foods[i].value = 5; break;  // Rare
+    configure_game(&config, &features, &modes);
+    select_level(&config, level_pack_get(&levelPack, levelIndex));
+    game_seed(&config, seed);
+    reset_game(&snake, &config, &score);
+    schedule_game(&scheduler, &config, 0);
+    
+    // One frame every 1/EXPORT_FPS s of game time, plus a second on the final board
+    int endFrame = -1;
+    for (int frame = 0; endFrame < 0 || frame <= endFrame; frame++) {
+        Uint32 frameTime = (Uint32)((Uint64)frame * 1000 / EXPORT_FPS);
+        while (snake.alive && SDL_TICKS_PASSED(frameTime, scheduler_next_deadline(&scheduler))) {
+            Timer *timer = scheduler_poll(&scheduler, scheduler_next_deadline(&scheduler));
+            if (timer == NULL) continue;
+            if (timer->kind == TIMER_SNAKE) {
+                steer_simulated(&snake, &config);
+            }
+            handle_timer(timer, &snake, &config, &score);
         }
-        
-        // Determine if this fruit should move (if moving fruit is enabled)
-        if (config->movingFruit) {
-            // Higher value fruits are more likely to move
-            config->foods[i].moving = (rand() % 5 < config->foods[i].type + 2);
-        } else {
-            config->foods[i].moving = false;
+        if (!snake.alive && endFrame < 0) {
+            endFrame = frame + EXPORT_FPS;
         }
         
-        place_food(&config->foods[i], snake, config);
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_playing(renderer, &snake, &config, score, false, CLOCK_RATE_NORMAL, font);
+        exporter_capture(exporter, renderer, true);
     }
+    
+    printf("Game over with score %d after %.1fs\n", score, scheduler.now / 1000.0);
+    exporter_close(exporter);
+    TTF_CloseFont(font);
+    SDL_DestroyTexture(target);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    TTF_Quit();
+    SDL_Quit();
+    return 0;
 }
 
-void update_game(Snake *snake, GameConfig *config, int *score, Uint32 currentTime) {
-    // Update moving fruits
-    if (config->movingFruit && currentTime - config->lastFruitMove > config->fruitMoveInterval) {
-        move_foods(config);
-        config->lastFruitMove = currentTime;
+// Copy a round into `save`, ready to be written as is
+void save_capture(SaveState *save, const Snake *snake, const GameConfig *config,
+    const Scheduler *scheduler, const GameClock *clock, int score) {
+    memset(save, 0, sizeof(SaveState));
+    memcpy(save->magic, SAVE_MAGIC, 4);
+    save->version = SAVE_VERSION;
+    save->size = sizeof(SaveState);
+    save->score = score;
+    save->snake = *snake;
+    save->config = *config;
+    save->scheduler = *scheduler;
+    save->clock = *clock;
+    
+    save->levelIndex = -1;
+    for (int i = 0; i < level_pack_count(&levelPack); i++) {
+        if (level_pack_get(&levelPack, i) == config->level) {
+            save->levelIndex = i;
+            memcpy(save->levelName, level_pack_name(&levelPack, i), LEVEL_NAME_LENGTH);
+            break;
+        }
     }
     
-    // Update moving obstacles
-    if (config->movingObstacles && currentTime - config->lastObstacleMove > config->obstacleMoveInterval) {
-        move_obstacles(config);
-        config->lastObstacleMove = currentTime;
+    // Addresses mean nothing in the next run
+    save->config.level = NULL;
+    save->config.walls = NULL;
+    save->config.handleTimer = NULL;
+}
+
+// Write through a temporary file so a crash mid-write never leaves a torn save
+bool save_write(const char *path, const SaveState *save) {
+    char tempPath[256];
+    snprintf(tempPath, sizeof(tempPath), "%s.tmp", path);
+    
+    FILE *file = fopen(tempPath, "wb");
+    if (file == NULL) return false;
+    
+    bool ok = fwrite(save, sizeof(SaveState), 1, file) == 1;
+    ok &= fclose(file) == 0;
+    if (!ok || rename(tempPath, path) != 0) {
+        remove(tempPath);
+        return false;
+    }
+    return true;
+}
+
+static bool save_list_valid(int head, int timerCount) {
+    return head >= -1 && head < timerCount;
+}
+
+static bool save_cell_valid(int x, int y) {
+    return x >= 0 && x < GRID_WIDTH && y >= 0 && y < GRID_HEIGHT;
+}
+
+static bool save_step_valid(int dx, int dy) {
+    return dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1;
+}
+
+// Everything the game indexes or steps with, checked against the arrays and the
+// board: counts, list heads, timer targets, positions and directions
+static bool save_valid(const SaveState *save) {
+    const Snake *snake = &save->snake;
+    const GameConfig *config = &save->config;
+    const Scheduler *scheduler = &save->scheduler;
+    if (!snake->alive || snake->length < 2 || snake->length > (int)(sizeof(snake->body) / sizeof(snake->body[0])) ||
+        !save_step_valid(snake->dx, snake->dy) ||
+        config->foodCount < 0 || config->foodCount > MAX_FOODS ||
+        config->obstacleCount < 0 || config->obstacleCount > MAX_OBSTACLES ||
+        config->featureMask >= FEATURE_COMBINATIONS ||
+        scheduler->timerCount < 0 || scheduler->timerCount > MAX_TIMERS ||
+        !save_list_valid(scheduler->pending, scheduler->timerCount) ||
+        save->clock.rateIndex < 0 || save->clock.rateIndex >= CLOCK_RATE_COUNT) {
+        return false;
+    }
+    // The link keys and the moves rely on a connected body: every segment a unit
+    // step from the one before, except the copies of the tail a meal leaves behind
+    bool tailCopies = false;
+    for (int i = 0; i < snake->length; i++) {
+        if (!save_cell_valid(snake->body[i].x, snake->body[i].y)) return false;
+        if (i == 0) continue;
+        int step = abs(snake->body[i].x - snake->body[i - 1].x) + abs(snake->body[i].y - snake->body[i - 1].y);
+        if (step == 0) tailCopies = true;
+        if (step > 1 || (step == 1 && tailCopies) || (step == 0 && i == 1)) return false;
+    }
+    for (int i = 0; i < config->foodCount; i++) {
+        const Food *food = &config->foods[i];
+        if (!save_cell_valid(food->x, food->y) || !save_step_valid(food->dx, food->dy) ||
+            (food->moving && food->moveInterval <= 0)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < config->obstacleCount; i++) {
+        const Obstacle *obstacle = &config->obstacles[i];
+        if (!save_cell_valid(obstacle->x, obstacle->y) || !save_step_valid(obstacle->dx, obstacle->dy) ||
+            (obstacle->moving && obstacle->moveInterval <= 0)) {
+            return false;
+        }
     }
     
-    // Update timer
-    if (config->timed && config->timeRemaining > 0) {
-        config->timeRemaining = config->maxTime - (currentTime / 1000);
-        if (config->timeRemaining <= 0) {
-            snake->alive = false;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SIZE; slot++) {
+            if (!save_list_valid(scheduler->slots[level][slot], scheduler->timerCount)) return false;
+        }
+    }
+    for (int i = 0; i < scheduler->timerCount; i++) {
+        const Timer *timer = &scheduler->timers[i];
+        if (!save_list_valid(timer->next, scheduler->timerCount) || timer->interval == 0) return false;
+        switch (timer->kind) {
+            case TIMER_SNAKE:
+            case TIMER_COUNTDOWN:
+                break;
+            case TIMER_FOOD:
+                if (timer->index < 0 || timer->index >= config->foodCount) return false;
+                break;
+            case TIMER_OBSTACLE:
+                if (timer->index < 0 || timer->index >= config->obstacleCount) return false;
+                break;
+            default:
+                return false;
         }
     }
+    return true;
 }
 
-void generate_mode_name(GameConfig *config, GameFeatures *features) {
-    strcpy(config->modeName, "");
+// Read and check a save, then rebuild its pointers. Returns false if the file is
+// missing, from another version, or does not describe a playable round, in which
+// case the game starts from the menu as if there were none.
+bool save_read(const char *path, SaveState *save) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+    
+    bool ok = fread(save, sizeof(SaveState), 1, file) == 1;
+    fclose(file);
+    if (!ok || memcmp(save->magic, SAVE_MAGIC, 4) != 0 || save->version != SAVE_VERSION ||
+        save->size != sizeof(SaveState)) {
+        return false;
+    }
     
-    // Check if chaos mode (everything enabled)
-    if (features->movingFruit && features->multiFruit && features->timed && 
-        features->obstacles && features->speed) {
-        strcpy(config->modeName, "CHAOS MODE");
-        return;
+    // Counts and indices are used unchecked by the game, so make sure they are in range
+    GameConfig *config = &save->config;
+    if (!save_valid(save)) {
+        log_warn("%s does not describe a playable round, starting a new game", path);
+        return false;
     }
     
-    // Otherwise, build the name based on enabled features
-    if (!features->movingFruit && !features->multiFruit && !features->timed && 
-        !features->obstacles && !features->speed) {
-        strcpy(config->modeName, "CLASSIC");
-        return;
+    // The level must be the same one the round was played on
+    const LevelHeader *level = NULL;
+    if (save->levelIndex >= 0) {
+        const char *name = level_pack_name(&levelPack, save->levelIndex);
+        if (name == NULL || strncmp(name, save->levelName, LEVEL_NAME_LENGTH) != 0) {
+            log_warn("%s was saved on a level that is no longer in the pack, starting a new game", path);
+            return false;
+        }
+        level = level_pack_get(&levelPack, save->levelIndex);
+        if (!level_fits_board(level)) return false;
     }
+    select_level(config, level);
+    config->handleTimer = select_timer_handler(config->featureMask);
+    config->hash = round_rehash(&save->snake, config, save->score);
+    return true;
+}
+
+static bool input_queue_push(InputQueue *queue, const SimCommand *command) {
+    Uint32 tail = (Uint32)SDL_AtomicGet(&queue->tail);
+    if (tail - (Uint32)SDL_AtomicGet(&queue->head) == INPUT_QUEUE_SIZE) return false;
     
-    // Build the name from enabled features
-    bool addedFeature = false;
+    queue->items[tail & (INPUT_QUEUE_SIZE - 1)] = *command;
+    SDL_AtomicSet(&queue->tail, (int)(tail + 1)); // Full barrier: the item is visible first
+    return true;
+}
+
+static bool input_queue_pop(InputQueue *queue, SimCommand *command) {
+    Uint32 head = (Uint32)SDL_AtomicGet(&queue->head);
+    if (head == (Uint32)SDL_AtomicGet(&queue->tail)) return false;
     
-    if (features->speed) {
-        strcat(config->modeName, "SPEED");
-        addedFeature = true;
+    *command = queue->items[head & (INPUT_QUEUE_SIZE - 1)];
+    SDL_AtomicSet(&queue->head, (int)(head + 1));
+    return true;
+}
+
+// Copy the sim thread's state into the back buffer and swap it into the middle
+static void sim_publish(Simulation *sim) {
+    SnapshotBuffer *buffer = &sim->snapshots;
+    GameSnapshot *snapshot = &buffer->buffers[buffer->back];
+    snapshot->snake = sim->snake;
+    snapshot->config = sim->config;
+    snapshot->score = sim->score;
+    snapshot->gameId = sim->gameId;
+    snapshot->playing = sim->playing;
+    snapshot->paused = sim->clock.paused;
+    snapshot->rateIndex = sim->clock.rateIndex;
+    snapshot->turnsTaken = sim->turnsTaken;
+    snapshot->turnPressed = sim->turnPressed;
+    
+    buffer->back = SDL_AtomicSet(&buffer->middle, buffer->back | SNAPSHOT_FRESH) & 3;
+}
+
+// Newest snapshot; stays valid until the next call
+const GameSnapshot *sim_latest(Simulation *sim) {
+    SnapshotBuffer *buffer = &sim->snapshots;
+    if (SDL_AtomicGet(&buffer->middle) & SNAPSHOT_FRESH) {
+        buffer->front = SDL_AtomicSet(&buffer->middle, buffer->front) & 3;
     }
-    
-    if (features->timed) {
-        if (addedFeature) strcat(config->modeName, "+");
-        strcat(config->modeName, "TIMED");
-        addedFeature = true;
+    return &buffer->buffers[buffer->front];
+}
+
+static void sim_apply(Simulation *sim, const SimCommand *command) {
+    Snake *snake = &sim->snake;
+    Uint32 now = SDL_GetTicks();
+    
+    switch (command->type) {
+        case SIM_START: {
+            GameFeatures features = command->features;
+            configure_game(&sim->config, &features, &modes);
+            select_level(&sim->config, command->level);
+            game_seed(&sim->config, command->seed);
+            reset_game(snake, &sim->config, &sim->score);
+            
+            // A fresh virtual clock, so time spent in the menu never counts
+            clock_start(&sim->clock, now);
+            schedule_game(&sim->scheduler, &sim->config, sim->clock.now);
+            sim->gameId = command->gameId;
+            sim->playing = true;
+            turn_queue_clear(&sim->turns);
+            break;
+        }
+        case SIM_STOP:
+            sim->playing = false;
+            remove(SAVE_FILE);
+            break;
+        case SIM_TURN:
+            // Taken on the next snake step; moving directly backwards is refused
+            turn_queue_push(&sim->turns, snake->dx, snake->dy, command->dx, command->dy, command->timestamp);
+            break;
+        case SIM_PAUSE:
+            clock_toggle_pause(&sim->clock, now);
+            break;
+        case SIM_CLOCK_RATE:
+            clock_set_rate(&sim->clock, command->value ? sim->clock.rateIndex + command->value : CLOCK_RATE_NORMAL, now);
+            break;
+        case SIM_SUSPEND:
+            if (sim->playing && sim->snake.alive) {
+                if (!sim->clock.paused) clock_toggle_pause(&sim->clock, now);
+                
+                SaveState save;
+                save_capture(&save, snake, &sim->config, &sim->scheduler, &sim->clock, sim->score);
+                save_write(SAVE_FILE, &save);
+            }
+            break;
+        case SIM_RESUME: {
+            // Picks up exactly where the save left off: no food or obstacles are placed
+            SaveState *save = command->save;
+            sim->snake = save->snake;
+            sim->config = save->config;
+            sim->scheduler = save->scheduler;
+            sim->clock = save->clock;
+            sim->clock.lastReal = now;
+            sim->score = save->score;
+            sim->gameId = command->gameId;
+            sim->playing = true;
+            turn_queue_clear(&sim->turns);
+            free(save);
+            break;
+        }
+        case SIM_QUIT:
+            break;
     }
-    
-    if (features->obstacles) {
-        if (addedFeature) strcat(config->modeName, "+");
-        if (features->movingFruit) {
-            strcat(config->modeName, "MVG-");
+}
+
+// One queued turn per snake step
+static void sim_take_turn(Simulation *sim) {
+    Uint32 pressed;
+    if (turn_queue_take(&sim->turns, &sim->snake.dx, &sim->snake.dy, &pressed)) {
+        sim->turnsTaken++;
+        sim->turnPressed = pressed;
+    }
+}
+
+// Runs the game at its own tick rate, whatever the renderer is doing
+static int sim_thread_main(void *data) {
+    Simulation *sim = data;
+    bool quit = false;
+    
+    while (!quit) {
+        bool changed = false;
+        SimCommand command;
+        while (input_queue_pop(&sim->input, &command)) {
+            quit |= command.type == SIM_QUIT;
+            sim_apply(sim, &command);
+            changed = true;
+        }
+        
+        // Run every timer that has come due on the game clock
+        Uint32 waitTime = SIM_IDLE_WAIT;
+        if (sim->playing) {
+            Uint32 now = SDL_GetTicks();
+            Uint32 gameTime = clock_advance(&sim->clock, now);
+            Timer *timer;
+            while (sim->snake.alive && (timer = scheduler_poll(&sim->scheduler, gameTime)) != NULL) {
+                uint64_t tickStart = metrics_clock();
+                alloc_watch_begin();
+                if (timer->kind == TIMER_SNAKE) {
+                    sim_take_turn(sim);
+                }
+                handle_timer(timer, &sim->snake, &sim->config, &sim->score);
+                alloc_watch_end("a timer");
+                if (timer->kind == TIMER_SNAKE) metrics_tick(tickStart);
+                changed = true;
+            }
+            
+            if (!sim->snake.alive) {
+                sim->playing = false;
+                changed = true;
+                remove(SAVE_FILE); // A finished round cannot be resumed
+            } else if (!sim->clock.paused) {
+                Uint32 deadline = scheduler_next_deadline(&sim->scheduler);
+                waitTime = SDL_TICKS_PASSED(gameTime, deadline) ? 0 : clock_real_delay(&sim->clock, deadline - gameTime);
+                if (waitTime > SIM_IDLE_WAIT) waitTime = SIM_IDLE_WAIT;
+            }
+        }
+        
+        if (changed) {
+            sim_publish(sim);
+            metrics_game(sim->score, sim->snake.length, food_place_retries, sim->config.modeName);
+        }
+        
+        // Sleep until the next timer is due, waking early for input
+        if (waitTime > 0 && !quit) {
+            SDL_SemWaitTimeout(sim->wake, waitTime);
         }
-        strcat(config->modeName, "OBSTACLE");
-        addedFeature = true;
     }
-    
-    if (features->multiFruit) {
-        if (addedFeature) strcat(config->modeName, "+");
-        strcat(config->modeName, "MULTI-FRUIT");
-        addedFeature = true;
-    } else if (features->movingFruit) {
-        if (addedFeature) strcat(config->modeName, "+");
-        strcat(config->modeName, "MVG-FRUIT");
+    return 0;
+}
+
+Simulation *sim_create(void) {
+    Simulation *sim = calloc(1, sizeof(Simulation));
+    if (sim == NULL) return NULL;
+    
+    sim->snapshots.back = 0;
+    SDL_AtomicSet(&sim->snapshots.middle, 1);
+    sim->snapshots.front = 2;
+    sim->clock.rateIndex = CLOCK_RATE_NORMAL;
+    scheduler_init(&sim->scheduler, 0);
+    
+    sim->wake = SDL_CreateSemaphore(0);
+    sim->thread = sim->wake ? SDL_CreateThread(sim_thread_main, "sim", sim) : NULL;
+    if (sim->thread == NULL) {
+        if (sim->wake) SDL_DestroySemaphore(sim->wake);
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+// Queue a command for the sim thread. The queue only fills if the sim thread has
+// stalled, in which case the command is dropped like a missed key press.
+void sim_send(Simulation *sim, const SimCommand *command) {
+    if (input_queue_push(&sim->input, command)) {
+        SDL_SemPost(sim->wake);
+    }
+}
+
+void sim_destroy(Simulation *sim) {
+    SimCommand quit = {.type = SIM_QUIT};
+    while (!input_queue_push(&sim->input, &quit)) {
+        SDL_Delay(1);
     }
+    SDL_SemPost(sim->wake);
+    SDL_WaitThread(sim->thread, NULL);
+    SDL_DestroySemaphore(sim->wake);
+    free(sim);
 }
 
 // Main function for the Challenge Menu
 int main(int argc, char *argv[]) {
+    log_init();
+    
+    // Mode parameters: built-in defaults unless MODES_FILE overrides them
+    modes = default_modes;
+    load_modes(MODES_FILE, &modes);
+    
+    // Handcrafted levels are optional; without a pack only the open board is offered
+    if (!level_pack_open(&levelPack, LEVELS_FILE)) {
+        log_info("No level pack (%s), playing on the open board only", LEVELS_FILE);
+    }
+    
+    // Headless simulation: ./challenge --simulate [seed] [games] [level]
+    if (argc > 1 && strcmp(argv[1], "--simulate") == 0) {
+        Uint64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+        int result = run_simulation(seed, argc > 3 ? atoi(argv[3]) : 10, argc > 4 ? atoi(argv[4]) : -1);
+        level_pack_close(&levelPack);
+        return result;
+    }
+    
+    // Offscreen video of a simulated game: ./challenge --export [seed] [level] [file.y4m]
+    if (argc > 1 && strcmp(argv[1], "--export") == 0) {
+        Uint64 seed = argc > 2 ? strtoull(argv[2], NULL, 10) : 1;
+        int result = run_export(seed, argc > 3 ? atoi(argv[3]) : -1, argc > 4 ? argv[4] : "export.y4m");
+        level_pack_close(&levelPack);
+        return result;
+    }
+    
+    metrics_start("challenge");
+    
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        printf("SDL_Init Error: %s\n", SDL_GetError());
+        log_error("SDL_Init Error: %s", SDL_GetError());
         return 1;
     }
     
     // Initialize SDL_ttf
     if (TTF_Init() != 0) {
-        printf("TTF_Init Error: %s\n", TTF_GetError());
+        log_error("TTF_Init Error: %s", TTF_GetError());
         SDL_Quit();
         return 1;
     }
@@ -940,7 +1487,7 @@ int main(int argc, char *argv[]) {
                                           WINDOW_HEIGHT, 
                                           SDL_WINDOW_SHOWN);
     if (window == NULL) {
-        printf("SDL_CreateWindow Error: %s\n", SDL_GetError());
+        log_error("SDL_CreateWindow Error: %s", SDL_GetError());
         TTF_Quit();
         SDL_Quit();
         return 1;
@@ -949,9 +1496,10 @@ int main(int argc, char *argv[]) {
     // Create renderer
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 
                                                SDL_RENDERER_ACCELERATED | 
-                                               SDL_RENDERER_PRESENTVSYNC);
+                                               SDL_RENDERER_PRESENTVSYNC |
+                                               SDL_RENDERER_TARGETTEXTURE);
     if (renderer == NULL) {
-        printf("SDL_CreateRenderer Error: %s\n", SDL_GetError());
+        log_error("SDL_CreateRenderer Error: %s", SDL_GetError());
         SDL_DestroyWindow(window);
         TTF_Quit();
         SDL_Quit();
@@ -961,7 +1509,7 @@ int main(int argc, char *argv[]) {
     // Load font
     TTF_Font *font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 24);
     if (font == NULL) {
-        printf("TTF_OpenFont Error: %s\n", TTF_GetError());
+        log_error("TTF_OpenFont Error: %s", TTF_GetError());
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         TTF_Quit();
@@ -969,16 +1517,42 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
+    // Smaller text for the F3 overlay; the main font stands in if it is missing
+    TTF_Font *smallFont = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 16);
+    
     // Initialize random number generator
     srand(time(NULL));
     
-    // Create game objects
-    Snake snake = {0};
-    GameConfig config = {0};
+    // Create game objects; the game itself lives on the simulation thread
     GameFeatures features = {0};
-    int score = 0;
     GameState gameState = MENU;
     
+    Simulation *sim = sim_create();
+    if (sim == NULL) {
+        log_error("Could not start the simulation thread: %s", SDL_GetError());
+        if (smallFont) TTF_CloseFont(smallFont);
+        TTF_CloseFont(font);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+        return 1;
+    }
+    const GameSnapshot *view = sim_latest(sim);
+    int gameId = 0;
+    
+    // Pick up a round suspended in an earlier run; it comes back paused
+    SaveState *save = malloc(sizeof(SaveState));
+    if (save != NULL && save_read(SAVE_FILE, save)) {
+        SimCommand command = {.type = SIM_RESUME};
+        command.save = save;
+        command.gameId = ++gameId;
+        sim_send(sim, &command);
+        gameState = PLAYING;
+    } else {
+        free(save);
+    }
+    
     // Create menu buttons
     Button checkboxes[5]; // 5 challenge options
     init_button(&checkboxes[0], WINDOW_WIDTH / 2 - 100, 120, "Moving Fruit", true);
@@ -988,22 +1562,40 @@ int main(int argc, char *argv[]) {
     init_button(&checkboxes[4], WINDOW_WIDTH / 2 - 100, 280, "Moving Obstacle", true);
     
     Button chaosButton;
-    init_button(&chaosButton, WINDOW_WIDTH / 2 - 100, 330, "CHAOS MODE (Everything!)", false);
+    init_button(&chaosButton, WINDOW_WIDTH / 2 - 100, 320, "CHAOS MODE (Everything!)", false);
+    
+    // Cycles through the open board and every level that fits the board
+    Button levelButton;
+    init_button(&levelButton, WINDOW_WIDTH / 2 - 100, 365, "LEVEL: OPEN BOARD", false);
+    int levelIndex = -1;
     
     Button playButton;
-    init_button(&playButton, WINDOW_WIDTH / 2 - 100, 400, "PLAY", false);
+    init_button(&playButton, WINDOW_WIDTH / 2 - 100, 410, "PLAY", false);
     
     Button exitButton;
-    init_button(&exitButton, WINDOW_WIDTH / 2 - 100, 450, "EXIT", false);
+    init_button(&exitButton, WINDOW_WIDTH / 2 - 100, 455, "EXIT", false);
     
     Button playAgainButton;
     init_button(&playAgainButton, WINDOW_WIDTH / 2 - 100, 400, "PLAY AGAIN", false);
     
-    Uint32 lastUpdate = 0;
+    Uint64 nextSeed = (Uint64)time(NULL);
+    int modeWatch = mode_watch_open();
+    
+    // F9 records what is on screen to a video; frames are drawn offscreen, read back
+    // and encoded on a background thread
+    SDL_Texture *captureTarget = NULL;
+    FrameExporter *recording = NULL;
+    bool modesChanged = false;
     Uint32 lastFPSUpdate = 0;
     int frames = 0;
     int fps = 0;
     
+    // F3 shows how long arrow keys take to reach the screen
+    static LatencyStats inputLatency, frameTimes;
+    bool showProfiler = false;
+    Uint32 turnsShown = 0;
+    Uint32 lastPresent = 0;
+    
     // Main game loop
     bool running = true;
     SDL_Event event;
@@ -1013,38 +1605,81 @@ int main(int argc, char *argv[]) {
         while (SDL_PollEvent(&event)) {
             switch (event.type) {
                 case SDL_QUIT:
+                    if (gameState == PLAYING) {
+                        SimCommand command = {.type = SIM_SUSPEND};
+                        sim_send(sim, &command);
+                    }
                     running = false;
                     break;
+                case SDL_WINDOWEVENT:
+                    // Keep the round safe whenever the player switches away
+                    if (gameState == PLAYING && event.window.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+                        SimCommand command = {.type = SIM_SUSPEND};
+                        sim_send(sim, &command);
+                    }
+                    break;
                 case SDL_KEYDOWN:
+                    if (event.key.keysym.sym == SDLK_F9) {
+                        if (recording) {
+                            exporter_close(recording);
+                            recording = NULL;
+                        } else {
+                            char path[64];
+                            snprintf(path, sizeof(path), "capture-%ld.y4m", (long)time(NULL));
+                            if (captureTarget == NULL) captureTarget = create_capture_target(renderer);
+                            recording = captureTarget ? exporter_open(path) : NULL;
+                            if (recording) log_info("Recording to %s", path);
+                            else log_warn("Could not record to %s", path);
+                        }
+                        break;
+                    }
+                    if (event.key.keysym.sym == SDLK_F3) {
+                        showProfiler = !showProfiler;
+                        break;
+                    }
                     if (gameState == PLAYING) {
+                        SimCommand command = {.type = SIM_TURN, .timestamp = event.key.timestamp};
                         switch (event.key.keysym.sym) {
                             case SDLK_UP:
-                                if (snake.dy != 1) { // Prevent moving directly backwards
-                                    snake.dx = 0;
-                                    snake.dy = -1;
-                                }
+                                command.dy = -1;
+                                sim_send(sim, &command);
                                 break;
                             case SDLK_DOWN:
-                                if (snake.dy != -1) {
-                                    snake.dx = 0;
-                                    snake.dy = 1;
-                                }
+                                command.dy = 1;
+                                sim_send(sim, &command);
                                 break;
                             case SDLK_LEFT:
-                                if (snake.dx != 1) {
-                                    snake.dx = -1;
-                                    snake.dy = 0;
-                                }
+                                command.dx = -1;
+                                sim_send(sim, &command);
                                 break;
                             case SDLK_RIGHT:
-                                if (snake.dx != -1) {
-                                    snake.dx = 1;
-                                    snake.dy = 0;
-                                }
+                                command.dx = 1;
+                                sim_send(sim, &command);
                                 break;
                             case SDLK_ESCAPE:
+                                command.type = SIM_STOP;
+                                sim_send(sim, &command);
                                 gameState = MENU;
                                 break;
+                            case SDLK_p:
+                                command.type = SIM_PAUSE;
+                                sim_send(sim, &command);
+                                break;
+                            case SDLK_LEFTBRACKET:
+                                command.type = SIM_CLOCK_RATE;
+                                command.value = -1;
+                                sim_send(sim, &command);
+                                break;
+                            case SDLK_RIGHTBRACKET:
+                                command.type = SIM_CLOCK_RATE;
+                                command.value = 1;
+                                sim_send(sim, &command);
+                                break;
+                            case SDLK_BACKSLASH:
+                                command.type = SIM_CLOCK_RATE;
+                                command.value = 0;
+                                sim_send(sim, &command);
+                                break;
                         }
                     }
                     break;
@@ -1059,6 +1694,7 @@ int main(int argc, char *argv[]) {
                         }
                         
                         chaosButton.hover = is_point_in_rect(mouseX, mouseY, &chaosButton.rect);
+                        levelButton.hover = is_point_in_rect(mouseX, mouseY, &levelButton.rect);
                         playButton.hover = is_point_in_rect(mouseX, mouseY, &playButton.rect);
                         exitButton.hover = is_point_in_rect(mouseX, mouseY, &exitButton.rect);
                     } else if (gameState == GAME_OVER) {
@@ -1090,6 +1726,15 @@ int main(int argc, char *argv[]) {
                                 }
                             }
                             
+                            // Check level button
+                            if (is_point_in_rect(mouseX, mouseY, &levelButton.rect)) {
+                                levelIndex = next_playable_level(levelIndex);
+                                // A full-length level name is cut to what the button holds
+                                snprintf(levelButton.text, sizeof(levelButton.text), "LEVEL: %.*s",
+                                         (int)(sizeof(levelButton.text) - sizeof("LEVEL: ")),
+                                         levelIndex < 0 ? "OPEN BOARD" : level_pack_name(&levelPack, levelIndex));
+                            }
+                            
                             // Check play button
                             if (is_point_in_rect(mouseX, mouseY, &playButton.rect)) {
                                 // Configure game features based on checkboxes
@@ -1104,15 +1749,13 @@ int main(int argc, char *argv[]) {
                                                 checkboxes[3].checked && 
                                                 checkboxes[4].checked;
                                 
-                                // Configure the game based on selected features
-                                configure_game(&config, &features, &snake);
-                                
-                                // Reset the game
-                                reset_game(&snake, &config, &score);
-                                
-                                // Set last update times for moving objects
-                                config.lastFruitMove = SDL_GetTicks();
-                                config.lastObstacleMove = SDL_GetTicks();
+                                // Have the sim thread set up and start the round
+                                SimCommand command = {.type = SIM_START};
+                                command.features = features;
+                                command.level = level_pack_get(&levelPack, levelIndex);
+                                command.seed = nextSeed++;
+                                command.gameId = ++gameId;
+                                sim_send(sim, &command);
                                 
                                 // Switch to playing state
                                 gameState = PLAYING;
@@ -1140,44 +1783,26 @@ int main(int argc, char *argv[]) {
         
         Uint32 currentTime = SDL_GetTicks();
         
-        // Update game state
-        if (gameState == PLAYING) {
-            // Update at appropriate intervals based on speed setting
-            if (currentTime - lastUpdate > config.updateDelay) {
-                // Move the snake
-                move_snake(&snake);
-                
-                // Check for obstacle collision
-                if (check_obstacle_collision(&snake, &config)) {
-                    snake.alive = false;
-                }
-                
-                // Check for food collision and handle multiple food types
-                for (int i = 0; i < config.foodCount; i++) {
-                    if (check_food_collision(&snake, &config.foods[i])) {
-                        // Increase score based on food value
-                        score += config.foods[i].value;
-                        
-                        // Grow snake
-                        grow_snake(&snake);
-                        
-                        // Replace eaten food
-                        place_food(&config.foods[i], &snake, &config);
-                    }
-                }
-                
-                // Update game elements (moving fruits, obstacles, timer)
-                update_game(&snake, &config, &score, currentTime);
-                
-                // Check if game over
-                if (!snake.alive) {
-                    gameState = GAME_OVER;
-                }
-                
-                lastUpdate = currentTime;
+        // Pick up edited mode definitions, but never in the middle of a round
+        if (mode_watch_changed(modeWatch)) {
+            modesChanged = true;
+        }
+        if (modesChanged && gameState != PLAYING) {
+            modesChanged = false;
+            if (load_modes(MODES_FILE, &modes)) {
+                log_info("Reloaded %s", MODES_FILE);
             }
         }
         
+        // Take the newest state the sim thread has published
+        view = sim_latest(sim);
+        bool currentRound = view->gameId == gameId;
+        
+        // Check if game over
+        if (gameState == PLAYING && currentRound && !view->playing) {
+            gameState = GAME_OVER;
+        }
+        
         // Calculate FPS
         frames++;
         if (currentTime - lastFPSUpdate >= 1000) {
@@ -1186,6 +1811,11 @@ int main(int argc, char *argv[]) {
             lastFPSUpdate = currentTime;
         }
         
+        // While recording, draw into the offscreen target instead of the window
+        if (recording) {
+            SDL_SetRenderTarget(renderer, captureTarget);
+        }
+        
         // Clear screen
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
@@ -1193,49 +1823,71 @@ int main(int argc, char *argv[]) {
         // Render game elements based on game state
         switch (gameState) {
             case MENU:
-                draw_challenge_menu(renderer, checkboxes, 5, &chaosButton, &playButton, &exitButton, font);
+                draw_challenge_menu(renderer, checkboxes, 5, &chaosButton, &levelButton, &playButton, &exitButton, font);
                 break;
             
                 
-            case PLAYING:
-                draw_ui_area(renderer, score, &config, font);
-                draw_grid(renderer);
-                
-                // Draw all food items
-                for (int i = 0; i < config.foodCount; i++) {
-                    draw_food(renderer, &config.foods[i]);
-                }
-                
-                // Draw obstacles if enabled
-                if (config.hasObstacles) {
-                    draw_obstacles(renderer, &config);
-                }
+            case PLAYING: {
+                // Until the round's first snapshot arrives there is nothing to show
+                if (!currentRound) break;
                 
-                // Draw snake
-                draw_snake(renderer, &snake);
+                draw_playing(renderer, &view->snake, &view->config, view->score, view->paused,
+                             view->rateIndex, font);
                 break;
+            }
                 
             case GAME_OVER:
-                draw_game_over_screen(renderer, score, &playAgainButton, &exitButton, font);
+                draw_game_over_screen(renderer, view->score, &playAgainButton, &exitButton, font);
                 break;
         }
         
-        // Display FPS in debug mode (optional)
-        if (0) { // Set to 1 to enable FPS display
-            char fps_text[16];
-            sprintf(fps_text, "FPS: %d", fps);
-            SDL_Color white = {255, 255, 255, 255};
-            draw_text(renderer, font, fps_text, 10, 10, white);
+        // Hand the frame to the encoder, then show it with a marker the video leaves out
+        if (recording) {
+            exporter_capture(recording, renderer, false);
+            SDL_SetRenderTarget(renderer, NULL);
+            SDL_RenderCopy(renderer, captureTarget, NULL, NULL);
+            
+            SDL_Rect marker = {WINDOW_WIDTH - 20, 8, 12, 12};
+            SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+            SDL_RenderFillRect(renderer, &marker);
+        }
+        
+        // F3 overlay, after the capture so videos leave it out too
+        if (showProfiler) {
+            draw_profiler(renderer, smallFont ? smallFont : font, fps, &inputLatency, &frameTimes);
         }
         
         // Present render
         SDL_RenderPresent(renderer);
+        metrics_frame();
         
-        // Cap frame rate (optional)
-        SDL_Delay(1);
+        // Time from key press to this frame for a turn it shows for the first time
+        Uint32 presentTime = SDL_GetTicks();
+        if (gameState == PLAYING && currentRound && view->turnsTaken != turnsShown) {
+            latency_turn_taken(&inputLatency, view->turnPressed);
+            latency_presented(&inputLatency, presentTime);
+        }
+        turnsShown = view->turnsTaken;
+        if (lastPresent != 0) latency_record(&frameTimes, presentTime - lastPresent);
+        lastPresent = presentTime;
+        
+        // Sleep until the next frame, waking early for input; ticks happen on the sim thread
+        Uint32 now = SDL_GetTicks();
+        Uint32 wake = currentTime + FRAME_INTERVAL;
+        if (!SDL_TICKS_PASSED(now, wake)) {
+            SDL_WaitEventTimeout(NULL, wake - now);
+        }
     }
     
     // Cleanup resources
+    if (recording) exporter_close(recording);
+    if (captureTarget) SDL_DestroyTexture(captureTarget);
+    sim_destroy(sim);
+    level_pack_close(&levelPack);
+#ifdef __linux__
+    if (modeWatch >= 0) close(modeWatch);
+#endif
+    if (smallFont) TTF_CloseFont(smallFont);
     TTF_CloseFont(font);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,1103 @@
+#ifndef CHALLENGE_RULES_H
+#define CHALLENGE_RULES_H
+
+// Rules of the challenge modes, shared by challenge.c (the game, its headless
+// --simulate runs and video export) and snake_env.c (the training environments).
+// Nothing here touches SDL.
+//
+// A round is set up with configure_game(), select_level(), game_seed() and
+// reset_game(); schedule_game() then files the snake, the countdown and every
+// moving fruit and obstacle into a timer wheel, each on its own interval, and
+// every timer scheduler_poll() hands out is run by handle_timer(). All times are
+// virtual game ms, so the caller decides how they map to the wall clock.
+//
+// The rules keep a Zobrist hash (zobrist.h) of the snake's body, the score and
+// where every fruit and obstacle is up to date as they move, a few keys per move;
+// round_hash() adds the headings, the clock and the generator and gives the hash
+// of the whole round.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "async_log.h"
+#include "levels.h"
+#include "zobrist.h"
+
+// Board size in cells
+#define GRID_WIDTH 32  // 640 / 20
+#define GRID_HEIGHT 24 // 480 / 20
+
+// Max number of obstacles and foods
+#define MAX_OBSTACLES 30
+#define MAX_FOODS 5
+#define OBSTACLE_PLACE_ATTEMPTS 1000 // Give up on an obstacle after this many rejected cells
+#define BOARD_WORDS (GRID_HEIGHT * LEVEL_ROW_WORDS(GRID_WIDTH)) // Board bitmap size
+
+// Timer wheel: level 0 has 1 ms slots, every level above is WHEEL_SIZE times coarser
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4                                // Covers 64^4 ms (about 4.6 hours)
+#define MAX_TIMERS (MAX_FOODS + MAX_OBSTACLES + 2)    // Snake, countdown, fruits, obstacles
+
+// Feature bits; every combination gets its own specialized timer handler
+#define FEATURE_MOVING_FRUIT (1 << 0)
+#define FEATURE_MULTI_FRUIT (1 << 1)
+#define FEATURE_TIMED (1 << 2)
+#define FEATURE_OBSTACLES (1 << 3)
+#define FEATURE_MOVING_OBSTACLES (1 << 4)
+#define FEATURE_COMBINATIONS 32
+
+// Force the per-feature kernels to be inlined so disabled features fold away
+#ifdef __GNUC__
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE inline
+#endif
+
+// Game feature flags
+typedef struct {
+    bool movingFruit;
+    bool multiFruit;
+    bool timed;
+    bool obstacles;
+    bool speed;
+    bool chaos;
+} GameFeatures;
+
+typedef struct {
+    int x, y;
+} Segment;
+
+typedef struct {
+    Segment body[100]; 
+    int length;
+    int dx, dy;
+    bool alive;
+} Snake;
+
+typedef struct {
+    int x, y;
+    int value;   // Point value
+    int type;    // Visual type
+    bool moving; // Whether it moves
+    int dx, dy;  // Direction for moving fruits
+    int moveInterval; // ms between steps for moving fruits
+} Food;
+
+typedef struct {
+    int x, y;
+    int dx, dy;  // Direction for moving obstacles
+    bool moving; // Whether it moves
+    int moveInterval; // ms between steps for moving obstacles
+} Obstacle;
+
+// Tunable mode parameters, parsed once from a mode file (modes.cfg) into this flat form
+typedef struct {
+    int16_t normalDelay;          // ms per snake step
+    int16_t speedDelay;           // ms per snake step in speed mode
+    int16_t timedSeconds;         // Length of a timed round
+    int16_t fruitMoveInterval;    // ms per moving fruit step
+    int16_t fruitIntervalStep;    // Each rarer fruit type moves this much faster
+    int16_t obstacleMoveInterval; // Base ms per moving obstacle step
+    int16_t obstacleJitter;       // Obstacles vary by -2..2 times this
+    int16_t obstaclesMin, obstaclesMax;
+    int16_t fruitsMin, fruitsMax;
+} ModeTable;
+
+struct Timer;
+struct GameConfig;
+typedef void (*TimerHandler)(struct Timer *timer, Snake *snake, struct GameConfig *config, int *score);
+
+typedef struct GameConfig {
+    bool timed;
+    int timeRemaining; // In seconds
+    int maxTime;       // Starting time
+    
+    bool hasObstacles;
+    Obstacle obstacles[MAX_OBSTACLES];
+    int obstacleCount;
+    bool movingObstacles;
+    int obstacleMoveInterval; // Base interval, individual obstacles vary around it
+    
+    bool movingFruit;
+    int fruitMoveInterval; // How often the fruit moves (in milliseconds), rarer fruit moves faster
+    
+    bool multiFruit;
+    Food foods[MAX_FOODS];
+    int foodCount;
+    
+    bool speed;
+    int updateDelay; // Basic snake speed
+    
+    char modeName[50]; // Name of the current mode configuration
+    
+    uint64_t rngState; // Game PRNG, seeded per game so a run can be reproduced
+    ModeTable mode;    // Mode parameters in effect for this round
+    
+    const LevelHeader *level; // Map from the level pack, NULL for the open board
+    const uint64_t *walls;    // Wall bitmap of the level (points into the pack) or an empty one
+    
+    unsigned featureMask;     // FEATURE_* bits of this configuration
+    TimerHandler handleTimer; // Timer handler specialized for featureMask
+    
+    uint64_t hash; // Zobrist hash kept by the rules; see round_hash()
+} GameConfig;
+
+// Everything that runs on its own interval
+typedef enum {
+    TIMER_SNAKE,     // Snake movement, every updateDelay ms
+    TIMER_COUNTDOWN, // Timed mode clock, every second
+    TIMER_FOOD,      // One moving fruit (index into foods)
+    TIMER_OBSTACLE   // One moving obstacle (index into obstacles)
+} TimerKind;
+
+typedef struct Timer {
+    TimerKind kind;
+    int index;
+    uint32_t expires;  // Absolute time of the next firing
+    uint32_t interval; // Period in ms
+    int next;          // Next timer in the same wheel slot, -1 at the end
+} Timer;
+
+// Hierarchical timer wheel; every timer sits in exactly one slot
+typedef struct {
+    Timer timers[MAX_TIMERS];
+    int timerCount;
+    int slots[WHEEL_LEVELS][WHEEL_SIZE]; // Head of each slot's list, -1 if empty
+    int pending;                         // Timers due at `now` not handed out yet
+    uint32_t now;                        // Time the wheel has been advanced to
+} Scheduler;
+
+// Built-in values, used when the mode file is missing or leaves a key out
+static const ModeTable default_modes = {
+    150, 100, 60, 500, 50, 800, 100, 15, 30, 3, 5
+};
+
+// Walls of the open board: none
+static const uint64_t open_board_walls[BOARD_WORDS];
+
+// Random positions place_food drew and had to draw again; owned by the thread running the game
+static _Thread_local unsigned long food_place_retries;
+
+// xorshift64* game PRNG; every random choice in a game comes from here
+static inline void game_seed(GameConfig *config, uint64_t seed) {
+    config->rngState = seed ? seed : 0x9E3779B97F4A7C15ull;
+}
+
+static inline int game_rand(GameConfig *config) {
+    config->rngState ^= config->rngState >> 12;
+    config->rngState ^= config->rngState << 25;
+    config->rngState ^= config->rngState >> 27;
+    return (int)((config->rngState * 0x2545F4914F6CDD1Dull) >> 33);
+}
+
+// Level walls; x and y must be on the board
+static inline bool cell_is_wall(GameConfig *config, int x, int y) {
+    return level_bit(config->walls, GRID_WIDTH, x, y);
+}
+
+// Zobrist keys of the pieces config->hash is made of
+static inline uint64_t head_key(const Snake *snake) {
+    return zobrist_key(ZOBRIST_HEAD, 0, snake->body[0].x, snake->body[0].y);
+}
+
+// Segment i and the one behind it
+static inline uint64_t link_key(const Snake *snake, int i) {
+    return zobrist_link(0, snake->body[i].x, snake->body[i].y, snake->body[i + 1].x, snake->body[i + 1].y);
+}
+
+static inline uint64_t score_key(int score) {
+    return zobrist_key(ZOBRIST_SCORE, 0, score, 0);
+}
+
+static inline uint64_t food_key(const GameConfig *config, int i) {
+    return zobrist_key(ZOBRIST_FOOD, i, config->foods[i].x, config->foods[i].y);
+}
+
+static inline uint64_t obstacle_key(const GameConfig *config, int i) {
+    return zobrist_key(ZOBRIST_OBSTACLE, i, config->obstacles[i].x, config->obstacles[i].y);
+}
+
+// config->hash computed from scratch, for a round set up or loaded without the rules
+static inline uint64_t round_rehash(const Snake *snake, const GameConfig *config, int score) {
+    uint64_t hash = head_key(snake) ^ score_key(score);
+    for (int i = 0; i + 1 < snake->length; i++) hash ^= link_key(snake, i);
+    for (int i = 0; i < config->foodCount; i++) hash ^= food_key(config, i);
+    for (int i = 0; i < config->obstacleCount; i++) hash ^= obstacle_key(config, i);
+    return hash;
+}
+
+// Hash of the whole round, for checking that two runs agree tick by tick and as a
+// transposition key. Headings are set directly by the player, and the rest changes
+// at most once a second or is fixed for the round, so they are added here instead
+// of tracked.
+static inline uint64_t round_hash(const Snake *snake, const GameConfig *config) {
+    uint64_t hash = config->hash ^ zobrist_key(ZOBRIST_HEADING, 0, snake->dx, snake->dy) ^
+                    zobrist_key(ZOBRIST_RNG, 0, (int)(config->rngState >> 16 & 0xffff), (int)(config->rngState & 0xffff)) ^
+                    zobrist_key(ZOBRIST_RNG, 1, (int)(config->rngState >> 48), (int)(config->rngState >> 32 & 0xffff));
+    if (snake->alive) hash ^= zobrist_key(ZOBRIST_ALIVE, 0, 0, 0);
+    if (config->timed) hash ^= zobrist_key(ZOBRIST_TIME_LEFT, 0, config->timeRemaining, 0);
+    for (int i = 0; i < config->foodCount; i++) {
+        const Food *food = &config->foods[i];
+        if (food->moving) hash ^= zobrist_key(ZOBRIST_FOOD_HEADING, i, food->dx, food->dy);
+    }
+    for (int i = 0; i < config->obstacleCount; i++) {
+        const Obstacle *obstacle = &config->obstacles[i];
+        if (obstacle->moving) hash ^= zobrist_key(ZOBRIST_OBSTACLE_HEADING, i, obstacle->dx, obstacle->dy);
+    }
+    return hash;
+}
+
+static inline void move_snake(Snake *snake) {
+    // Move body segments
+    for (int i = snake->length - 1; i > 0; i--) {
+        snake->body[i] = snake->body[i - 1];
+    }
+    
+    // Move head
+    snake->body[0].x += snake->dx;
+    snake->body[0].y += snake->dy;
+
+    // Check wall collision
+    if (snake->body[0].x < 0 || snake->body[0].x >= GRID_WIDTH ||
+        snake->body[0].y < 0 || snake->body[0].y >= GRID_HEIGHT) {
+        snake->alive = false;
+    }
+    
+    // Check self collision
+    for (int i = 1; i < snake->length; i++) {
+        if (snake->body[0].x == snake->body[i].x && snake->body[0].y == snake->body[i].y) {
+            snake->alive = false;
+            break;
+        }
+    }
+}
+
+static inline bool check_food_collision(Snake *snake, Food *food) {
+    return (snake->body[0].x == food->x && snake->body[0].y == food->y);
+}
+
+static inline bool check_obstacle_collision(Snake *snake, GameConfig *config) {
+    if (!config->hasObstacles) return false;
+    
+    for (int i = 0; i < config->obstacleCount; i++) {
+        if (snake->body[0].x == config->obstacles[i].x && 
+            snake->body[0].y == config->obstacles[i].y) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline void grow_snake(Snake *snake) {
+    if (snake->length < 100) {
+        snake->body[snake->length] = snake->body[snake->length - 1];
+        snake->length++;
+    }
+}
+
+// Shared by every kernel; `features` is a compile-time constant in the specialized handlers
+static KERNEL_INLINE void place_food_kernel(Food *food, Snake *snake, GameConfig *config, unsigned features) {
+    bool valid_position = false;
+    int x, y;
+    unsigned long draws = 0;
+    
+    while (!valid_position) {
+        draws++;
+        x = game_rand(config) % GRID_WIDTH;
+        y = game_rand(config) % GRID_HEIGHT;
+        
+        // Levels restrict food to their food zone, which never includes walls
+        if (config->level) {
+            valid_position = level_bit(level_food_zone(config->level), GRID_WIDTH, x, y);
+            if (!valid_position) continue;
+        }
+        valid_position = true;
+        
+        // Check if the position is not occupied by the snake
+        for (int i = 0; i < snake->length; i++) {
+            if (x == snake->body[i].x && y == snake->body[i].y) {
+                valid_position = false;
+                break;
+            }
+        }
+        
+        // Check if the position is not occupied by an obstacle
+        if ((features & FEATURE_OBSTACLES) && valid_position) {
+            for (int i = 0; i < config->obstacleCount; i++) {
+                if (x == config->obstacles[i].x && y == config->obstacles[i].y) {
+                    valid_position = false;
+                    break;
+                }
+            }
+        }
+        
+        // Check if the position is not occupied by another food item
+        if ((features & FEATURE_MULTI_FRUIT) && valid_position) {
+            for (int i = 0; i < config->foodCount; i++) {
+                if (x == config->foods[i].x && y == config->foods[i].y) {
+                    valid_position = false;
+                    break;
+                }
+            }
+        }
+    }
+    
+    int slot = (int)(food - config->foods);
+    config->hash ^= food_key(config, slot);
+    food->x = x;
+    food->y = y;
+    config->hash ^= food_key(config, slot);
+    food_place_retries += draws - 1;
+    
+    // For moving fruit
+    if ((features & FEATURE_MOVING_FRUIT) && food->moving) {
+        // Randomly assign an initial direction
+        do {
+            food->dx = (game_rand(config) % 3) - 1; // -1, 0, or 1
+            food->dy = (game_rand(config) % 3) - 1; // -1, 0, or 1
+        } while (food->dx == 0 && food->dy == 0); // Ensure it's not stationary
+    }
+}
+
+static inline void place_food(Food *food, Snake *snake, GameConfig *config) {
+    place_food_kernel(food, snake, config, config->featureMask);
+}
+
+// Would blocking the free cell (x, y) in `open` still leave every free cell reachable
+// from every other? On success the cell is left blocked, otherwise `open` is unchanged.
+static inline bool keeps_board_connected(uint64_t *open, int x, int y) {
+    // Quick local test: walk the 8 cells around (x, y). If all of its free direct
+    // neighbours are joined through that ring, any path through (x, y) can go around it.
+    static const int ring[8][2] = {{0, -1}, {1, -1}, {1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}};
+    bool freeCell[8];
+    int start = -1;
+    for (int k = 0; k < 8; k++) {
+        int nx = x + ring[k][0], ny = y + ring[k][1];
+        freeCell[k] = nx >= 0 && nx < GRID_WIDTH && ny >= 0 && ny < GRID_HEIGHT &&
+                      level_bit(open, GRID_WIDTH, nx, ny);
+        if (!freeCell[k]) start = k;
+    }
+    
+    int groups = 0;
+    if (start < 0) {
+        groups = 1; // Completely surrounded by free cells
+    } else {
+        bool inRun = false, runHasNeighbour = false;
+        for (int step = 1; step <= 8; step++) {
+            int k = (start + step) % 8;
+            if (freeCell[k]) {
+                inRun = true;
+                runHasNeighbour |= (k % 2 == 0); // Even ring positions are the direct neighbours
+            } else if (inRun) {
+                groups += runHasNeighbour;
+                inRun = runHasNeighbour = false;
+            }
+        }
+    }
+    
+    int word = y * LEVEL_ROW_WORDS(GRID_WIDTH) + (x >> 6);
+    uint64_t bit = 1ULL << (x & 63);
+    open[word] &= ~bit;
+    if (groups <= 1) return true;
+    
+    // Otherwise flood fill from one neighbour and check that nothing was cut off
+    uint64_t reach[BOARD_WORDS] = {0};
+    for (int k = 0; k < 8; k += 2) {
+        if (freeCell[k]) {
+            int nx = x + ring[k][0], ny = y + ring[k][1];
+            reach[ny * LEVEL_ROW_WORDS(GRID_WIDTH) + (nx >> 6)] |= 1ULL << (nx & 63);
+            break;
+        }
+    }
+    if (level_flood_fill(open, reach, GRID_WIDTH, GRID_HEIGHT) == level_count_bits(open, GRID_WIDTH, GRID_HEIGHT)) {
+        return true;
+    }
+    open[word] |= bit;
+    return false;
+}
+
+// Scatter obstacles without ever splitting the free cells into separate regions,
+// so every fruit stays reachable
+static inline void place_obstacles(GameConfig *config, Snake *snake) {
+    if (!config->hasObstacles) return;
+    
+    // Free cells: everything except walls (and, as they are placed, obstacles)
+    uint64_t open[BOARD_WORDS];
+    for (int i = 0; i < BOARD_WORDS; i++) {
+        open[i] = ~config->walls[i];
+    }
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        open[y * LEVEL_ROW_WORDS(GRID_WIDTH) + LEVEL_ROW_WORDS(GRID_WIDTH) - 1] &= 
+            GRID_WIDTH % 64 ? (1ULL << (GRID_WIDTH % 64)) - 1 : ~0ULL;
+    }
+    
+    int target = config->mode.obstaclesMin + 
+                 game_rand(config) % (config->mode.obstaclesMax - config->mode.obstaclesMin + 1);
+    config->obstacleCount = 0;
+    
+    for (int i = 0; i < target; i++) {
+        bool valid_position = false;
+        int x, y;
+        int attempts = 0;
+        
+        while (!valid_position && attempts++ < OBSTACLE_PLACE_ATTEMPTS) {
+            x = game_rand(config) % GRID_WIDTH;
+            y = game_rand(config) % GRID_HEIGHT;
+            
+            // Keep off walls and other obstacles
+            valid_position = level_bit(open, GRID_WIDTH, x, y);
+            if (!valid_position) continue;
+            
+            // Check if the position is not occupied by the snake
+            for (int j = 0; j < snake->length; j++) {
+                if (x == snake->body[j].x && y == snake->body[j].y) {
+                    valid_position = false;
+                    break;
+                }
+            }
+            
+            // Check if the position is not occupied by food
+            for (int j = 0; j < config->foodCount; j++) {
+                if (x == config->foods[j].x && y == config->foods[j].y) {
+                    valid_position = false;
+                    break;
+                }
+            }
+            
+            // Make sure there's enough space around the snake's head
+            if (abs(x - snake->body[0].x) < 3 && abs(y - snake->body[0].y) < 3) {
+                valid_position = false;
+            }
+            
+            // Never cut the board in two
+            if (valid_position && !keeps_board_connected(open, x, y)) {
+                valid_position = false;
+            }
+        }
+        
+        // A crowded level may have no safe cell left; play with fewer obstacles
+        if (!valid_position) break;
+        config->obstacleCount = i + 1;
+        
+        config->obstacles[i].x = x;
+        config->obstacles[i].y = y;
+        
+        // For moving obstacles
+        if (config->movingObstacles && game_rand(config) % 3 == 0) { // 1/3 chance to be moving
+            config->obstacles[i].moving = true;
+            // Each obstacle drifts at its own pace around the base interval
+            config->obstacles[i].moveInterval = config->obstacleMoveInterval + 
+                                                (game_rand(config) % 5 - 2) * config->mode.obstacleJitter;
+            // Randomly assign an initial direction
+            do {
+                config->obstacles[i].dx = (game_rand(config) % 3) - 1; // -1, 0, or 1
+                config->obstacles[i].dy = (game_rand(config) % 3) - 1; // -1, 0, or 1
+            } while (config->obstacles[i].dx == 0 && config->obstacles[i].dy == 0);
+        } else {
+            config->obstacles[i].moving = false;
+        }
+    }
+}
+
+static inline void initialize_multi_fruits(GameConfig *config, Snake *snake) {
+    if (!config->multiFruit) {
+        config->foodCount = 1;
+        config->foods[0].type = 0;  // Regular food
+        config->foods[0].value = 1;
+        config->foods[0].moving = config->movingFruit;
+        config->foods[0].moveInterval = config->fruitMoveInterval;
+        place_food(&config->foods[0], snake, config);
+        return;
+    }
+    
+    // For multi-fruit mode, place 3-5 fruits
+    config->foodCount = config->mode.fruitsMin + 
+                        game_rand(config) % (config->mode.fruitsMax - config->mode.fruitsMin + 1);
+    
+    for (int i = 0; i < config->foodCount; i++) {
+        config->foods[i].type = game_rand(config) % 4; // 0-3 different types
+        
+        // Set point value based on type
+        switch (config->foods[i].type) {
+            case 0: config->foods[i].value = 1; break;  // Regular
+            case 1: config->foods[i].value = 2; break;  // Bonus
+            case 2: config->foods[i].value = 3; break;  // Special
+            case 3: config->foods[i].value = 5; break;  // Rare
+        }
+        
+        // Determine if this fruit should move (if moving fruit is enabled)
+        if (config->movingFruit) {
+            // Higher value fruits are more likely to move
+            config->foods[i].moving = (game_rand(config) % 5 < config->foods[i].type + 2);
+            config->foods[i].moveInterval = config->fruitMoveInterval - 
+                                             config->foods[i].type * config->mode.fruitIntervalStep;
+        } else {
+            config->foods[i].moving = false;
+        }
+        
+        place_food(&config->foods[i], snake, config);
+    }
+}
+
+static inline void reset_game(Snake *snake, GameConfig *config, int *score) {
+    // Reset snake: middle of the board heading right, or one of the level's spawns
+    int headX = GRID_WIDTH / 2, headY = GRID_HEIGHT / 2;
+    snake->dx = 1;
+    snake->dy = 0;
+    if (config->level) {
+        const LevelSpawn *spawn = &level_spawns(config->level)[game_rand(config) % config->level->spawnCount];
+        headX = spawn->x;
+        headY = spawn->y;
+        snake->dx = spawn->dx;
+        snake->dy = spawn->dy;
+    }
+    
+    snake->length = 3;
+    for (int i = 0; i < snake->length; i++) {
+        snake->body[i].x = headX - snake->dx * i;
+        snake->body[i].y = headY - snake->dy * i;
+    }
+    snake->alive = true;
+    
+    // Reset score
+    *score = 0;
+    
+    // Reset time for timed mode
+    if (config->timed) {
+        config->timeRemaining = config->maxTime;
+    }
+    
+    // Place obstacles
+    if (config->hasObstacles) {
+        place_obstacles(config, snake);
+    }
+    
+    // Place food items
+    if (config->multiFruit) {
+        initialize_multi_fruits(config, snake);
+    } else {
+        config->foodCount = 1;
+        config->foods[0].type = 0;  // Regular food
+        config->foods[0].value = 1;
+        config->foods[0].moving = config->movingFruit;
+        config->foods[0].moveInterval = config->fruitMoveInterval;
+        place_food(&config->foods[0], snake, config);
+    }
+    
+    config->hash = round_rehash(snake, config, *score);
+}
+
+static KERNEL_INLINE void move_food_kernel(GameConfig *config, int i, unsigned features) {
+    Food *food = &config->foods[i];
+    if (!(features & FEATURE_MOVING_FRUIT) || !food->moving) return;
+    
+    int new_x = food->x + food->dx;
+    int new_y = food->y + food->dy;
+    
+    // Check if the food would go out of bounds and change direction if needed
+    if (new_x < 0 || new_x >= GRID_WIDTH) {
+        food->dx *= -1;
+        new_x = food->x + food->dx;
+    }
+    
+    if (new_y < 0 || new_y >= GRID_HEIGHT) {
+        food->dy *= -1;
+        new_y = food->y + food->dy;
+    }
+    
+    // Check if the food would collide with a wall or an obstacle
+    bool collision = cell_is_wall(config, new_x, new_y);
+    if ((features & FEATURE_OBSTACLES) && !collision) {
+        for (int j = 0; j < config->obstacleCount; j++) {
+            if (new_x == config->obstacles[j].x && new_y == config->obstacles[j].y) {
+                collision = true;
+                break;
+            }
+        }
+    }
+    
+    // If no collision, update the position
+    if (!collision) {
+        config->hash ^= food_key(config, i);
+        food->x = new_x;
+        food->y = new_y;
+        config->hash ^= food_key(config, i);
+    } else {
+        // Otherwise, change direction
+        food->dx *= -1;
+        food->dy *= -1;
+    }
+}
+
+static KERNEL_INLINE void move_obstacle_kernel(GameConfig *config, int i, unsigned features) {
+    Obstacle *obstacle = &config->obstacles[i];
+    if (!(features & FEATURE_MOVING_OBSTACLES) || !obstacle->moving) return;
+    
+    int new_x = obstacle->x + obstacle->dx;
+    int new_y = obstacle->y + obstacle->dy;
+    
+    // Check if the obstacle would go out of bounds and change direction if needed
+    if (new_x < 0 || new_x >= GRID_WIDTH) {
+        obstacle->dx *= -1;
+        new_x = obstacle->x + obstacle->dx;
+    }
+    
+    if (new_y < 0 || new_y >= GRID_HEIGHT) {
+        obstacle->dy *= -1;
+        new_y = obstacle->y + obstacle->dy;
+    }
+    
+    // Check for collisions with walls and other obstacles
+    bool collision = cell_is_wall(config, new_x, new_y);
+    for (int j = 0; j < config->obstacleCount; j++) {
+        if (i != j && new_x == config->obstacles[j].x && new_y == config->obstacles[j].y) {
+            collision = true;
+            break;
+        }
+    }
+    
+    // Check for collisions with food
+    int foodCount = (features & FEATURE_MULTI_FRUIT) ? config->foodCount : 1;
+    for (int j = 0; j < foodCount; j++) {
+        if (new_x == config->foods[j].x && new_y == config->foods[j].y) {
+            collision = true;
+            break;
+        }
+    }
+    
+    // If no collision, update the position
+    if (!collision) {
+        config->hash ^= obstacle_key(config, i);
+        obstacle->x = new_x;
+        obstacle->y = new_y;
+        config->hash ^= obstacle_key(config, i);
+    } else {
+        // Otherwise, change direction
+        obstacle->dx *= -1;
+        obstacle->dy *= -1;
+    }
+}
+
+// The challenge board has a fixed size; bigger maps are for other modes
+static inline bool level_fits_board(const LevelHeader *level) {
+    return level && level->width == GRID_WIDTH && level->height == GRID_HEIGHT;
+}
+
+// Play on a level from the pack (NULL or a level of the wrong size: open board).
+// The level stays in the mapped pack; only pointers are switched.
+static inline void select_level(GameConfig *config, const LevelHeader *level) {
+    if (level_fits_board(level)) {
+        config->level = level;
+        config->walls = level_walls(level);
+    } else {
+        config->level = NULL;
+        config->walls = open_board_walls;
+    }
+}
+
+// Reset the wheel to an empty state at time `now`
+static inline void scheduler_init(Scheduler *scheduler, uint32_t now) {
+    scheduler->timerCount = 0;
+    scheduler->pending = -1;
+    scheduler->now = now;
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < WHEEL_SIZE; slot++) {
+            scheduler->slots[level][slot] = -1;
+        }
+    }
+}
+
+// File a timer into the slot matching how far away it expires
+static inline void scheduler_insert(Scheduler *scheduler, int id) {
+    Timer *timer = &scheduler->timers[id];
+    // Timers due right now only arrive here while cascading, before the current
+    // level 0 slot is collected; anything older fires on the next millisecond
+    if ((int32_t)(timer->expires - scheduler->now) < 0) {
+        timer->expires = scheduler->now + 1;
+    }
+    
+    // Lowest level whose slots have not yet passed the expiry time, so the slot
+    // is reached before the wheel comes around again
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 &&
+           (timer->expires >> (WHEEL_BITS * level)) - (scheduler->now >> (WHEEL_BITS * level)) >= WHEEL_SIZE) {
+        level++;
+    }
+    
+    int slot = (timer->expires >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    timer->next = scheduler->slots[level][slot];
+    scheduler->slots[level][slot] = id;
+}
+
+// Register a periodic timer that first fires `interval` ms from now
+static inline void scheduler_add(Scheduler *scheduler, TimerKind kind, int index, uint32_t interval) {
+    if (scheduler->timerCount >= MAX_TIMERS || interval == 0) return;
+    
+    int id = scheduler->timerCount++;
+    Timer *timer = &scheduler->timers[id];
+    timer->kind = kind;
+    timer->index = index;
+    timer->interval = interval;
+    timer->expires = scheduler->now + interval;
+    scheduler_insert(scheduler, id);
+}
+
+// Move the timers of one coarse slot down to the finer levels
+static inline void scheduler_cascade(Scheduler *scheduler, int level) {
+    int slot = (scheduler->now >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    int id = scheduler->slots[level][slot];
+    scheduler->slots[level][slot] = -1;
+    
+    while (id >= 0) {
+        int next = scheduler->timers[id].next;
+        scheduler_insert(scheduler, id);
+        id = next;
+    }
+}
+
+// Advance the wheel towards `target` and return the next timer that is due, or NULL
+// once the wheel has caught up. The returned timer is already re-armed for its next period.
+static inline Timer *scheduler_poll(Scheduler *scheduler, uint32_t target) {
+    while (true) {
+        if (scheduler->pending >= 0) {
+            int id = scheduler->pending;
+            Timer *timer = &scheduler->timers[id];
+            scheduler->pending = timer->next;
+            
+            timer->expires += timer->interval;
+            scheduler_insert(scheduler, id);
+            return timer;
+        }
+        
+        if ((int32_t)(scheduler->now + 1 - target) > 0) {
+            return NULL;
+        }
+        
+        scheduler->now++;
+        
+        // Pull coarser slots down whenever a finer level wraps around
+        for (int level = 1; level < WHEEL_LEVELS; level++) {
+            if ((scheduler->now >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) break;
+            scheduler_cascade(scheduler, level);
+        }
+        
+        int slot = scheduler->now & WHEEL_MASK;
+        scheduler->pending = scheduler->slots[0][slot];
+        scheduler->slots[0][slot] = -1;
+    }
+}
+
+// Earliest time something may fire; a coarse slot counts from when it cascades
+static inline uint32_t scheduler_next_deadline(Scheduler *scheduler) {
+    if (scheduler->pending >= 0) return scheduler->now;
+    
+    uint32_t deadline = scheduler->now + (1u << (WHEEL_BITS * WHEEL_LEVELS - 1));
+    for (int level = 0; level < WHEEL_LEVELS; level++) {
+        uint32_t base = scheduler->now >> (WHEEL_BITS * level);
+        for (uint32_t i = 1; i < WHEEL_SIZE; i++) {
+            if (scheduler->slots[level][(base + i) & WHEEL_MASK] >= 0) {
+                uint32_t when = (base + i) << (WHEEL_BITS * level);
+                if ((int32_t)(when - deadline) < 0) deadline = when;
+                break;
+            }
+        }
+    }
+    return deadline;
+}
+
+// Register the snake, the countdown and every moving fruit and obstacle
+static inline void schedule_game(Scheduler *scheduler, GameConfig *config, uint32_t now) {
+    scheduler_init(scheduler, now);
+    scheduler_add(scheduler, TIMER_SNAKE, 0, config->updateDelay);
+    
+    if (config->timed) {
+        scheduler_add(scheduler, TIMER_COUNTDOWN, 0, 1000);
+    }
+    
+    if (config->movingFruit) {
+        for (int i = 0; i < config->foodCount; i++) {
+            if (config->foods[i].moving) {
+                scheduler_add(scheduler, TIMER_FOOD, i, config->foods[i].moveInterval);
+            }
+        }
+    }
+    
+    if (config->movingObstacles) {
+        for (int i = 0; i < config->obstacleCount; i++) {
+            if (config->obstacles[i].moving) {
+                scheduler_add(scheduler, TIMER_OBSTACLE, i, config->obstacles[i].moveInterval);
+            }
+        }
+    }
+}
+
+// One snake step: movement, collisions and eating
+static KERNEL_INLINE void tick_snake_kernel(Snake *snake, GameConfig *config, int *score, unsigned features) {
+    // Move the snake; the tail's link goes, the head and its link arrive
+    config->hash ^= head_key(snake) ^ link_key(snake, snake->length - 2);
+    move_snake(snake);
+    config->hash ^= head_key(snake) ^ link_key(snake, 0);
+    
+    // Check for wall and obstacle collision
+    if (snake->alive && cell_is_wall(config, snake->body[0].x, snake->body[0].y)) {
+        snake->alive = false;
+    }
+    if ((features & FEATURE_OBSTACLES) && check_obstacle_collision(snake, config)) {
+        snake->alive = false;
+    }
+    
+    // Check for food collision and handle multiple food types
+    int foodCount = (features & FEATURE_MULTI_FRUIT) ? config->foodCount : 1;
+    for (int i = 0; i < foodCount; i++) {
+        if (check_food_collision(snake, &config->foods[i])) {
+            // Increase score based on food value
+            config->hash ^= score_key(*score) ^ score_key(*score + config->foods[i].value);
+            *score += config->foods[i].value;
+            
+            // Grow snake
+            int length = snake->length;
+            grow_snake(snake);
+            if (snake->length > length) config->hash ^= link_key(snake, length - 1);
+            
+            // Replace eaten food
+            place_food_kernel(&config->foods[i], snake, config, features);
+        }
+    }
+}
+
+static KERNEL_INLINE void handle_timer_kernel(Timer *timer, Snake *snake, GameConfig *config, int *score,
+                                              unsigned features) {
+    switch (timer->kind) {
+        case TIMER_SNAKE:
+            tick_snake_kernel(snake, config, score, features);
+            break;
+        case TIMER_COUNTDOWN:
+            if (!(features & FEATURE_TIMED)) break;
+            if (config->timeRemaining > 0) {
+                config->timeRemaining--;
+            }
+            if (config->timeRemaining <= 0) {
+                snake->alive = false;
+            }
+            break;
+        case TIMER_FOOD:
+            move_food_kernel(config, timer->index, features);
+            break;
+        case TIMER_OBSTACLE:
+            move_obstacle_kernel(config, timer->index, features);
+            break;
+    }
+}
+
+// Instantiate handle_timer_kernel once per feature combination
+#define FOR_EACH_FEATURE_MASK(X) \
+    X(0)  X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)  \
+    X(8)  X(9)  X(10) X(11) X(12) X(13) X(14) X(15) \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) \
+    X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31)
+
+#define DEFINE_TIMER_HANDLER(mask) \
+    static void handle_timer_##mask(Timer *timer, Snake *snake, GameConfig *config, int *score) { \
+        handle_timer_kernel(timer, snake, config, score, mask); \
+    }
+FOR_EACH_FEATURE_MASK(DEFINE_TIMER_HANDLER)
+
+#define TIMER_HANDLER_ENTRY(mask) handle_timer_##mask,
+static const TimerHandler timer_handlers[FEATURE_COMBINATIONS] = {
+    FOR_EACH_FEATURE_MASK(TIMER_HANDLER_ENTRY)
+};
+
+static inline TimerHandler select_timer_handler(unsigned featureMask) {
+    return timer_handlers[featureMask & (FEATURE_COMBINATIONS - 1)];
+}
+
+static inline void handle_timer(Timer *timer, Snake *snake, GameConfig *config, int *score) {
+    config->handleTimer(timer, snake, config, score);
+}
+
+static inline void generate_mode_name(GameConfig *config, const GameFeatures *features) {
+    strcpy(config->modeName, "");
+    
+    // Check if chaos mode (everything enabled)
+    if (features->movingFruit && features->multiFruit && features->timed && 
+        features->obstacles && features->speed) {
+        strcpy(config->modeName, "CHAOS MODE");
+        return;
+    }
+    
+    // Otherwise, build the name based on enabled features
+    if (!features->movingFruit && !features->multiFruit && !features->timed && 
+        !features->obstacles && !features->speed) {
+        strcpy(config->modeName, "CLASSIC");
+        return;
+    }
+    
+    // Build the name from enabled features
+    bool addedFeature = false;
+    
+    if (features->speed) {
+        strcat(config->modeName, "SPEED");
+        addedFeature = true;
+    }
+    
+    if (features->timed) {
+        if (addedFeature) strcat(config->modeName, "+");
+        strcat(config->modeName, "TIMED");
+        addedFeature = true;
+    }
+    
+    if (features->obstacles) {
+        if (addedFeature) strcat(config->modeName, "+");
+        if (features->movingFruit) {
+            strcat(config->modeName, "MVG-");
+        }
+        strcat(config->modeName, "OBSTACLE");
+        addedFeature = true;
+    }
+    
+    if (features->multiFruit) {
+        if (addedFeature) strcat(config->modeName, "+");
+        strcat(config->modeName, "MULTI-FRUIT");
+        addedFeature = true;
+    } else if (features->movingFruit) {
+        if (addedFeature) strcat(config->modeName, "+");
+        strcat(config->modeName, "MVG-FRUIT");
+    }
+}
+
+// Set up a round with `features` and the parameters in `mode`, on the open board
+static inline void configure_game(GameConfig *config, const GameFeatures *features, const ModeTable *mode) {
+    // Reset config to defaults
+    memset(config, 0, sizeof(GameConfig));
+    config->mode = *mode;
+    config->walls = open_board_walls;
+    
+    // Apply feature settings
+    config->movingFruit = features->movingFruit;
+    config->multiFruit = features->multiFruit;
+    config->timed = features->timed;
+    config->hasObstacles = features->obstacles;
+    config->movingObstacles = features->obstacles && features->movingFruit; // Only if both are selected
+    
+    // Set base speed
+    if (features->speed) {
+        config->updateDelay = config->mode.speedDelay; // Faster speed
+    } else {
+        config->updateDelay = config->mode.normalDelay; // Normal speed
+    }
+    
+    // Configure timed mode
+    if (config->timed) {
+        config->maxTime = config->mode.timedSeconds;
+        config->timeRemaining = config->maxTime;
+    }
+    
+    // Configure food movement
+    if (config->movingFruit) {
+        config->fruitMoveInterval = config->mode.fruitMoveInterval;
+    }
+    
+    // Configure obstacle movement
+    if (config->movingObstacles) {
+        config->obstacleMoveInterval = config->mode.obstacleMoveInterval;
+    }
+    
+    // Generate a name for this mode configuration
+    generate_mode_name(config, features);
+    
+    // Pick the timer handler built for exactly this set of features
+    config->featureMask = (config->movingFruit ? FEATURE_MOVING_FRUIT : 0) |
+                          (config->multiFruit ? FEATURE_MULTI_FRUIT : 0) |
+                          (config->timed ? FEATURE_TIMED : 0) |
+                          (config->hasObstacles ? FEATURE_OBSTACLES : 0) |
+                          (config->movingObstacles ? FEATURE_MOVING_OBSTACLES : 0);
+    config->handleTimer = select_timer_handler(config->featureMask);
+}
+
+// Keys accepted in a mode file and the range each value must fall in
+typedef struct {
+    const char *key;
+    size_t offset;
+    int min, max;
+} ModeKey;
+
+static const ModeKey mode_keys[] = {
+    {"normal_delay", offsetof(ModeTable, normalDelay), 20, 2000},
+    {"speed_delay", offsetof(ModeTable, speedDelay), 20, 2000},
+    {"timed_seconds", offsetof(ModeTable, timedSeconds), 5, 3600},
+    {"fruit_move_interval", offsetof(ModeTable, fruitMoveInterval), 50, 10000},
+    {"fruit_interval_step", offsetof(ModeTable, fruitIntervalStep), 0, 1000},
+    {"obstacle_move_interval", offsetof(ModeTable, obstacleMoveInterval), 50, 10000},
+    {"obstacle_jitter", offsetof(ModeTable, obstacleJitter), 0, 1000},
+    {"obstacles_min", offsetof(ModeTable, obstaclesMin), 0, MAX_OBSTACLES},
+    {"obstacles_max", offsetof(ModeTable, obstaclesMax), 0, MAX_OBSTACLES},
+    {"fruits_min", offsetof(ModeTable, fruitsMin), 1, MAX_FOODS},
+    {"fruits_max", offsetof(ModeTable, fruitsMax), 1, MAX_FOODS},
+};
+
+// Parse a mode file on top of the built-in defaults. On any error `table` is left
+// untouched and false is returned, so a half-edited file never reaches a round.
+static inline bool load_modes(const char *path, ModeTable *table) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return false;
+    
+    ModeTable parsed = default_modes;
+    char line[128];
+    int lineNumber = 0;
+    bool ok = true;
+    
+    while (ok && fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char *comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        
+        char key[32];
+        int value;
+        char extra;
+        if (sscanf(line, " %31[a-z_] = %d %c", key, &value, &extra) != 2) {
+            char blank;
+            if (sscanf(line, " %c", &blank) == 1) {
+                log_warn("%s:%d: expected \"key = number\"", path, lineNumber);
+                ok = false;
+            }
+            continue;
+        }
+        
+        const ModeKey *match = NULL;
+        for (size_t i = 0; i < sizeof(mode_keys) / sizeof(mode_keys[0]); i++) {
+            if (strcmp(mode_keys[i].key, key) == 0) match = &mode_keys[i];
+        }
+        if (match == NULL) {
+            log_warn("%s:%d: unknown key '%s'", path, lineNumber, key);
+            ok = false;
+        } else if (value < match->min || value > match->max) {
+            log_warn("%s:%d: %s must be between %d and %d", path, lineNumber, key, match->min, match->max);
+            ok = false;
+        } else {
+            *(int16_t *)((char *)&parsed + match->offset) = (int16_t)value;
+        }
+    }
+    fclose(file);
+    
+    // Values that only make sense together
+    if (ok && (parsed.obstaclesMin > parsed.obstaclesMax || parsed.fruitsMin > parsed.fruitsMax)) {
+        log_warn("%s: a minimum is larger than its maximum", path);
+        ok = false;
+    }
+    if (ok && (parsed.fruitMoveInterval - 3 * parsed.fruitIntervalStep <= 0 ||
+               parsed.obstacleMoveInterval - 2 * parsed.obstacleJitter <= 0)) {
+        log_warn("%s: interval steps would make some objects never move", path);
+        ok = false;
+    }
+    
+    if (ok) *table = parsed;
+    return ok;
+}
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef LEVELS_H
+#define LEVELS_H
+
+// Binary level packs, shared by challenge.c (and other game modes) and mklevels.c.
+//
+// A pack is built once from the ASCII maps in levels/:
+//   gcc -O2 mklevels.c -o mklevels && ./mklevels levels.pak levels/*.txt
+// and mapped read-only at runtime. Levels are used straight from the mapping, so
+// switching level is just pointing the game at a different LevelHeader.
+//
+// Layout (host byte order, every section starts on an 8-byte boundary):
+//   LevelPackHeader
+//   LevelIndexEntry[levelCount]
+//   per level: LevelHeader, LevelSpawn[spawnCount], wall bitmap, food zone bitmap
+// Bitmaps are row-major with one bit per cell; every row is padded to whole 64-bit
+// words so large arena maps can be scanned a word at a time.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LEVELS_USE_MMAP 1
+#endif
+
+#define LEVEL_PACK_MAGIC "SNLV"
+#define LEVEL_PACK_VERSION 1
+#define LEVEL_NAME_LENGTH 24
+#define LEVEL_MAX_DIMENSION 4096
+#define LEVEL_SPAWN_LENGTH 3 // Cells a fresh snake covers, head included
+
+// 64-bit words per bitmap row
+#define LEVEL_ROW_WORDS(width) (((width) + 63) / 64)
+
+typedef struct {
+    char magic[4];       // LEVEL_PACK_MAGIC
+    uint16_t version;    // LEVEL_PACK_VERSION
+    uint16_t levelCount;
+    uint32_t indexOffset; // From the start of the pack
+    uint32_t size;        // Total pack size in bytes
+} LevelPackHeader;
+
+typedef struct {
+    uint32_t offset; // LevelHeader position from the start of the pack
+    uint32_t size;   // Bytes used by the level
+    char name[LEVEL_NAME_LENGTH];
+} LevelIndexEntry;
+
+// Offsets below are from the start of the LevelHeader
+typedef struct {
+    uint16_t width, height;
+    uint16_t spawnCount;
+    uint16_t reserved;
+    uint32_t spawnOffset;
+    uint32_t wallOffset;
+    uint32_t foodZoneOffset; // Cells where food may appear
+    uint32_t wallCount;
+} LevelHeader;
+
+// A snake start: head position and the direction it moves in
+typedef struct {
+    int16_t x, y;
+    int8_t dx, dy;
+    uint8_t reserved[2];
+} LevelSpawn;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    bool mapped; // Unmap rather than free on close
+    const LevelPackHeader *header;
+    const LevelIndexEntry *index;
+} LevelPack;
+
+static inline const LevelSpawn *level_spawns(const LevelHeader *level) {
+    return (const LevelSpawn *)((const uint8_t *)level + level->spawnOffset);
+}
+
+static inline const uint64_t *level_walls(const LevelHeader *level) {
+    return (const uint64_t *)((const uint8_t *)level + level->wallOffset);
+}
+
+static inline const uint64_t *level_food_zone(const LevelHeader *level) {
+    return (const uint64_t *)((const uint8_t *)level + level->foodZoneOffset);
+}
+
+static inline bool level_bit(const uint64_t *bits, int width, int x, int y) {
+    return (bits[(size_t)y * LEVEL_ROW_WORDS(width) + (x >> 6)] >> (x & 63)) & 1;
+}
+
+static inline int level_popcount(uint64_t word) {
+#ifdef __GNUC__
+    return __builtin_popcountll(word);
+#else
+    int count = 0;
+    for (; word; word &= word - 1) count++;
+    return count;
+#endif
+}
+
+static inline int level_count_bits(const uint64_t *bits, int width, int height) {
+    int count = 0;
+    for (size_t i = 0; i < (size_t)LEVEL_ROW_WORDS(width) * height; i++) {
+        count += level_popcount(bits[i]);
+    }
+    return count;
+}
+
+// Grow `bits` along runs of `open` within one word, as far as the runs go. Each
+// step doubles the distance covered, so six steps per direction reach across a
+// whole word.
+static inline uint64_t level_fill_word(uint64_t bits, uint64_t open) {
+    uint64_t up = bits, down = bits, upOpen = open, downOpen = open;
+    for (int shift = 1; shift < 64; shift *= 2) {
+        up |= (up << shift) & upOpen;
+        upOpen &= upOpen << shift;
+        down |= (down >> shift) & downOpen;
+        downOpen &= downOpen >> shift;
+    }
+    return (up | down) & open;
+}
+
+// Spread a row of `reach` sideways through `open` until it stops growing, carrying
+// across word boundaries. Returns true if it grew.
+static inline bool level_fill_row(uint64_t *row, const uint64_t *openRow, int words) {
+    bool grew = false, spreading = true;
+    while (spreading) {
+        spreading = false;
+        for (int w = 0; w < words; w++) {
+            uint64_t carry = (w > 0 ? row[w - 1] >> 63 : 0) | (w + 1 < words ? row[w + 1] << 63 : 0);
+            uint64_t grown = level_fill_word(row[w] | (carry & openRow[w]), openRow[w]);
+            if (grown != row[w]) {
+                row[w] = grown;
+                spreading = grew = true;
+            }
+        }
+    }
+    return grew;
+}
+
+// Bit-parallel flood fill. `reach` holds the seed cells on entry and every cell of
+// `open` connected to them (4-neighbour moves) on return; both use the bitmap layout
+// above and `reach` must be a subset of `open`. Each pass spreads a whole row at a
+// time: a row is filled sideways to a fixed point before the sweep moves on to the
+// next, alternating downward and upward sweeps. Returns the number of reached cells.
+static inline int level_flood_fill(const uint64_t *open, uint64_t *reach, int width, int height) {
+    int words = LEVEL_ROW_WORDS(width);
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+        for (int pass = 0; pass < 2; pass++) {
+            for (int i = 0; i < height; i++) {
+                int y = pass == 0 ? i : height - 1 - i;
+                uint64_t *row = reach + (size_t)y * words;
+                const uint64_t *openRow = open + (size_t)y * words;
+
+                // Pull in the rows above and below
+                for (int w = 0; w < words; w++) {
+                    uint64_t grown = row[w];
+                    if (y > 0) grown |= row[w - words];
+                    if (y < height - 1) grown |= row[w + words];
+                    grown &= openRow[w];
+                    if (grown != row[w]) {
+                        row[w] = grown;
+                        changed = true;
+                    }
+                }
+
+                if (level_fill_row(row, openRow, words)) changed = true;
+            }
+        }
+    }
+    return level_count_bits(reach, width, height);
+}
+
+// Bytes one level occupies, used by both the writer and the validator
+static inline size_t level_size(int width, int height, int spawnCount) {
+    size_t bitmap = (size_t)LEVEL_ROW_WORDS(width) * height * sizeof(uint64_t);
+    size_t spawns = ((size_t)spawnCount * sizeof(LevelSpawn) + 7) & ~(size_t)7;
+    return sizeof(LevelHeader) + spawns + 2 * bitmap;
+}
+
+// A spawn faces one of the four ways, and the body trailing behind its head
+// lies on the board and clear of walls
+static inline bool level_spawn_valid(const LevelHeader *level, const LevelSpawn *spawn) {
+    if (abs(spawn->dx) + abs(spawn->dy) != 1) return false;
+    for (int i = 0; i < LEVEL_SPAWN_LENGTH; i++) {
+        int x = spawn->x - spawn->dx * i, y = spawn->y - spawn->dy * i;
+        if (x < 0 || x >= level->width || y < 0 || y >= level->height ||
+            level_bit(level_walls(level), level->width, x, y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Check that every offset in the pack stays inside it, so levels can be read
+// without further bounds checks, and that every spawn is one a snake can start on
+static inline bool level_pack_validate(const LevelPack *pack) {
+    if (pack->size < sizeof(LevelPackHeader)) return false;
+
+    const LevelPackHeader *header = pack->header;
+    if (memcmp(header->magic, LEVEL_PACK_MAGIC, 4) != 0 || header->version != LEVEL_PACK_VERSION ||
+        header->size != pack->size || header->indexOffset % 8 != 0 ||
+        header->indexOffset + (size_t)header->levelCount * sizeof(LevelIndexEntry) > pack->size) {
+        return false;
+    }
+
+    for (int i = 0; i < header->levelCount; i++) {
+        const LevelIndexEntry *entry = &pack->index[i];
+        if (entry->offset % 8 != 0 || entry->offset + (size_t)entry->size > pack->size ||
+            entry->size < sizeof(LevelHeader) || entry->name[LEVEL_NAME_LENGTH - 1] != '\0') {
+            return false;
+        }
+
+        const LevelHeader *level = (const LevelHeader *)(pack->data + entry->offset);
+        size_t bitmap = (size_t)LEVEL_ROW_WORDS(level->width) * level->height * sizeof(uint64_t);
+        if (level->width == 0 || level->height == 0 || level->spawnCount == 0 ||
+            level->width > LEVEL_MAX_DIMENSION || level->height > LEVEL_MAX_DIMENSION ||
+            level_size(level->width, level->height, level->spawnCount) != entry->size ||
+            level->spawnOffset != sizeof(LevelHeader) ||
+            level->wallOffset % 8 != 0 || level->wallOffset + bitmap > entry->size ||
+            level->foodZoneOffset % 8 != 0 || level->foodZoneOffset + bitmap > entry->size) {
+            return false;
+        }
+        for (int s = 0; s < level->spawnCount; s++) {
+            if (!level_spawn_valid(level, &level_spawns(level)[s])) return false;
+        }
+    }
+    return true;
+}
+
+// Map a pack file. Returns false (and leaves `pack` empty) if it is missing or damaged.
+static inline bool level_pack_open(LevelPack *pack, const char *path) {
+    memset(pack, 0, sizeof(*pack));
+
+#ifdef LEVELS_USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+
+    pack->data = data;
+    pack->size = (size_t)info.st_size;
+    pack->mapped = true;
+#else
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = size > 0 ? malloc((size_t)size) : NULL;
+    if (data == NULL || fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+
+    pack->data = data;
+    pack->size = (size_t)size;
+#endif
+
+    pack->header = (const LevelPackHeader *)pack->data;
+    pack->index = (const LevelIndexEntry *)(pack->data + pack->header->indexOffset);
+
+    if (!level_pack_validate(pack)) {
+#ifdef LEVELS_USE_MMAP
+        munmap((void *)pack->data, pack->size);
+#else
+        free((void *)pack->data);
+#endif
+        memset(pack, 0, sizeof(*pack));
+        return false;
+    }
+    return true;
+}
+
+static inline void level_pack_close(LevelPack *pack) {
+    if (pack->data == NULL) return;
+
+#ifdef LEVELS_USE_MMAP
+    if (pack->mapped) munmap((void *)pack->data, pack->size);
+#else
+    free((void *)pack->data);
+#endif
+    memset(pack, 0, sizeof(*pack));
+}
+
+static inline int level_pack_count(const LevelPack *pack) {
+    return pack->header ? pack->header->levelCount : 0;
+}
+
+static inline const LevelHeader *level_pack_get(const LevelPack *pack, int i) {
+    if (i < 0 || i >= level_pack_count(pack)) return NULL;
+    return (const LevelHeader *)(pack->data + pack->index[i].offset);
+}
+
+static inline const char *level_pack_name(const LevelPack *pack, int i) {
+    if (i < 0 || i >= level_pack_count(pack)) return NULL;
+    return pack->index[i].name;
+}
+
+#endif
@@ -3,8 +3,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>  // For execl function
 
+#include "async_log.h"
+
 #define SCREEN_WIDTH 800
 #define SCREEN_HEIGHT 600
 #define BUTTON_WIDTH 200
@@ -39,12 +43,12 @@ SDL_Texture* renderText(const char* text, SDL_Color color, SDL_Rect* destRect);
 // Initialize SDL and TTF
 bool init() {
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        log_error("SDL could not initialize! SDL_Error: %s", SDL_GetError());
         return false;
     }
 
     if (TTF_Init() < 0) {
-        printf("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
+        log_error("SDL_ttf could not initialize! TTF_Error: %s", TTF_GetError());
         return false;
     }
 
@@ -54,13 +58,13 @@ bool init() {
                               SCREEN_WIDTH, SCREEN_HEIGHT,
                               SDL_WINDOW_SHOWN);
     if (!window) {
-        printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Window could not be created! SDL_Error: %s", SDL_GetError());
         return false;
     }
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (!renderer) {
-        printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Renderer could not be created! SDL_Error: %s", SDL_GetError());
         SDL_DestroyWindow(window);
         return false;
     }
@@ -68,8 +72,8 @@ bool init() {
     // Load font with better error handling
     font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 24);
     if (!font) {
-        printf("Failed to load font! TTF_Error: %s\n", TTF_GetError());
-        printf("Attempted to load font at: dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf\n");
+        log_error("Failed to load font! TTF_Error: %s", TTF_GetError());
+        log_error("Attempted to load font at: dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf");
         SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(window);
         return false;
@@ -90,24 +94,24 @@ void cleanup() {
 // Render text helper function
 SDL_Texture* renderText(const char* text, SDL_Color color, SDL_Rect* destRect) {
     if (!font) {
-        printf("Error in renderText: Font not loaded!\n");
+        log_error("Error in renderText: Font not loaded!");
         return NULL;
     }
     
     if (!text) {
-        printf("Error in renderText: Null text string!\n");
+        log_error("Error in renderText: Null text string!");
         return NULL;
     }
     
     SDL_Surface* surface = TTF_RenderText_Solid(font, text, color);
     if (!surface) {
-        printf("Unable to render text surface! SDL_ttf Error: %s\n", TTF_GetError());
+        log_error("Unable to render text surface! SDL_ttf Error: %s", TTF_GetError());
         return NULL;
     }
     
     SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
     if (!texture) {
-        printf("Unable to create texture from rendered text! SDL Error: %s\n", SDL_GetError());
+        log_error("Unable to create texture from rendered text! SDL Error: %s", SDL_GetError());
         SDL_FreeSurface(surface);
         return NULL;
     }
@@ -182,14 +186,15 @@ void renderMenu() {
 void launchProgram(const char* programPath) {
     cleanup(); // Clean up SDL resources before executing new program
     
-    // Print debug info
-    printf("Attempting to launch: %s\n", programPath);
+    // Print debug info, and write out the log before this process is replaced
+    log_info("Attempting to launch: %s", programPath);
+    log_shutdown();
     
     // Execute the program (replace the current process)
     execl(programPath, programPath, NULL);
     
     // If execl returns, it failed
-    perror("execl failed");
+    log_error("execl failed: %s", strerror(errno));
     exit(EXIT_FAILURE);
 }
 
@@ -204,19 +209,19 @@ void handleMenuEvents() {
             int y = event.button.y;
 
             // Debug print to see where clicks are being registered
-            printf("Mouse click at x=%d, y=%d\n", x, y);
+            log_debug("Mouse click at x=%d, y=%d", x, y);
 
             if (x >= singlePlayerButton.x && x < singlePlayerButton.x + singlePlayerButton.w &&
                 y >= singlePlayerButton.y && y < singlePlayerButton.y + singlePlayerButton.h) {
-                printf("Single Player button clicked!\n");
+                log_debug("Single Player button clicked!");
                 launchProgram("./attempt");
             } else if (x >= challengeModeButton.x && x < challengeModeButton.x + challengeModeButton.w &&
                       y >= challengeModeButton.y && y < challengeModeButton.y + challengeModeButton.h) {
-                printf("Challenge Mode button clicked!\n");
+                log_debug("Challenge Mode button clicked!");
                 launchProgram("./challenge");
             } else if (x >= twoPlayerButton.x && x < twoPlayerButton.x + twoPlayerButton.w &&
                       y >= twoPlayerButton.y && y < twoPlayerButton.y + twoPlayerButton.h) {
-                printf("Two Player button clicked!\n");
+                log_debug("Two Player button clicked!");
                 launchProgram("./multiplayer");
             }
         }
@@ -225,6 +230,8 @@ void handleMenuEvents() {
 
 // Main loop
 int main(int argc, char* argv[]) {
+    log_init();
+    
     if (!init()) {
         return 1;
     }
@@ -241,7 +248,7 @@ int main(int argc, char* argv[]) {
                 break;
             default:
                 // This should not happen with the new implementation
-                printf("Unexpected game state!\n");
+                log_error("Unexpected game state!");
                 running = false;
                 break;
         }
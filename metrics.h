@@ -0,0 +1,376 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// Live metrics for the fleet monitor, served on a Unix socket in the Prometheus
+// text format. Shared by attempt.c, challenge.c and multiplayer.c.
+//
+//   metrics_start("attempt");                    // once, after log_init()
+//   uint64_t start = metrics_clock();              // around each game tick
+//   ...
+//   metrics_tick(start);
+//   metrics_game(score, length, retries, mode);  // whenever the game changes
+//   metrics_frame();                             // after each SDL_RenderPresent
+//
+// The game threads only ever store into a block of atomic counters; they never
+// wait for the socket or take a lock. A background thread accepts connections,
+// samples the block and writes one exposition per connection, then hangs up.
+// Both a bare connection and an HTTP GET get an answer, e.g.
+//
+//   curl --unix-socket /tmp/snake-attempt.sock http://cabinet/metrics
+//
+// Tick-time quantiles are taken over the ticks since the previous scrape, so with
+// one monitor scraping they describe its scrape interval. The counters run from
+// the start of the process.
+//
+// Environment:
+//   SNAKE_METRICS  socket path instead of /tmp/snake-<program>.sock
+//
+// Nothing is served on systems without Unix sockets; the calls then only count.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "async_log.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define METRICS_AVAILABLE 1
+#endif
+
+#define METRICS_TICK_BUCKETS 48   // Half-octave buckets of tick time from 1 us to 16 s
+#define METRICS_MODE_SIZE 64      // Longer mode names are cut short
+#define METRICS_POLL_INTERVAL 100 // ms between checks for metrics_stop()
+#define METRICS_REQUEST_WAIT 50   // ms a scraper gets to send its request
+#define METRICS_PAGE_SIZE 8192
+
+static struct {
+    // Written by the render thread
+    atomic_ulong frames;
+    atomic_ulong drawCalls;   // All frames
+    atomic_uint frameDraws;   // The last frame
+    atomic_uint fpsMilli;     // Frames per 1000 s, over the last second
+
+    // Written by whichever thread runs the game
+    atomic_ulong ticks;
+    atomic_ulong tickNanos;   // Sum of all tick times
+    atomic_ulong tickCounts[METRICS_TICK_BUCKETS];
+    atomic_ulong foodRetries;
+    atomic_int score;
+    atomic_int length;
+    atomic_uint modeSequence; // Odd while `mode` is being rewritten
+    char mode[METRICS_MODE_SIZE];
+
+    // Render thread only
+    unsigned draws;           // Draw calls so far this frame
+    uint64_t fpsStart;
+    unsigned fpsFrames;
+
+    // Server thread only
+    unsigned long scrapedCounts[METRICS_TICK_BUCKETS];
+    char program[32];
+    char path[108];
+    atomic_bool running;
+#ifdef METRICS_AVAILABLE
+    int listener;
+    pthread_t server;
+#endif
+} metrics_state;
+
+// Monotonic time in ns
+static inline uint64_t metrics_clock(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Bucket of a tick that took `us` microseconds: 0, 1, [2, 3), [3, 4), [4, 6), [6, 8), ...
+static inline int metrics_bucket(uint64_t us) {
+    if (us < 2) return (int)us;
+    int top = 63 - __builtin_clzll(us);
+    int bucket = 2 * top + (int)((us >> (top - 1)) & 1);
+    return bucket < METRICS_TICK_BUCKETS ? bucket : METRICS_TICK_BUCKETS - 1;
+}
+
+// Exclusive upper bound of a bucket, in microseconds
+static inline uint64_t metrics_bucket_limit(int bucket) {
+    if (bucket < 2) return (uint64_t)bucket + 1;
+    int top = bucket / 2;
+    return ((uint64_t)(2 + bucket % 2) << (top - 1)) + ((uint64_t)1 << (top - 1));
+}
+
+// A game tick that began at `start` (metrics_clock()) has finished
+static inline void metrics_tick(uint64_t start) {
+    uint64_t nanos = metrics_clock() - start;
+    atomic_fetch_add_explicit(&metrics_state.ticks, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metrics_state.tickNanos, nanos, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metrics_state.tickCounts[metrics_bucket(nanos / 1000)], 1, memory_order_relaxed);
+}
+
+// Current game: the score and length of the snake being watched, place_food's
+// retries so far, and a name for the mode. Called by one thread at a time.
+static inline void metrics_game(int score, int length, unsigned long foodRetries, const char *mode) {
+    atomic_store_explicit(&metrics_state.score, score, memory_order_relaxed);
+    atomic_store_explicit(&metrics_state.length, length, memory_order_relaxed);
+    atomic_store_explicit(&metrics_state.foodRetries, foodRetries, memory_order_relaxed);
+
+    // The name rarely changes; when it does, readers see the sequence move and retry
+    if (strncmp(metrics_state.mode, mode, METRICS_MODE_SIZE - 1) != 0) {
+        unsigned sequence = atomic_load_explicit(&metrics_state.modeSequence, memory_order_relaxed);
+        atomic_store_explicit(&metrics_state.modeSequence, sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        snprintf(metrics_state.mode, METRICS_MODE_SIZE, "%s", mode);
+        atomic_store_explicit(&metrics_state.modeSequence, sequence + 2, memory_order_release);
+    }
+}
+
+static inline void metrics_draw_call(void) {
+    metrics_state.draws++;
+}
+
+// A frame was presented: publish its draw calls and keep the frame rate
+static inline void metrics_frame(void) {
+    atomic_fetch_add_explicit(&metrics_state.frames, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&metrics_state.drawCalls, metrics_state.draws, memory_order_relaxed);
+    atomic_store_explicit(&metrics_state.frameDraws, metrics_state.draws, memory_order_relaxed);
+    metrics_state.draws = 0;
+
+    uint64_t now = metrics_clock();
+    metrics_state.fpsFrames++;
+    if (metrics_state.fpsStart == 0) {
+        metrics_state.fpsStart = now;
+        metrics_state.fpsFrames = 0;
+    } else if (now - metrics_state.fpsStart >= 1000000000u) {
+        uint64_t fpsMilli = (uint64_t)metrics_state.fpsFrames * 1000000000000u / (now - metrics_state.fpsStart);
+        atomic_store_explicit(&metrics_state.fpsMilli, (unsigned)fpsMilli, memory_order_relaxed);
+        metrics_state.fpsStart = now;
+        metrics_state.fpsFrames = 0;
+    }
+}
+
+// Every SDL draw call counts towards the frame's total
+#ifdef SDL_INIT_VIDEO
+#define SDL_RenderClear(...) (metrics_draw_call(), SDL_RenderClear(__VA_ARGS__))
+#define SDL_RenderCopy(...) (metrics_draw_call(), SDL_RenderCopy(__VA_ARGS__))
+#define SDL_RenderDrawLine(...) (metrics_draw_call(), SDL_RenderDrawLine(__VA_ARGS__))
+#define SDL_RenderDrawRect(...) (metrics_draw_call(), SDL_RenderDrawRect(__VA_ARGS__))
+#define SDL_RenderFillRect(...) (metrics_draw_call(), SDL_RenderFillRect(__VA_ARGS__))
+#endif
+
+// Smallest bucket limit, in seconds, that `fraction` of `total` ticks stay under
+static inline double metrics_quantile(const unsigned long *counts, unsigned long total, double fraction) {
+    unsigned long wanted = (unsigned long)(total * fraction + 0.5);
+    if (wanted == 0) wanted = 1;
+    unsigned long seen = 0;
+    for (int i = 0; i < METRICS_TICK_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= wanted) return metrics_bucket_limit(i) / 1e6;
+    }
+    return metrics_bucket_limit(METRICS_TICK_BUCKETS - 1) / 1e6;
+}
+
+// One exposition of the current values. Returns its length.
+static inline size_t metrics_format(char *page, size_t size) {
+    // Ticks since the last scrape, for the quantiles
+    unsigned long window[METRICS_TICK_BUCKETS], windowTotal = 0;
+    for (int i = 0; i < METRICS_TICK_BUCKETS; i++) {
+        unsigned long count = atomic_load_explicit(&metrics_state.tickCounts[i], memory_order_relaxed);
+        window[i] = count - metrics_state.scrapedCounts[i];
+        windowTotal += window[i];
+        metrics_state.scrapedCounts[i] = count;
+    }
+
+    char mode[METRICS_MODE_SIZE];
+    unsigned sequence;
+    do {
+        sequence = atomic_load_explicit(&metrics_state.modeSequence, memory_order_acquire);
+        memcpy(mode, metrics_state.mode, sizeof(mode));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((sequence & 1) || sequence != atomic_load_explicit(&metrics_state.modeSequence, memory_order_relaxed));
+    mode[METRICS_MODE_SIZE - 1] = '\0';
+    for (char *c = mode; *c; c++) {
+        if (*c == '"' || *c == '\\' || *c == '\n') *c = '_';
+    }
+
+    int length = snprintf(page, size,
+        "# HELP snake_info The running game.\n"
+        "# TYPE snake_info gauge\n"
+        "snake_info{program=\"%s\",mode=\"%s\"} 1\n"
+        "# HELP snake_fps Frames presented per second, over the last second.\n"
+        "# TYPE snake_fps gauge\n"
+        "snake_fps %.3f\n"
+        "# HELP snake_frames_total Frames presented.\n"
+        "# TYPE snake_frames_total counter\n"
+        "snake_frames_total %lu\n"
+        "# HELP snake_draw_calls Draw calls in the last frame.\n"
+        "# TYPE snake_draw_calls gauge\n"
+        "snake_draw_calls %u\n"
+        "# HELP snake_draw_calls_total Draw calls in all frames.\n"
+        "# TYPE snake_draw_calls_total counter\n"
+        "snake_draw_calls_total %lu\n"
+        "# HELP snake_tick_seconds Time to run one game tick; quantiles over the ticks since the last scrape.\n"
+        "# TYPE snake_tick_seconds summary\n",
+        metrics_state.program, mode,
+        atomic_load_explicit(&metrics_state.fpsMilli, memory_order_relaxed) / 1000.0,
+        atomic_load_explicit(&metrics_state.frames, memory_order_relaxed),
+        atomic_load_explicit(&metrics_state.frameDraws, memory_order_relaxed),
+        atomic_load_explicit(&metrics_state.drawCalls, memory_order_relaxed));
+
+    static const double quantiles[] = {0.5, 0.9, 0.99};
+    for (int q = 0; q < 3 && length < (int)size; q++) {
+        if (windowTotal == 0) {
+            length += snprintf(page + length, size - length, "snake_tick_seconds{quantile=\"%g\"} NaN\n", quantiles[q]);
+        } else {
+            length += snprintf(page + length, size - length, "snake_tick_seconds{quantile=\"%g\"} %.6f\n",
+                               quantiles[q], metrics_quantile(window, windowTotal, quantiles[q]));
+        }
+    }
+
+    if (length < (int)size) {
+        length += snprintf(page + length, size - length,
+            "snake_tick_seconds_sum %.6f\n"
+            "snake_tick_seconds_count %lu\n"
+            "# HELP snake_place_food_retries_total Random fruit positions that were taken and had to be drawn again.\n"
+            "# TYPE snake_place_food_retries_total counter\n"
+            "snake_place_food_retries_total %lu\n"
+            "# HELP snake_score Score of the current game.\n"
+            "# TYPE snake_score gauge\n"
+            "snake_score %d\n"
+            "# HELP snake_length Length of the snake in the current game.\n"
+            "# TYPE snake_length gauge\n"
+            "snake_length %d\n",
+            atomic_load_explicit(&metrics_state.tickNanos, memory_order_relaxed) / 1e9,
+            atomic_load_explicit(&metrics_state.ticks, memory_order_relaxed),
+            atomic_load_explicit(&metrics_state.foodRetries, memory_order_relaxed),
+            atomic_load_explicit(&metrics_state.score, memory_order_relaxed),
+            atomic_load_explicit(&metrics_state.length, memory_order_relaxed));
+    }
+    return length < (int)size ? (size_t)length : size - 1;
+}
+
+#ifdef METRICS_AVAILABLE
+// Answer one scraper: HTTP if it sent a GET, the bare page otherwise
+static inline void metrics_answer(int client) {
+    char request[512];
+    ssize_t received = 0;
+    struct pollfd wait = {client, POLLIN, 0};
+    if (poll(&wait, 1, METRICS_REQUEST_WAIT) > 0) {
+        received = recv(client, request, sizeof(request) - 1, 0);
+    }
+    bool http = received >= 4 && memcmp(request, "GET ", 4) == 0;
+
+    static char page[METRICS_PAGE_SIZE];
+    size_t length = metrics_format(page, sizeof(page));
+
+    char header[160];
+    int headerLength = 0;
+    if (http) {
+        headerLength = snprintf(header, sizeof(header),
+                                "HTTP/1.0 200 OK\r\n"
+                                "Content-Type: text/plain; version=0.0.4\r\n"
+                                "Content-Length: %zu\r\n"
+                                "Connection: close\r\n\r\n",
+                                length);
+    }
+
+#ifdef MSG_NOSIGNAL
+    int flags = MSG_NOSIGNAL; // A scraper that hung up must not kill the game
+#else
+    int flags = 0;
+#endif
+    if (headerLength > 0) send(client, header, (size_t)headerLength, flags);
+    send(client, page, length, flags);
+}
+
+static void *metrics_server_main(void *data) {
+    (void)data;
+    while (atomic_load(&metrics_state.running)) {
+        struct pollfd wait = {metrics_state.listener, POLLIN, 0};
+        if (poll(&wait, 1, METRICS_POLL_INTERVAL) <= 0) continue;
+
+        int client = accept(metrics_state.listener, NULL, NULL);
+        if (client < 0) continue;
+        metrics_answer(client);
+        close(client);
+    }
+    return NULL;
+}
+
+// Stop serving and remove the socket. Safe to call more than once.
+static inline void metrics_stop(void) {
+    if (atomic_exchange(&metrics_state.running, false)) {
+        pthread_join(metrics_state.server, NULL);
+        close(metrics_state.listener);
+        unlink(metrics_state.path);
+    }
+}
+
+// Serve the metrics of `program`. Returns false if the socket could not be set up,
+// or another running game is serving on it; the counters still count.
+static inline bool metrics_start(const char *program) {
+    snprintf(metrics_state.program, sizeof(metrics_state.program), "%s", program);
+    const char *path = getenv("SNAKE_METRICS");
+    if (path) snprintf(metrics_state.path, sizeof(metrics_state.path), "%s", path);
+    else snprintf(metrics_state.path, sizeof(metrics_state.path), "/tmp/snake-%s.sock", program);
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    snprintf(address.sun_path, sizeof(address.sun_path), "%s", metrics_state.path);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        log_warn("No metrics: %s", strerror(errno));
+        return false;
+    }
+
+    // A socket left behind by a game that has exited is taken over
+    int bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+    if (bound != 0 && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool taken = probe >= 0 && connect(probe, (struct sockaddr *)&address, sizeof(address)) == 0;
+        if (probe >= 0) close(probe);
+        if (taken) {
+            log_warn("No metrics: another game is serving on %s", metrics_state.path);
+            close(listener);
+            return false;
+        }
+        unlink(metrics_state.path);
+        bound = bind(listener, (struct sockaddr *)&address, sizeof(address));
+    }
+    if (bound != 0 || listen(listener, 8) != 0) {
+        log_warn("No metrics on %s: %s", metrics_state.path, strerror(errno));
+        close(listener);
+        return false;
+    }
+
+    metrics_state.listener = listener;
+    atomic_store(&metrics_state.running, true);
+    if (pthread_create(&metrics_state.server, NULL, metrics_server_main, NULL) != 0) {
+        atomic_store(&metrics_state.running, false);
+        close(listener);
+        unlink(metrics_state.path);
+        return false;
+    }
+    atexit(metrics_stop);
+    log_info("Serving metrics on %s", metrics_state.path);
+    return true;
+}
+#else
+static inline bool metrics_start(const char *program) {
+    snprintf(metrics_state.program, sizeof(metrics_state.program), "%s", program);
+    return false;
+}
+static inline void metrics_stop(void) {}
+#endif
+
+#endif
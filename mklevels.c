@@ -0,0 +1,272 @@
+// Level pack builder: turns ASCII maps into the binary format described in levels.h
+//
+//   gcc -O2 mklevels.c -o mklevels
+//   ./mklevels levels.pak levels/*.txt
+//
+// Map files:
+//   ; name: Display Name     metadata and comments start with ';'
+//   #                        wall
+//   .                        floor
+//   f                        floor where food may appear (if a map has no 'f', food
+//                            may appear on any floor cell)
+//   > < ^ v                  snake spawn, facing that way; the body trails behind it
+
+#include "levels.h"
+
+#include <ctype.h>
+
+#define MAX_LEVELS 256
+
+typedef struct {
+    char name[LEVEL_NAME_LENGTH];
+    int width, height;
+    uint8_t *data; // Serialized level, level_size() bytes
+    size_t size;
+} BuiltLevel;
+
+static void set_bit(uint64_t *bits, int width, int x, int y) {
+    bits[(size_t)y * LEVEL_ROW_WORDS(width) + (x >> 6)] |= 1ULL << (x & 63);
+}
+
+// Read one map file into `level`. Prints the problem and returns false on bad input.
+static bool build_level(const char *path, BuiltLevel *level) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    char **rows = NULL;
+    int rowCount = 0, width = 0;
+    char line[LEVEL_MAX_DIMENSION + 2];
+
+    // Default name: the file name without directory or extension
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(level->name, sizeof(level->name), "%.*s", (int)strcspn(base, "."), base);
+
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        size_t length = strcspn(line, "\r\n");
+        line[length] = '\0';
+
+        if (line[0] == ';') {
+            const char *value = strstr(line, "name:");
+            if (value) {
+                value += 5;
+                while (isspace((unsigned char)*value)) value++;
+                snprintf(level->name, sizeof(level->name), "%s", value);
+            }
+            continue;
+        }
+        if (length == 0) continue;
+
+        if (width == 0) width = (int)length;
+        if ((int)length != width || rowCount >= LEVEL_MAX_DIMENSION) {
+            fprintf(stderr, "%s:%d: every row must be %d cells wide\n", path, rowCount + 1, width);
+            ok = false;
+            break;
+        }
+
+        char **grown = realloc(rows, sizeof(char *) * (size_t)(rowCount + 1));
+        if (grown) rows = grown;
+        char *row = grown ? strdup(line) : NULL;
+        if (row == NULL) {
+            fprintf(stderr, "%s: out of memory\n", path);
+            ok = false;
+            break;
+        }
+        rows[rowCount++] = row;
+    }
+    fclose(file);
+
+    if (ok && rowCount == 0) {
+        fprintf(stderr, "%s: no map rows\n", path);
+        ok = false;
+    }
+
+    int spawnCount = 0;
+    bool hasFoodZone = false;
+    for (int y = 0; ok && y < rowCount; y++) {
+        for (int x = 0; ok && x < width; x++) {
+            switch (rows[y][x]) {
+                case '#': case '.': break;
+                case 'f': hasFoodZone = true; break;
+                case '>': case '<': case '^': case 'v': spawnCount++; break;
+                default:
+                    fprintf(stderr, "%s:%d: unknown cell '%c'\n", path, y + 1, rows[y][x]);
+                    ok = false;
+            }
+        }
+    }
+    if (ok && spawnCount == 0) {
+        fprintf(stderr, "%s: needs at least one spawn (> < ^ v)\n", path);
+        ok = false;
+    }
+
+    if (ok) {
+        level->width = width;
+        level->height = rowCount;
+        level->size = level_size(width, rowCount, spawnCount);
+        level->data = calloc(1, level->size);
+        if (level->data == NULL) {
+            fprintf(stderr, "%s: out of memory\n", path);
+            ok = false;
+        }
+    }
+
+    if (ok) {
+        size_t bitmap = (size_t)LEVEL_ROW_WORDS(width) * rowCount * sizeof(uint64_t);
+        LevelHeader *header = (LevelHeader *)level->data;
+        header->width = (uint16_t)width;
+        header->height = (uint16_t)rowCount;
+        header->spawnCount = (uint16_t)spawnCount;
+        header->spawnOffset = sizeof(LevelHeader);
+        header->foodZoneOffset = (uint32_t)(level->size - bitmap);
+        header->wallOffset = (uint32_t)(level->size - 2 * bitmap);
+
+        LevelSpawn *spawns = (LevelSpawn *)(level->data + header->spawnOffset);
+        uint64_t *walls = (uint64_t *)(level->data + header->wallOffset);
+        uint64_t *foodZone = (uint64_t *)(level->data + header->foodZoneOffset);
+        int spawn = 0;
+
+        for (int y = 0; y < rowCount; y++) {
+            for (int x = 0; x < width; x++) {
+                char cell = rows[y][x];
+                if (cell == '#') {
+                    set_bit(walls, width, x, y);
+                    header->wallCount++;
+                } else if (cell == 'f' || !hasFoodZone) {
+                    set_bit(foodZone, width, x, y);
+                }
+
+                if (cell == '>' || cell == '<' || cell == '^' || cell == 'v') {
+                    LevelSpawn *s = &spawns[spawn++];
+                    s->x = (int16_t)x;
+                    s->y = (int16_t)y;
+                    s->dx = cell == '>' ? 1 : cell == '<' ? -1 : 0;
+                    s->dy = cell == 'v' ? 1 : cell == '^' ? -1 : 0;
+
+                    // The body trails behind the head and must be on open floor, as
+                    // level_spawn_valid() checks again when the pack is opened
+                    for (int i = 1; i < LEVEL_SPAWN_LENGTH && ok; i++) {
+                        int bx = x - s->dx * i, by = y - s->dy * i;
+                        if (bx < 0 || bx >= width || by < 0 || by >= rowCount || rows[by][bx] == '#') {
+                            fprintf(stderr, "%s:%d: no room behind spawn at column %d\n", path, y + 1, x + 1);
+                            ok = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Every floor cell must be reachable from the spawns, or food could land in a sealed pocket
+    if (ok) {
+        const LevelHeader *header = (const LevelHeader *)level->data;
+        size_t words = (size_t)LEVEL_ROW_WORDS(width) * rowCount;
+        uint64_t *open = malloc(words * sizeof(uint64_t));
+        uint64_t *reach = calloc(words, sizeof(uint64_t));
+        if (open == NULL || reach == NULL) {
+            fprintf(stderr, "%s: out of memory checking that the floor is connected\n", path);
+            free(open);
+            free(reach);
+            for (int i = 0; i < rowCount; i++) free(rows[i]);
+            free(rows);
+            return false;
+        }
+        const uint64_t *walls = level_walls(header);
+        int lastBits = width % 64;
+
+        for (size_t i = 0; i < words; i++) {
+            open[i] = ~walls[i];
+            if (lastBits && i % LEVEL_ROW_WORDS(width) == (size_t)LEVEL_ROW_WORDS(width) - 1) {
+                open[i] &= (1ULL << lastBits) - 1;
+            }
+        }
+        const LevelSpawn *spawn = level_spawns(header);
+        reach[(size_t)spawn->y * LEVEL_ROW_WORDS(width) + (spawn->x >> 6)] = 1ULL << (spawn->x & 63);
+
+        int unreachable = level_count_bits(open, width, rowCount) - level_flood_fill(open, reach, width, rowCount);
+        if (unreachable > 0) {
+            fprintf(stderr, "%s: %d floor cells cannot be reached from the spawns\n", path, unreachable);
+            ok = false;
+        }
+        free(open);
+        free(reach);
+    }
+
+    for (int i = 0; i < rowCount; i++) free(rows[i]);
+    free(rows);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s output.pak map.txt...\n", argv[0]);
+        return 1;
+    }
+
+    int levelCount = argc - 2;
+    if (levelCount > MAX_LEVELS) {
+        fprintf(stderr, "at most %d levels per pack\n", MAX_LEVELS);
+        return 1;
+    }
+
+    BuiltLevel levels[MAX_LEVELS];
+    memset(levels, 0, sizeof(levels));
+    for (int i = 0; i < levelCount; i++) {
+        if (!build_level(argv[i + 2], &levels[i])) return 1;
+    }
+
+    // Header, index, then the levels back to back (all sizes are multiples of 8)
+    LevelPackHeader header = {0};
+    memcpy(header.magic, LEVEL_PACK_MAGIC, 4);
+    header.version = LEVEL_PACK_VERSION;
+    header.levelCount = (uint16_t)levelCount;
+    header.indexOffset = sizeof(LevelPackHeader);
+
+    LevelIndexEntry index[MAX_LEVELS];
+    memset(index, 0, sizeof(index));
+    size_t offset = header.indexOffset + sizeof(LevelIndexEntry) * (size_t)levelCount;
+    offset = (offset + 7) & ~(size_t)7;
+    size_t levelStart = offset;
+
+    for (int i = 0; i < levelCount; i++) {
+        index[i].offset = (uint32_t)offset;
+        index[i].size = (uint32_t)levels[i].size;
+        // Only the name itself, so the entry stays zero after it; the bytes past
+        // the terminator in `levels[i].name` may be left over from the default name
+        memcpy(index[i].name, levels[i].name, strlen(levels[i].name));
+        offset += levels[i].size;
+    }
+    if (offset > UINT32_MAX) {
+        fprintf(stderr, "pack would exceed 4 GB\n");
+        return 1;
+    }
+    header.size = (uint32_t)offset;
+
+    FILE *out = fopen(argv[1], "wb");
+    if (out == NULL) {
+        fprintf(stderr, "%s: cannot create\n", argv[1]);
+        return 1;
+    }
+
+    static const uint8_t padding[8] = {0};
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(index, sizeof(LevelIndexEntry), (size_t)levelCount, out);
+    fwrite(padding, 1, levelStart - header.indexOffset - sizeof(LevelIndexEntry) * (size_t)levelCount, out);
+    for (int i = 0; i < levelCount; i++) {
+        fwrite(levels[i].data, 1, levels[i].size, out);
+        printf("%-24s %4dx%-4d %u walls\n", levels[i].name, levels[i].width, levels[i].height,
+               ((LevelHeader *)levels[i].data)->wallCount);
+        free(levels[i].data);
+    }
+
+    if (fclose(out) != 0) {
+        fprintf(stderr, "%s: write failed\n", argv[1]);
+        return 1;
+    }
+    printf("Wrote %d levels (%zu bytes) to %s\n", levelCount, offset, argv[1]);
+    return 0;
+}
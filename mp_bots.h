@@ -0,0 +1,263 @@
+#ifndef MP_BOTS_H
+#define MP_BOTS_H
+
+// Computer players for the multiplayer battle, shared by multiplayer.c (the Bot and
+// AI opponents) and tournament.c (which rates them against each other). Like
+// mp_rules.h, nothing here touches SDL or threads.
+//
+// bot_action() is the greedy fruit-seeking bot, and doubles as the rollout policy
+// of the tree search. The search itself is decoupled UCT over relative moves: an
+// MctsSearch grows one tree for its snake and a rival, each picking from its own
+// statistics, while any other snakes follow the rollout policy. multiplayer.c runs
+// one search per worker thread against a deadline and merges the root statistics;
+// tournament.c runs a single search for a fixed number of rollouts.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "mp_rules.h"
+
+// Tree search settings
+#define MCTS_MAX_NODES 16384     // Tree nodes per search
+#define MCTS_ROLLOUT_DEPTH 24    // Moves simulated per rollout
+#define MCTS_EXPLORATION 0.3f    // UCB1 exploration constant
+#define MCTS_DISCOUNT 0.9f       // Fruit eaten sooner is worth more
+
+// Relative moves the bots choose between
+#define MCTS_STRAIGHT 0
+#define MCTS_LEFT 1
+#define MCTS_RIGHT 2
+#define MCTS_ACTIONS 3
+
+// Copy of the match the AI simulates on
+typedef struct {
+    Match match;
+    int ticksLeft;
+    float discount;          // Weight of fruit eaten on the next move
+    float eaten[MAX_PLAYERS]; // Discounted fruit eaten by each snake since the capture
+} SimState;
+
+// Search tree node with separate statistics for the AI's and its rival's own
+// action; other snakes follow the rollout policy
+typedef struct {
+    int children[MCTS_ACTIONS * MCTS_ACTIONS]; // Indexed by joint action (AI * 3 + rival)
+    float value[2][MCTS_ACTIONS];
+    int visits[2][MCTS_ACTIONS];
+    int totalVisits;
+} MctsNode;
+
+// One search tree. `nodes` holds MCTS_MAX_NODES and belongs to the caller.
+typedef struct {
+    MctsNode *nodes;
+    int nodeCount;
+    uint32_t rng;
+    int player; // Snake the search plays for, statistics slot 0
+    int rival;  // Snake it plans against, statistics slot 1
+} MctsSearch;
+
+// Copy of the match state the AI searches over
+static inline void sim_capture(SimState *sim, const Match *match, int time_left) {
+    sim->match = *match;
+    sim->ticksLeft = time_left / MOVE_INTERVAL;
+    sim->discount = 1.0f;
+    memset(sim->eaten, 0, sizeof(sim->eaten));
+}
+
+// Direction after taking a relative action (straight, left, right)
+static inline void turn_direction(int dx, int dy, int action, int *new_dx, int *new_dy) {
+    *new_dx = dx;
+    *new_dy = dy;
+    if (action == MCTS_LEFT) {
+        *new_dx = dy;
+        *new_dy = -dx;
+    } else if (action == MCTS_RIGHT) {
+        *new_dx = -dy;
+        *new_dy = dx;
+    }
+}
+
+static inline void apply_relative_move(Snake *snake, int action) {
+    turn_direction(snake->dx, snake->dy, action, &snake->dx, &snake->dy);
+}
+
+// Advance the copy by one move, following the same order as the main loop
+static inline void sim_step(SimState *sim, const int actions[MAX_PLAYERS]) {
+    Match *match = &sim->match;
+    int scores[MAX_PLAYERS];
+
+    for (int i = 0; i < match->snakeCount; i++) {
+        if (match->snakes[i].alive) apply_relative_move(&match->snakes[i], actions[i]);
+        scores[i] = match->snakes[i].score;
+    }
+
+    move_snakes(match);
+    eat_foods(match);
+
+    for (int i = 0; i < match->snakeCount; i++) {
+        sim->eaten[i] += sim->discount * (match->snakes[i].score - scores[i]) / 10;
+    }
+    sim->discount *= MCTS_DISCOUNT;
+
+    ensure_minimum_fruits(match);
+
+    sim->ticksLeft--;
+}
+
+static inline bool sim_finished(const SimState *sim) {
+    return sim->ticksLeft <= 0 || match_over(&sim->match);
+}
+
+// Bot and rollout policy: mostly head for the nearest fruit, otherwise a random
+// action, never running straight into a wall or body
+static inline int bot_action(const Match *match, int player, uint32_t *rng) {
+    const Snake *snake = &match->snakes[player];
+    if (!snake->alive) return MCTS_STRAIGHT;
+
+    int safe[MCTS_ACTIONS];
+    int safe_count = 0;
+    int greedy = -1;
+    int greedy_distance = GRID_WIDTH + GRID_HEIGHT;
+
+    for (int a = 0; a < MCTS_ACTIONS; a++) {
+        int dx, dy;
+        turn_direction(snake->dx, snake->dy, a, &dx, &dy);
+        int x = snake->body[0].x + dx;
+        int y = snake->body[0].y + dy;
+        if (cell_blocked(match, x, y)) continue;
+
+        safe[safe_count++] = a;
+        for (int i = 0; i < FOOD_SLOTS; i++) {
+            if (!match->foods[i].active) continue;
+            int distance = abs(match->foods[i].x - x) + abs(match->foods[i].y - y);
+            if (distance < greedy_distance) {
+                greedy_distance = distance;
+                greedy = a;
+            }
+        }
+    }
+
+    if (safe_count == 0) return MCTS_STRAIGHT;
+    if (greedy >= 0 && mp_rand(rng) % 4 != 0) return greedy;
+    return safe[mp_rand(rng) % safe_count];
+}
+
+// Reward in [0, 1] for `player`: staying alive is worth half, fruit eaten ahead
+// of `rival` (sooner counts more) the rest
+static inline float sim_reward(const SimState *sim, int player, int rival) {
+    const Snake *self = &sim->match.snakes[player];
+
+    float lead = 0.25f + (sim->eaten[player] - sim->eaten[rival]) / 8.0f;
+    if (lead < 0.0f) lead = 0.0f;
+    if (lead > 0.5f) lead = 0.5f;
+    return (self->alive ? 0.5f : 0.0f) + lead;
+}
+
+// Decoupled UCT: each snake picks its own action from its own statistics
+static inline int mcts_select(const MctsNode *node, int player) {
+    int best = 0;
+    float best_score = -1.0f;
+    float log_total = logf((float)node->totalVisits + 1.0f);
+
+    for (int a = 0; a < MCTS_ACTIONS; a++) {
+        int visits = node->visits[player][a];
+        if (visits == 0) return a;
+
+        float score = node->value[player][a] / visits +
+                      MCTS_EXPLORATION * sqrtf(log_total / visits);
+        if (score > best_score) {
+            best_score = score;
+            best = a;
+        }
+    }
+    return best;
+}
+
+static inline int mcts_new_node(MctsSearch *search) {
+    if (search->nodeCount >= MCTS_MAX_NODES) return -1;
+
+    int index = search->nodeCount++;
+    MctsNode *node = &search->nodes[index];
+    memset(node, 0, sizeof(MctsNode));
+    for (int i = 0; i < MCTS_ACTIONS * MCTS_ACTIONS; i++) {
+        node->children[i] = -1;
+    }
+    return index;
+}
+
+// Empty the tree for a new position
+static inline void mcts_reset(MctsSearch *search) {
+    search->nodeCount = 0;
+    mcts_new_node(search);
+}
+
+// One selection / expansion / rollout / backpropagation pass
+static inline void mcts_iterate(MctsSearch *search, const SimState *root) {
+    SimState sim = *root;
+    sim.match.rng = mp_rand(&search->rng) | 1; // Each rollout sees its own future fruit
+    int searched[2] = {search->player, search->rival}; // Tree statistics slots 0 and 1
+    int path[MCTS_ROLLOUT_DEPTH + 1];
+    int path_actions[MCTS_ROLLOUT_DEPTH + 1][2];
+    int depth = 0;
+    int node_index = 0;
+
+    // Selection and expansion; snakes outside the tree move by the rollout policy
+    while (depth < MCTS_ROLLOUT_DEPTH && !sim_finished(&sim)) {
+        MctsNode *node = &search->nodes[node_index];
+        int actions[MAX_PLAYERS];
+        for (int p = 0; p < sim.match.snakeCount; p++) {
+            actions[p] = bot_action(&sim.match, p, &search->rng);
+        }
+        for (int s = 0; s < 2; s++) {
+            actions[searched[s]] = sim.match.snakes[searched[s]].alive ? mcts_select(node, s) : MCTS_STRAIGHT;
+        }
+
+        path[depth] = node_index;
+        path_actions[depth][0] = actions[searched[0]];
+        path_actions[depth][1] = actions[searched[1]];
+        depth++;
+
+        sim_step(&sim, actions);
+
+        int child = path_actions[depth - 1][0] * MCTS_ACTIONS + path_actions[depth - 1][1];
+        if (node->children[child] < 0) {
+            node->children[child] = mcts_new_node(search);
+            break;
+        }
+        node_index = node->children[child];
+    }
+
+    // Rollout
+    for (int t = depth; t < MCTS_ROLLOUT_DEPTH && !sim_finished(&sim); t++) {
+        int actions[MAX_PLAYERS];
+        for (int p = 0; p < sim.match.snakeCount; p++) {
+            actions[p] = bot_action(&sim.match, p, &search->rng);
+        }
+        sim_step(&sim, actions);
+    }
+
+    // Backpropagation
+    float rewards[2] = {
+        sim_reward(&sim, searched[0], searched[1]),
+        sim_reward(&sim, searched[1], searched[0])
+    };
+    for (int d = 0; d < depth; d++) {
+        MctsNode *node = &search->nodes[path[d]];
+        node->totalVisits++;
+        for (int s = 0; s < 2; s++) {
+            node->visits[s][path_actions[d][s]]++;
+            node->value[s][path_actions[d][s]] += rewards[s];
+        }
+    }
+}
+
+// Most visited of the root's actions for the searching snake, given the root
+// visits summed over one or more trees
+static inline int mcts_best_action(const int visits[MCTS_ACTIONS]) {
+    int best = MCTS_STRAIGHT;
+    for (int a = 0; a < MCTS_ACTIONS; a++) {
+        if (visits[a] > visits[best]) best = a;
+    }
+    return best;
+}
+
+#endif
@@ -0,0 +1,320 @@
+#ifndef MP_NET_H
+#define MP_NET_H
+
+// UDP protocol between mp_server.c and the network client in multiplayer.c.
+//
+// The server owns the match. Clients only send what their player pressed and
+// draw the state the server broadcasts after every tick. Every datagram starts
+// with a type byte and multi-byte fields are little-endian.
+//
+//   client -> server
+//     MP_JOIN      type, version, players, 0, nonce:u32
+//                  Sent until a WELCOME with the same nonce arrives. `players` is the
+//                  match size wanted; clients asking for the same size are grouped.
+//     MP_INPUT     type, direction, 0, 0, session:u32, ack:u32
+//                  Sent on every key press and for every snapshot received. `ack` is the
+//                  newest tick the client holds, `direction` is an MpDirection.
+//     MP_LEAVE     type, 0, 0, 0, session:u32
+//
+//   server -> client
+//     MP_WELCOME   type, player, players, 0, nonce:u32, session:u32, match:u32
+//     MP_SNAPSHOT  type, player, 0, 0, tick:u32, base:u32, length:u16, payload
+//                  The payload is the packed state (mp_pack_state) XORed with the packed
+//                  state of tick `base`, then zero-run-length encoded. `base` 0 means a
+//                  keyframe: XOR against all zeros. The server deltas against the newest
+//                  tick the client acknowledged, so losing a snapshot costs nothing but
+//                  a slightly larger next one.
+
+#include "mp_rules.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#define MP_NET_AVAILABLE 1
+#endif
+
+#define MP_PROTOCOL_VERSION 3
+#define MP_DEFAULT_PORT 7777
+#define MP_MAX_PACKET 2048
+#define MP_HISTORY 32         // Ticks of packed state kept on both ends for deltas
+#define MP_TIMEOUT 5000       // ms of silence before the other end is given up on
+#define MP_JOIN_INTERVAL 250  // ms between JOIN retries
+
+enum {
+    MP_JOIN = 1,
+    MP_INPUT,
+    MP_LEAVE,
+    MP_WELCOME,
+    MP_SNAPSHOT
+};
+
+typedef enum {
+    MP_DIR_NONE,
+    MP_DIR_UP,
+    MP_DIR_DOWN,
+    MP_DIR_LEFT,
+    MP_DIR_RIGHT
+} MpDirection;
+
+typedef enum {
+    MP_PHASE_WAITING, // Not every player has joined yet
+    MP_PHASE_PLAYING,
+    MP_PHASE_OVER
+} MpPhase;
+
+// Packed state: header, snakes, then fruit
+#define MP_STATE_HEADER 12 // tick:u32, timeLeft:u32, phase, snakeCount, joined, 0
+#define MP_SNAKE_BYTES (8 + MAX_LENGTH * 2) // length, direction, alive, 0, score:u16, 0, 0, (x, y)...
+#define MP_STATE_SIZE (MP_STATE_HEADER + MAX_PLAYERS * MP_SNAKE_BYTES + FOOD_SLOTS * 3)
+#define MP_SNAPSHOT_HEADER 14
+
+// Header fields of a packed state
+typedef struct {
+    uint32_t tick;
+    int timeLeft;
+    MpPhase phase;
+    int joined; // Players connected so far
+} MpStateInfo;
+
+static inline void mp_put16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void mp_put32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t mp_get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static inline uint32_t mp_get32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline MpDirection mp_direction(int dx, int dy) {
+    if (dy < 0) return MP_DIR_UP;
+    if (dy > 0) return MP_DIR_DOWN;
+    if (dx < 0) return MP_DIR_LEFT;
+    if (dx > 0) return MP_DIR_RIGHT;
+    return MP_DIR_NONE;
+}
+
+static inline void mp_direction_delta(int direction, int *dx, int *dy) {
+    *dx = direction == MP_DIR_LEFT ? -1 : direction == MP_DIR_RIGHT ? 1 : 0;
+    *dy = direction == MP_DIR_UP ? -1 : direction == MP_DIR_DOWN ? 1 : 0;
+}
+
+// Flatten the match into MP_STATE_SIZE bytes. Unused slots stay zero, so a quiet
+// tick differs from the previous one in only a handful of bytes.
+static inline void mp_pack_state(const Match *match, const MpStateInfo *info, uint8_t *out) {
+    memset(out, 0, MP_STATE_SIZE);
+    mp_put32(out, info->tick);
+    mp_put32(out + 4, (uint32_t)(info->timeLeft > 0 ? info->timeLeft : 0));
+    out[8] = (uint8_t)info->phase;
+    out[9] = (uint8_t)match->snakeCount;
+    out[10] = (uint8_t)info->joined;
+
+    for (int p = 0; p < match->snakeCount; p++) {
+        const Snake *snake = &match->snakes[p];
+        uint8_t *s = out + MP_STATE_HEADER + p * MP_SNAKE_BYTES;
+        s[0] = (uint8_t)snake->length;
+        s[1] = (uint8_t)mp_direction(snake->dx, snake->dy);
+        s[2] = snake->alive;
+        mp_put16(s + 4, (uint16_t)snake->score);
+        for (int i = 0; i < snake->length; i++) {
+            // Dead snakes may have a head just off the board; 0xff reads back as -1
+            s[8 + i * 2] = (uint8_t)snake->body[i].x;
+            s[9 + i * 2] = (uint8_t)snake->body[i].y;
+        }
+    }
+
+    uint8_t *f = out + MP_STATE_HEADER + MAX_PLAYERS * MP_SNAKE_BYTES;
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        f[i * 3] = (uint8_t)match->foods[i].x;
+        f[i * 3 + 1] = (uint8_t)match->foods[i].y;
+        f[i * 3 + 2] = match->foods[i].active;
+    }
+}
+
+// Rebuild a match from a packed state. Returns false if the state is malformed.
+static inline bool mp_unpack_state(const uint8_t *in, Match *match, MpStateInfo *info) {
+    int snakeCount = in[9];
+    if (snakeCount < MIN_PLAYERS || snakeCount > MAX_PLAYERS || in[8] > MP_PHASE_OVER) return false;
+
+    memset(match, 0, sizeof(*match));
+    match->snakeCount = snakeCount;
+    match->rng = 1;
+    info->tick = mp_get32(in);
+    info->timeLeft = (int)mp_get32(in + 4);
+    info->phase = (MpPhase)in[8];
+    info->joined = in[10];
+
+    for (int p = 0; p < snakeCount; p++) {
+        Snake *snake = &match->snakes[p];
+        const uint8_t *s = in + MP_STATE_HEADER + p * MP_SNAKE_BYTES;
+        // Snakes spawn at 3 and only grow; moving one needs a neck and a tail
+        if (s[0] < 2 || s[0] > MAX_LENGTH) return false;
+
+        snake->length = s[0];
+        mp_direction_delta(s[1], &snake->dx, &snake->dy);
+        snake->alive = s[2] != 0;
+        snake->score = mp_get16(s + 4);
+        snprintf(snake->name, sizeof(snake->name), "Player %c", 'A' + p);
+        for (int i = 0; i < snake->length; i++) {
+            snake->body[i].x = (int8_t)s[8 + i * 2];
+            snake->body[i].y = (int8_t)s[9 + i * 2];
+            if (snake->alive) occupancy_add(&match->grid, snake->body[i]);
+        }
+    }
+
+    const uint8_t *f = in + MP_STATE_HEADER + MAX_PLAYERS * MP_SNAKE_BYTES;
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        match->foods[i].x = f[i * 3];
+        match->foods[i].y = f[i * 3 + 1];
+        match->foods[i].active = f[i * 3 + 2] != 0;
+    }
+    match->hash = match_rehash(match);
+    return true;
+}
+
+// Zero-run-length coding of a XOR delta. A control byte c below 0x80 is followed by
+// c + 1 literal bytes; c of 0x80 and above stands for (c & 0x7f) + 1 zero bytes.
+// Returns the encoded length, or 0 if it does not fit in `capacity`.
+static inline size_t mp_rle_encode(const uint8_t *in, size_t length, uint8_t *out, size_t capacity) {
+    size_t o = 0, i = 0;
+    while (i < length) {
+        size_t run = 0;
+        while (i + run < length && in[i + run] == 0 && run < 128) run++;
+
+        // A lone zero is cheaper inside a literal than as a run of its own
+        if (run >= 2 || (run == 1 && i + 1 == length)) {
+            if (o + 1 > capacity) return 0;
+            out[o++] = (uint8_t)(0x80 | (run - 1));
+            i += run;
+            continue;
+        }
+
+        size_t start = i;
+        while (i < length && i - start < 128 && !(in[i] == 0 && i + 1 < length && in[i + 1] == 0)) i++;
+        size_t literal = i - start;
+        if (o + 1 + literal > capacity) return 0;
+        out[o++] = (uint8_t)(literal - 1);
+        memcpy(out + o, in + start, literal);
+        o += literal;
+    }
+    return o;
+}
+
+// Decode exactly `length` bytes. Returns false on a truncated or oversized payload.
+static inline bool mp_rle_decode(const uint8_t *in, size_t inLength, uint8_t *out, size_t length) {
+    size_t o = 0, i = 0;
+    while (i < inLength) {
+        uint8_t c = in[i++];
+        size_t count = (size_t)(c & 0x7f) + 1;
+        if (o + count > length) return false;
+        if (c & 0x80) {
+            memset(out + o, 0, count);
+        } else {
+            if (i + count > inLength) return false;
+            memcpy(out + o, in + i, count);
+            i += count;
+        }
+        o += count;
+    }
+    return o == length;
+}
+
+// Snapshot datagram for `state`, delta coded against `base` (NULL for a keyframe).
+// Returns the datagram length, or 0 if the state does not fit.
+static inline size_t mp_write_snapshot(uint8_t *packet, int player, const uint8_t *state, uint32_t tick,
+                                       const uint8_t *base, uint32_t baseTick) {
+    uint8_t delta[MP_STATE_SIZE];
+    for (size_t i = 0; i < MP_STATE_SIZE; i++) {
+        delta[i] = base ? state[i] ^ base[i] : state[i];
+    }
+
+    size_t length = mp_rle_encode(delta, MP_STATE_SIZE, packet + MP_SNAPSHOT_HEADER,
+                                  MP_MAX_PACKET - MP_SNAPSHOT_HEADER);
+    if (length == 0) return 0;
+
+    packet[0] = MP_SNAPSHOT;
+    packet[1] = (uint8_t)player;
+    packet[2] = packet[3] = 0;
+    mp_put32(packet + 4, tick);
+    mp_put32(packet + 8, base ? baseTick : 0);
+    mp_put16(packet + 12, (uint16_t)length);
+    return MP_SNAPSHOT_HEADER + length;
+}
+
+// States kept by tick, for delta coding on the server and decoding on the client
+typedef struct {
+    uint8_t states[MP_HISTORY][MP_STATE_SIZE];
+    uint32_t ticks[MP_HISTORY]; // 0 marks an empty slot
+} MpHistory;
+
+static inline const uint8_t *mp_history_find(const MpHistory *history, uint32_t tick) {
+    if (tick == 0 || history->ticks[tick % MP_HISTORY] != tick) return NULL;
+    return history->states[tick % MP_HISTORY];
+}
+
+static inline uint8_t *mp_history_store(MpHistory *history, uint32_t tick) {
+    history->ticks[tick % MP_HISTORY] = tick;
+    return history->states[tick % MP_HISTORY];
+}
+
+// Decode a snapshot datagram into `history`. Returns the new state, or NULL if the
+// datagram is malformed or its base state is no longer held.
+static inline const uint8_t *mp_read_snapshot(MpHistory *history, const uint8_t *packet, size_t size,
+                                              uint32_t *tick) {
+    if (size < MP_SNAPSHOT_HEADER || packet[0] != MP_SNAPSHOT) return NULL;
+    *tick = mp_get32(packet + 4);
+    uint32_t baseTick = mp_get32(packet + 8);
+    size_t length = mp_get16(packet + 12);
+    if (*tick == 0 || size != MP_SNAPSHOT_HEADER + length) return NULL;
+
+    const uint8_t *base = NULL;
+    if (baseTick != 0) {
+        base = mp_history_find(history, baseTick);
+        if (base == NULL) return NULL;
+    }
+
+    uint8_t state[MP_STATE_SIZE];
+    if (!mp_rle_decode(packet + MP_SNAPSHOT_HEADER, length, state, MP_STATE_SIZE)) return NULL;
+    if (base) {
+        for (size_t i = 0; i < MP_STATE_SIZE; i++) state[i] ^= base[i];
+    }
+
+    uint8_t *slot = mp_history_store(history, *tick);
+    memcpy(slot, state, MP_STATE_SIZE);
+    return slot;
+}
+
+#ifdef MP_NET_AVAILABLE
+// Milliseconds from an arbitrary fixed point
+static inline uint32_t mp_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+static inline bool mp_set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+#endif
@@ -0,0 +1,345 @@
+#ifndef MP_RULES_H
+#define MP_RULES_H
+
+// Rules of the multiplayer battle, shared by multiplayer.c (local games and the
+// network client) and mp_server.c (the headless authoritative server). Nothing here
+// touches SDL, so the server builds without it.
+//
+// One tick: every snake steers, move_snakes() moves them all at once and settles
+// crashes, eat_foods() lets heads eat, ensure_minimum_fruits() tops the board up.
+//
+// The rules keep a Zobrist hash (zobrist.h) of the bodies, fruit, scores and lives
+// up to date as they change them, a few keys per move; match_hash() adds the
+// headings and fruit generator and gives the hash of the whole state.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "zobrist.h"
+
+// Board size in cells
+#define GRID_WIDTH 32  // 640 / 20
+#define GRID_HEIGHT 24 // 480 / 20
+
+// Game duration in milliseconds (2 minutes)
+#define GAME_DURATION 120000 // 2 minutes in milliseconds
+
+// Define the number of fruits that should be present
+#define FRUIT_COUNT 5
+#define FOOD_SLOTS (FRUIT_COUNT * 2) // Extra space for more fruits
+#define FOOD_PLACE_ATTEMPTS 64 // Random draws before scanning for a free cell
+
+// Snakes in a match
+#define MIN_PLAYERS 2
+#define MAX_PLAYERS 8
+#define MAX_LENGTH 100
+
+// Time between snake moves in milliseconds
+#define MOVE_INTERVAL 150
+
+typedef struct {
+    int x, y;
+} Segment;
+
+typedef struct {
+    Segment body[MAX_LENGTH];
+    int length;
+    int dx, dy;
+    bool alive;
+    int score;
+    char name[10];
+} Snake;
+
+typedef struct {
+    int x, y;
+    bool active;
+} Food;
+
+// How many snake segments cover each cell. Kept in step with the snakes as they
+// move, so a collision or free-cell test is one lookup however many snakes play.
+typedef struct {
+    uint8_t cells[GRID_HEIGHT][GRID_WIDTH];
+} Occupancy;
+
+// Everything the rules act on
+typedef struct {
+    Snake snakes[MAX_PLAYERS];
+    int snakeCount;
+    Food foods[FOOD_SLOTS];
+    Occupancy grid;
+    uint32_t rng; // Fruit placement; part of the match so copies replay identically
+    uint64_t hash; // Zobrist hash kept by the rules; see match_hash()
+} Match;
+
+// Starting head position and direction of each snake; the body trails behind
+static const int player_spawns[MAX_PLAYERS][4] = {
+    {5, 5, 1, 0},                              // A: left side, heading right
+    {GRID_WIDTH - 6, GRID_HEIGHT - 6, -1, 0},  // B: right side, heading left
+    {GRID_WIDTH - 6, 5, 0, 1},
+    {5, GRID_HEIGHT - 6, 0, -1},
+    {GRID_WIDTH / 2, 2, 1, 0},
+    {GRID_WIDTH / 2 - 1, GRID_HEIGHT - 3, -1, 0},
+    {2, GRID_HEIGHT / 2, 0, -1},
+    {GRID_WIDTH - 3, GRID_HEIGHT / 2 - 1, 0, 1}
+};
+
+// Cells place_food drew and had to draw again, per thread so AI searches keep
+// their own count. Rollback netplay counts its resimulated ticks again.
+static _Thread_local unsigned long food_place_retries;
+
+// xorshift32; `state` must not be zero
+static inline uint32_t mp_rand(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static inline void occupancy_add(Occupancy *grid, Segment cell) {
+    if (cell.x >= 0 && cell.x < GRID_WIDTH && cell.y >= 0 && cell.y < GRID_HEIGHT) {
+        grid->cells[cell.y][cell.x]++;
+    }
+}
+
+static inline void occupancy_remove(Occupancy *grid, Segment cell) {
+    if (cell.x >= 0 && cell.x < GRID_WIDTH && cell.y >= 0 && cell.y < GRID_HEIGHT) {
+        grid->cells[cell.y][cell.x]--;
+    }
+}
+
+// Walls and every live snake's body, the tail included
+static inline bool cell_blocked(const Match *match, int x, int y) {
+    if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) return true;
+    return match->grid.cells[y][x] > 0;
+}
+
+// Turn towards (dx, dy) unless that would reverse into the snake's own neck
+static inline void snake_steer(Snake *snake, int dx, int dy) {
+    if (dx == -snake->dx && dy == -snake->dy) return;
+    snake->dx = dx;
+    snake->dy = dy;
+}
+
+static inline uint64_t head_key(int p, Segment head) {
+    return zobrist_key(ZOBRIST_HEAD, p, head.x, head.y);
+}
+
+// Key of segment `from` of snake `p`, followed by segment `to`
+static inline uint64_t link_key(int p, Segment from, Segment to) {
+    return zobrist_link(p, from.x, from.y, to.x, to.y);
+}
+
+// Step snake `p` forward; the tail cell is freed and the head cell taken
+static inline void move_snake(Match *match, int p) {
+    Snake *snake = &match->snakes[p];
+    if (!snake->alive) return;  // Don't move dead snakes
+
+    Segment tail = snake->body[snake->length - 1];
+    occupancy_remove(&match->grid, tail);
+    match->hash ^= link_key(p, snake->body[snake->length - 2], tail) ^ head_key(p, snake->body[0]);
+
+    // Move body segments
+    for (int i = snake->length - 1; i > 0; i--) {
+        snake->body[i] = snake->body[i - 1];
+    }
+
+    // Move head
+    snake->body[0].x += snake->dx;
+    snake->body[0].y += snake->dy;
+    occupancy_add(&match->grid, snake->body[0]);
+    match->hash ^= link_key(p, snake->body[0], snake->body[1]) ^ head_key(p, snake->body[0]);
+}
+
+// Move every snake at once, then kill each one whose head ended up in a wall or on
+// a cell any other segment also covers. This settles head-on crashes (both die) and
+// bodies alike with one lookup per snake, independent of the order snakes are in.
+static inline void move_snakes(Match *match) {
+    for (int i = 0; i < match->snakeCount; i++) {
+        move_snake(match, i);
+    }
+
+    bool crashed[MAX_PLAYERS] = {false};
+    for (int i = 0; i < match->snakeCount; i++) {
+        Snake *snake = &match->snakes[i];
+        if (!snake->alive) continue;
+
+        Segment head = snake->body[0];
+        crashed[i] = head.x < 0 || head.x >= GRID_WIDTH || head.y < 0 || head.y >= GRID_HEIGHT ||
+                     match->grid.cells[head.y][head.x] > 1;
+    }
+
+    // Dead snakes leave the board
+    for (int i = 0; i < match->snakeCount; i++) {
+        if (!crashed[i]) continue;
+
+        Snake *snake = &match->snakes[i];
+        snake->alive = false;
+        match->hash ^= zobrist_key(ZOBRIST_ALIVE, i, 0, 0);
+        for (int s = 0; s < snake->length; s++) {
+            occupancy_remove(&match->grid, snake->body[s]);
+        }
+    }
+}
+
+static inline void grow_snake(Match *match, int p) {
+    Snake *snake = &match->snakes[p];
+    // Add a new segment at the current tail position
+    // This will be moved on the next frame
+    if (snake->length < MAX_LENGTH) {
+        snake->body[snake->length] = snake->body[snake->length - 1];
+        occupancy_add(&match->grid, snake->body[snake->length]);
+        match->hash ^= link_key(p, snake->body[snake->length - 1], snake->body[snake->length]);
+        snake->length++;
+    }
+}
+
+static inline bool check_food_collision(const Snake *snake, const Food *food) {
+    return (snake->alive && food->active && snake->body[0].x == food->x && snake->body[0].y == food->y);
+}
+
+// Heads that landed on fruit eat it
+static inline void eat_foods(Match *match) {
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        Food *food = &match->foods[i];
+        for (int s = 0; s < match->snakeCount && food->active; s++) {
+            Snake *snake = &match->snakes[s];
+            if (check_food_collision(snake, food)) {
+                food->active = false;
+                match->hash ^= zobrist_key(ZOBRIST_FOOD, i, food->x, food->y) ^
+                               zobrist_key(ZOBRIST_SCORE, s, snake->score, 0) ^
+                               zobrist_key(ZOBRIST_SCORE, s, snake->score + 10, 0);
+                snake->score += 10;
+                grow_snake(match, s);
+            }
+        }
+    }
+}
+
+// Put a fruit on a cell no snake covers. Returns false, leaving the slot inactive,
+// when the snakes cover the whole board.
+static inline bool place_food(Food *food, Match *match) {
+    int x = 0, y = 0;
+    bool found = false;
+
+    // Random draws are cheap while the board is mostly empty
+    for (int attempt = 0; attempt < FOOD_PLACE_ATTEMPTS && !found; attempt++) {
+        if (attempt > 0) food_place_retries++;
+        x = mp_rand(&match->rng) % GRID_WIDTH;
+        y = mp_rand(&match->rng) % GRID_HEIGHT;
+        found = !cell_blocked(match, x, y);
+    }
+
+    // Crowded board: pick uniformly among the cells left
+    if (!found) {
+        int freeCells = 0;
+        for (int cell = 0; cell < GRID_WIDTH * GRID_HEIGHT; cell++) {
+            freeCells += !cell_blocked(match, cell % GRID_WIDTH, cell / GRID_WIDTH);
+        }
+        if (freeCells == 0) return false;
+
+        int pick = (int)(mp_rand(&match->rng) % (uint32_t)freeCells);
+        for (int cell = 0; !found; cell++) {
+            if (!cell_blocked(match, cell % GRID_WIDTH, cell / GRID_WIDTH) && pick-- == 0) {
+                x = cell % GRID_WIDTH;
+                y = cell / GRID_WIDTH;
+                found = true;
+            }
+        }
+    }
+
+    food->x = x;
+    food->y = y;
+    food->active = true;
+    match->hash ^= zobrist_key(ZOBRIST_FOOD, (int)(food - match->foods), food->x, food->y);
+    return true;
+}
+
+// Top the board back up to FRUIT_COUNT fruits
+static inline void ensure_minimum_fruits(Match *match) {
+    int active_count = 0;
+
+    // Count active fruits
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        if (match->foods[i].active) {
+            active_count++;
+        }
+    }
+
+    // Add more fruits if needed
+    for (int i = 0; i < FOOD_SLOTS && active_count < FRUIT_COUNT; i++) {
+        if (!match->foods[i].active) {
+            if (!place_food(&match->foods[i], match)) break; // No free cell left
+            active_count++;
+        }
+    }
+}
+
+// match->hash computed from scratch, for a match built without the rules
+static inline uint64_t match_rehash(const Match *match) {
+    uint64_t hash = 0;
+    for (int p = 0; p < match->snakeCount; p++) {
+        const Snake *snake = &match->snakes[p];
+        if (snake->alive) hash ^= zobrist_key(ZOBRIST_ALIVE, p, 0, 0);
+        hash ^= zobrist_key(ZOBRIST_SCORE, p, snake->score, 0);
+        hash ^= head_key(p, snake->body[0]);
+        for (int i = 0; i + 1 < snake->length; i++) {
+            hash ^= link_key(p, snake->body[i], snake->body[i + 1]);
+        }
+    }
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        if (match->foods[i].active) hash ^= zobrist_key(ZOBRIST_FOOD, i, match->foods[i].x, match->foods[i].y);
+    }
+    return hash;
+}
+
+// Hash of the whole state, for checking that two runs agree tick by tick and as a
+// transposition key. Headings and the generator are set directly by players, bots
+// and searches, so they are added here instead of tracked.
+static inline uint64_t match_hash(const Match *match) {
+    uint64_t hash = match->hash ^ zobrist_key(ZOBRIST_RNG, 0, (int)(match->rng >> 16), (int)(match->rng & 0xffff));
+    for (int p = 0; p < match->snakeCount; p++) {
+        hash ^= zobrist_key(ZOBRIST_HEADING, p, match->snakes[p].dx, match->snakes[p].dy);
+    }
+    return hash;
+}
+
+// The round ends once every snake has crashed
+static inline bool match_over(const Match *match) {
+    for (int i = 0; i < match->snakeCount; i++) {
+        if (match->snakes[i].alive) return false;
+    }
+    return true;
+}
+
+// Start a new round with `snakeCount` snakes at their spawn points
+static inline void match_reset(Match *match, int snakeCount, uint32_t seed) {
+    memset(match, 0, sizeof(*match));
+    match->snakeCount = snakeCount;
+    match->rng = seed ? seed : 1;
+
+    for (int p = 0; p < snakeCount; p++) {
+        Snake *snake = &match->snakes[p];
+        const int *spawn = player_spawns[p];
+        snake->length = 3;
+        snake->dx = spawn[2];
+        snake->dy = spawn[3];
+        snake->alive = true;
+        snprintf(snake->name, sizeof(snake->name), "Player %c", 'A' + p);
+
+        for (int i = 0; i < snake->length; i++) {
+            snake->body[i].x = spawn[0] - spawn[2] * i;
+            snake->body[i].y = spawn[1] - spawn[3] * i;
+            occupancy_add(&match->grid, snake->body[i]);
+        }
+    }
+    match->hash = match_rehash(match);
+
+    // Place initial fruits
+    ensure_minimum_fruits(match);
+}
+
+#endif
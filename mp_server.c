@@ -0,0 +1,359 @@
+// Headless authoritative server for networked multiplayer matches
+//
+//   gcc -O2 -pthread mp_server.c -o mp_server
+//   ./mp_server [port]                  (default 7777)
+//   ./multiplayer --connect host[:port] [snakes]
+//
+// One UDP socket serves every match. Clients are grouped into matches by the match
+// size they ask for; a match starts as soon as it is full, runs the rules from
+// mp_rules.h once per MOVE_INTERVAL, and sends every client a delta-coded snapshot
+// after each tick (see mp_net.h for the protocol). A client that goes quiet for
+// MP_TIMEOUT is dropped and its snake carries on straight ahead.
+
+#include "async_log.h"
+#include "mp_net.h"
+
+#ifndef MP_NET_AVAILABLE
+#error "mp_server needs BSD sockets"
+#endif
+
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+
+#define MAX_CLIENTS 4096
+#define MAX_MATCHES 2048
+#define MATCH_LINGER 3000 // ms a finished match keeps sending its final state
+
+typedef struct {
+    bool active;
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    uint32_t nonce;    // From the JOIN, so retried JOINs are recognised
+    uint32_t session;  // Index in the low 16 bits, random high bits
+    int match;
+    int player;
+    uint32_t ack;      // Newest tick the client holds
+    uint32_t lastHeard;
+} Client;
+
+typedef struct {
+    uint32_t id;
+    int size;          // Snakes in the match
+    int clients[MAX_PLAYERS]; // Client per snake, -1 once it has left
+    int joined;
+    MpPhase phase;
+    Match match;
+    uint32_t tick;
+    int timeLeft;
+    uint32_t overTime; // When the match finished
+    MpHistory history;
+} ServerMatch;
+
+typedef struct {
+    int fd;
+    Client clients[MAX_CLIENTS];
+    ServerMatch *matches[MAX_MATCHES]; // Allocated while in use
+    int matchCount;
+    uint32_t nextMatchId;
+    uint32_t rng;
+    long packetsOut, bytesOut;
+} Server;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static void send_packet(Server *server, const Client *client, const uint8_t *packet, size_t length) {
+    if (sendto(server->fd, packet, length, 0, (const struct sockaddr *)&client->address,
+               client->addressLength) == (ssize_t)length) {
+        server->packetsOut++;
+        server->bytesOut += (long)length;
+    }
+}
+
+static bool same_address(const Client *client, const struct sockaddr_storage *address, socklen_t length) {
+    return client->addressLength == length && memcmp(&client->address, address, length) == 0;
+}
+
+// Client behind a session id, provided it still talks from the same address
+static Client *find_session(Server *server, uint32_t session, const struct sockaddr_storage *address,
+                            socklen_t length) {
+    if ((session & 0xffff) >= MAX_CLIENTS) return NULL;
+    Client *client = &server->clients[session & 0xffff];
+    if (!client->active || client->session != session || !same_address(client, address, length)) {
+        return NULL;
+    }
+    return client;
+}
+
+static void send_welcome(Server *server, const Client *client) {
+    uint8_t packet[16];
+    packet[0] = MP_WELCOME;
+    packet[1] = (uint8_t)client->player;
+    packet[2] = (uint8_t)server->matches[client->match]->size;
+    packet[3] = 0;
+    mp_put32(packet + 4, client->nonce);
+    mp_put32(packet + 8, client->session);
+    mp_put32(packet + 12, server->matches[client->match]->id);
+    send_packet(server, client, packet, sizeof(packet));
+}
+
+static void free_match(Server *server, int index) {
+    ServerMatch *match = server->matches[index];
+    for (int p = 0; p < match->size; p++) {
+        if (match->clients[p] >= 0) server->clients[match->clients[p]].active = false;
+    }
+    free(match);
+    server->matches[index] = NULL;
+    server->matchCount--;
+}
+
+static void drop_client(Server *server, int index) {
+    Client *client = &server->clients[index];
+    ServerMatch *match = server->matches[client->match];
+    match->clients[client->player] = -1;
+    client->active = false;
+    if (match->phase == MP_PHASE_WAITING) match->joined--; // The seat opens up again
+
+    // Nobody left to play or watch
+    bool empty = true;
+    for (int p = 0; p < match->size; p++) {
+        if (match->clients[p] >= 0) empty = false;
+    }
+    if (empty) free_match(server, client->match);
+}
+
+// Seat a new client in a waiting match of the size it wants, opening one if needed
+static void handle_join(Server *server, const uint8_t *packet, size_t length,
+                        const struct sockaddr_storage *address, socklen_t addressLength, uint32_t now) {
+    if (length < 8 || packet[1] != MP_PROTOCOL_VERSION) return;
+    int size = packet[2];
+    if (size < MIN_PLAYERS || size > MAX_PLAYERS) return;
+    uint32_t nonce = mp_get32(packet + 4);
+
+    // A retried JOIN: the WELCOME was lost
+    int freeClient = -1;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        Client *client = &server->clients[i];
+        if (!client->active) {
+            if (freeClient < 0) freeClient = i;
+        } else if (client->nonce == nonce && same_address(client, address, addressLength)) {
+            client->lastHeard = now;
+            send_welcome(server, client);
+            return;
+        }
+    }
+    if (freeClient < 0) return;
+
+    int seat = -1;
+    for (int i = 0; i < MAX_MATCHES && seat < 0; i++) {
+        ServerMatch *match = server->matches[i];
+        if (match && match->phase == MP_PHASE_WAITING && match->size == size) seat = i;
+    }
+    if (seat < 0) {
+        for (int i = 0; i < MAX_MATCHES && seat < 0; i++) {
+            if (server->matches[i] == NULL) seat = i;
+        }
+        if (seat < 0) return;
+
+        ServerMatch *match = calloc(1, sizeof(ServerMatch));
+        if (match == NULL) return;
+        match->id = ++server->nextMatchId;
+        match->size = size;
+        for (int p = 0; p < MAX_PLAYERS; p++) match->clients[p] = -1;
+        match->phase = MP_PHASE_WAITING;
+        match->timeLeft = GAME_DURATION;
+        match_reset(&match->match, size, mp_rand(&server->rng));
+        server->matches[seat] = match;
+        server->matchCount++;
+    }
+
+    ServerMatch *match = server->matches[seat];
+    int player = 0;
+    while (match->clients[player] >= 0) player++;
+
+    Client *client = &server->clients[freeClient];
+    memset(client, 0, sizeof(*client));
+    client->active = true;
+    client->address = *address;
+    client->addressLength = addressLength;
+    client->nonce = nonce;
+    client->session = (mp_rand(&server->rng) & 0xffff0000u) | (uint32_t)freeClient;
+    client->match = seat;
+    client->player = player;
+    client->lastHeard = now;
+    match->clients[player] = freeClient;
+    match->joined++;
+    if (match->joined == match->size) match->phase = MP_PHASE_PLAYING;
+
+    send_welcome(server, client);
+}
+
+static void handle_packet(Server *server, const uint8_t *packet, size_t length,
+                          const struct sockaddr_storage *address, socklen_t addressLength, uint32_t now) {
+    if (length < 1) return;
+    if (packet[0] == MP_JOIN) {
+        handle_join(server, packet, length, address, addressLength, now);
+        return;
+    }
+    if (length < 8) return;
+
+    Client *client = find_session(server, mp_get32(packet + 4), address, addressLength);
+    if (client == NULL) return;
+    client->lastHeard = now;
+
+    if (packet[0] == MP_LEAVE) {
+        drop_client(server, (int)(client - server->clients));
+    } else if (packet[0] == MP_INPUT && length >= 12) {
+        // Snapshots arrive in order almost always; never move the ack backwards
+        uint32_t ack = mp_get32(packet + 8);
+        if (ack > client->ack) client->ack = ack;
+
+        ServerMatch *match = server->matches[client->match];
+        Snake *snake = &match->match.snakes[client->player];
+        if (match->phase == MP_PHASE_PLAYING && snake->alive && packet[1] != MP_DIR_NONE) {
+            int dx, dy;
+            mp_direction_delta(packet[1], &dx, &dy);
+            snake_steer(snake, dx, dy);
+        }
+    }
+}
+
+// One tick of every match, followed by its snapshots. `now` is the wall clock, not
+// the tick's due time: packets handled this round were stamped with it, and a tick
+// caught up late is due before them.
+static void tick_matches(Server *server, uint32_t now) {
+    uint8_t packet[MP_MAX_PACKET];
+
+    for (int m = 0; m < MAX_MATCHES; m++) {
+        ServerMatch *match = server->matches[m];
+        if (match == NULL) continue;
+
+        // Drop clients that went quiet
+        for (int p = 0; p < match->size; p++) {
+            int c = match->clients[p];
+            if (c >= 0 && (int32_t)(now - server->clients[c].lastHeard) > MP_TIMEOUT) {
+                drop_client(server, c);
+                if (server->matches[m] == NULL) break;
+            }
+        }
+        if (server->matches[m] == NULL) continue;
+
+        if (match->phase == MP_PHASE_PLAYING) {
+            move_snakes(&match->match);
+            eat_foods(&match->match);
+            ensure_minimum_fruits(&match->match);
+            match->timeLeft -= MOVE_INTERVAL;
+            if (match->timeLeft <= 0 || match_over(&match->match)) {
+                match->phase = MP_PHASE_OVER;
+                match->overTime = now;
+            }
+        } else if (match->phase == MP_PHASE_OVER && (int32_t)(now - match->overTime) > MATCH_LINGER) {
+            free_match(server, m);
+            continue;
+        }
+
+        MpStateInfo info = {++match->tick, match->timeLeft, match->phase, match->joined};
+        uint8_t *state = mp_history_store(&match->history, info.tick);
+        mp_pack_state(&match->match, &info, state);
+
+        for (int p = 0; p < match->size; p++) {
+            if (match->clients[p] < 0) continue;
+            Client *client = &server->clients[match->clients[p]];
+            const uint8_t *base = mp_history_find(&match->history, client->ack);
+            size_t length = mp_write_snapshot(packet, p, state, info.tick, base, client->ack);
+            if (length == 0 && base) length = mp_write_snapshot(packet, p, state, info.tick, NULL, 0);
+            if (length > 0) send_packet(server, client, packet, length);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int port = argc > 1 ? atoi(argv[1]) : MP_DEFAULT_PORT;
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "usage: %s [port]\n", argv[0]);
+        return 1;
+    }
+
+    log_init();
+    Server *server = calloc(1, sizeof(Server));
+    server->rng = (uint32_t)time(NULL) | 1;
+
+    server->fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    bool ipv6 = server->fd >= 0;
+    if (ipv6) {
+        // Accept IPv4 clients on the same socket where the system allows it
+        int off = 0;
+        setsockopt(server->fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        struct sockaddr_in6 address = {0};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons((uint16_t)port);
+        if (bind(server->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            close(server->fd);
+            ipv6 = false;
+        }
+    }
+    if (!ipv6) {
+        server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((uint16_t)port);
+        if (server->fd < 0 || bind(server->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            log_error("Could not bind UDP port %d: %s", port, strerror(errno));
+            return 1;
+        }
+    }
+    mp_set_nonblocking(server->fd);
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+    log_info("Serving matches on UDP port %d", port);
+
+    uint32_t nextTick = mp_now() + MOVE_INTERVAL;
+    uint32_t reportTime = mp_now();
+    uint8_t packet[MP_MAX_PACKET];
+
+    while (!stop_requested) {
+        uint32_t now = mp_now();
+        int wait = (int32_t)(nextTick - now) > 0 ? (int)(nextTick - now) : 0;
+        struct pollfd pfd = {server->fd, POLLIN, 0};
+        poll(&pfd, 1, wait);
+
+        // Drain everything queued before ticking
+        now = mp_now();
+        while (true) {
+            struct sockaddr_storage address;
+            socklen_t addressLength = sizeof(address);
+            ssize_t length = recvfrom(server->fd, packet, sizeof(packet), 0,
+                                      (struct sockaddr *)&address, &addressLength);
+            if (length < 0) break;
+            handle_packet(server, packet, (size_t)length, &address, addressLength, now);
+        }
+
+        // Catch up on missed ticks rather than slowing the game down
+        while ((int32_t)(now - nextTick) >= 0) {
+            tick_matches(server, now);
+            nextTick += MOVE_INTERVAL;
+        }
+
+        if (now - reportTime >= 10000) {
+            log_info("%d matches, %.1f packets/s, %.1f KB/s out", server->matchCount,
+                     server->packetsOut * 1000.0 / (now - reportTime),
+                     server->bytesOut / 1.024 / (now - reportTime));
+            server->packetsOut = server->bytesOut = 0;
+            reportTime = now;
+        }
+    }
+
+    log_info("Shutting down with %d matches running", server->matchCount);
+    close(server->fd);
+    for (int i = 0; i < MAX_MATCHES; i++) free(server->matches[i]);
+    free(server);
+    return 0;
+}
@@ -0,0 +1,227 @@
+// Regression check for mp_server.c: two clients stay connected past MP_TIMEOUT
+//
+//   gcc -O2 -pthread mp_server.c -o mp_server
+//   gcc -O2 mp_server_check.c -o mp_server_check
+//   ./mp_server_check [-x server] [-p port] [-t ms]
+//
+// Starts the server, joins a two-snake match with two UDP clients on localhost and
+// plays it the way multiplayer.c does: every snapshot is acknowledged with an INPUT,
+// and a bot steers around whatever is ahead so both snakes stay alive. Halfway
+// through, the server is stopped for a few ticks while the players keep pressing
+// keys, so it wakes up to a queue of input and has ticks to catch up on, which is
+// what a loaded machine does to it now and then.
+//
+// The clients never go quiet, so the server must keep sending both of them
+// snapshots for the whole run, which is longer than MP_TIMEOUT (-t, default
+// MP_TIMEOUT + 2000 ms). A client that stops getting snapshots while the match is
+// still being played has been dropped, and fails the run.
+
+#include "mp_net.h"
+
+#ifndef MP_NET_AVAILABLE
+#error "mp_server_check needs BSD sockets"
+#endif
+
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#define CHECK_CLIENTS 2
+#define CHECK_SILENCE 1000 // ms without a snapshot that counts as dropped
+#define CHECK_STALL (MOVE_INTERVAL * 3) // ms the server is stopped for
+#define CHECK_PRESS 40     // ms between key presses while it is stopped
+
+typedef struct {
+    int fd;
+    uint32_t nonce;
+    uint32_t session;
+    int player;
+    bool welcomed;
+    uint32_t lastSnapshot; // When the newest snapshot arrived
+    uint32_t ack;
+    MpPhase phase;
+    long snapshots;
+    MpHistory history;
+} CheckClient;
+
+static void send_join(const CheckClient *client) {
+    uint8_t packet[8] = {MP_JOIN, MP_PROTOCOL_VERSION, CHECK_CLIENTS, 0};
+    mp_put32(packet + 4, client->nonce);
+    send(client->fd, packet, sizeof(packet), 0);
+}
+
+static void send_input(const CheckClient *client, MpDirection direction) {
+    uint8_t packet[12] = {MP_INPUT, (uint8_t)direction, 0, 0};
+    mp_put32(packet + 4, client->session);
+    mp_put32(packet + 8, client->ack);
+    send(client->fd, packet, sizeof(packet), 0);
+}
+
+// Keep going unless something is ahead, then take whichever side is free
+static MpDirection steer(const Match *match, int player) {
+    const Snake *snake = &match->snakes[player];
+    if (!snake->alive) return MP_DIR_NONE;
+
+    int x = snake->body[0].x, y = snake->body[0].y;
+    if (!cell_blocked(match, x + snake->dx, y + snake->dy)) return MP_DIR_NONE;
+    int dx = -snake->dy, dy = snake->dx;
+    if (cell_blocked(match, x + dx, y + dy)) {
+        dx = -dx;
+        dy = -dy;
+    }
+    return mp_direction(dx, dy);
+}
+
+static void receive(CheckClient *client, uint32_t now) {
+    uint8_t packet[MP_MAX_PACKET];
+    ssize_t length;
+    while ((length = recv(client->fd, packet, sizeof(packet), 0)) > 0) {
+        if (packet[0] == MP_WELCOME && length >= 16 && mp_get32(packet + 4) == client->nonce) {
+            client->welcomed = true;
+            client->player = packet[1];
+            client->session = mp_get32(packet + 8);
+            continue;
+        }
+
+        uint32_t tick;
+        const uint8_t *state = mp_read_snapshot(&client->history, packet, (size_t)length, &tick);
+        if (state == NULL || !client->welcomed) continue;
+
+        Match match;
+        MpStateInfo info;
+        if (!mp_unpack_state(state, &match, &info)) continue;
+        if (tick > client->ack) client->ack = tick;
+        client->phase = info.phase;
+        client->lastSnapshot = now;
+        client->snapshots++;
+        send_input(client, info.phase == MP_PHASE_PLAYING ? steer(&match, client->player) : MP_DIR_NONE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *server = "./mp_server";
+    int port = 7790;
+    int duration = MP_TIMEOUT + 2000;
+
+    int option;
+    while ((option = getopt(argc, argv, "x:p:t:")) != -1) {
+        switch (option) {
+            case 'x': server = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 't': duration = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-x server] [-p port] [-t ms]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (port <= 0 || port > 65535 || duration <= 0) {
+        fprintf(stderr, "port must be 1..65535 and the duration positive\n");
+        return 1;
+    }
+
+    char portText[16];
+    snprintf(portText, sizeof(portText), "%d", port);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid == 0) {
+        execl(server, server, portText, (char *)NULL);
+        perror(server);
+        _exit(127);
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+
+    static CheckClient clients[CHECK_CLIENTS];
+    struct pollfd pfds[CHECK_CLIENTS];
+    for (int i = 0; i < CHECK_CLIENTS; i++) {
+        CheckClient *client = &clients[i];
+        client->fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (client->fd < 0 || connect(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            perror("socket");
+            kill(pid, SIGTERM);
+            return 1;
+        }
+        mp_set_nonblocking(client->fd);
+        client->nonce = (uint32_t)getpid() * 2654435761u + (uint32_t)i + 1;
+        pfds[i] = (struct pollfd){client->fd, POLLIN, 0};
+    }
+
+    // Join until both are seated and the match is under way
+    uint32_t start = mp_now(), lastJoin = 0;
+    bool playing = false;
+    while (!playing && mp_now() - start < MP_TIMEOUT) {
+        uint32_t now = mp_now();
+        if (now - lastJoin >= MP_JOIN_INTERVAL) {
+            for (int i = 0; i < CHECK_CLIENTS; i++) {
+                if (!clients[i].welcomed) send_join(&clients[i]);
+            }
+            lastJoin = now;
+        }
+        poll(pfds, CHECK_CLIENTS, 50);
+        playing = true;
+        for (int i = 0; i < CHECK_CLIENTS; i++) {
+            receive(&clients[i], mp_now());
+            if (clients[i].phase != MP_PHASE_PLAYING) playing = false;
+        }
+    }
+
+    int failures = 0;
+    if (!playing) {
+        fprintf(stderr, "the match never started\n");
+        failures++;
+    }
+
+    // Play, failing any client the server stops talking to mid-match
+    start = mp_now();
+    bool stalled = false;
+    while (failures == 0 && mp_now() - start < (uint32_t)duration) {
+        if (!stalled && mp_now() - start >= (uint32_t)duration / 2) {
+            kill(pid, SIGSTOP);
+            uint32_t stop = mp_now();
+            while (mp_now() - stop < CHECK_STALL) {
+                for (int i = 0; i < CHECK_CLIENTS; i++) send_input(&clients[i], MP_DIR_NONE);
+                usleep(CHECK_PRESS * 1000);
+            }
+            kill(pid, SIGCONT);
+            for (int i = 0; i < CHECK_CLIENTS; i++) clients[i].lastSnapshot = mp_now();
+            stalled = true;
+        }
+
+        poll(pfds, CHECK_CLIENTS, 50);
+        uint32_t now = mp_now();
+        for (int i = 0; i < CHECK_CLIENTS; i++) {
+            CheckClient *client = &clients[i];
+            receive(client, now);
+            if (client->phase == MP_PHASE_PLAYING && now - client->lastSnapshot > CHECK_SILENCE) {
+                fprintf(stderr, "client %d heard nothing for %u ms at %u ms into the match\n", i,
+                        now - client->lastSnapshot, client->lastSnapshot - start);
+                failures++;
+            }
+        }
+    }
+
+    for (int i = 0; i < CHECK_CLIENTS; i++) {
+        uint8_t packet[8] = {MP_LEAVE};
+        mp_put32(packet + 4, clients[i].session);
+        send(clients[i].fd, packet, sizeof(packet), 0);
+        printf("client %d: player %d, %ld snapshots, last tick %u\n", i, clients[i].player, clients[i].snapshots,
+               clients[i].ack);
+        close(clients[i].fd);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (failures > 0) {
+        printf("FAILED: the server dropped a client that never went quiet\n");
+        return 1;
+    }
+    printf("both clients stayed connected for %d ms (MP_TIMEOUT is %d)\n", duration, MP_TIMEOUT);
+    return 0;
+}
@@ -5,11 +5,28 @@
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 
-// Original grid dimensions
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#else
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
+#include "async_log.h"
+#include "metrics.h"
+#include "mp_bots.h"
+#include "mp_rules.h"
+#include "mp_net.h"
+#include "pool.h"
+#include "replay.h"
+#include "rollback.h"
+#include "spectate.h"
+#include "turns.h"
+
+// Original grid dimensions (the board itself is set in mp_rules.h)
 #define CELL_SIZE 20
-#define GRID_WIDTH 32  // 640 / 20
-#define GRID_HEIGHT 24 // 480 / 20
 
 // UI dimensions
 #define UI_HEIGHT 60  // Height of the UI area above the grid
@@ -33,11 +50,30 @@
 // Highscore file name
 #define HIGHSCORE_FILE "highscore.dat"
 
-// Game duration in milliseconds (2 minutes)
-#define GAME_DURATION 120000 // 2 minutes in milliseconds
+// Local players; bots take the rest of the snakes
+#define HUMAN_PLAYERS 4 // Keyboard layouts available
+
+// Game state of one session (a round, or an online match) comes out of this pool
+#define SESSION_POOL_SIZE (256 * 1024)
+
+// Every local round is recorded here; see replay.h
+#define REPLAY_DIR "replays"
+
+// Replay playback (--replay file)
+#define SCRUB_HEIGHT 6                          // Timeline along the bottom of the UI area
+#define SCRUB_GRAB 20                           // Height of the strip that takes clicks on it
+#define REPLAY_SKIP (5000 / MOVE_INTERVAL)      // Ticks an arrow key jumps
+#define REPLAY_MIN_SPEED -2                     // Playback speed is 2^n times real time
+#define REPLAY_MAX_SPEED 4
+
+// Peer-to-peer netplay (--host / --join)
+#define NETPLAY_INPUT_DELAY 1 // Ticks between a key press and its move; hides that much latency
+#define NETPLAY_KEY_QUEUE 4   // Presses buffered for upcoming ticks
+#define NETPLAY_RESEND 50     // ms between input packets while waiting
 
-// Define the number of fruits that should be present
-#define FRUIT_COUNT 5
+// AI opponent (Monte Carlo tree search, see mp_bots.h) settings
+#define MCTS_MAX_THREADS 16
+#define MCTS_TIME_MARGIN 15      // ms kept free before each move to collect the result
 
 // Game states
 typedef enum {
@@ -46,53 +82,106 @@ typedef enum {
     GAME_OVER
 } GameState;
 
-typedef struct {
-    int x, y;
-} Segment;
-
-typedef struct {
-    Segment body[100]; 
-    int length;
-    int dx, dy;
-    bool alive;
-    int score;
-    SDL_Color color;
-    char name[10];
-} Snake;
-
-typedef struct {
-    int x, y;
-    bool active;
-} Food;
-
 typedef struct {
     SDL_Rect rect;
     char text[20];
     bool hover;
 } Button;
 
+// Who steers each snake
+typedef enum {
+    CONTROL_KEYS, // A local player, with the keyboard layout of its index
+    CONTROL_BOT,  // Greedy fruit-seeking bot
+    CONTROL_MCTS  // The tree search AI
+} PlayerControl;
+
+struct MctsBot;
+
+typedef struct {
+    struct MctsBot *bot;
+    SDL_Thread *thread;
+    MctsSearch search; // Each worker grows its own tree
+    long rollouts;  // Rollouts completed in the last search
+    char pad[64];   // Keep neighbouring workers' hot fields on separate cache lines
+} MctsWorker;
+
+// Worker pool that searches in the background while the current move plays out
+typedef struct MctsBot {
+    MctsWorker workers[MCTS_MAX_THREADS];
+    int workerCount;
+    int player;               // Index of the snake the AI controls
+    int rival;                // Snake whose moves the tree searches as well
+    
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    SDL_cond *done;
+    SimState root;
+    Uint32 deadline;
+    int generation;
+    int finished;
+    bool searching;
+    bool quit;
+    
+    long rolloutCount;        // Rollouts since statsStart
+    Uint32 statsStart;
+    double rolloutsPerSecond;
+} MctsBot;
+
+static const SDL_Color player_colors[MAX_PLAYERS] = {
+    {50, 200, 50, 255},   // Green
+    {50, 50, 200, 255},   // Blue
+    {230, 140, 30, 255},  // Orange
+    {200, 60, 200, 255},  // Magenta
+    {40, 200, 200, 255},  // Cyan
+    {220, 220, 60, 255},  // Yellow
+    {230, 80, 80, 255},   // Red
+    {220, 220, 220, 255}  // White
+};
+
+// Keyboard layouts of the local players, in player order: up, down, left, right
+static const SDL_Keycode player_keys[HUMAN_PLAYERS][4] = {
+    {SDLK_w, SDLK_s, SDLK_a, SDLK_d},
+    {SDLK_UP, SDLK_DOWN, SDLK_LEFT, SDLK_RIGHT},
+    {SDLK_i, SDLK_k, SDLK_j, SDLK_l},
+    {SDLK_KP_8, SDLK_KP_5, SDLK_KP_4, SDLK_KP_6}
+};
+
+// State of an online or netplay session, reset when the session ends
+Pool session_pool;
+
 // Function prototypes
 void draw_grid(SDL_Renderer *renderer);
-void draw_snake(SDL_Renderer *renderer, Snake *snake);
+void draw_snake(SDL_Renderer *renderer, Snake *snake, SDL_Color color);
 void draw_foods(SDL_Renderer *renderer, Food foods[], int count);
 void draw_segment(SDL_Renderer *renderer, int x, int y, char segment, int width, int height, int thickness);
 void draw_digit(SDL_Renderer *renderer, int x, int y, int digit, int width, int height, int thickness);
-void draw_score(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time_left, TTF_Font *font);
-void move_snake(Snake *snake, Snake *other_snake);
-bool check_food_collision(Snake *snake, Food *food);
-void place_food(Food *food, Snake *snakeA, Snake *snakeB);
-void ensure_minimum_fruits(Food foods[], int count, Snake *snakeA, Snake *snakeB);
-void grow_snake(Snake *snake);
+void draw_score(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font);
+void draw_match(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font);
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, const LatencyStats *input, const LatencyStats *frames);
+void report_match(const Match *match, const char *mode);
 void init_button(Button *button, int x, int y, const char *text);
 void draw_button(SDL_Renderer *renderer, Button *button, TTF_Font *font);
 bool is_point_in_rect(int x, int y, SDL_Rect *rect);
 void draw_text(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
 void draw_text_centered(SDL_Renderer *renderer, TTF_Font *font, const char *text, int x, int y, SDL_Color color);
-void draw_welcome_screen(SDL_Renderer *renderer, Button *playButton, TTF_Font *font);
-void draw_game_over_screen(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, Button *playAgainButton, Button *exitButton, TTF_Font *font);
-void reset_game(Snake *snakeA, Snake *snakeB, Food foods[], int count);
-void draw_ui_area(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time_left, TTF_Font *font);
+void draw_welcome_screen(SDL_Renderer *renderer, Button *playersButton, Button *playButton, Button *aiButton, TTF_Font *font);
+void draw_game_over_screen(SDL_Renderer *renderer, Match *match, Button *playAgainButton, Button *exitButton, TTF_Font *font);
+Uint32 reset_game(Match *match, int snakeCount);
+void start_recording(ReplayWriter *recording, const Match *match, Uint32 seed);
+void draw_ui_area(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font);
 void format_time(int milliseconds, char *buffer);
+bool mcts_init(MctsBot *bot, int player);
+void mcts_begin(MctsBot *bot, SimState *root, Uint32 deadline);
+int mcts_finish(MctsBot *bot);
+void mcts_shutdown(MctsBot *bot);
+void run_spectator(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font);
+SDL_Rect scrub_bar_rect(void);
+void draw_scrub_bar(SDL_Renderer *renderer, const ReplayPlayer *player);
+void run_replay(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *path);
+#ifdef MP_NET_AVAILABLE
+void run_client(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *server, int players);
+void run_netplay(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *join, int port);
+#endif
 
 // Main function remains at the bottom
 
@@ -114,14 +203,14 @@ void draw_grid(SDL_Renderer *renderer) {
     SDL_RenderDrawRect(renderer, &border);
 }
 
-void draw_snake(SDL_Renderer *renderer, Snake *snake) {
+void draw_snake(SDL_Renderer *renderer, Snake *snake, SDL_Color color) {
     if (!snake->alive) return;  // Don't draw dead snakes
     
     // Draw body segments
     SDL_SetRenderDrawColor(renderer, 
-                          snake->color.r * 0.8, 
-                          snake->color.g * 0.8, 
-                          snake->color.b * 0.8, 
+                          color.r * 0.8, 
+                          color.g * 0.8, 
+                          color.b * 0.8, 
                           255);
     for (int i = 1; i < snake->length; i++) {
         SDL_Rect rect = {
@@ -135,9 +224,9 @@ void draw_snake(SDL_Renderer *renderer, Snake *snake) {
     
     // Draw head in brighter color
     SDL_SetRenderDrawColor(renderer, 
-                          snake->color.r, 
-                          snake->color.g, 
-                          snake->color.b, 
+                          color.r, 
+                          color.g, 
+                          color.b, 
                           255);
     SDL_Rect head_rect = {
         snake->body[0].x * CELL_SIZE, 
@@ -233,7 +322,7 @@ void format_time(int milliseconds, char *buffer) {
 }
 
 // Function to draw the UI area with scores and timer
-void draw_ui_area(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time_left, TTF_Font *font) {
+void draw_ui_area(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font) {
     // Background for UI area
     SDL_SetRenderDrawColor(renderer, 30, 30, 40, 255);
     SDL_Rect ui_rect = {0, 0, WINDOW_WIDTH, UI_HEIGHT};
@@ -243,13 +332,6 @@ void draw_ui_area(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time
     SDL_SetRenderDrawColor(renderer, 100, 100, 100, 255);
     SDL_RenderDrawLine(renderer, 0, UI_HEIGHT, WINDOW_WIDTH, UI_HEIGHT);
     
-    // Player A score
-    char scoreA_text[32];
-    sprintf(scoreA_text, "PLAYER A: %d", snakeA->score);
-    
-    SDL_Color playerA_color = snakeA->color;
-    draw_text(renderer, font, scoreA_text, UI_PADDING, UI_HEIGHT / 2 - 10, playerA_color);
-    
     // Timer in the middle
     char time_text[32];
     format_time(time_left, time_text);
@@ -261,131 +343,234 @@ void draw_ui_area(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time
     int timer_x = WINDOW_WIDTH / 2 - surface->w / 2;
     SDL_FreeSurface(surface);
     
-    draw_text(renderer, font, time_text, timer_x, UI_HEIGHT / 2 - 10, white);
-    
-    // Player B score
-    char scoreB_text[32];
-    sprintf(scoreB_text, "PLAYER B: %d", snakeB->score);
-    
-    SDL_Color playerB_color = snakeB->color;
-    
-    // Calculate position for Player B score (right-aligned)
-    surface = TTF_RenderText_Solid(font, scoreB_text, playerB_color);
-    int scoreB_x = WINDOW_WIDTH - UI_PADDING - surface->w;
-    SDL_FreeSurface(surface);
+    if (match->snakeCount == 2) {
+        Snake *snakeA = &match->snakes[0];
+        Snake *snakeB = &match->snakes[1];
+        
+        // Player A score
+        char scoreA_text[32];
+        sprintf(scoreA_text, "PLAYER A: %d", snakeA->score);
+        
+        SDL_Color playerA_color = player_colors[0];
+        draw_text(renderer, font, scoreA_text, UI_PADDING, UI_HEIGHT / 2 - 10, playerA_color);
+        
+        draw_text(renderer, font, time_text, timer_x, UI_HEIGHT / 2 - 10, white);
+        
+        // Player B score
+        char scoreB_text[32];
+        sprintf(scoreB_text, "PLAYER B: %d", snakeB->score);
+        
+        SDL_Color playerB_color = player_colors[1];
+        
+        // Calculate position for Player B score (right-aligned)
+        surface = TTF_RenderText_Solid(font, scoreB_text, playerB_color);
+        int scoreB_x = WINDOW_WIDTH - UI_PADDING - surface->w;
+        SDL_FreeSurface(surface);
+        
+        draw_text(renderer, font, scoreB_text, scoreB_x, UI_HEIGHT / 2 - 10, playerB_color);
+        return;
+    }
     
-    draw_text(renderer, font, scoreB_text, scoreB_x, UI_HEIGHT / 2 - 10, playerB_color);
+    // More players: timer on top, one short score per snake in a row below it
+    draw_text(renderer, font, time_text, timer_x, 2, white);
+    for (int i = 0; i < match->snakeCount; i++) {
+        Snake *snake = &match->snakes[i];
+        char score_text[16];
+        sprintf(score_text, "%c:%d", 'A' + i, snake->score);
+        
+        SDL_Color color = player_colors[i];
+        if (!snake->alive) color = (SDL_Color){120, 120, 120, 255}; // Greyed out once dead
+        draw_text(renderer, font, score_text, UI_PADDING + i * (WINDOW_WIDTH / match->snakeCount), 
+                  UI_HEIGHT / 2, color);
+    }
 }
 
-// Modified score function now displays both players' scores and the timer
-void draw_score(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, int time_left, TTF_Font *font) {
-    draw_ui_area(renderer, snakeA, snakeB, time_left, font);
+// Modified score function now displays every player's score and the timer
+void draw_score(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font) {
+    draw_ui_area(renderer, match, time_left, font);
 }
 
-void move_snake(Snake *snake, Snake *other_snake) {
-    if (!snake->alive) return;  // Don't move dead snakes
+// Scores, timer, board, fruit and snakes
+void draw_match(SDL_Renderer *renderer, Match *match, int time_left, TTF_Font *font) {
+    // Draw UI area with scores and timer
+    draw_score(renderer, match, time_left, font);
     
-    // Move body segments
-    for (int i = snake->length - 1; i > 0; i--) {
-        snake->body[i] = snake->body[i - 1];
-    }
+    // Draw grid
+    draw_grid(renderer);
     
-    // Move head
-    snake->body[0].x += snake->dx;
-    snake->body[0].y += snake->dy;
-
-    // Check wall collision
-    if (snake->body[0].x < 0 || snake->body[0].x >= GRID_WIDTH ||
-        snake->body[0].y < 0 || snake->body[0].y >= GRID_HEIGHT) {
-        snake->alive = false;
-        return;
-    }
+    // Draw foods
+    draw_foods(renderer, match->foods, FOOD_SLOTS);
     
-    // Check self collision
-    for (int i = 1; i < snake->length; i++) {
-        if (snake->body[0].x == snake->body[i].x && snake->body[0].y == snake->body[i].y) {
-            snake->alive = false;
-            return;
-        }
+    // Draw snakes
+    for (int p = 0; p < match->snakeCount; p++) {
+        draw_snake(renderer, &match->snakes[p], player_colors[p]);
     }
+}
+
+// F3 overlay along the bottom: key press to screen, and time between frames
+void draw_profiler(SDL_Renderer *renderer, TTF_Font *font, const LatencyStats *input, const LatencyStats *frames) {
+    SDL_Color white = {255, 255, 255, 255};
+    char line[128];
     
-    // Check collision with other snake
-    if (other_snake->alive) {
-        for (int i = 0; i < other_snake->length; i++) {
-            if (snake->body[0].x == other_snake->body[i].x && 
-                snake->body[0].y == other_snake->body[i].y) {
-                snake->alive = false;
-                return;
-            }
-        }
-    }
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
+    SDL_Rect box = {0, WINDOW_HEIGHT - 46, WINDOW_WIDTH, 46};
+    SDL_RenderFillRect(renderer, &box);
+    
+    latency_format(input, "input to photon", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 44, white);
+    latency_format(frames, "frame", line, sizeof(line));
+    draw_text(renderer, font, line, UI_PADDING, WINDOW_HEIGHT - 23, white);
 }
 
-bool check_food_collision(Snake *snake, Food *food) {
-    return (snake->alive && food->active && snake->body[0].x == food->x && snake->body[0].y == food->y);
+// Hand the leading snake's score and the longest length to the metrics endpoint
+void report_match(const Match *match, const char *mode) {
+    int score = 0, length = 0;
+    for (int p = 0; p < match->snakeCount; p++) {
+        if (match->snakes[p].score > score) score = match->snakes[p].score;
+        if (match->snakes[p].length > length) length = match->snakes[p].length;
+    }
+    metrics_game(score, length, food_place_retries, mode);
 }
 
-void place_food(Food *food, Snake *snakeA, Snake *snakeB) {
-    bool valid_position;
-    
-    do {
-        valid_position = true;
-        food->x = rand() % GRID_WIDTH;
-        food->y = rand() % GRID_HEIGHT;
-        
-        // Check if food is not on snake A
-        for (int i = 0; i < snakeA->length; i++) {
-            if (food->x == snakeA->body[i].x && food->y == snakeA->body[i].y) {
-                valid_position = false;
-                break;
-            }
+// Worker thread: wait for a search request, search until the deadline, report back
+static int mcts_worker_main(void *data) {
+    MctsWorker *worker = (MctsWorker *)data;
+    MctsBot *bot = worker->bot;
+    int seen_generation = 0;
+    
+    SDL_LockMutex(bot->lock);
+    while (true) {
+        while (!bot->quit && bot->generation == seen_generation) {
+            SDL_CondWait(bot->wake, bot->lock);
         }
+        if (bot->quit) break;
         
-        // Check if food is not on snake B
-        if (valid_position) {
-            for (int i = 0; i < snakeB->length; i++) {
-                if (food->x == snakeB->body[i].x && food->y == snakeB->body[i].y) {
-                    valid_position = false;
-                    break;
-                }
-            }
+        seen_generation = bot->generation;
+        SimState root = bot->root;
+        Uint32 deadline = bot->deadline;
+        SDL_UnlockMutex(bot->lock);
+        
+        // Every worker grows its own tree; only the root statistics are merged
+        mcts_reset(&worker->search);
+        long rollouts = 0;
+        do {
+            mcts_iterate(&worker->search, &root);
+            rollouts++;
+        } while (!SDL_TICKS_PASSED(SDL_GetTicks(), deadline));
+        
+        SDL_LockMutex(bot->lock);
+        worker->rollouts = rollouts;
+        bot->finished++;
+        SDL_CondSignal(bot->done);
+    }
+    SDL_UnlockMutex(bot->lock);
+    return 0;
+}
+
+// Start the worker pool for the AI controlling `player` (0 = A, 1 = B, ...); its
+// search also plans for Player A, or B when the AI is A. On failure everything
+// started so far is stopped and freed again, so it can simply be called again.
+bool mcts_init(MctsBot *bot, int player) {
+    memset(bot, 0, sizeof(MctsBot));
+    bot->player = player;
+    bot->rival = player == 0 ? 1 : 0;
+    bot->lock = SDL_CreateMutex();
+    bot->wake = SDL_CreateCond();
+    bot->done = SDL_CreateCond();
+    if (!bot->lock || !bot->wake || !bot->done) {
+        mcts_shutdown(bot);
+        return false;
+    }
+    
+    // Leave one core for the game loop
+    bot->workerCount = SDL_GetCPUCount() - 1;
+    if (bot->workerCount < 1) bot->workerCount = 1;
+    if (bot->workerCount > MCTS_MAX_THREADS) bot->workerCount = MCTS_MAX_THREADS;
+    
+    for (int i = 0; i < bot->workerCount; i++) {
+        MctsWorker *worker = &bot->workers[i];
+        worker->bot = bot;
+        worker->search.player = bot->player;
+        worker->search.rival = bot->rival;
+        worker->search.rng = 0x9E3779B9u * (Uint32)(i + 1) ^ (Uint32)time(NULL);
+        if (worker->search.rng == 0) worker->search.rng = 1;
+        worker->search.nodes = malloc(sizeof(MctsNode) * MCTS_MAX_NODES);
+        if (!worker->search.nodes) SDL_OutOfMemory();
+        else worker->thread = SDL_CreateThread(mcts_worker_main, "mcts", worker);
+        if (!worker->thread) {
+            free(worker->search.nodes);
+            bot->workerCount = i; // Only these are running
+            mcts_shutdown(bot);
+            return false;
         }
-    } while (!valid_position);
+    }
     
-    food->active = true;
+    bot->statsStart = SDL_GetTicks();
+    return true;
+}
+
+// Kick off a background search of the current position, to be collected by the deadline
+void mcts_begin(MctsBot *bot, SimState *root, Uint32 deadline) {
+    SDL_LockMutex(bot->lock);
+    bot->root = *root;
+    bot->deadline = deadline;
+    bot->finished = 0;
+    bot->generation++;
+    bot->searching = true;
+    SDL_CondBroadcast(bot->wake);
+    SDL_UnlockMutex(bot->lock);
 }
 
-// New function to ensure minimum number of fruits are present
-// New function to ensure minimum number of fruits are present
-void ensure_minimum_fruits(Food foods[], int count, Snake *snakeA, Snake *snakeB) {
-    int active_count = 0;
+// Wait for the search to finish and return the most visited action for the bot's snake
+int mcts_finish(MctsBot *bot) {
+    if (!bot->searching) return MCTS_STRAIGHT;
     
-    // Count active fruits
-    for (int i = 0; i < count; i++) {
-        if (foods[i].active) {
-            active_count++;
+    SDL_LockMutex(bot->lock);
+    while (bot->finished < bot->workerCount) {
+        SDL_CondWait(bot->done, bot->lock);
+    }
+    bot->searching = false;
+    SDL_UnlockMutex(bot->lock);
+    
+    int visits[MCTS_ACTIONS] = {0};
+    for (int i = 0; i < bot->workerCount; i++) {
+        MctsWorker *worker = &bot->workers[i];
+        for (int a = 0; a < MCTS_ACTIONS; a++) {
+            visits[a] += worker->search.nodes[0].visits[0][a];
         }
+        bot->rolloutCount += worker->rollouts;
     }
     
-    // Add more fruits if needed
-    while (active_count < FRUIT_COUNT) {
-        for (int i = 0; i < count; i++) {
-            if (!foods[i].active) {
-                place_food(&foods[i], snakeA, snakeB);
-                active_count++;
-                if (active_count >= FRUIT_COUNT) {
-                    break;
-                }
-            }
-        }
+    // Refresh the rollouts/sec figure about once a second
+    Uint32 now = SDL_GetTicks();
+    if (now - bot->statsStart >= 1000) {
+        bot->rolloutsPerSecond = bot->rolloutCount * 1000.0 / (now - bot->statsStart);
+        bot->rolloutCount = 0;
+        bot->statsStart = now;
     }
+    
+    return mcts_best_action(visits);
 }
 
-void grow_snake(Snake *snake) {
-    // Add a new segment at the current tail position
-    // This will be moved on the next frame
-    snake->body[snake->length] = snake->body[snake->length - 1];
-    snake->length++;
+// Stop and free the pool; also undoes a partly started one
+void mcts_shutdown(MctsBot *bot) {
+    if (bot->workerCount > 0) {
+        mcts_finish(bot);
+        
+        SDL_LockMutex(bot->lock);
+        bot->quit = true;
+        SDL_CondBroadcast(bot->wake);
+        SDL_UnlockMutex(bot->lock);
+    }
+    
+    for (int i = 0; i < bot->workerCount; i++) {
+        SDL_WaitThread(bot->workers[i].thread, NULL);
+        free(bot->workers[i].search.nodes);
+    }
+    if (bot->done) SDL_DestroyCond(bot->done);
+    if (bot->wake) SDL_DestroyCond(bot->wake);
+    if (bot->lock) SDL_DestroyMutex(bot->lock);
+    memset(bot, 0, sizeof(MctsBot));
 }
 
 void init_button(Button *button, int x, int y, const char *text) {
@@ -446,28 +631,31 @@ void draw_text_centered(SDL_Renderer *renderer, TTF_Font *font, const char *text
     SDL_DestroyTexture(texture);
 }
 
-void draw_welcome_screen(SDL_Renderer *renderer, Button *playButton, TTF_Font *font) {
+void draw_welcome_screen(SDL_Renderer *renderer, Button *playersButton, Button *playButton, Button *aiButton, TTF_Font *font) {
     // Draw background
     SDL_SetRenderDrawColor(renderer, 20, 20, 30, 255);
     SDL_RenderClear(renderer);
     
     // Draw title
     SDL_Color title_color = {255, 255, 100, 255};
-    draw_text_centered(renderer, font, "SNAKE BATTLE", WINDOW_WIDTH / 2, 100, title_color);
+    draw_text_centered(renderer, font, "SNAKE BATTLE", WINDOW_WIDTH / 2, 90, title_color);
     
     // Draw instructions
     SDL_Color text_color = {200, 200, 200, 255};
-    draw_text_centered(renderer, font, "Player A: WASD to move", WINDOW_WIDTH / 2, 180, text_color);
-    draw_text_centered(renderer, font, "Player B: Arrow keys to move", WINDOW_WIDTH / 2, 210, text_color);
-    draw_text_centered(renderer, font, "Game time: 2 minutes", WINDOW_WIDTH / 2, 240, text_color);
-    draw_text_centered(renderer, font, "Collect fruits to score points", WINDOW_WIDTH / 2, 270, text_color);
+    draw_text_centered(renderer, font, "Player A: WASD to move", WINDOW_WIDTH / 2, 150, text_color);
+    draw_text_centered(renderer, font, "Player B: Arrow keys to move (or the AI)", WINDOW_WIDTH / 2, 180, text_color);
+    draw_text_centered(renderer, font, "Players C, D: IJKL, numpad 8456", WINDOW_WIDTH / 2, 210, text_color);
+    draw_text_centered(renderer, font, "Bots fill any remaining snakes", WINDOW_WIDTH / 2, 240, text_color);
+    draw_text_centered(renderer, font, "Game time: 2 minutes", WINDOW_WIDTH / 2, 270, text_color);
     draw_text_centered(renderer, font, "Avoid walls and other snakes", WINDOW_WIDTH / 2, 300, text_color);
     
-    // Draw play button
+    // Draw play buttons
+    draw_button(renderer, playersButton, font);
     draw_button(renderer, playButton, font);
+    draw_button(renderer, aiButton, font);
 }
 
-void draw_game_over_screen(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB, Button *playAgainButton, Button *exitButton, TTF_Font *font) {
+void draw_game_over_screen(SDL_Renderer *renderer, Match *match, Button *playAgainButton, Button *exitButton, TTF_Font *font) {
     // Draw semi-transparent overlay
     SDL_SetRenderDrawColor(renderer, 0, 0, 0, 200);
     SDL_Rect overlay = {0, 0, WINDOW_WIDTH, WINDOW_HEIGHT};
@@ -477,22 +665,31 @@ void draw_game_over_screen(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB,
     SDL_Color title_color = {255, 100, 100, 255};
     draw_text_centered(renderer, font, "GAME OVER", WINDOW_WIDTH / 2, 100, title_color);
     
-    // Draw scores
+    // Draw scores, and find the single best one
     SDL_Color text_color = {255, 255, 255, 255};
     char score_text[100];
-    sprintf(score_text, "Player A: %d", snakeA->score);
-    draw_text_centered(renderer, font, score_text, WINDOW_WIDTH / 2, 150, snakeA->color);
-    
-    sprintf(score_text, "Player B: %d", snakeB->score);
-    draw_text_centered(renderer, font, score_text, WINDOW_WIDTH / 2, 180, snakeB->color);
+    int best = 0;
+    bool tied = false;
+    for (int i = 0; i < match->snakeCount; i++) {
+        Snake *snake = &match->snakes[i];
+        sprintf(score_text, "%s: %d", snake->name, snake->score);
+        draw_text_centered(renderer, font, score_text, WINDOW_WIDTH / 2, 150 + 28 * i, player_colors[i]);
+        
+        if (i > 0 && snake->score == match->snakes[best].score) {
+            tied = true;
+        } else if (snake->score > match->snakes[best].score) {
+            best = i;
+            tied = false;
+        }
+    }
     
     // Draw winner
-    if (snakeA->score > snakeB->score) {
-        draw_text_centered(renderer, font, "Player A Wins!", WINDOW_WIDTH / 2, 230, snakeA->color);
-    } else if (snakeB->score > snakeA->score) {
-        draw_text_centered(renderer, font, "Player B Wins!", WINDOW_WIDTH / 2, 230, snakeB->color);
+    int winner_y = 150 + 28 * match->snakeCount + 22;
+    if (tied) {
+        draw_text_centered(renderer, font, "It's a Draw!", WINDOW_WIDTH / 2, winner_y, text_color);
     } else {
-        draw_text_centered(renderer, font, "It's a Draw!", WINDOW_WIDTH / 2, 230, text_color);
+        sprintf(score_text, "%s Wins!", match->snakes[best].name);
+        draw_text_centered(renderer, font, score_text, WINDOW_WIDTH / 2, winner_y, player_colors[best]);
     }
     
     // Draw buttons
@@ -500,52 +697,714 @@ void draw_game_over_screen(SDL_Renderer *renderer, Snake *snakeA, Snake *snakeB,
     draw_button(renderer, exitButton, font);
 }
 
-void reset_game(Snake *snakeA, Snake *snakeB, Food foods[], int count) {
-    // Reset Snake A
-    snakeA->length = 3;
-    snakeA->dx = 1;
-    snakeA->dy = 0;
-    snakeA->alive = true;
-    snakeA->score = 0;
+// Start a new round with `snakeCount` snakes at their spawn points; returns the
+// seed, which a recording of the round needs
+Uint32 reset_game(Match *match, int snakeCount) {
+    Uint32 seed = (Uint32)rand();
+    match_reset(match, snakeCount, seed);
+    return seed;
+}
+
+// Record the round that is about to start, which reset_game() set up from `seed`,
+// to REPLAY_DIR/<date>-<time>-<seed>.snr. The game plays on if that fails.
+void start_recording(ReplayWriter *recording, const Match *match, Uint32 seed) {
+    mkdir(REPLAY_DIR, 0755); // Fails harmlessly once it exists
+
+    char stamp[32], path[96];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(path, sizeof(path), "%s/%s-%08x.snr", REPLAY_DIR, stamp, (unsigned)seed);
+    if (!replay_writer_open(recording, path, match, seed, true)) {
+        log_warn("Could not record this round to %s", path);
+    }
+}
+
+#ifdef MP_NET_AVAILABLE
+// UDP socket connected to "host[:port]", or -1
+static int client_connect(const char *server) {
+    char host[256];
+    char port[8];
+    snprintf(host, sizeof(host), "%s", server);
+    snprintf(port, sizeof(port), "%d", MP_DEFAULT_PORT);
+    
+    // A single colon separates the port; more than one is a bare IPv6 address
+    char *colon = strrchr(host, ':');
+    if (colon && colon == strchr(host, ':')) {
+        *colon = '\0';
+        snprintf(port, sizeof(port), "%s", colon + 1);
+    }
     
-    // Position Snake A at the left side of the grid
-    for (int i = 0; i < snakeA->length; i++) {
-        snakeA->body[i].x = 5 - i;
-        snakeA->body[i].y = 5;
+    struct addrinfo hints = {0};
+    struct addrinfo *addresses = NULL;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, port, &hints, &addresses) != 0) return -1;
+    
+    int fd = -1;
+    for (struct addrinfo *a = addresses; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
     }
+    freeaddrinfo(addresses);
     
-    // Reset Snake B
-    snakeB->length = 3;
-    snakeB->dx = -1;
-    snakeB->dy = 0;
-    snakeB->alive = true;
-    snakeB->score = 0;
+    if (fd >= 0 && !mp_set_nonblocking(fd)) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static void client_send_input(int fd, Uint32 session, int direction, Uint32 ack) {
+    Uint8 packet[12] = {MP_INPUT, (Uint8)direction, 0, 0};
+    mp_put32(packet + 4, session);
+    mp_put32(packet + 8, ack);
+    send(fd, packet, sizeof(packet), 0);
+}
+
+// Thin network client: key presses go to mp_server, and whatever state it sends
+// back is drawn. The match is never simulated here. Returns when the window is
+// closed or EXIT is clicked.
+void run_client(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *server, int players) {
+    int fd = client_connect(server);
+    if (fd < 0) {
+        log_error("Could not reach server %s", server);
+        return;
+    }
     
-    // Position Snake B at the right side of the grid
-    for (int i = 0; i < snakeB->length; i++) {
-        snakeB->body[i].x = GRID_WIDTH - 6 + i;
-        snakeB->body[i].y = GRID_HEIGHT - 6;
+    MpHistory *history = pool_alloc(&session_pool, sizeof(MpHistory));
+    if (history == NULL) {
+        close(fd);
+        return;
     }
+    Match match;
+    MpStateInfo info = {0, GAME_DURATION, MP_PHASE_WAITING, 0};
+    match_reset(&match, players, 1);
+    
+    // Connection state; a new nonce asks for a fresh seat
+    bool welcomed = false;
+    Uint32 nonce = (Uint32)rand() ^ SDL_GetTicks();
+    Uint32 session = 0;
+    Uint32 match_id = 0;
+    Uint32 newest = 0;     // Newest tick held, acknowledged with every input
+    int player = 0;
+    int direction = MP_DIR_NONE;
+    Uint32 join_time = 0;
+    Uint32 heard_time = SDL_GetTicks();
+    
+    Button playAgainButton, exitButton;
+    init_button(&playAgainButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 - 110, 420, "PLAY AGAIN");
+    init_button(&exitButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 + 110, 420, "EXIT");
     
-    // Reset all foods
-    for (int i = 0; i < count; i++) {
-        foods[i].active = false;
+    bool quit = false;
+    bool rejoin = false;
+    SDL_Event e;
+    Uint32 frame_time = SDL_GetTicks();
+    
+    while (!quit) {
+        bool over = welcomed && info.phase == MP_PHASE_OVER;
+        
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            else if (e.type == SDL_MOUSEMOTION && over) {
+                playAgainButton.hover = is_point_in_rect(e.motion.x, e.motion.y, &playAgainButton.rect);
+                exitButton.hover = is_point_in_rect(e.motion.x, e.motion.y, &exitButton.rect);
+            }
+            else if (e.type == SDL_MOUSEBUTTONDOWN && over) {
+                if (is_point_in_rect(e.button.x, e.button.y, &playAgainButton.rect)) {
+                    rejoin = true;
+                }
+                else if (is_point_in_rect(e.button.x, e.button.y, &exitButton.rect)) {
+                    quit = true;
+                }
+            }
+            else if (e.type == SDL_KEYDOWN && welcomed && info.phase == MP_PHASE_PLAYING) {
+                // Either of the first two layouts steers; the server rejects reversals
+                for (int layout = 0; layout < 2; layout++) {
+                    for (int k = 0; k < 4; k++) {
+                        if (e.key.keysym.sym == player_keys[layout][k]) direction = MP_DIR_UP + k;
+                    }
+                }
+                client_send_input(fd, session, direction, newest);
+            }
+        }
+        
+        Uint32 current_time = SDL_GetTicks();
+        
+        // Server gone quiet mid-match: start over with a new seat
+        if (welcomed && info.phase != MP_PHASE_OVER && current_time - heard_time > MP_TIMEOUT) {
+            log_warn("Lost connection to %s, rejoining", server);
+            rejoin = true;
+        }
+        if (rejoin) {
+            if (welcomed) {
+                Uint8 packet[8] = {MP_LEAVE, 0, 0, 0};
+                mp_put32(packet + 4, session);
+                send(fd, packet, sizeof(packet), 0);
+            }
+            welcomed = rejoin = false;
+            nonce++;
+            newest = 0;
+            direction = MP_DIR_NONE;
+            memset(history, 0, sizeof(MpHistory));
+            match_reset(&match, players, 1);
+            info = (MpStateInfo){0, GAME_DURATION, MP_PHASE_WAITING, 0};
+            join_time = 0;
+        }
+        
+        if (!welcomed && current_time - join_time >= MP_JOIN_INTERVAL) {
+            Uint8 packet[8] = {MP_JOIN, MP_PROTOCOL_VERSION, (Uint8)players, 0};
+            mp_put32(packet + 4, nonce);
+            send(fd, packet, sizeof(packet), 0);
+            join_time = current_time;
+        }
+        
+        // Everything that arrived since the last frame; only the newest state is drawn
+        Uint8 packet[MP_MAX_PACKET];
+        ssize_t length;
+        while ((length = recv(fd, packet, sizeof(packet), 0)) > 0) {
+            if (packet[0] == MP_WELCOME && length >= 16 && !welcomed && mp_get32(packet + 4) == nonce) {
+                welcomed = true;
+                player = packet[1];
+                session = mp_get32(packet + 8);
+                match_id = mp_get32(packet + 12);
+                heard_time = current_time;
+                
+                char title[96];
+                sprintf(title, "Multiplayer Snake Game - online as Player %c (match %u)", 'A' + player,
+                        (unsigned)match_id);
+                SDL_SetWindowTitle(window, title);
+            }
+            else if (packet[0] == MP_SNAPSHOT && welcomed) {
+                Uint32 tick;
+                const Uint8 *state = mp_read_snapshot(history, packet, (size_t)length, &tick);
+                if (state == NULL) continue;
+                heard_time = current_time;
+                
+                MpStateInfo decoded;
+                Match unpacked;
+                if (tick > newest && mp_unpack_state(state, &unpacked, &decoded)) {
+                    newest = tick;
+                    match = unpacked;
+                    info = decoded;
+                }
+                client_send_input(fd, session, direction, newest);
+            }
+        }
+        
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_match(renderer, &match, info.timeLeft, font);
+        
+        SDL_Color text_color = {255, 255, 255, 255};
+        char status[64] = "";
+        if (!welcomed) {
+            sprintf(status, "Connecting to %.40s...", server);
+        } else if (info.phase == MP_PHASE_WAITING) {
+            sprintf(status, "Waiting for players (%d/%d)", info.joined, match.snakeCount);
+        }
+        if (status[0]) {
+            draw_text_centered(renderer, font, status, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, text_color);
+        }
+        if (welcomed && info.phase == MP_PHASE_OVER) {
+            draw_game_over_screen(renderer, &match, &playAgainButton, &exitButton, font);
+        }
+        
+        SDL_RenderPresent(renderer);
+        metrics_frame();
+        report_match(&match, "ONLINE");
+        
+        // Cap frame rate
+        Uint32 frame_time_elapsed = SDL_GetTicks() - frame_time;
+        if (frame_time_elapsed < 16) { // Target ~60 FPS
+            SDL_Delay(16 - frame_time_elapsed);
+        }
+        frame_time = SDL_GetTicks();
     }
     
-    // Place initial fruits
-    ensure_minimum_fruits(foods, count, snakeA, snakeB);
+    if (welcomed) {
+        Uint8 packet[8] = {MP_LEAVE, 0, 0, 0};
+        mp_put32(packet + 4, session);
+        send(fd, packet, sizeof(packet), 0);
+    }
+    close(fd);
+    pool_reset(&session_pool);
+}
+
+// UDP socket bound to `port` on every interface, or -1. Like mp_server.c, it
+// takes IPv6 and IPv4 peers on one socket where the system allows it, and falls
+// back to IPv4 only.
+static int netplay_listen(int port) {
+    int fd = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (fd >= 0) {
+        int off = 0;
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        struct sockaddr_in6 address = {0};
+        address.sin6_family = AF_INET6;
+        address.sin6_addr = in6addr_any;
+        address.sin6_port = htons((uint16_t)port);
+        if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons((uint16_t)port);
+        if (fd >= 0 && bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd >= 0 && !mp_set_nonblocking(fd)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Peer-to-peer rollback netplay (rollback.h) between a host (`join` NULL, Player A)
+// and a joiner (Player B). Both run the match; nothing waits on the network unless
+// one peer gets ROLLBACK_WINDOW ticks ahead of what it has heard from the other.
+void run_netplay(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *join, int port) {
+    int fd = join ? client_connect(join) : netplay_listen(port);
+    if (fd < 0) {
+        log_error("Could not %s %s", join ? "reach" : "listen on port", join ? join : "");
+        return;
+    }
+    bool host = join == NULL;
+    bool peer_known = !host; // The host learns its peer from the first HELLO
+    
+    RollbackSession *session = pool_alloc(&session_pool, sizeof(RollbackSession));
+    if (session == NULL) {
+        close(fd);
+        return;
+    }
+    bool started = false;
+    bool finished = false;
+    int local = host ? 0 : 1;
+    rollback_init(session, local, 1, NETPLAY_INPUT_DELAY);
+    
+    // Key presses wait here for their tick, one turn per tick
+    int queued[NETPLAY_KEY_QUEUE];
+    int queued_count = 0;
+    
+    Button rematchButton, exitButton;
+    init_button(&rematchButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 - 110, 420, "REMATCH");
+    init_button(&exitButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 + 110, 420, "EXIT");
+    
+    Uint32 hello_time = 0;
+    Uint32 send_time = 0;
+    Uint32 heard_time = SDL_GetTicks();
+    Uint32 next_tick = 0;
+    Uint32 title_time = 0;
+    long title_rollbacks = 0;
+    Uint32 desync_game = 0; // Game whose desync has been reported
+    bool quit = false;
+    SDL_Event e;
+    Uint32 frame_time = SDL_GetTicks();
+    
+    while (!quit) {
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT) {
+                quit = true;
+            }
+            else if (e.type == SDL_MOUSEMOTION && finished) {
+                rematchButton.hover = is_point_in_rect(e.motion.x, e.motion.y, &rematchButton.rect);
+                exitButton.hover = is_point_in_rect(e.motion.x, e.motion.y, &exitButton.rect);
+            }
+            else if (e.type == SDL_MOUSEBUTTONDOWN && finished) {
+                if (is_point_in_rect(e.button.x, e.button.y, &rematchButton.rect)) {
+                    // The joiner asks again; the host waits to be asked
+                    started = finished = false;
+                    queued_count = 0;
+                    hello_time = 0;
+                }
+                else if (is_point_in_rect(e.button.x, e.button.y, &exitButton.rect)) {
+                    quit = true;
+                }
+            }
+            else if (e.type == SDL_KEYDOWN && started && queued_count < NETPLAY_KEY_QUEUE) {
+                for (int layout = 0; layout < 2; layout++) {
+                    for (int k = 0; k < 4; k++) {
+                        if (e.key.keysym.sym == player_keys[layout][k]) queued[queued_count++] = MP_DIR_UP + k;
+                    }
+                }
+            }
+        }
+        
+        Uint32 current_time = SDL_GetTicks();
+        
+        if (!host && !started && current_time - hello_time >= MP_JOIN_INTERVAL) {
+            Uint8 hello[4] = {ROLLBACK_HELLO, MP_PROTOCOL_VERSION, 0, 0};
+            send(fd, hello, sizeof(hello), 0);
+            hello_time = current_time;
+        }
+        
+        Uint8 packet[MP_MAX_PACKET];
+        struct sockaddr_storage from;
+        socklen_t from_length = sizeof(from);
+        ssize_t length;
+        while ((length = recvfrom(fd, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_length)) > 0) {
+            socklen_t peer_length = from_length; // An IPv4 peer on the IPv6 socket comes as a mapped address
+            from_length = sizeof(from);
+            
+            if (packet[0] == ROLLBACK_HELLO && host && length >= 2 && packet[1] == MP_PROTOCOL_VERSION) {
+                // Answer from now on only this peer
+                if (!peer_known && connect(fd, (struct sockaddr *)&from, peer_length) == 0) peer_known = true;
+                if (!started) {
+                    rollback_init(session, local, (Uint32)rand() | 1, NETPLAY_INPUT_DELAY);
+                    started = true;
+                    finished = false;
+                    next_tick = current_time;
+                }
+                Uint8 start[8] = {ROLLBACK_START, 0, 0, 0};
+                mp_put32(start + 4, session->game);
+                send(fd, start, sizeof(start), 0);
+                heard_time = current_time;
+            }
+            else if (packet[0] == ROLLBACK_START && !host && length >= 8) {
+                Uint32 game = mp_get32(packet + 4);
+                if (!started && game != session->game) {
+                    rollback_init(session, local, game, NETPLAY_INPUT_DELAY);
+                    started = true;
+                    finished = false;
+                    next_tick = current_time;
+                }
+                heard_time = current_time;
+            }
+            else if (started && rollback_read_inputs(session, packet, (size_t)length)) {
+                heard_time = current_time;
+            }
+        }
+        
+        if (started && session->desynced && desync_game != session->game) {
+            log_error("Desync: the other player's game differs from tick %u on", session->desyncTick);
+            desync_game = session->game;
+        }
+        
+        if (started && !finished) {
+            rollback_sync(session);
+            finished = rollback_finished(session);
+            
+            if (!finished && SDL_TICKS_PASSED(current_time, next_tick) && rollback_can_advance(session)) {
+                int direction = MP_DIR_NONE;
+                if (queued_count > 0) {
+                    direction = queued[0];
+                    memmove(queued, queued + 1, sizeof(int) * --queued_count);
+                }
+                rollback_advance(session, direction);
+                next_tick += rollback_tick_interval(session);
+                
+                // Don't try to catch up after a stall; just carry on from now
+                if (SDL_TICKS_PASSED(current_time, next_tick + MOVE_INTERVAL)) next_tick = current_time;
+                send_time = 0;
+            }
+            
+            if (current_time - heard_time > MP_TIMEOUT) {
+                log_warn("Lost the connection to the other player");
+                quit = true;
+            }
+        }
+        
+        // Every tick, and every so often while either side waits
+        if (started && peer_known && current_time - send_time >= NETPLAY_RESEND) {
+            Uint8 inputs[ROLLBACK_MAX_PACKET];
+            send(fd, inputs, rollback_write_inputs(session, inputs), 0);
+            send_time = current_time;
+        }
+        
+        if (started && current_time - title_time >= 1000) {
+            char title[128];
+            sprintf(title, "Multiplayer Snake Game - netplay as Player %c: %ld rollbacks/s, %ld ticks re-simulated",
+                    'A' + local, session->rollbacks - title_rollbacks, session->resimTicks);
+            SDL_SetWindowTitle(window, title);
+            title_rollbacks = session->rollbacks;
+            title_time = current_time;
+        }
+        
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_match(renderer, &session->match, GAME_DURATION - (int)session->tick * MOVE_INTERVAL, font);
+        
+        if (!started) {
+            SDL_Color text_color = {255, 255, 255, 255};
+            char status[64];
+            if (host) sprintf(status, "Waiting for a player on port %d...", port);
+            else sprintf(status, "Connecting to %.40s...", join);
+            draw_text_centered(renderer, font, status, WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, text_color);
+        }
+        else if (finished) {
+            draw_game_over_screen(renderer, &session->match, &rematchButton, &exitButton, font);
+        }
+        if (started && session->desynced) {
+            SDL_Color warning_color = {255, 80, 80, 255};
+            char warning[64];
+            sprintf(warning, "DESYNC since tick %u", session->desyncTick);
+            draw_text_centered(renderer, font, warning, WINDOW_WIDTH / 2, WINDOW_HEIGHT - 20, warning_color);
+        }
+        
+        SDL_RenderPresent(renderer);
+        metrics_frame();
+        report_match(&session->match, "NETPLAY");
+        
+        // Cap frame rate
+        Uint32 frame_time_elapsed = SDL_GetTicks() - frame_time;
+        if (frame_time_elapsed < 16) { // Target ~60 FPS
+            SDL_Delay(16 - frame_time_elapsed);
+        }
+        frame_time = SDL_GetTicks();
+    }
+    
+    close(fd);
+    pool_reset(&session_pool);
+}
+#endif
+
+// Lobby-screen viewer for the spectator feed of a game running on this machine.
+// Only reads shared memory, so any number of these can watch without the players
+// noticing. Returns when the window is closed.
+void run_spectator(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font) {
+    SpectateReader reader;
+    bool open = false;
+    bool watching = false; // A state has arrived since the feed was opened
+    Match match;
+    MpStateInfo info = {0, GAME_DURATION, MP_PHASE_WAITING, 0};
+    match_reset(&match, MIN_PLAYERS, 1);
+    
+    SDL_SetWindowTitle(window, "Multiplayer Snake Game - spectating");
+    
+    Uint32 retry_time = 0;
+    bool quit = false;
+    SDL_Event e;
+    Uint32 frame_time = SDL_GetTicks();
+    
+    while (!quit) {
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
+                quit = true;
+            }
+        }
+        
+        Uint32 current_time = SDL_GetTicks();
+        
+        // Follow the game across restarts: a closed feed is let go and looked for again
+        if (open && !spectate_live(&reader)) {
+            spectate_close_reader(&reader);
+            open = watching = false;
+        }
+        if (!open && current_time - retry_time >= 1000) {
+            open = spectate_open(&reader, SPECTATE_NAME);
+            retry_time = current_time;
+        }
+        if (open && spectate_poll(&reader, &match, &info)) {
+            watching = true;
+        }
+        
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_match(renderer, &match, info.timeLeft, font);
+        
+        SDL_Color text_color = {255, 255, 255, 255};
+        if (!watching) {
+            draw_text_centered(renderer, font, "Waiting for a game to start...", WINDOW_WIDTH / 2,
+                               WINDOW_HEIGHT / 2, text_color);
+        } else if (info.phase == MP_PHASE_OVER) {
+            draw_text_centered(renderer, font, "GAME OVER", WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, text_color);
+        }
+        
+        SDL_RenderPresent(renderer);
+        metrics_frame();
+        report_match(&match, "SPECTATE");
+        
+        // Cap frame rate
+        Uint32 frame_time_elapsed = SDL_GetTicks() - frame_time;
+        if (frame_time_elapsed < 16) { // Target ~60 FPS
+            SDL_Delay(16 - frame_time_elapsed);
+        }
+        frame_time = SDL_GetTicks();
+    }
+    
+    if (open) spectate_close_reader(&reader);
+}
+
+// Timeline of a replay, along the bottom of the UI area
+SDL_Rect scrub_bar_rect(void) {
+    SDL_Rect bar = {UI_PADDING, UI_HEIGHT - SCRUB_HEIGHT - 3, WINDOW_WIDTH - 2 * UI_PADDING, SCRUB_HEIGHT};
+    return bar;
+}
+
+// The part played so far, a mark at each keyframe and the playhead
+void draw_scrub_bar(SDL_Renderer *renderer, const ReplayPlayer *player) {
+    SDL_Rect bar = scrub_bar_rect();
+    Uint32 ticks = player->reader.ticks > 0 ? player->reader.ticks : 1;
+    
+    SDL_SetRenderDrawColor(renderer, 70, 70, 80, 255);
+    SDL_RenderFillRect(renderer, &bar);
+    
+    SDL_Rect played = bar;
+    played.w = (int)((Uint64)bar.w * player->tick / ticks);
+    SDL_SetRenderDrawColor(renderer, 170, 170, 190, 255);
+    SDL_RenderFillRect(renderer, &played);
+    
+    SDL_SetRenderDrawColor(renderer, 40, 40, 50, 255);
+    for (int k = 0; k < player->reader.keyframes; k++) {
+        int x = bar.x + (int)((Uint64)bar.w * player->reader.index[k].tick / ticks);
+        SDL_RenderDrawLine(renderer, x, bar.y, x, bar.y + bar.h - 1);
+    }
+    
+    SDL_Rect head = {bar.x + played.w - 2, bar.y - 3, 4, bar.h + 6};
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    SDL_RenderFillRect(renderer, &head);
+}
+
+// Tick under window column `x` of the timeline
+static Uint32 scrub_tick(const ReplayPlayer *player, int x) {
+    SDL_Rect bar = scrub_bar_rect();
+    if (x <= bar.x) return 0;
+    if (x >= bar.x + bar.w) return player->reader.ticks;
+    return (Uint32)((Uint64)player->reader.ticks * (Uint32)(x - bar.x) / (Uint32)bar.w);
+}
+
+// Watch a recording, such as one from REPLAY_DIR. Space pauses, the arrow keys skip and change
+// speed, Home and End jump to either end, and the timeline can be clicked or
+// dragged. Every jump starts from the nearest keyframe.
+void run_replay(SDL_Window *window, SDL_Renderer *renderer, TTF_Font *font, const char *path) {
+    static ReplayPlayer player;
+    if (!replay_player_open(&player, path)) {
+        log_error("%s is not a readable recording", path);
+        return;
+    }
+    const ReplayReader *reader = &player.reader;
+    log_info("Replaying %s: %d snakes, %u ticks, %d keyframes%s", path, reader->snakeCount, reader->ticks,
+             reader->keyframes, reader->complete ? "" : ", cut short");
+    
+    bool quit = false;
+    bool paused = false;
+    bool dragging = false;
+    int speed = 0;          // Power of two
+    float due = 0;          // Recorded ms waiting to be played
+    char title[160] = "";
+    SDL_Event e;
+    Uint32 frame_time = SDL_GetTicks();
+    Uint32 last_time = frame_time;
+    
+    while (!quit) {
+        while (SDL_PollEvent(&e) != 0) {
+            if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE)) {
+                quit = true;
+            }
+            else if (e.type == SDL_KEYDOWN) {
+                switch (e.key.keysym.sym) {
+                    case SDLK_SPACE:
+                        // At the end, play again from the start
+                        if (player.tick >= reader->ticks) replay_player_seek(&player, 0);
+                        else paused = !paused;
+                        break;
+                    case SDLK_LEFT:
+                        replay_player_seek(&player, player.tick > REPLAY_SKIP ? player.tick - REPLAY_SKIP : 0);
+                        break;
+                    case SDLK_RIGHT: replay_player_seek(&player, player.tick + REPLAY_SKIP); break;
+                    case SDLK_HOME: replay_player_seek(&player, 0); break;
+                    case SDLK_END: replay_player_seek(&player, reader->ticks); break;
+                    case SDLK_UP: if (speed < REPLAY_MAX_SPEED) speed++; break;
+                    case SDLK_DOWN: if (speed > REPLAY_MIN_SPEED) speed--; break;
+                }
+                due = 0;
+            }
+            else if (e.type == SDL_MOUSEBUTTONDOWN && e.button.y >= UI_HEIGHT - SCRUB_GRAB && e.button.y < UI_HEIGHT) {
+                dragging = true;
+                replay_player_seek(&player, scrub_tick(&player, e.button.x));
+            }
+            else if (e.type == SDL_MOUSEMOTION && dragging) {
+                replay_player_seek(&player, scrub_tick(&player, e.motion.x));
+            }
+            else if (e.type == SDL_MOUSEBUTTONUP) {
+                dragging = false;
+                due = 0;
+            }
+        }
+        
+        // Play what is due at the chosen speed
+        Uint32 current_time = SDL_GetTicks();
+        if (!paused && !dragging) {
+            due += (current_time - last_time) * ldexpf(1.0f, speed);
+            while (due >= MOVE_INTERVAL) {
+                due -= MOVE_INTERVAL;
+                if (!replay_player_step(&player)) {
+                    due = 0;
+                    break;
+                }
+            }
+        }
+        last_time = current_time;
+        
+        bool ended = player.tick >= reader->ticks;
+        char status[160];
+        sprintf(status, "Multiplayer Snake Game - replay %.80s, %gx%s", path, ldexp(1.0, speed),
+                ended ? ", end" : paused ? ", paused" : "");
+        if (strcmp(status, title) != 0) {
+            strcpy(title, status);
+            SDL_SetWindowTitle(window, title);
+        }
+        
+        int time_left = GAME_DURATION - (int)player.tick * MOVE_INTERVAL;
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+        SDL_RenderClear(renderer);
+        draw_match(renderer, &player.match, time_left > 0 ? time_left : 0, font);
+        draw_scrub_bar(renderer, &player);
+        
+        // The recording ends on a hash of the match; a different result means the
+        // rules changed since it was made, or the file is damaged
+        SDL_Color text_color = {255, 255, 255, 255};
+        if (reader->failed && reader->complete && !ended) {
+            draw_text_centered(renderer, font, "RECORDING DAMAGED", WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, text_color);
+        } else if (ended && reader->complete && match_hash(&player.match) != reader->hash) {
+            draw_text_centered(renderer, font, "OUT OF SYNC", WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, text_color);
+        } else if (ended) {
+            draw_text_centered(renderer, font, "END - SPACE TO WATCH AGAIN", WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2,
+                               text_color);
+        }
+        
+        SDL_RenderPresent(renderer);
+        metrics_frame();
+        report_match(&player.match, "REPLAY");
+        
+        // Cap frame rate
+        Uint32 frame_time_elapsed = SDL_GetTicks() - frame_time;
+        if (frame_time_elapsed < 16) { // Target ~60 FPS
+            SDL_Delay(16 - frame_time_elapsed);
+        }
+        frame_time = SDL_GetTicks();
+    }
+    
+    replay_player_close(&player);
 }
 
 int main(int argc, char *argv[]) {
+    log_init();
+    metrics_start("multiplayer");
+    if (!pool_init(&session_pool, SESSION_POOL_SIZE)) {
+        log_error("Could not reserve %d bytes for game state", SESSION_POOL_SIZE);
+        return 1;
+    }
+    
     // Initialize SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
+        log_error("SDL could not initialize! SDL_Error: %s", SDL_GetError());
         return 1;
     }
     
     // Initialize SDL_ttf
     if (TTF_Init() == -1) {
-        printf("SDL_ttf could not initialize! SDL_ttf Error: %s\n", TTF_GetError());
+        log_error("SDL_ttf could not initialize! SDL_ttf Error: %s", TTF_GetError());
         return 1;
     }
     
@@ -557,25 +1416,25 @@ int main(int argc, char *argv[]) {
                                          WINDOW_HEIGHT, 
                                          SDL_WINDOW_SHOWN);
     if (window == NULL) {
-        printf("Window could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Window could not be created! SDL_Error: %s", SDL_GetError());
         return 1;
     }
     
     // Create renderer
     SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
     if (renderer == NULL) {
-        printf("Renderer could not be created! SDL_Error: %s\n", SDL_GetError());
+        log_error("Renderer could not be created! SDL_Error: %s", SDL_GetError());
         return 1;
     }
     
     // Load font
     TTF_Font *font = TTF_OpenFont("font.ttf", 24);
     if (font == NULL) {
-        printf("Failed to load font! SDL_ttf Error: %s\n", TTF_GetError());
+        log_warn("Failed to load font! SDL_ttf Error: %s", TTF_GetError());
         // Try to load default font if first attempt fails
         font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 24);
         if (font == NULL) {
-            printf("Failed to load default font! SDL_ttf Error: %s\n", TTF_GetError());
+            log_error("Failed to load default font! SDL_ttf Error: %s", TTF_GetError());
             return 1;
         }
     }
@@ -583,56 +1442,89 @@ int main(int argc, char *argv[]) {
     // Seed random number generator
     srand(time(NULL));
     
-    // Initialize Snake A (WASD controls)
-    Snake snakeA;
-    snakeA.length = 3;
-    snakeA.dx = 1;
-    snakeA.dy = 0;
-    snakeA.alive = true;
-    snakeA.score = 0;
-    snakeA.color = (SDL_Color){50, 200, 50, 255}; // Green
-    strcpy(snakeA.name, "Player A");
+    // Watch the game another instance is running, or one recorded earlier
+    bool spectate = argc >= 2 && strcmp(argv[1], "--spectate") == 0;
+    bool replay = argc >= 3 && strcmp(argv[1], "--replay") == 0;
+    if (spectate || replay) {
+        if (spectate) run_spectator(window, renderer, font);
+        else run_replay(window, renderer, font, argv[2]);
+        
+        pool_destroy(&session_pool);
+        TTF_CloseFont(font);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+        return 0;
+    }
     
-    // Position Snake A at the left side of the grid
-    for (int i = 0; i < snakeA.length; i++) {
-        snakeA.body[i].x = 5 - i;
-        snakeA.body[i].y = 5;
+#ifdef MP_NET_AVAILABLE
+    // Online: the server runs the match and this process only draws it, or two
+    // peers each run it with rollback
+    bool online = argc >= 2 && (strcmp(argv[1], "--host") == 0 ||
+                                (argc >= 3 && (strcmp(argv[1], "--connect") == 0 || strcmp(argv[1], "--join") == 0)));
+    if (online) {
+        if (strcmp(argv[1], "--connect") == 0) {
+            int players = argc >= 4 ? atoi(argv[3]) : MIN_PLAYERS;
+            if (players < MIN_PLAYERS || players > MAX_PLAYERS) players = MIN_PLAYERS;
+            run_client(window, renderer, font, argv[2], players);
+        } else if (strcmp(argv[1], "--join") == 0) {
+            run_netplay(window, renderer, font, argv[2], 0);
+        } else {
+            run_netplay(window, renderer, font, NULL, argc >= 3 ? atoi(argv[2]) : MP_DEFAULT_PORT);
+        }
+        
+        pool_destroy(&session_pool);
+        TTF_CloseFont(font);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        TTF_Quit();
+        SDL_Quit();
+        return 0;
     }
+#endif
     
-    // Initialize Snake B (Arrow keys)
-    Snake snakeB;
-    snakeB.length = 3;
-    snakeB.dx = -1;
-    snakeB.dy = 0;
-    snakeB.alive = true;
-    snakeB.score = 0;
-    snakeB.color = (SDL_Color){50, 50, 200, 255}; // Blue
-    strcpy(snakeB.name, "Player B");
+    // Smaller text for the F3 overlay; the main font stands in if it is missing
+    TTF_Font *small_font = TTF_OpenFont("dejavu-fonts-ttf-2.37/ttf/DejaVuSans.ttf", 16);
     
-    // Position Snake B at the right side of the grid
-    for (int i = 0; i < snakeB.length; i++) {
-        snakeB.body[i].x = GRID_WIDTH - 6 + i;
-        snakeB.body[i].y = GRID_HEIGHT - 6;
-    }
+    // Two players until the menu says otherwise
+    Match match;
+    int player_count = MIN_PLAYERS;
+    Uint32 match_seed = reset_game(&match, player_count);
     
-    // Initialize foods
-    Food foods[FRUIT_COUNT * 2]; // Extra space for more fruits
-    for (int i = 0; i < FRUIT_COUNT * 2; i++) {
-        foods[i].active = false;
-    }
+    // The round being played, as it is recorded
+    static ReplayWriter recording;
+    Uint32 match_tick = 0;
     
-    // Place initial fruits
-    ensure_minimum_fruits(foods, FRUIT_COUNT * 2, &snakeA, &snakeB);
+    // Who steers each snake, set when a round starts
+    PlayerControl controls[MAX_PLAYERS];
+    Uint32 bot_rng = (Uint32)time(NULL) | 1;
+    
+    // Each local player's presses wait here for their tick; F3 shows how long they
+    // take to reach the screen
+    TurnQueue turns[HUMAN_PLAYERS] = {0};
+    static LatencyStats input_latency, frame_times;
+    bool show_profiler = false;
+    Uint32 last_present = 0;
     
     // Initialize buttons
-    Button playButton, playAgainButton, exitButton;
-    init_button(&playButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2, 350, "PLAY");
-    init_button(&playAgainButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 - 110, 300, "PLAY AGAIN");
-    init_button(&exitButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 + 110, 300, "EXIT");
+    Button playersButton, playButton, aiButton, playAgainButton, exitButton;
+    init_button(&playersButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2, 335, "SNAKES: 2");
+    init_button(&playButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2, 335 + BUTTON_HEIGHT + BUTTON_PADDING, "PLAY");
+    init_button(&aiButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2, 335 + 2 * (BUTTON_HEIGHT + BUTTON_PADDING), "PLAY VS AI");
+    init_button(&playAgainButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 - 110, 420, "PLAY AGAIN");
+    init_button(&exitButton, WINDOW_WIDTH / 2 - BUTTON_WIDTH / 2 + 110, 420, "EXIT");
     
     // Game state
     GameState state = MENU;
     
+    // Spectator feed (multiplayer --spectate); the game runs the same without one
+    SpectateWriter feed;
+    if (!spectate_create(&feed, SPECTATE_NAME)) {
+        log_info("No spectator feed: another game has it, or shared memory is unavailable");
+    }
+    bool feed_changed = false;
+    
     // Game loop variables
     bool quit = false;
     SDL_Event e;
@@ -642,6 +1534,12 @@ int main(int argc, char *argv[]) {
     Uint32 game_start_time = 0;
     int time_left = GAME_DURATION;
     
+    // AI opponent for Player B, started on first use
+    MctsBot bot;
+    bool bot_ready = false;
+    bool vs_ai = false;
+    Uint32 title_time = 0;
+    
     while (!quit) {
         // Handle events
         while (SDL_PollEvent(&e) != 0) {
@@ -653,7 +1551,9 @@ int main(int argc, char *argv[]) {
                 int mouse_y = e.motion.y;
                 
                 if (state == MENU) {
+                    playersButton.hover = is_point_in_rect(mouse_x, mouse_y, &playersButton.rect);
                     playButton.hover = is_point_in_rect(mouse_x, mouse_y, &playButton.rect);
+                    aiButton.hover = is_point_in_rect(mouse_x, mouse_y, &aiButton.rect);
                 }
                 else if (state == GAME_OVER) {
                     playAgainButton.hover = is_point_in_rect(mouse_x, mouse_y, &playAgainButton.rect);
@@ -665,16 +1565,51 @@ int main(int argc, char *argv[]) {
                 int mouse_y = e.button.y;
                 
                 if (state == MENU) {
-                    if (is_point_in_rect(mouse_x, mouse_y, &playButton.rect)) {
+                    // Cycle through 2..MAX_PLAYERS snakes
+                    if (is_point_in_rect(mouse_x, mouse_y, &playersButton.rect)) {
+                        player_count = player_count == MAX_PLAYERS ? MIN_PLAYERS : player_count + 1;
+                        sprintf(playersButton.text, "SNAKES: %d", player_count);
+                        match_seed = reset_game(&match, player_count);
+                    }
+                    
+                    bool human = is_point_in_rect(mouse_x, mouse_y, &playButton.rect);
+                    bool ai = is_point_in_rect(mouse_x, mouse_y, &aiButton.rect);
+                    
+                    if (ai && !bot_ready) {
+                        bot_ready = mcts_init(&bot, 1);
+                        if (!bot_ready) {
+                            log_error("Failed to start AI opponent! SDL_Error: %s", SDL_GetError());
+                            ai = false;
+                        }
+                    }
+                    
+                    if (human || ai) {
+                        // Local players take the first snakes (just A against the AI), bots the rest
+                        vs_ai = ai;
+                        for (int p = 0; p < player_count; p++) {
+                            bool local = ai ? p == 0 : p < HUMAN_PLAYERS;
+                            controls[p] = local ? CONTROL_KEYS : CONTROL_BOT;
+                        }
+                        if (ai) controls[1] = CONTROL_MCTS;
+                        for (int p = 0; p < HUMAN_PLAYERS; p++) turn_queue_clear(&turns[p]);
+                        start_recording(&recording, &match, match_seed);
+                        match_tick = 0;
                         state = PLAYING;
                         game_start_time = SDL_GetTicks();
+                        move_time = game_start_time;
+                        feed_changed = true;
                     }
                 }
                 else if (state == GAME_OVER) {
                     if (is_point_in_rect(mouse_x, mouse_y, &playAgainButton.rect)) {
-                        reset_game(&snakeA, &snakeB, foods, FRUIT_COUNT * 2);
+                        match_seed = reset_game(&match, player_count);
+                        for (int p = 0; p < HUMAN_PLAYERS; p++) turn_queue_clear(&turns[p]);
+                        start_recording(&recording, &match, match_seed);
+                        match_tick = 0;
                         state = PLAYING;
                         game_start_time = SDL_GetTicks();
+                        move_time = game_start_time;
+                        feed_changed = true;
                     }
                     else if (is_point_in_rect(mouse_x, mouse_y, &exitButton.rect)) {
                         quit = true;
@@ -682,59 +1617,23 @@ int main(int argc, char *argv[]) {
                 }
             }
             else if (e.type == SDL_KEYDOWN) {
-                      if (state == PLAYING) {
-                    // Player A controls (WASD)
-                    switch (e.key.keysym.sym) {
-                        case SDLK_w:
-                            if (snakeA.dy != 1) { // Prevent 180-degree turn
-                                snakeA.dx = 0;
-                                snakeA.dy = -1;
-                            }
-                            break;
-                        case SDLK_s:
-                            if (snakeA.dy != -1) {
-                                snakeA.dx = 0;
-                                snakeA.dy = 1;
-                            }
-                            break;
-                        case SDLK_a:
-                            if (snakeA.dx != 1) {
-                                snakeA.dx = -1;
-                                snakeA.dy = 0;
-                            }
-                            break;
-                        case SDLK_d:
-                            if (snakeA.dx != -1) {
-                                snakeA.dx = 1;
-                                snakeA.dy = 0;
-                            }
-                            break;
-                            
-                        // Player B controls (Arrow Keys)
-                        case SDLK_UP:
-                            if (snakeB.dy != 1) {
-                                snakeB.dx = 0;
-                                snakeB.dy = -1;
-                            }
-                            break;
-                        case SDLK_DOWN:
-                            if (snakeB.dy != -1) {
-                                snakeB.dx = 0;
-                                snakeB.dy = 1;
-                            }
-                            break;
-                        case SDLK_LEFT:
-                            if (snakeB.dx != 1) {
-                                snakeB.dx = -1;
-                                snakeB.dy = 0;
-                            }
-                            break;
-                        case SDLK_RIGHT:
-                            if (snakeB.dx != -1) {
-                                snakeB.dx = 1;
-                                snakeB.dy = 0;
-                            }
-                            break;
+                if (e.key.keysym.sym == SDLK_F3) {
+                    show_profiler = !show_profiler;
+                }
+                else if (state == PLAYING) {
+                    // Each local player's layout, queued for their next ticks; 180-degree turns are ignored
+                    for (int p = 0; p < match.snakeCount && p < HUMAN_PLAYERS; p++) {
+                        if (controls[p] != CONTROL_KEYS) continue;
+                        
+                        Snake *snake = &match.snakes[p];
+                        const SDL_Keycode *keys = player_keys[p];
+                        SDL_Keycode key = e.key.keysym.sym;
+                        for (int k = 0; k < 4; k++) {
+                            if (key != keys[k]) continue;
+                            int dx, dy;
+                            mp_direction_delta(MP_DIR_UP + k, &dx, &dy);
+                            turn_queue_push(&turns[p], snake->dx, snake->dy, dx, dy, e.key.timestamp);
+                        }
                     }
                 }
             }
@@ -751,80 +1650,119 @@ int main(int argc, char *argv[]) {
             if (time_left <= 0) {
                 state = GAME_OVER;
                 time_left = 0;
+                feed_changed = true;
+                replay_writer_close(&recording, match_tick, &match);
             }
             
             // Move snakes at a fixed rate (150ms)
-            if (current_time - move_time >= 150) {
+            if (state == PLAYING && current_time - move_time >= MOVE_INTERVAL) {
                 move_time = current_time;
+                uint64_t tick_start = metrics_clock();
+                alloc_watch_begin();
+                
+                // Let the AI steer Player B with the result of the search that ran during the last move
+                if (vs_ai && bot.searching) {
+                    apply_relative_move(&match.snakes[1], mcts_finish(&bot));
+                }
                 
-                // Move snakes
-                move_snake(&snakeA, &snakeB);
-                move_snake(&snakeB, &snakeA);
+                // One queued turn per local player
+                for (int p = 0; p < match.snakeCount && p < HUMAN_PLAYERS; p++) {
+                    Uint32 pressed;
+                    if (controls[p] == CONTROL_KEYS && match.snakes[p].alive &&
+                        turn_queue_take(&turns[p], &match.snakes[p].dx, &match.snakes[p].dy, &pressed)) {
+                        latency_turn_taken(&input_latency, pressed);
+                    }
+                }
                 
-                // Check for fruit collisions
-                for (int i = 0; i < FRUIT_COUNT * 2; i++) {
-                    if (foods[i].active) {
-                        // Check if Snake A ate food
-                        if (check_food_collision(&snakeA, &foods[i])) {
-                            foods[i].active = false;
-                            snakeA.score += 10;
-                            grow_snake(&snakeA);
-                        }
-                        // Check if Snake B ate food
-                        else if (check_food_collision(&snakeB, &foods[i])) {
-                            foods[i].active = false;
-                            snakeB.score += 10;
-                            grow_snake(&snakeB);
-                        }
+                // Bots decide on the board as it stands
+                for (int p = 0; p < match.snakeCount; p++) {
+                    if (controls[p] == CONTROL_BOT && match.snakes[p].alive) {
+                        apply_relative_move(&match.snakes[p], bot_action(&match, p, &bot_rng));
                     }
                 }
                 
+                // Every snake is steered; record the turns taken
+                replay_write_tick(&recording, match_tick, &match);
+                
+                // Move snakes, then check for fruit collisions
+                move_snakes(&match);
+                eat_foods(&match);
+                
                 // Ensure minimum number of fruits
-                ensure_minimum_fruits(foods, FRUIT_COUNT * 2, &snakeA, &snakeB);
+                ensure_minimum_fruits(&match);
+                match_tick++;
                 
-                // Check if game is over (both snakes dead)
-                if (!snakeA.alive && !snakeB.alive) {
+                // Check if game is over (every snake dead)
+                if (match_over(&match)) {
                     state = GAME_OVER;
+                    replay_writer_close(&recording, match_tick, &match);
                 }
+                feed_changed = true;
+                alloc_watch_end("a multiplayer tick");
+                metrics_tick(tick_start);
+            }
+            
+            // Search the next move in the background while this one plays out
+            if (state == PLAYING && vs_ai && match.snakes[1].alive && !bot.searching) {
+                SimState root;
+                sim_capture(&root, &match, time_left);
+                mcts_begin(&bot, &root, move_time + MOVE_INTERVAL - MCTS_TIME_MARGIN);
             }
         }
         
+        report_match(&match, vs_ai ? "VS AI" : "LOCAL");
+        
+        // Hand the tick to any spectators; this never waits on them
+        if (feed_changed) {
+            spectate_publish(&feed, &match, time_left, state == GAME_OVER ? MP_PHASE_OVER : MP_PHASE_PLAYING);
+            feed_changed = false;
+        }
+        
+        // Don't leave a search running once the round is over
+        if (state != PLAYING && bot_ready && bot.searching) {
+            mcts_finish(&bot);
+        }
+        
+        // Report the AI's search throughput in the title bar
+        if (vs_ai && state == PLAYING && current_time - title_time >= 1000) {
+            char title[96];
+            sprintf(title, "Multiplayer Snake Game - AI: %.0fk rollouts/s on %d threads",
+                    bot.rolloutsPerSecond / 1000.0, bot.workerCount);
+            SDL_SetWindowTitle(window, title);
+            title_time = current_time;
+        }
+        
         // Clear screen
         SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
         SDL_RenderClear(renderer);
         
         // Render based on game state
         if (state == MENU) {
-            draw_welcome_screen(renderer, &playButton, font);
+            draw_welcome_screen(renderer, &playersButton, &playButton, &aiButton, font);
         }
         else if (state == PLAYING) {
-            // Draw UI area with scores and timer
-            draw_score(renderer, &snakeA, &snakeB, time_left, font);
-            
-            // Draw grid
-            draw_grid(renderer);
-            
-            // Draw foods
-            draw_foods(renderer, foods, FRUIT_COUNT * 2);
-            
-            // Draw snakes
-            draw_snake(renderer, &snakeA);
-            draw_snake(renderer, &snakeB);
+            draw_match(renderer, &match, time_left, font);
         }
         else if (state == GAME_OVER) {
             // Draw the game screen in the background
-            draw_score(renderer, &snakeA, &snakeB, time_left, font);
-            draw_grid(renderer);
-            draw_foods(renderer, foods, FRUIT_COUNT * 2);
-            draw_snake(renderer, &snakeA);
-            draw_snake(renderer, &snakeB);
+            draw_match(renderer, &match, time_left, font);
             
             // Draw game over screen
-            draw_game_over_screen(renderer, &snakeA, &snakeB, &playAgainButton, &exitButton, font);
+            draw_game_over_screen(renderer, &match, &playAgainButton, &exitButton, font);
+        }
+        if (show_profiler) {
+            draw_profiler(renderer, small_font ? small_font : font, &input_latency, &frame_times);
         }
         
         // Update screen
         SDL_RenderPresent(renderer);
+        metrics_frame();
+        
+        // Every turn taken so far is on screen now
+        Uint32 present_time = SDL_GetTicks();
+        latency_presented(&input_latency, present_time);
+        if (last_present != 0) latency_record(&frame_times, present_time - last_present);
+        last_present = present_time;
         
         // Cap frame rate
         Uint32 frame_time_elapsed = SDL_GetTicks() - frame_time;
@@ -835,6 +1773,13 @@ int main(int argc, char *argv[]) {
     }
     
     // Clean up resources
+    if (bot_ready) {
+        mcts_shutdown(&bot);
+    }
+    replay_writer_close(&recording, match_tick, &match);
+    spectate_close(&feed, SPECTATE_NAME);
+    pool_destroy(&session_pool);
+    if (small_font) TTF_CloseFont(small_font);
     TTF_CloseFont(font);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
@@ -0,0 +1,159 @@
+#ifndef POOL_H
+#define POOL_H
+
+// Per-session memory. A Pool is one block taken from the heap when the program
+// starts; pool_alloc() hands out pieces of it by bumping an offset, and
+// pool_reset() gives all of them back at once. multiplayer.c takes the state of an
+// online or netplay session (snapshot history, rollback session) from its session
+// pool and resets the pool when the session ends, so that state never goes back to
+// malloc once play has started, and nothing is freed piece by piece. Local rounds
+// keep their state in fixed arrays and take nothing from the pool.
+//
+//   Pool pool;
+//   pool_init(&pool, 256 * 1024);
+//   MpHistory *history = pool_alloc(&pool, sizeof(MpHistory)); // zeroed
+//   ...
+//   pool_reset(&pool);
+//
+// Heap allocation counting, for test builds (-DSNAKE_ALLOC_HOOK, glibc only):
+// malloc, calloc, realloc and the aligned allocators (posix_memalign, aligned_alloc,
+// memalign, valloc, pvalloc) are interposed for the whole process, SDL included,
+// and count per thread. The code between
+//
+//   alloc_watch_begin();
+//   ...
+//   alloc_watch_end("tick");
+//
+// must not allocate on the calling thread; if it does the program logs how many
+// allocations there were and aborts. The games watch their tick while PLAYING.
+// Drawing is left out: SDL_ttf makes a surface and a texture for every text, every
+// frame. In normal builds the watch compiles to nothing.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "async_log.h"
+
+#define POOL_ALIGN _Alignof(max_align_t)
+
+typedef struct {
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    size_t peak; // Most ever in use, for sizing the pool
+} Pool;
+
+static inline bool pool_init(Pool *pool, size_t size) {
+    pool->base = malloc(size);
+    pool->size = pool->base ? size : 0;
+    pool->used = pool->peak = 0;
+    return pool->base != NULL;
+}
+
+static inline void pool_destroy(Pool *pool) {
+    free(pool->base);
+    pool->base = NULL;
+    pool->size = pool->used = 0;
+}
+
+// `size` zeroed bytes, aligned for any type, or NULL if the pool is full
+static inline void *pool_alloc(Pool *pool, size_t size) {
+    size_t start = (pool->used + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1);
+    if (start > pool->size || size > pool->size - start) {
+        log_error("Session pool exhausted: %zu bytes wanted, %zu of %zu in use", size, pool->used, pool->size);
+        return NULL;
+    }
+    pool->used = start + size;
+    if (pool->used > pool->peak) pool->peak = pool->used;
+    memset(pool->base + start, 0, size);
+    return pool->base + start;
+}
+
+// Everything pool_alloc() handed out is gone
+static inline void pool_reset(Pool *pool) {
+    pool->used = 0;
+}
+
+#if defined(SNAKE_ALLOC_HOOK) && defined(__GLIBC__)
+#include <errno.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *memory, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void *__libc_valloc(size_t size);
+extern void *__libc_pvalloc(size_t size);
+extern void __libc_free(void *memory);
+
+static _Thread_local unsigned long alloc_count; // Heap allocations made by this thread
+static _Thread_local unsigned long alloc_watch_start;
+
+void *malloc(size_t size) {
+    alloc_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    alloc_count++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *memory, size_t size) {
+    alloc_count++;
+    return __libc_realloc(memory, size);
+}
+
+int posix_memalign(void **memory, size_t alignment, size_t size) {
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) return EINVAL;
+    alloc_count++;
+    void *block = __libc_memalign(alignment, size);
+    if (block == NULL) return ENOMEM;
+    *memory = block;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    alloc_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+    alloc_count++;
+    return __libc_memalign(alignment, size);
+}
+
+void *valloc(size_t size) {
+    alloc_count++;
+    return __libc_valloc(size);
+}
+
+void *pvalloc(size_t size) {
+    alloc_count++;
+    return __libc_pvalloc(size);
+}
+
+void free(void *memory) {
+    __libc_free(memory);
+}
+
+static inline void alloc_watch_begin(void) {
+    alloc_watch_start = alloc_count;
+}
+
+static inline void alloc_watch_end(const char *what) {
+    unsigned long count = alloc_count - alloc_watch_start;
+    if (count > 0) {
+        log_error("%lu heap allocation%s during %s", count, count == 1 ? "" : "s", what);
+        log_shutdown();
+        abort();
+    }
+}
+#else
+static inline void alloc_watch_begin(void) {}
+static inline void alloc_watch_end(const char *what) { (void)what; }
+#endif
+
+#endif
@@ -0,0 +1,760 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+// Recorded matches: the seed and every change of direction of every snake, which
+// is all mp_rules.h needs to play a match again tick for tick, plus a keyframe of
+// the full state every REPLAY_KEYFRAME_TICKS so playback can jump anywhere.
+//
+// Snakes hold their heading for many ticks between turns, so a recording is a list
+// of events (tick, snake, new direction) with each tick stored as the distance from
+// the previous event. There are two ways to code the events:
+//
+//   raw      one varint per event: delta << 5 | snake << 2 | (direction - 1)
+//   entropy  a binary range coder with adaptive bit models: the tick delta as its
+//            bit length and then its bits, the snake given the previous event's
+//            snake, and the direction given that snake's current heading. A turn
+//            can only go left or right, so a direction costs about one bit.
+//
+// The encoder and decoder both stream: events are gathered into chunks of at most
+// REPLAY_CHUNK_SIZE bytes, and a chunk is written out when it is full or
+// REPLAY_FLUSH_TICKS ticks have passed, so a crash loses at most about a minute.
+// The range coder restarts with every chunk, but the models carry over until the
+// next keyframe. Decoding can start at any keyframe, since the models, the tick
+// the deltas count from and the headings all start over there.
+//
+// File layout (little-endian):
+//   header    "SNRP", version, flags, snakeCount, 0, seed:u32, started:u32 (unix time)
+//   chunk     events:u16, length:u16, payload[length]
+//   keyframe  a chunk of 0 events: 'K', tick:u32, rng:u32, then the mp_pack_state()
+//             of the match, mp_rle_encode()d
+//   end       a chunk of 0 events: 'E', ticks:u32, hash:u64, the match_hash() after
+//             the last tick, which a player checks its result against
+//   index     ticks:u32, hash:u64, count:u32, (tick:u32, offset:u32) per keyframe
+//   trailer   offset of the index:u32, "SNRI"
+//
+// Tick t is the t-th move of the match. An event at tick t sets the snake's
+// heading just before that move. A keyframe at tick t comes after the events of
+// that tick and holds the match after t moves, steered for the next one; the seed
+// stands in for one at tick 0. A file cut short, say by a crash, has no index, and
+// the reader finds the keyframes by walking the chunk headers instead.
+
+#include "mp_net.h"
+
+#include <stdio.h>
+
+#define REPLAY_MAGIC "SNRP"
+#define REPLAY_INDEX_MAGIC "SNRI"
+#define REPLAY_VERSION 3
+#define REPLAY_HEADER 16
+#define REPLAY_CHUNK_HEADER 4
+#define REPLAY_CHUNK_SIZE 4096    // Payload bytes per chunk at most
+#define REPLAY_EVENT_MAX 16       // Worst-case bytes one event adds to a payload
+#define REPLAY_FLUSH_TICKS 400    // Ticks between chunks at the latest (a minute of play)
+#define REPLAY_KEYFRAME_TICKS 400 // Ticks between keyframes; a seek re-simulates fewer
+#define REPLAY_INDEX_SIZE 1024    // Keyframes indexed at most, 17 hours at one a minute
+#define REPLAY_KEYFRAME_HEADER 9  // 'K', tick, rng
+#define REPLAY_END_SIZE 13
+#define REPLAY_TRAILER 8
+
+// Payloads of chunks without events start with one of these
+#define REPLAY_KEYFRAME 'K'
+#define REPLAY_END 'E'
+
+// Header flags
+#define REPLAY_ENTROPY 0x01 // Payloads are range coded
+
+// Range coder, as in LZMA: 11-bit probabilities that adapt by 1/32 per bit
+#define REPLAY_PROB_BITS 11
+#define REPLAY_PROB_ONE (1 << REPLAY_PROB_BITS)
+#define REPLAY_PROB_SHIFT 5
+#define REPLAY_TOP (1u << 24)
+
+typedef struct {
+    uint32_t tick;
+    int snake;
+    MpDirection direction;
+} ReplayEvent;
+
+// Adaptive models, one per coding decision, shared by the encoder and decoder
+typedef struct {
+    uint16_t deltaLength[32];     // Bit length of delta + 1, as a 5-bit tree
+    uint16_t deltaBits[33][32];   // The bits below the top one, by length and position
+    uint16_t snake[MAX_PLAYERS][8];   // 3-bit tree, by the previous event's snake
+    uint16_t direction[4][4];     // 2-bit tree, by the snake's current heading
+} ReplayModel;
+
+typedef struct {
+    uint64_t low;
+    uint32_t range;
+    uint8_t cache;
+    uint64_t cacheSize;
+    uint8_t *out;
+    size_t length;
+} ReplayEncoder;
+
+typedef struct {
+    uint32_t range;
+    uint32_t code;
+    const uint8_t *in;
+    size_t length;
+    size_t position;
+} ReplayDecoder;
+
+// Where decoding can start
+typedef struct {
+    uint32_t tick;
+    uint32_t offset; // Of the keyframe chunk, from the start of the file
+} ReplayKeyframe;
+
+// What coding an event needs to know about the ones before it
+typedef struct {
+    ReplayModel model;
+    uint32_t tick;               // Tick of the previous event
+    int snake;                   // Snake of the previous event
+    uint8_t heading[MAX_PLAYERS]; // Current MpDirection of every snake
+} ReplayContext;
+
+typedef struct {
+    FILE *file;
+    uint8_t flags;
+    int snakeCount;
+    ReplayContext context;
+    uint32_t chunkTick;          // Tick the current chunk started on
+    int chunkEvents;
+    ReplayEncoder encoder;
+    uint8_t chunk[REPLAY_CHUNK_SIZE + REPLAY_EVENT_MAX];
+    uint8_t state[MP_STATE_SIZE]; // Keyframe being packed
+    ReplayKeyframe index[REPLAY_INDEX_SIZE];
+    int keyframes;
+    char stdioBuffer[BUFSIZ];    // So writing never allocates mid-game
+    long bytes;                  // Written so far
+    long keyframeBytes;          // Of which keyframes
+} ReplayWriter;
+
+typedef struct {
+    FILE *file;
+    uint8_t flags;
+    int snakeCount;
+    uint32_t seed;
+    uint32_t started;
+    ReplayContext context;
+    int chunkEvents;             // Events left in the current chunk
+    ReplayDecoder decoder;
+    uint8_t chunk[REPLAY_CHUNK_SIZE];
+    size_t chunkLength;
+    bool ended;                  // The end chunk has been read
+    bool failed;                 // The file is truncated or malformed
+    bool complete;               // The file has its end chunk, so `ticks` is known up front
+    uint32_t ticks;              // From the end chunk or the index
+    uint64_t hash;               // From the end chunk
+    uint8_t state[MP_STATE_SIZE]; // Packed match of the last keyframe read
+    uint32_t keyframeTick;
+    uint32_t keyframeRng;
+    ReplayKeyframe index[REPLAY_INDEX_SIZE];
+    int keyframes;
+} ReplayReader;
+
+static inline void replay_put64(uint8_t *p, uint64_t v) {
+    mp_put32(p, (uint32_t)v);
+    mp_put32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline uint64_t replay_get64(const uint8_t *p) {
+    return (uint64_t)mp_get32(p) | (uint64_t)mp_get32(p + 4) << 32;
+}
+
+static inline void replay_context_init(ReplayContext *context, int snakeCount) {
+    uint16_t *probs = (uint16_t *)&context->model;
+    for (size_t i = 0; i < sizeof(ReplayModel) / sizeof(uint16_t); i++) probs[i] = REPLAY_PROB_ONE / 2;
+    context->tick = 0;
+    context->snake = 0;
+    for (int p = 0; p < MAX_PLAYERS; p++) {
+        context->heading[p] = p < snakeCount ? (uint8_t)mp_direction(player_spawns[p][2], player_spawns[p][3]) : MP_DIR_UP;
+    }
+}
+
+// Models and headings start over at a keyframe; `state` is its packed match
+static inline void replay_context_keyframe(ReplayContext *context, uint32_t tick, const uint8_t *state) {
+    int snakeCount = state[9];
+    replay_context_init(context, snakeCount);
+    context->tick = tick;
+    for (int p = 0; p < snakeCount; p++) {
+        uint8_t heading = state[MP_STATE_HEADER + p * MP_SNAKE_BYTES + 1];
+        if (heading != MP_DIR_NONE && heading <= MP_DIR_RIGHT) context->heading[p] = heading;
+    }
+}
+
+// Range encoder
+
+static inline void replay_encoder_start(ReplayEncoder *encoder, uint8_t *out) {
+    encoder->low = 0;
+    encoder->range = 0xffffffffu;
+    encoder->cache = 0;
+    encoder->cacheSize = 1;
+    encoder->out = out;
+    encoder->length = 0;
+}
+
+static inline void replay_shift_low(ReplayEncoder *encoder) {
+    if ((uint32_t)encoder->low < 0xff000000u || (encoder->low >> 32) != 0) {
+        uint8_t carry = (uint8_t)(encoder->low >> 32);
+        uint8_t byte = encoder->cache;
+        do {
+            encoder->out[encoder->length++] = (uint8_t)(byte + carry);
+            byte = 0xff;
+        } while (--encoder->cacheSize != 0);
+        encoder->cache = (uint8_t)(encoder->low >> 24);
+    }
+    encoder->cacheSize++;
+    encoder->low = (encoder->low & 0x00ffffffu) << 8;
+}
+
+static inline void replay_encode_bit(ReplayEncoder *encoder, uint16_t *prob, int bit) {
+    uint32_t bound = (encoder->range >> REPLAY_PROB_BITS) * *prob;
+    if (bit == 0) {
+        encoder->range = bound;
+        *prob += (REPLAY_PROB_ONE - *prob) >> REPLAY_PROB_SHIFT;
+    } else {
+        encoder->low += bound;
+        encoder->range -= bound;
+        *prob -= *prob >> REPLAY_PROB_SHIFT;
+    }
+    while (encoder->range < REPLAY_TOP) {
+        encoder->range <<= 8;
+        replay_shift_low(encoder);
+    }
+}
+
+// `bits` bits of `value`, most significant first, down a tree of 1 << bits probabilities
+static inline void replay_encode_tree(ReplayEncoder *encoder, uint16_t *probs, int bits, uint32_t value) {
+    uint32_t node = 1;
+    for (int i = bits - 1; i >= 0; i--) {
+        int bit = (int)(value >> i) & 1;
+        replay_encode_bit(encoder, &probs[node], bit);
+        node = node << 1 | (uint32_t)bit;
+    }
+}
+
+static inline size_t replay_encoder_finish(ReplayEncoder *encoder) {
+    for (int i = 0; i < 5; i++) replay_shift_low(encoder);
+    return encoder->length;
+}
+
+// Range decoder; reading past the payload gives zeros and is caught by the caller
+
+static inline uint8_t replay_decoder_byte(ReplayDecoder *decoder) {
+    return decoder->position < decoder->length ? decoder->in[decoder->position++] : (decoder->position++, 0);
+}
+
+static inline void replay_decoder_start(ReplayDecoder *decoder, const uint8_t *in, size_t length) {
+    decoder->in = in;
+    decoder->length = length;
+    decoder->position = 0;
+    decoder->range = 0xffffffffu;
+    decoder->code = 0;
+    for (int i = 0; i < 5; i++) decoder->code = decoder->code << 8 | replay_decoder_byte(decoder);
+}
+
+static inline int replay_decode_bit(ReplayDecoder *decoder, uint16_t *prob) {
+    uint32_t bound = (decoder->range >> REPLAY_PROB_BITS) * *prob;
+    int bit;
+    if (decoder->code < bound) {
+        decoder->range = bound;
+        *prob += (REPLAY_PROB_ONE - *prob) >> REPLAY_PROB_SHIFT;
+        bit = 0;
+    } else {
+        decoder->code -= bound;
+        decoder->range -= bound;
+        *prob -= *prob >> REPLAY_PROB_SHIFT;
+        bit = 1;
+    }
+    while (decoder->range < REPLAY_TOP) {
+        decoder->range <<= 8;
+        decoder->code = decoder->code << 8 | replay_decoder_byte(decoder);
+    }
+    return bit;
+}
+
+static inline uint32_t replay_decode_tree(ReplayDecoder *decoder, uint16_t *probs, int bits) {
+    uint32_t node = 1;
+    for (int i = 0; i < bits; i++) node = node << 1 | (uint32_t)replay_decode_bit(decoder, &probs[node]);
+    return node - (1u << bits);
+}
+
+// Events
+
+static inline size_t replay_put_varint(uint8_t *out, uint64_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+static inline void replay_encode_event(ReplayContext *context, ReplayEncoder *encoder, const ReplayEvent *event) {
+    ReplayModel *model = &context->model;
+    uint32_t value = event->tick - context->tick + 1;
+    int length = 32 - __builtin_clz(value);
+    replay_encode_tree(encoder, model->deltaLength, 5, (uint32_t)(length - 1));
+    for (int i = length - 2; i >= 0; i--) {
+        replay_encode_bit(encoder, &model->deltaBits[length][i], (int)(value >> i) & 1);
+    }
+    replay_encode_tree(encoder, model->snake[context->snake], 3, (uint32_t)event->snake);
+    replay_encode_tree(encoder, model->direction[context->heading[event->snake] - 1], 2,
+                       (uint32_t)(event->direction - 1));
+}
+
+static inline void replay_decode_event(ReplayContext *context, ReplayDecoder *decoder, ReplayEvent *event) {
+    ReplayModel *model = &context->model;
+    int length = (int)replay_decode_tree(decoder, model->deltaLength, 5) + 1;
+    uint32_t value = 1;
+    for (int i = length - 2; i >= 0; i--) {
+        value = value << 1 | (uint32_t)replay_decode_bit(decoder, &model->deltaBits[length][i]);
+    }
+    event->tick = context->tick + value - 1;
+    event->snake = (int)replay_decode_tree(decoder, model->snake[context->snake], 3);
+    event->direction = (MpDirection)(replay_decode_tree(decoder, model->direction[context->heading[event->snake] - 1], 2) + 1);
+}
+
+// The event has been coded; later ones are coded relative to it
+static inline void replay_context_update(ReplayContext *context, const ReplayEvent *event) {
+    context->tick = event->tick;
+    context->snake = event->snake;
+    context->heading[event->snake] = (uint8_t)event->direction;
+}
+
+// Writer
+
+static inline void replay_write_chunk(ReplayWriter *writer, int events, const uint8_t *payload, size_t length) {
+    uint8_t header[REPLAY_CHUNK_HEADER];
+    mp_put16(header, (uint16_t)events);
+    mp_put16(header + 2, (uint16_t)length);
+    fwrite(header, 1, sizeof(header), writer->file);
+    fwrite(payload, 1, length, writer->file);
+    writer->bytes += (long)(sizeof(header) + length);
+}
+
+static inline void replay_chunk_start(ReplayWriter *writer, uint32_t tick) {
+    writer->chunkTick = tick;
+    writer->chunkEvents = 0;
+    replay_encoder_start(&writer->encoder, writer->chunk);
+}
+
+// Write out the events gathered so far, if any
+static inline void replay_flush(ReplayWriter *writer, uint32_t tick) {
+    if (writer->file == NULL) return;
+    if (writer->chunkEvents > 0) {
+        size_t length = writer->flags & REPLAY_ENTROPY ? replay_encoder_finish(&writer->encoder) : writer->encoder.length;
+        replay_write_chunk(writer, writer->chunkEvents, writer->chunk, length);
+        fflush(writer->file);
+    }
+    replay_chunk_start(writer, tick);
+}
+
+// Start recording a match that match_reset() has just set up from `seed`. Returns
+// false if the file could not be created.
+static inline bool replay_writer_open(ReplayWriter *writer, const char *path, const Match *match, uint32_t seed,
+                                      bool entropy) {
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) return false;
+    setvbuf(writer->file, writer->stdioBuffer, _IOFBF, sizeof(writer->stdioBuffer));
+
+    writer->flags = entropy ? REPLAY_ENTROPY : 0;
+    writer->snakeCount = match->snakeCount;
+    replay_context_init(&writer->context, match->snakeCount);
+
+    uint8_t header[REPLAY_HEADER] = {0};
+    memcpy(header, REPLAY_MAGIC, 4);
+    header[4] = REPLAY_VERSION;
+    header[5] = writer->flags;
+    header[6] = (uint8_t)match->snakeCount;
+    mp_put32(header + 8, seed);
+    mp_put32(header + 12, (uint32_t)time(NULL));
+    fwrite(header, 1, sizeof(header), writer->file);
+    writer->bytes = REPLAY_HEADER;
+    replay_chunk_start(writer, 0);
+    return true;
+}
+
+// Store the match as the keyframe for `tick` and start the event models over
+static inline void replay_write_keyframe(ReplayWriter *writer, uint32_t tick, const Match *match) {
+    replay_flush(writer, tick);
+
+    MpStateInfo info = {tick, GAME_DURATION - (int)tick * MOVE_INTERVAL, MP_PHASE_PLAYING, match->snakeCount};
+    mp_pack_state(match, &info, writer->state);
+    uint8_t *payload = writer->chunk;
+    payload[0] = REPLAY_KEYFRAME;
+    mp_put32(payload + 1, tick);
+    mp_put32(payload + 5, match->rng);
+    size_t length = REPLAY_KEYFRAME_HEADER + mp_rle_encode(writer->state, MP_STATE_SIZE, payload + REPLAY_KEYFRAME_HEADER,
+                                                           REPLAY_CHUNK_SIZE - REPLAY_KEYFRAME_HEADER);
+
+    if (writer->keyframes < REPLAY_INDEX_SIZE) {
+        writer->index[writer->keyframes++] = (ReplayKeyframe){tick, (uint32_t)writer->bytes};
+    }
+    replay_write_chunk(writer, 0, payload, length);
+    writer->keyframeBytes += (long)(REPLAY_CHUNK_HEADER + length);
+    replay_context_keyframe(&writer->context, tick, writer->state);
+    replay_chunk_start(writer, tick);
+}
+
+// Record tick `tick`: call once per move, after the snakes have been steered and
+// before they move. Only headings that changed since the last call are stored.
+static inline void replay_write_tick(ReplayWriter *writer, uint32_t tick, const Match *match) {
+    if (writer->file == NULL) return;
+
+    for (int p = 0; p < writer->snakeCount; p++) {
+        MpDirection direction = mp_direction(match->snakes[p].dx, match->snakes[p].dy);
+        if (direction == MP_DIR_NONE || direction == writer->context.heading[p]) continue;
+
+        ReplayEvent event = {tick, p, direction};
+        if (writer->flags & REPLAY_ENTROPY) {
+            replay_encode_event(&writer->context, &writer->encoder, &event);
+        } else {
+            uint64_t token = (uint64_t)(tick - writer->context.tick) << 5 | (uint64_t)p << 2 | (uint64_t)(direction - 1);
+            writer->encoder.length += replay_put_varint(writer->chunk + writer->encoder.length, token);
+        }
+        replay_context_update(&writer->context, &event);
+        writer->chunkEvents++;
+
+        // The range coder holds back a few bytes, so leave room for them
+        if (writer->encoder.length + writer->encoder.cacheSize + REPLAY_EVENT_MAX > REPLAY_CHUNK_SIZE ||
+            writer->chunkEvents == 0xffff) {
+            replay_flush(writer, tick);
+        }
+    }
+    if (tick > 0 && tick % REPLAY_KEYFRAME_TICKS == 0) replay_write_keyframe(writer, tick, match);
+    else if (tick - writer->chunkTick >= REPLAY_FLUSH_TICKS) replay_flush(writer, tick);
+}
+
+// Finish the recording after `ticks` moves. Does nothing if it is not open.
+static inline void replay_writer_close(ReplayWriter *writer, uint32_t ticks, const Match *match) {
+    if (writer->file == NULL) return;
+    replay_flush(writer, ticks);
+
+    uint8_t end[REPLAY_END_SIZE];
+    uint64_t hash = match_hash(match);
+    end[0] = REPLAY_END;
+    mp_put32(end + 1, ticks);
+    replay_put64(end + 5, hash);
+    replay_write_chunk(writer, 0, end, sizeof(end));
+
+    uint32_t indexOffset = (uint32_t)writer->bytes;
+    uint8_t field[16];
+    mp_put32(field, ticks);
+    replay_put64(field + 4, hash);
+    mp_put32(field + 12, (uint32_t)writer->keyframes);
+    fwrite(field, 1, 16, writer->file);
+    for (int k = 0; k < writer->keyframes; k++) {
+        mp_put32(field, writer->index[k].tick);
+        mp_put32(field + 4, writer->index[k].offset);
+        fwrite(field, 1, 8, writer->file);
+    }
+    mp_put32(field, indexOffset);
+    memcpy(field + 4, REPLAY_INDEX_MAGIC, 4);
+    fwrite(field, 1, REPLAY_TRAILER, writer->file);
+    writer->bytes += 16 + 8 * writer->keyframes + REPLAY_TRAILER;
+
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+// Reader
+
+// Keyframe k is at tick (k + 1) * REPLAY_KEYFRAME_TICKS, so the keyframes found
+// bound how long the match can have been; this catches a damaged tick count
+static inline bool replay_ticks_plausible(const ReplayReader *reader, uint32_t ticks) {
+    if (reader->keyframes == REPLAY_INDEX_SIZE) return true;
+    return ticks <= (uint32_t)(reader->keyframes + 1) * REPLAY_KEYFRAME_TICKS &&
+           (reader->keyframes == 0 || ticks >= reader->index[reader->keyframes - 1].tick);
+}
+
+// Read the index at the end of the file. Returns false if there is none.
+static inline bool replay_read_index(ReplayReader *reader) {
+    uint8_t field[16];
+    if (fseek(reader->file, -REPLAY_TRAILER, SEEK_END) != 0 ||
+        fread(field, 1, REPLAY_TRAILER, reader->file) != REPLAY_TRAILER ||
+        memcmp(field + 4, REPLAY_INDEX_MAGIC, 4) != 0) {
+        return false;
+    }
+    uint32_t offset = mp_get32(field);
+    if (fseek(reader->file, (long)offset, SEEK_SET) != 0 || fread(field, 1, 16, reader->file) != 16) return false;
+
+    uint32_t count = mp_get32(field + 12);
+    if (count > REPLAY_INDEX_SIZE) return false;
+    for (uint32_t k = 0; k < count; k++) {
+        uint8_t entry[8];
+        if (fread(entry, 1, 8, reader->file) != 8) return false;
+        reader->index[k] = (ReplayKeyframe){mp_get32(entry), mp_get32(entry + 4)};
+        if (reader->index[k].tick != (k + 1) * REPLAY_KEYFRAME_TICKS || reader->index[k].offset < REPLAY_HEADER ||
+            reader->index[k].offset >= offset) {
+            return false;
+        }
+    }
+    reader->keyframes = (int)count;
+    reader->ticks = mp_get32(field);
+    reader->hash = replay_get64(field + 4);
+    return replay_ticks_plausible(reader, reader->ticks);
+}
+
+// Find the keyframes and the end by walking the chunk headers, for a file that was
+// never closed. Such a file can only be played as far as its last keyframe.
+static inline void replay_scan(ReplayReader *reader) {
+    reader->keyframes = 0;
+    long offset = REPLAY_HEADER;
+    uint8_t header[REPLAY_CHUNK_HEADER], marker[REPLAY_END_SIZE];
+    fseek(reader->file, offset, SEEK_SET);
+    while (fread(header, 1, sizeof(header), reader->file) == sizeof(header)) {
+        size_t length = mp_get16(header + 2);
+        if (mp_get16(header) == 0) {
+            size_t head = length < sizeof(marker) ? length : sizeof(marker);
+            if (fread(marker, 1, head, reader->file) != head) break;
+            if (marker[0] == REPLAY_END && length == REPLAY_END_SIZE) {
+                reader->complete = replay_ticks_plausible(reader, mp_get32(marker + 1));
+                reader->ticks = mp_get32(marker + 1);
+                reader->hash = replay_get64(marker + 5);
+                break;
+            }
+            uint32_t tick = mp_get32(marker + 1);
+            if (marker[0] == REPLAY_KEYFRAME && length > REPLAY_KEYFRAME_HEADER && reader->keyframes < REPLAY_INDEX_SIZE &&
+                tick == (uint32_t)(reader->keyframes + 1) * REPLAY_KEYFRAME_TICKS) {
+                reader->index[reader->keyframes++] = (ReplayKeyframe){tick, (uint32_t)offset};
+            }
+            length -= head;
+        }
+        offset += (long)(REPLAY_CHUNK_HEADER + length);
+        if (fseek(reader->file, offset, SEEK_SET) != 0) break;
+    }
+    if (!reader->complete) reader->ticks = reader->keyframes > 0 ? reader->index[reader->keyframes - 1].tick : 0;
+}
+
+// Open a recording and read its header and index. Returns false if it is not one.
+static inline bool replay_reader_open(ReplayReader *reader, const char *path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) return false;
+
+    uint8_t header[REPLAY_HEADER];
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header) || memcmp(header, REPLAY_MAGIC, 4) != 0 ||
+        header[4] != REPLAY_VERSION || header[6] < MIN_PLAYERS || header[6] > MAX_PLAYERS) {
+        fclose(reader->file);
+        reader->file = NULL;
+        return false;
+    }
+    reader->flags = header[5];
+    reader->snakeCount = header[6];
+    reader->seed = mp_get32(header + 8);
+    reader->started = mp_get32(header + 12);
+    replay_context_init(&reader->context, reader->snakeCount);
+
+    reader->complete = replay_read_index(reader);
+    if (!reader->complete) replay_scan(reader);
+    fseek(reader->file, REPLAY_HEADER, SEEK_SET);
+    return true;
+}
+
+static inline void replay_reader_close(ReplayReader *reader) {
+    if (reader->file) fclose(reader->file);
+    reader->file = NULL;
+}
+
+// Load the next chunk. A keyframe leaves its packed match in `state`, its tick and
+// generator in `keyframeTick` and `keyframeRng`, and no events to read. Returns
+// false at the end of the recording or on an error.
+static inline bool replay_next_chunk(ReplayReader *reader) {
+    uint8_t header[REPLAY_CHUNK_HEADER];
+    if (fread(header, 1, sizeof(header), reader->file) != sizeof(header)) {
+        reader->failed = true;
+        return false;
+    }
+    int events = mp_get16(header);
+    size_t length = mp_get16(header + 2);
+    if (length > REPLAY_CHUNK_SIZE || fread(reader->chunk, 1, length, reader->file) != length ||
+        (events == 0 && length == 0)) {
+        reader->failed = true;
+        return false;
+    }
+
+    if (events == 0 && reader->chunk[0] == REPLAY_END && length == REPLAY_END_SIZE) {
+        // The index already said how it ends
+        if (mp_get32(reader->chunk + 1) != reader->ticks || replay_get64(reader->chunk + 5) != reader->hash) {
+            reader->failed = true;
+            return false;
+        }
+        reader->ended = true;
+        return false;
+    }
+    if (events == 0) {
+        if (reader->chunk[0] != REPLAY_KEYFRAME || length <= REPLAY_KEYFRAME_HEADER ||
+            !mp_rle_decode(reader->chunk + REPLAY_KEYFRAME_HEADER, length - REPLAY_KEYFRAME_HEADER, reader->state,
+                           MP_STATE_SIZE) ||
+            reader->state[9] != reader->snakeCount) {
+            reader->failed = true;
+            return false;
+        }
+        reader->keyframeTick = mp_get32(reader->chunk + 1);
+        reader->keyframeRng = mp_get32(reader->chunk + 5);
+        replay_context_keyframe(&reader->context, reader->keyframeTick, reader->state);
+        reader->chunkEvents = 0;
+        return true;
+    }
+    reader->chunkEvents = events;
+    reader->chunkLength = length;
+    if (reader->flags & REPLAY_ENTROPY) replay_decoder_start(&reader->decoder, reader->chunk, length);
+    else reader->decoder.position = 0;
+    return true;
+}
+
+// The next event, in tick order. Returns false at the end, where `ended`, `ticks`
+// and `hash` are set, or on a damaged file, where `failed` is.
+static inline bool replay_read_event(ReplayReader *reader, ReplayEvent *event) {
+    if (reader->file == NULL || reader->ended || reader->failed) return false;
+    while (reader->chunkEvents == 0) {
+        if (!replay_next_chunk(reader)) return false;
+    }
+
+    if (reader->flags & REPLAY_ENTROPY) {
+        replay_decode_event(&reader->context, &reader->decoder, event);
+        if (reader->decoder.position > reader->chunkLength + 4) reader->failed = true;
+    } else {
+        uint64_t token = 0;
+        int shift = 0;
+        uint8_t byte;
+        do {
+            if (reader->decoder.position >= reader->chunkLength || shift > 63) {
+                reader->failed = true;
+                return false;
+            }
+            byte = reader->chunk[reader->decoder.position++];
+            token |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        event->tick = reader->context.tick + (uint32_t)(token >> 5);
+        event->snake = (int)(token >> 2 & 7);
+        event->direction = (MpDirection)((token & 3) + 1);
+    }
+    if (event->snake >= reader->snakeCount) reader->failed = true;
+    if (reader->failed) return false;
+
+    replay_context_update(&reader->context, event);
+    reader->chunkEvents--;
+    return true;
+}
+
+// Index of the last keyframe at or before `tick`, or -1
+static inline int replay_keyframe_before(const ReplayReader *reader, uint32_t tick) {
+    int low = 0, high = reader->keyframes - 1, found = -1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        if (reader->index[middle].tick <= tick) {
+            found = middle;
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return found;
+}
+
+// Restore `match` from the last keyframe at or before `tick`, or from the seed if
+// there is none, and read on from there. Sets `*from` to the tick restored.
+static inline bool replay_reader_seek(ReplayReader *reader, uint32_t tick, Match *match, uint32_t *from) {
+    if (reader->file == NULL) return false;
+    reader->ended = reader->failed = false;
+    reader->chunkEvents = 0;
+
+    int k = replay_keyframe_before(reader, tick);
+    if (k < 0) {
+        fseek(reader->file, REPLAY_HEADER, SEEK_SET);
+        replay_context_init(&reader->context, reader->snakeCount);
+        match_reset(match, reader->snakeCount, reader->seed);
+        *from = 0;
+        return true;
+    }
+
+    MpStateInfo info;
+    if (fseek(reader->file, (long)reader->index[k].offset, SEEK_SET) != 0 || !replay_next_chunk(reader) ||
+        reader->chunkEvents != 0 || reader->keyframeTick != reader->index[k].tick ||
+        !mp_unpack_state(reader->state, match, &info)) {
+        reader->failed = true;
+        return false;
+    }
+    match->rng = reader->keyframeRng;
+    *from = reader->keyframeTick;
+    return true;
+}
+
+// Steer a snake as an event says
+static inline void replay_apply(Match *match, const ReplayEvent *event) {
+    mp_direction_delta(event->direction, &match->snakes[event->snake].dx, &match->snakes[event->snake].dy);
+}
+
+// Playback
+
+// A recording being watched: the match after `tick` moves, steered for the next
+typedef struct {
+    ReplayReader reader;
+    Match match;
+    uint32_t tick;
+    ReplayEvent next;  // First event not applied yet
+    bool pending;
+} ReplayPlayer;
+
+static inline void replay_player_steer(ReplayPlayer *player) {
+    while (player->pending && player->next.tick <= player->tick) {
+        replay_apply(&player->match, &player->next);
+        player->pending = replay_read_event(&player->reader, &player->next);
+    }
+}
+
+// One move. Returns false at the end of the recording or where it is damaged. A
+// file that was never closed plays up to its last keyframe; the events before that
+// are all there, even if reading ahead has run into the cut.
+static inline bool replay_player_step(ReplayPlayer *player) {
+    const ReplayReader *reader = &player->reader;
+    if (player->tick >= reader->ticks || (reader->failed && reader->complete)) return false;
+    move_snakes(&player->match);
+    eat_foods(&player->match);
+    ensure_minimum_fruits(&player->match);
+    player->tick++;
+    replay_player_steer(player);
+    return !(reader->failed && reader->complete);
+}
+
+// Jump to `tick`: from the nearest keyframe before it, or straight on from here
+// when that is nearer. Returns false if the recording is damaged on the way.
+static inline bool replay_player_seek(ReplayPlayer *player, uint32_t tick) {
+    if (tick > player->reader.ticks) tick = player->reader.ticks;
+
+    int k = replay_keyframe_before(&player->reader, tick);
+    uint32_t keyframe = k >= 0 ? player->reader.index[k].tick : 0;
+    if (tick < player->tick || keyframe > player->tick || player->reader.failed) {
+        if (!replay_reader_seek(&player->reader, tick, &player->match, &player->tick)) return false;
+        player->pending = replay_read_event(&player->reader, &player->next);
+        replay_player_steer(player);
+    }
+    while (player->tick < tick) {
+        if (!replay_player_step(player)) return false;
+    }
+    return true;
+}
+
+static inline bool replay_player_open(ReplayPlayer *player, const char *path) {
+    memset(player, 0, sizeof(*player));
+    if (!replay_reader_open(&player->reader, path)) return false;
+    player->reader.failed = true; // Makes the seek start from the top
+    if (!replay_player_seek(player, 0)) {
+        replay_reader_close(&player->reader);
+        return false;
+    }
+    return true;
+}
+
+static inline void replay_player_close(ReplayPlayer *player) {
+    replay_reader_close(&player->reader);
+}
+
+#endif
@@ -0,0 +1,277 @@
+// Size and speed bench for the match recordings in replay.h
+//
+//   gcc -O2 replay_bench.c -o replay_bench
+//   ./replay_bench [-g games] [-n snakes] [-s seed] [-o directory]
+//
+// Bots play full matches, each recorded twice, once with raw varint events and once
+// range coded. Both recordings are then played back from the file: decoded, applied
+// to a fresh match_reset() from the recorded seed and re-simulated, and the final
+// match_hash() must equal the one the recording ends with. Then the player jumps to
+// random ticks, back and forth, and the match it lands on must hash the same as
+// the straight playback did at that tick. Any mismatch fails the run. So does a
+// seek that plays on from a keyframe holding a snake cut down to one segment,
+// which the reader has to turn down as damaged.
+//
+// Sizes are given per hour of play, next to what storing a packed state every tick
+// would take, with the keyframes' share. Playback speed is given in ticks per second
+// and as a multiple of real time (one tick is MOVE_INTERVAL ms), both for decoding
+// alone and for decoding and re-simulating, and seeks in microseconds. Recordings
+// are written to the directory given with -o and kept there, or to /tmp and removed.
+
+#include "replay.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_TICKS (GAME_DURATION / MOVE_INTERVAL)
+#define BENCH_SEEKS 20 // Per recording
+
+typedef struct {
+    long bytes;
+    long keyframeBytes;
+    double decodeSeconds; // Reading events only
+    double playSeconds;   // Reading events and re-simulating
+    double seekSeconds;
+    double slowestSeek;
+    long seeks;
+} BenchCodec;
+
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Bot at the keys: turn away from whatever is ahead, and now and then for no reason
+static void bench_bot(Match *match, int p, uint32_t *rng) {
+    Snake *snake = &match->snakes[p];
+    if (!snake->alive) return;
+
+    bool blocked = cell_blocked(match, snake->body[0].x + snake->dx, snake->body[0].y + snake->dy);
+    if (!blocked && mp_rand(rng) % 8 != 0) return;
+
+    int turn = mp_rand(rng) % 2 ? 1 : -1;
+    int dx = -snake->dy * turn, dy = snake->dx * turn;
+    if (cell_blocked(match, snake->body[0].x + dx, snake->body[0].y + dy)) {
+        dx = -dx;
+        dy = -dy;
+    }
+    snake_steer(snake, dx, dy);
+}
+
+// Play one match into both recordings; returns its length in ticks and counts events
+static uint32_t record_game(const char *rawPath, const char *codedPath, BenchCodec *codecs, int snakes, uint32_t seed,
+                            long *events) {
+    static ReplayWriter raw, coded;
+    Match match;
+    match_reset(&match, snakes, seed);
+    if (!replay_writer_open(&raw, rawPath, &match, seed, false) ||
+        !replay_writer_open(&coded, codedPath, &match, seed, true)) {
+        perror("replay_writer_open");
+        exit(1);
+    }
+
+    uint32_t rng = seed * 2654435761u | 1;
+    uint8_t heading[MAX_PLAYERS];
+    for (int p = 0; p < snakes; p++) heading[p] = (uint8_t)mp_direction(match.snakes[p].dx, match.snakes[p].dy);
+
+    uint32_t tick = 0;
+    while (tick < BENCH_MAX_TICKS && !match_over(&match)) {
+        for (int p = 0; p < snakes; p++) bench_bot(&match, p, &rng);
+        for (int p = 0; p < snakes; p++) {
+            uint8_t direction = (uint8_t)mp_direction(match.snakes[p].dx, match.snakes[p].dy);
+            if (direction != heading[p]) (*events)++;
+            heading[p] = direction;
+        }
+        replay_write_tick(&raw, tick, &match);
+        replay_write_tick(&coded, tick, &match);
+        move_snakes(&match);
+        eat_foods(&match);
+        ensure_minimum_fruits(&match);
+        tick++;
+    }
+    replay_writer_close(&raw, tick, &match);
+    replay_writer_close(&coded, tick, &match);
+    codecs[0].keyframeBytes += raw.keyframeBytes;
+    codecs[1].keyframeBytes += coded.keyframeBytes;
+    return tick;
+}
+
+// Read every event of a recording without simulating; returns how many there were
+static long decode_only(const char *path) {
+    static ReplayReader reader;
+    if (!replay_reader_open(&reader, path)) return -1;
+    ReplayEvent event;
+    long events = 0;
+    while (replay_read_event(&reader, &event)) events++;
+    bool ended = reader.ended;
+    replay_reader_close(&reader);
+    return ended ? events : -1;
+}
+
+// Play a recording back from the start, keeping the hash after every tick; true if
+// it ends on the hash it recorded
+static bool play(const char *path, uint64_t *hashes) {
+    static ReplayPlayer player;
+    if (!replay_player_open(&player, path)) return false;
+
+    hashes[0] = match_hash(&player.match);
+    while (replay_player_step(&player)) hashes[player.tick] = match_hash(&player.match);
+    const ReplayReader *reader = &player.reader;
+    bool ok = reader->complete && !reader->failed && player.tick == reader->ticks &&
+              match_hash(&player.match) == reader->hash;
+    replay_player_close(&player);
+    return ok;
+}
+
+// Jump around a recording; true if every seek lands on the match straight playback had
+static bool seek(const char *path, const uint64_t *hashes, uint32_t *rng, BenchCodec *codec) {
+    static ReplayPlayer player;
+    if (!replay_player_open(&player, path)) return false;
+
+    bool ok = true;
+    for (int i = 0; i < BENCH_SEEKS && ok; i++) {
+        uint32_t tick = mp_rand(rng) % (player.reader.ticks + 1);
+        double start = wall_seconds();
+        ok = replay_player_seek(&player, tick) && player.tick == tick;
+        double seconds = wall_seconds() - start;
+        ok = ok && match_hash(&player.match) == hashes[tick];
+
+        codec->seekSeconds += seconds;
+        if (seconds > codec->slowestSeek) codec->slowestSeek = seconds;
+        codec->seeks++;
+    }
+    replay_player_close(&player);
+    return ok;
+}
+
+// Record a match whose first keyframe has a live snake of length 1; true if seeking
+// past that keyframe fails instead of playing on from it
+static bool truncated_keyframe(const char *path, uint32_t seed) {
+    static ReplayWriter writer;
+    static ReplayPlayer player;
+    Match match;
+    match_reset(&match, MIN_PLAYERS, seed);
+    if (!replay_writer_open(&writer, path, &match, seed, true)) {
+        perror("replay_writer_open");
+        exit(1);
+    }
+
+    uint32_t tick = 0;
+    for (; tick <= REPLAY_KEYFRAME_TICKS; tick++) {
+        Match damaged = match;
+        damaged.snakes[0].length = 1;
+        damaged.snakes[0].alive = true;
+        replay_write_tick(&writer, tick, tick == REPLAY_KEYFRAME_TICKS ? &damaged : &match);
+        move_snakes(&match);
+        eat_foods(&match);
+        ensure_minimum_fruits(&match);
+    }
+    replay_writer_close(&writer, tick, &match);
+
+    bool refused = !replay_player_open(&player, path) || !replay_player_seek(&player, REPLAY_KEYFRAME_TICKS + 1);
+    replay_player_close(&player);
+    return refused;
+}
+
+static void measure(BenchCodec *codec, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        codec->bytes += ftell(file);
+        fclose(file);
+    }
+}
+
+static void report(const char *name, const BenchCodec *codec, double hours, long events, long ticks) {
+    double realTime = ticks * (MOVE_INTERVAL / 1000.0);
+    long eventBytes = codec->bytes - codec->keyframeBytes;
+    printf("%-8s %8.1f KB/hour (%4.1f in keyframes)  %5.2f bytes/event  decode %6.1fM ticks/s (%.0fx real time)  "
+           "play %5.2fM ticks/s (%.0fx)  seek %.0f us, slowest %.0f us\n",
+           name, codec->bytes / hours / 1024.0, codec->keyframeBytes / hours / 1024.0,
+           events ? (double)eventBytes / events : 0.0, ticks / codec->decodeSeconds / 1e6,
+           realTime / codec->decodeSeconds, ticks / codec->playSeconds / 1e6, realTime / codec->playSeconds,
+           codec->seekSeconds / codec->seeks * 1e6, codec->slowestSeek * 1e6);
+}
+
+int main(int argc, char *argv[]) {
+    int games = 50, snakes = 2;
+    uint32_t seed = 1;
+    const char *directory = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "g:n:s:o:")) != -1) {
+        switch (option) {
+            case 'g': games = atoi(optarg); break;
+            case 'n': snakes = atoi(optarg); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'o': directory = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-g games] [-n snakes] [-s seed] [-o directory]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (games < 1 || snakes < MIN_PLAYERS || snakes > MAX_PLAYERS) {
+        fprintf(stderr, "games must be >= 1, snakes %d..%d\n", MIN_PLAYERS, MAX_PLAYERS);
+        return 1;
+    }
+
+    long ticks = 0, events = 0;
+    int failures = 0;
+    uint32_t gameRng = seed * 2654435761u | 1;
+    uint32_t seekRng = seed ^ 0x5eec;
+    char rawPath[512], codedPath[512];
+    static uint64_t hashes[BENCH_MAX_TICKS + 1];
+    BenchCodec codecs[2] = {{0}};
+
+    for (int g = 0; g < games; g++) {
+        uint32_t game = mp_rand(&gameRng) | 1;
+        snprintf(rawPath, sizeof(rawPath), "%s/replay-%u-raw.snr", directory ? directory : "/tmp", game);
+        snprintf(codedPath, sizeof(codedPath), "%s/replay-%u.snr", directory ? directory : "/tmp", game);
+        ticks += record_game(rawPath, codedPath, codecs, snakes, game, &events);
+
+        const char *paths[2] = {rawPath, codedPath};
+        for (int c = 0; c < 2; c++) {
+            measure(&codecs[c], paths[c]);
+            double start = wall_seconds();
+            long decoded = decode_only(paths[c]);
+            double middle = wall_seconds();
+            bool ok = play(paths[c], hashes);
+            codecs[c].decodeSeconds += middle - start;
+            codecs[c].playSeconds += wall_seconds() - middle;
+            ok = ok && seek(paths[c], hashes, &seekRng, &codecs[c]);
+            if (decoded < 0 || !ok) {
+                fprintf(stderr, "game %d (seed %u): %s recording does not play back or seek\n", g, game, c ? "coded" : "raw");
+                failures++;
+            }
+        }
+        if (!directory) {
+            remove(rawPath);
+            remove(codedPath);
+        }
+    }
+
+    snprintf(codedPath, sizeof(codedPath), "%s/replay-truncated.snr", directory ? directory : "/tmp");
+    if (!truncated_keyframe(codedPath, seed)) {
+        fprintf(stderr, "a keyframe with a one-segment snake was played on from\n");
+        failures++;
+    }
+    if (!directory) remove(codedPath);
+
+    double hours = ticks * (MOVE_INTERVAL / 1000.0) / 3600.0;
+    printf("%d games of %d snakes, %ld ticks (%.2f hours of play), %ld events (%.1f per snake-minute)\n", games,
+           snakes, ticks, hours, events, events / (hours * 60.0 * snakes));
+    printf("%-8s %8.1f KB/hour\n", "states", (double)MP_STATE_SIZE * ticks / hours / 1024.0);
+    report("raw", &codecs[0], hours, events, ticks);
+    report("coded", &codecs[1], hours, events, ticks);
+    printf("coded is %.1f%% of raw\n", 100.0 * codecs[1].bytes / codecs[0].bytes);
+
+    if (failures > 0) {
+        printf("FAILED: %d recordings did not play back to their final hash, seek correctly or refuse damage\n",
+               failures);
+        return 1;
+    }
+    printf("all recordings played back to their final hash, every seek matched and the damaged keyframe was refused\n");
+    return 0;
+}
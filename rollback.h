@@ -0,0 +1,247 @@
+#ifndef ROLLBACK_H
+#define ROLLBACK_H
+
+// Peer-to-peer rollback netplay for two-player matches, shared by multiplayer.c
+// (--host / --join) and rollback_bench.c.
+//
+// Both peers run the whole match from the same seed; the rules in mp_rules.h are
+// deterministic, so equal inputs give equal games. A local key press is scheduled
+// `inputDelay` ticks ahead and sent to the peer at once. The remote snake is
+// predicted to keep its heading. When the remote input for an already simulated tick
+// arrives and turns out to be a turn, the match is restored from the state saved at
+// the start of that tick and re-simulated up to the present.
+//
+// Latency below inputDelay * MOVE_INTERVAL is hidden completely. Beyond that a turn
+// costs one rollback, and a peer never predicts more than ROLLBACK_WINDOW ticks past
+// the last remote input it has; if it gets that far ahead it stalls.
+//
+// Inputs packet (little-endian):
+//   ROLLBACK_INPUTS, count, 0, 0, game:u32, first:u32, ack:u32, tick:u32,
+//   confirmed:u32, hash:u64, direction[count]
+// carrying every local input from `first` (the oldest the peer has not acknowledged)
+// on. `ack` acknowledges the sender's remote inputs and `tick` is how far the
+// sender has simulated. Because every packet repeats all unacknowledged inputs,
+// a lost packet needs no retransmission of its own.
+//
+// `hash` is the sender's match_hash() at the start of tick `confirmed`, the newest
+// state it has from confirmed inputs only. The receiver compares it with its own
+// hash of that tick, so the two games are checked against each other continuously
+// and a desync is caught within a round trip of the tick it happened on.
+
+#include "mp_rules.h"
+#include "mp_net.h"
+
+#define ROLLBACK_WINDOW 8      // Ticks simulated ahead of the last remote input, at most
+#define ROLLBACK_MAX_DELAY 8   // Largest input delay in ticks
+#define ROLLBACK_RING 64       // Input slots; covers the window and delay on both peers
+#define ROLLBACK_PLAYERS 2
+#define ROLLBACK_HEADER 32
+#define ROLLBACK_MAX_PACKET (ROLLBACK_HEADER + ROLLBACK_RING)
+
+// Packet types, numbered after the server protocol's (mp_net.h)
+enum {
+    ROLLBACK_HELLO = 16, // joiner -> host, repeated until START: type, version, 0, 0
+    ROLLBACK_START,      // host -> joiner: type, 0, 0, 0, game:u32 (also the seed)
+    ROLLBACK_INPUTS
+};
+
+typedef struct {
+    Match match;                 // Ticks [0, tick) applied, with predictions where needed
+    uint32_t tick;
+    uint32_t game;               // Seed; tells this game's packets from a previous one's
+    int local;                   // Snake this peer steers; the other one is remote
+    int inputDelay;
+
+    uint8_t inputs[ROLLBACK_RING][ROLLBACK_PLAYERS]; // Direction by tick and snake
+    uint32_t localNext;          // First tick without a local input
+    uint32_t remoteNext;         // Remote inputs are known for every tick below this
+    uint32_t peerAck;            // The peer has every local input below this
+    uint32_t peerTick;           // How far the peer said it has simulated
+
+    bool mispredicted;           // Some simulated tick used a wrong prediction
+    uint32_t rollbackFrom;       // Oldest such tick
+    Match saved[ROLLBACK_WINDOW + 1]; // State at the start of each recent tick
+    uint64_t hashes[ROLLBACK_RING]; // match_hash() at the start of each recent tick
+
+    bool desynced;               // The peer's game differs from this one
+    uint32_t desyncTick;         // First tick found to differ
+
+    long rollbacks;              // Restores so far
+    long resimTicks;             // Ticks simulated again because of them
+} RollbackSession;
+
+// Copy the parts of a match the rules read. Body segments past each snake's length
+// are never read, so a snapshot of a short snake is a few hundred bytes.
+static inline void rollback_copy(Match *dst, const Match *src) {
+    dst->snakeCount = src->snakeCount;
+    dst->rng = src->rng;
+    dst->hash = src->hash;
+    memcpy(dst->foods, src->foods, sizeof(src->foods));
+    memcpy(&dst->grid, &src->grid, sizeof(src->grid));
+    for (int p = 0; p < src->snakeCount; p++) {
+        Snake *d = &dst->snakes[p];
+        const Snake *s = &src->snakes[p];
+        d->length = s->length;
+        d->dx = s->dx;
+        d->dy = s->dy;
+        d->alive = s->alive;
+        d->score = s->score;
+        memcpy(d->name, s->name, sizeof(d->name));
+        memcpy(d->body, s->body, sizeof(Segment) * (size_t)s->length);
+    }
+}
+
+static inline void rollback_init(RollbackSession *s, int local, uint32_t game, int inputDelay) {
+    memset(s, 0, sizeof(*s));
+    match_reset(&s->match, ROLLBACK_PLAYERS, game);
+    s->game = game;
+    s->local = local;
+    s->inputDelay = inputDelay < 0 ? 0 : inputDelay > ROLLBACK_MAX_DELAY ? ROLLBACK_MAX_DELAY : inputDelay;
+
+    // Nobody can have pressed anything for the first inputDelay ticks
+    s->localNext = s->remoteNext = (uint32_t)s->inputDelay;
+}
+
+// Simulate tick `t` from the current state with the best inputs known for it
+static inline void rollback_step(RollbackSession *s, uint32_t t) {
+    rollback_copy(&s->saved[t % (ROLLBACK_WINDOW + 1)], &s->match);
+    s->hashes[t % ROLLBACK_RING] = match_hash(&s->match);
+
+    for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+        bool known = t < (p == s->local ? s->localNext : s->remoteNext);
+        int direction = known ? s->inputs[t % ROLLBACK_RING][p] : MP_DIR_NONE; // Predict: no turn
+        Snake *snake = &s->match.snakes[p];
+        if (direction != MP_DIR_NONE && snake->alive) {
+            int dx, dy;
+            mp_direction_delta(direction, &dx, &dy);
+            snake_steer(snake, dx, dy);
+        }
+    }
+
+    move_snakes(&s->match);
+    eat_foods(&s->match);
+    ensure_minimum_fruits(&s->match);
+}
+
+// Replay from the oldest mispredicted tick, if any, so the match reflects every
+// remote input received so far
+static inline void rollback_sync(RollbackSession *s) {
+    if (!s->mispredicted) return;
+
+    rollback_copy(&s->match, &s->saved[s->rollbackFrom % (ROLLBACK_WINDOW + 1)]);
+    for (uint32_t t = s->rollbackFrom; t < s->tick; t++) {
+        rollback_step(s, t);
+    }
+    s->rollbacks++;
+    s->resimTicks += s->tick - s->rollbackFrom;
+    s->mispredicted = false;
+}
+
+// Whether the next tick may be simulated without predicting too far ahead
+static inline bool rollback_can_advance(const RollbackSession *s) {
+    return s->tick < s->remoteNext + ROLLBACK_WINDOW && (int)s->tick * MOVE_INTERVAL < GAME_DURATION;
+}
+
+// The match has ended on confirmed inputs alone, so no rollback can undo it. The
+// peer may already be past that tick on predictions; it has to agree all the same.
+static inline bool rollback_finished(const RollbackSession *s) {
+    if (s->mispredicted) return false;
+    if (s->remoteNext >= s->tick) {
+        return match_over(&s->match) || (int)s->tick * MOVE_INTERVAL >= GAME_DURATION;
+    }
+    return match_over(&s->saved[s->remoteNext % (ROLLBACK_WINDOW + 1)]);
+}
+
+// Queue the local direction for tick + inputDelay and simulate one tick. Call only
+// when rollback_can_advance() says so.
+static inline void rollback_advance(RollbackSession *s, int direction) {
+    s->inputs[s->localNext % ROLLBACK_RING][s->local] = (uint8_t)direction;
+    s->localNext++;
+
+    rollback_sync(s);
+    rollback_step(s, s->tick);
+    s->tick++;
+}
+
+// Remote input for tick `t`; inputs must arrive in tick order, repeats are ignored
+static inline void rollback_add_remote(RollbackSession *s, uint32_t t, int direction) {
+    if (t != s->remoteNext || t >= s->tick + ROLLBACK_RING - ROLLBACK_WINDOW) return;
+
+    s->inputs[t % ROLLBACK_RING][1 - s->local] = (uint8_t)direction;
+    s->remoteNext++;
+
+    // Already simulated on the prediction, which was wrong
+    if (t < s->tick && direction != MP_DIR_NONE && (!s->mispredicted || t < s->rollbackFrom)) {
+        s->mispredicted = true;
+        s->rollbackFrom = t;
+    }
+}
+
+// Newest tick whose starting state follows from confirmed inputs alone
+static inline uint32_t rollback_confirmed(const RollbackSession *s) {
+    uint32_t confirmed = s->remoteNext < s->tick ? s->remoteNext : s->tick;
+    if (s->mispredicted && s->rollbackFrom < confirmed) confirmed = s->rollbackFrom;
+    return confirmed;
+}
+
+// match_hash() at the start of tick `t`, which must be at most ROLLBACK_RING ticks old
+static inline uint64_t rollback_hash_at(const RollbackSession *s, uint32_t t) {
+    return t == s->tick ? match_hash(&s->match) : s->hashes[t % ROLLBACK_RING];
+}
+
+// Fill `packet` with every local input the peer has not acknowledged
+static inline size_t rollback_write_inputs(const RollbackSession *s, uint8_t *packet) {
+    uint32_t count = s->localNext - s->peerAck;
+    packet[0] = ROLLBACK_INPUTS;
+    packet[1] = (uint8_t)count;
+    packet[2] = packet[3] = 0;
+    mp_put32(packet + 4, s->game);
+    mp_put32(packet + 8, s->peerAck);
+    mp_put32(packet + 12, s->remoteNext);
+    mp_put32(packet + 16, s->tick);
+    uint32_t confirmed = rollback_confirmed(s);
+    uint64_t hash = rollback_hash_at(s, confirmed);
+    mp_put32(packet + 20, confirmed);
+    mp_put32(packet + 24, (uint32_t)hash);
+    mp_put32(packet + 28, (uint32_t)(hash >> 32));
+    for (uint32_t i = 0; i < count; i++) {
+        packet[ROLLBACK_HEADER + i] = s->inputs[(s->peerAck + i) % ROLLBACK_RING][s->local];
+    }
+    return ROLLBACK_HEADER + count;
+}
+
+// Take in an inputs packet from the peer. Returns false if it is not one of this game's.
+static inline bool rollback_read_inputs(RollbackSession *s, const uint8_t *packet, size_t length) {
+    if (length < ROLLBACK_HEADER || packet[0] != ROLLBACK_INPUTS || mp_get32(packet + 4) != s->game ||
+        length != ROLLBACK_HEADER + (size_t)packet[1]) {
+        return false;
+    }
+
+    uint32_t first = mp_get32(packet + 8);
+    uint32_t ack = mp_get32(packet + 12);
+    uint32_t tick = mp_get32(packet + 16);
+    if (ack > s->peerAck && ack <= s->localNext) s->peerAck = ack;
+    if (tick > s->peerTick) s->peerTick = tick;
+
+    for (uint32_t i = 0; i < packet[1]; i++) {
+        if (packet[ROLLBACK_HEADER + i] <= MP_DIR_RIGHT) rollback_add_remote(s, first + i, packet[ROLLBACK_HEADER + i]);
+    }
+
+    // Compare with the peer's confirmed state once this side has confirmed it too
+    uint32_t confirmed = mp_get32(packet + 20);
+    uint64_t hash = mp_get32(packet + 24) | (uint64_t)mp_get32(packet + 28) << 32;
+    if (!s->desynced && confirmed <= rollback_confirmed(s) && s->tick - confirmed < ROLLBACK_RING &&
+        hash != rollback_hash_at(s, confirmed)) {
+        s->desynced = true;
+        s->desyncTick = confirmed;
+    }
+    return true;
+}
+
+// Milliseconds until the next tick. A peer that has run ahead of the other slows
+// down a little, so neither keeps predicting (and rolling back) more than it must.
+static inline int rollback_tick_interval(const RollbackSession *s) {
+    return s->tick > s->peerTick + 1 ? MOVE_INTERVAL + MOVE_INTERVAL / 10 : MOVE_INTERVAL;
+}
+
+#endif
@@ -0,0 +1,251 @@
+// Loopback test bench for the rollback netplay in rollback.h
+//
+//   gcc -O2 rollback_bench.c -o rollback_bench
+//   ./rollback_bench [-l latency ms] [-j jitter ms] [-p loss %] [-d input delay] [-g games] [-s seed]
+//
+// Two peers play each other in one process, with bots at the keys, over a simulated
+// link. The link delays every packet by the latency plus a random jitter, so packets
+// also arrive out of order, and drops the given share of them. Time is simulated in
+// 1 ms steps, so a whole match takes a fraction of a second. Rollbacks and regular
+// ticks are timed separately on the wall clock.
+//
+// After every match both peers' final states are compared with each other, and with
+// a fresh replay of the inputs each side actually pressed. Any difference is a
+// desync and fails the run, as is a desync the peers caught themselves by comparing
+// hashes during play, or an incremental match hash that disagrees with one
+// computed from scratch.
+
+#include "rollback.h"
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_MAX_PACKETS 4096
+#define BENCH_MAX_TICKS (GAME_DURATION / MOVE_INTERVAL + ROLLBACK_MAX_DELAY + 1)
+#define BENCH_RESEND 20 // ms between packets while stalled
+
+typedef struct {
+    uint32_t deliverAt;
+    size_t length;
+    uint8_t data[ROLLBACK_MAX_PACKET];
+} BenchPacket;
+
+// One direction of the link; packets are delivered in deliverAt order, not send order
+typedef struct {
+    BenchPacket packets[BENCH_MAX_PACKETS];
+    int count;
+} BenchLink;
+
+typedef struct {
+    RollbackSession session;
+    uint32_t nextTick;   // Simulated time of the next tick
+    uint32_t lastSend;
+    uint32_t rng;
+    uint8_t pressed[BENCH_MAX_TICKS]; // Local input by the tick it applies to
+    long stalls;         // Milliseconds spent waiting for the peer
+    double resimSeconds; // Wall time spent rolling back and re-simulating
+    double tickSeconds;  // Wall time spent on regular ticks
+} BenchPeer;
+
+static double wall_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void link_send(BenchLink *link, const uint8_t *data, size_t length, uint32_t now, int latency,
+                      int jitter, int loss, uint32_t *rng) {
+    if ((int)(mp_rand(rng) % 100) < loss || link->count == BENCH_MAX_PACKETS) return;
+
+    BenchPacket *packet = &link->packets[link->count++];
+    packet->deliverAt = now + (uint32_t)latency + (jitter > 0 ? mp_rand(rng) % (uint32_t)(jitter + 1) : 0);
+    packet->length = length;
+    memcpy(packet->data, data, length);
+}
+
+static void link_deliver(BenchLink *link, BenchPeer *peer, uint32_t now) {
+    for (int i = 0; i < link->count;) {
+        if (link->packets[i].deliverAt <= now) {
+            rollback_read_inputs(&peer->session, link->packets[i].data, link->packets[i].length);
+            link->packets[i] = link->packets[--link->count];
+        } else {
+            i++;
+        }
+    }
+}
+
+// Bot at the keys: turn away from whatever is ahead, and now and then for no reason.
+// It only sees this peer's (possibly predicted) game, like a player would.
+static int bench_bot(BenchPeer *peer) {
+    const Match *match = &peer->session.match;
+    const Snake *snake = &match->snakes[peer->session.local];
+    if (!snake->alive) return MP_DIR_NONE;
+
+    bool blocked = cell_blocked(match, snake->body[0].x + snake->dx, snake->body[0].y + snake->dy);
+    if (!blocked && mp_rand(&peer->rng) % 8 != 0) return MP_DIR_NONE;
+
+    int left = mp_direction(snake->dy, -snake->dx);
+    int right = mp_direction(-snake->dy, snake->dx);
+    return mp_rand(&peer->rng) % 2 ? left : right;
+}
+
+static void peer_send(BenchPeer *peer, BenchLink *link, uint32_t now, int latency, int jitter, int loss,
+                      uint32_t *rng) {
+    uint8_t packet[ROLLBACK_MAX_PACKET];
+    size_t length = rollback_write_inputs(&peer->session, packet);
+    link_send(link, packet, length, now, latency, jitter, loss, rng);
+    peer->lastSend = now;
+}
+
+// Same match from the recorded inputs with no network at all
+static uint64_t replay_hash(uint32_t game, const BenchPeer *peers, uint32_t ticks) {
+    Match match;
+    match_reset(&match, ROLLBACK_PLAYERS, game);
+    for (uint32_t t = 0; t < ticks; t++) {
+        for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+            int direction = peers[p].pressed[t];
+            Snake *snake = &match.snakes[p];
+            if (direction != MP_DIR_NONE && snake->alive) {
+                int dx, dy;
+                mp_direction_delta(direction, &dx, &dy);
+                snake_steer(snake, dx, dy);
+            }
+        }
+        move_snakes(&match);
+        eat_foods(&match);
+        ensure_minimum_fruits(&match);
+    }
+    return match_hash(&match);
+}
+
+int main(int argc, char *argv[]) {
+    int latency = 80, jitter = 40, loss = 5, inputDelay = 1, games = 20;
+    uint32_t seed = 1;
+
+    int option;
+    while ((option = getopt(argc, argv, "l:j:p:d:g:s:")) != -1) {
+        switch (option) {
+            case 'l': latency = atoi(optarg); break;
+            case 'j': jitter = atoi(optarg); break;
+            case 'p': loss = atoi(optarg); break;
+            case 'd': inputDelay = atoi(optarg); break;
+            case 'g': games = atoi(optarg); break;
+            case 's': seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "usage: %s [-l latency ms] [-j jitter ms] [-p loss %%] [-d input delay] [-g games] [-s seed]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (latency < 0 || jitter < 0 || loss < 0 || loss > 90 || games < 1) {
+        fprintf(stderr, "latency and jitter must be >= 0, loss 0..90, games >= 1\n");
+        return 1;
+    }
+
+    static BenchPeer peers[ROLLBACK_PLAYERS];
+    static BenchLink links[ROLLBACK_PLAYERS]; // links[p] carries packets to peer p
+    uint32_t linkRng = seed * 2654435761u | 1;
+    long totalTicks = 0, rollbacks = 0, resimTicks = 0, stalls = 0;
+    double resimSeconds = 0, tickSeconds = 0;
+    uint32_t simulatedMs = 0;
+    int desyncs = 0;
+    long hashErrors = 0;
+
+    for (int g = 0; g < games; g++) {
+        uint32_t game = mp_rand(&linkRng) | 1;
+        memset(peers, 0, sizeof(peers));
+        memset(links, 0, sizeof(links));
+        for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+            rollback_init(&peers[p].session, p, game, inputDelay);
+            peers[p].rng = game + (uint32_t)p * 7919u;
+        }
+        // The joiner starts when the host's START reaches it
+        peers[1].nextTick = (uint32_t)latency;
+
+        uint32_t now = 0;
+        bool finished[ROLLBACK_PLAYERS] = {false};
+        while (!finished[0] || !finished[1]) {
+            for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+                BenchPeer *peer = &peers[p];
+                BenchLink *out = &links[1 - p];
+                link_deliver(&links[p], peer, now);
+
+                double start = wall_seconds();
+                if (peer->session.mispredicted) {
+                    rollback_sync(&peer->session);
+                    peer->resimSeconds += wall_seconds() - start;
+                }
+
+                if (!finished[p] && rollback_finished(&peer->session)) finished[p] = true;
+
+                if (!finished[p] && now >= peer->nextTick) {
+                    if (rollback_can_advance(&peer->session)) {
+                        int direction = bench_bot(peer);
+                        peer->pressed[peer->session.localNext] = (uint8_t)direction;
+
+                        start = wall_seconds();
+                        rollback_advance(&peer->session, direction); // Already in sync, so one plain tick
+                        peer->tickSeconds += wall_seconds() - start;
+                        if (peer->session.match.hash != match_rehash(&peer->session.match)) hashErrors++;
+                        peer->nextTick += (uint32_t)rollback_tick_interval(&peer->session);
+                        peer_send(peer, out, now, latency, jitter, loss, &linkRng);
+                    } else {
+                        peer->stalls++;
+                        peer->nextTick = now + 1;
+                    }
+                }
+
+                // Keep the peer supplied while either side waits
+                if (now - peer->lastSend >= BENCH_RESEND) peer_send(peer, out, now, latency, jitter, loss, &linkRng);
+            }
+
+            if (++now > 10u * GAME_DURATION) {
+                fprintf(stderr, "game %d did not finish (peers at ticks %u and %u)\n", g,
+                        peers[0].session.tick, peers[1].session.tick);
+                return 1;
+            }
+        }
+
+        // Both peers and an offline replay must agree on the final state
+        // A peer may have predicted past the end; nothing moves there any more
+        uint32_t ticks = peers[0].session.tick < peers[1].session.tick ? peers[0].session.tick : peers[1].session.tick;
+        uint64_t sums[3] = {
+            match_hash(&peers[0].session.match),
+            match_hash(&peers[1].session.match),
+            replay_hash(game, peers, ticks)
+        };
+        if (sums[0] != sums[1] || sums[0] != sums[2]) {
+            printf("game %d: DESYNC (%016llx %016llx, replay %016llx)\n", g, (unsigned long long)sums[0],
+                   (unsigned long long)sums[1], (unsigned long long)sums[2]);
+            desyncs++;
+        }
+        for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+            if (peers[p].session.desynced) {
+                printf("game %d: peer %d saw a DESYNC at tick %u\n", g, p, peers[p].session.desyncTick);
+                desyncs++;
+            }
+        }
+
+        for (int p = 0; p < ROLLBACK_PLAYERS; p++) {
+            totalTicks += peers[p].session.tick;
+            rollbacks += peers[p].session.rollbacks;
+            resimTicks += peers[p].session.resimTicks;
+            stalls += peers[p].stalls;
+            resimSeconds += peers[p].resimSeconds;
+            tickSeconds += peers[p].tickSeconds;
+        }
+        simulatedMs += now;
+    }
+
+    printf("%d games, %ums latency + 0..%ums jitter, %d%% loss, input delay %d\n",
+           games, latency, jitter, loss, inputDelay);
+    printf("rollbacks:  %.2f per peer-second, %.1f ticks re-simulated each on average\n",
+           rollbacks * 1000.0 / simulatedMs / ROLLBACK_PLAYERS, rollbacks ? (double)resimTicks / rollbacks : 0.0);
+    printf("re-sim:     %.2f us per rollback, %.3f us per regular tick\n",
+           rollbacks ? resimSeconds * 1e6 / rollbacks : 0.0, tickSeconds * 1e6 / totalTicks);
+    printf("stalls:     %.2f ms per peer-second waiting on the peer\n",
+           stalls * 1000.0 / simulatedMs / ROLLBACK_PLAYERS);
+    if (hashErrors) printf("incremental hash wrong after %ld ticks\n", hashErrors);
+    printf("%s\n", desyncs || hashErrors ? "DESYNC" : "in sync");
+    return desyncs || hashErrors ? 1 : 0;
+}
@@ -0,0 +1,185 @@
+#include "snake_env.h"
+
+#include "challenge_rules.h"
+
+#if SNAKE_ENV_WIDTH != GRID_WIDTH || SNAKE_ENV_HEIGHT != GRID_HEIGHT
+#error "snake_env.h and challenge_rules.h disagree on the board size"
+#endif
+
+// Complete state of one environment: a challenge round and its timers
+typedef struct {
+    Snake snake;
+    GameConfig config;
+    Scheduler scheduler;
+    int score;
+} EnvState;
+
+struct SnakeEnv {
+    int numEnvs;
+    GameConfig config; // Configured round every episode starts from
+    LevelPack pack;    // Holds the level `config` plays on, if any
+    EnvState *states;
+};
+
+// Derive a well-mixed, non-zero seed for environment `index`
+static uint64_t env_seed(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z ? z : 1;
+}
+
+// New episode drawing from `seed`, set up the way challenge.c starts a round
+static void reset_state(const SnakeEnv *env, EnvState *state, uint64_t seed) {
+    state->config = env->config;
+    game_seed(&state->config, seed);
+    reset_game(&state->snake, &state->config, &state->score);
+    schedule_game(&state->scheduler, &state->config, 0);
+}
+
+static void apply_action(Snake *snake, int action) {
+    switch (action) {
+        case SNAKE_ACTION_UP:
+            if (snake->dy != 1) { snake->dx = 0; snake->dy = -1; }
+            break;
+        case SNAKE_ACTION_DOWN:
+            if (snake->dy != -1) { snake->dx = 0; snake->dy = 1; }
+            break;
+        case SNAKE_ACTION_LEFT:
+            if (snake->dx != 1) { snake->dx = -1; snake->dy = 0; }
+            break;
+        case SNAKE_ACTION_RIGHT:
+            if (snake->dx != -1) { snake->dx = 1; snake->dy = 0; }
+            break;
+    }
+}
+
+// Run the round's timers up to and including the next snake move, which takes the
+// action; fruit, obstacles and the countdown fire in between on their own intervals
+static float step_state(EnvState *state, int action) {
+    Snake *snake = &state->snake;
+    Scheduler *scheduler = &state->scheduler;
+    int scoreBefore = state->score;
+
+    while (snake->alive) {
+        Timer *timer = scheduler_poll(scheduler, scheduler_next_deadline(scheduler));
+        if (timer == NULL) continue;
+
+        bool snakeMove = timer->kind == TIMER_SNAKE;
+        if (snakeMove) apply_action(snake, action);
+        handle_timer(timer, snake, &state->config, &state->score);
+        if (snakeMove) break;
+    }
+
+    if (!snake->alive) return -1.0f;
+    return (float)(state->score - scoreBefore);
+}
+
+static void write_observation(const EnvState *state, uint8_t *obs) {
+    uint8_t *body = obs + SNAKE_ENV_PLANE_BODY * GRID_WIDTH * GRID_HEIGHT;
+    uint8_t *head = obs + SNAKE_ENV_PLANE_HEAD * GRID_WIDTH * GRID_HEIGHT;
+    uint8_t *food = obs + SNAKE_ENV_PLANE_FOOD * GRID_WIDTH * GRID_HEIGHT;
+    uint8_t *obstacle = obs + SNAKE_ENV_PLANE_OBSTACLE * GRID_WIDTH * GRID_HEIGHT;
+    uint8_t *wall = obs + SNAKE_ENV_PLANE_WALL * GRID_WIDTH * GRID_HEIGHT;
+
+    memset(obs, 0, SNAKE_ENV_OBS_SIZE);
+
+    // A dead snake's head may be off the board
+    const Snake *snake = &state->snake;
+    for (int i = 0; i < snake->length; i++) {
+        int x = snake->body[i].x, y = snake->body[i].y;
+        if (x < 0 || x >= GRID_WIDTH || y < 0 || y >= GRID_HEIGHT) continue;
+        (i == 0 ? head : body)[y * GRID_WIDTH + x] = 1;
+    }
+
+    const GameConfig *config = &state->config;
+    for (int i = 0; i < config->foodCount; i++) {
+        food[config->foods[i].y * GRID_WIDTH + config->foods[i].x] = 1;
+    }
+    for (int i = 0; i < config->obstacleCount; i++) {
+        obstacle[config->obstacles[i].y * GRID_WIDTH + config->obstacles[i].x] = 1;
+    }
+    if (config->level) {
+        for (int y = 0; y < GRID_HEIGHT; y++) {
+            for (int x = 0; x < GRID_WIDTH; x++) {
+                wall[y * GRID_WIDTH + x] = level_bit(config->walls, GRID_WIDTH, x, y);
+            }
+        }
+    }
+}
+
+SnakeEnv *snake_env_create(int num_envs, const SnakeEnvFeatures *features) {
+    if (num_envs <= 0 || !features) return NULL;
+
+    ModeTable mode = default_modes;
+    if (features->modesFile && !load_modes(features->modesFile, &mode)) return NULL;
+
+    SnakeEnv *env = calloc(1, sizeof(SnakeEnv));
+    if (!env) return NULL;
+
+    env->states = calloc((size_t)num_envs, sizeof(EnvState));
+    if (!env->states) {
+        snake_env_destroy(env);
+        return NULL;
+    }
+
+    const LevelHeader *level = NULL;
+    if (features->levelPack) {
+        if (level_pack_open(&env->pack, features->levelPack)) {
+            level = level_pack_get(&env->pack, features->level);
+        }
+        if (!level_fits_board(level)) {
+            snake_env_destroy(env);
+            return NULL;
+        }
+    }
+
+    GameFeatures game = {
+        features->movingFruit, features->multiFruit, features->timed, features->obstacles, features->speed,
+        features->movingFruit && features->multiFruit && features->timed && features->obstacles && features->speed
+    };
+    configure_game(&env->config, &game, &mode);
+    select_level(&env->config, level);
+
+    env->numEnvs = num_envs;
+    for (int i = 0; i < num_envs; i++) {
+        reset_state(env, &env->states[i], env_seed(0, (uint64_t)i));
+    }
+    return env;
+}
+
+void snake_env_destroy(SnakeEnv *env) {
+    if (!env) return;
+    level_pack_close(&env->pack);
+    free(env->states);
+    free(env);
+}
+
+int snake_env_num_envs(const SnakeEnv *env) {
+    return env->numEnvs;
+}
+
+void snake_env_reset(SnakeEnv *env, uint64_t seed, uint8_t *observations) {
+    for (int i = 0; i < env->numEnvs; i++) {
+        EnvState *state = &env->states[i];
+        reset_state(env, state, env_seed(seed, (uint64_t)i));
+        write_observation(state, observations + (size_t)i * SNAKE_ENV_OBS_SIZE);
+    }
+}
+
+void snake_env_step(SnakeEnv *env, const int *actions, uint8_t *observations,
+                    float *rewards, uint8_t *dones) {
+    for (int i = 0; i < env->numEnvs; i++) {
+        EnvState *state = &env->states[i];
+
+        rewards[i] = step_state(state, actions[i]);
+        dones[i] = !state->snake.alive;
+
+        // Continue the environment's random stream into its next episode
+        if (dones[i]) {
+            reset_state(env, state, state->config.rngState);
+        }
+        write_observation(state, observations + (size_t)i * SNAKE_ENV_OBS_SIZE);
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef SNAKE_ENV_H
+#define SNAKE_ENV_H
+
+// Headless, vectorized version of the challenge mode rules for training agents.
+// The rules are challenge.c's own (challenge_rules.h): the same mode parameters,
+// level pack maps, obstacle placement and per-fruit and per-obstacle timers, run on
+// virtual time. One step is one snake move.
+//
+// Build as a shared library:
+//   gcc -O2 -shared -fPIC -pthread snake_env.c -o libsnakeenv.so
+//
+// Every call works on a whole vector of environments at once. Observations are
+// written into caller-provided buffers laid out as
+//   observations[env][plane][y][x]   (uint8_t, 0 or 1)
+// so a batch is one contiguous block of SNAKE_ENV_OBS_SIZE bytes per environment.
+// No memory is allocated after snake_env_create.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Board dimensions (same as challenge.c)
+#define SNAKE_ENV_WIDTH 32
+#define SNAKE_ENV_HEIGHT 24
+
+// Observation planes
+#define SNAKE_ENV_PLANE_BODY 0
+#define SNAKE_ENV_PLANE_HEAD 1
+#define SNAKE_ENV_PLANE_FOOD 2
+#define SNAKE_ENV_PLANE_OBSTACLE 3
+#define SNAKE_ENV_PLANE_WALL 4
+#define SNAKE_ENV_PLANES 5
+
+#define SNAKE_ENV_OBS_SIZE (SNAKE_ENV_PLANES * SNAKE_ENV_WIDTH * SNAKE_ENV_HEIGHT)
+
+// Actions (absolute directions; reversing into the body is ignored like the keyboard handler)
+typedef enum {
+    SNAKE_ACTION_UP = 0,
+    SNAKE_ACTION_DOWN,
+    SNAKE_ACTION_LEFT,
+    SNAKE_ACTION_RIGHT,
+    SNAKE_ACTION_COUNT
+} SnakeAction;
+
+// Same switches as the challenge menu, plus where the mode parameters and the map
+// come from. Zeroed paths give the built-in parameters and the open board.
+typedef struct {
+    bool movingFruit;
+    bool multiFruit;
+    bool timed;
+    bool obstacles;
+    bool speed;
+    const char *modesFile; // Mode parameters in the format of modes.cfg, NULL for the defaults
+    const char *levelPack; // Level pack built by mklevels, NULL for the open board
+    int level;             // Entry of levelPack to play on; it must fit the board
+} SnakeEnvFeatures;
+
+typedef struct SnakeEnv SnakeEnv;
+
+// Create num_envs environments sharing one feature set. Returns NULL on failure,
+// including a mode file that does not parse or a level that cannot be played.
+SnakeEnv *snake_env_create(int num_envs, const SnakeEnvFeatures *features);
+void snake_env_destroy(SnakeEnv *env);
+int snake_env_num_envs(const SnakeEnv *env);
+
+// Start a new episode in every environment. Environment i is seeded from (seed, i),
+// so the same seed always reproduces the same episodes.
+// observations: num_envs * SNAKE_ENV_OBS_SIZE bytes
+void snake_env_reset(SnakeEnv *env, uint64_t seed, uint8_t *observations);
+
+// Advance every environment by one snake tick.
+// actions:      num_envs SnakeAction values
+// observations: num_envs * SNAKE_ENV_OBS_SIZE bytes
+// rewards:      num_envs floats (points eaten this tick, -1 on death)
+// dones:        num_envs flags; a finished environment is reset automatically and
+//               its observation already shows the first frame of the next episode
+void snake_env_step(SnakeEnv *env, const int *actions, uint8_t *observations,
+                    float *rewards, uint8_t *dones);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef SPECTATE_H
+#define SPECTATE_H
+
+// Spectator feed: the match, tick by tick, in a shared-memory ring that any number
+// of local viewers can read (multiplayer --spectate).
+//
+// The game is the only writer and never waits for anyone. Each tick it appends one
+// record: the packed state (mp_net.h) XORed with the previous tick's and zero-run-
+// length encoded, so a quiet tick takes a few dozen bytes. Every
+// SPECTATE_KEYFRAME_INTERVAL ticks the record is a keyframe, which is the state
+// itself. Viewers only ever read the shared memory. A viewer that joins late, or
+// falls so far behind that the ring lapped it, starts again from the latest
+// keyframe. A slow viewer cannot hold the game up.
+//
+// Ring layout: SpectateHeader, then `capacity` bytes of records, each
+//   length:u16, keyframe:u8, 0, tick:u32, payload[length]
+// at a byte position that only grows. Position p lives at data[p % capacity],
+// and a record may wrap around the end.
+
+#include "mp_net.h"
+
+#include <stdatomic.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define SPECTATE_AVAILABLE 1
+#endif
+
+#define SPECTATE_NAME "/snake-spectate"
+#define SPECTATE_MAGIC 0x564f4e53u // "SNOV"
+#define SPECTATE_VERSION 1
+#define SPECTATE_CAPACITY (256 * 1024)   // Ring bytes; a minute or more of play
+#define SPECTATE_KEYFRAME_INTERVAL 32    // Ticks between keyframes (about 5 seconds)
+#define SPECTATE_RECORD_HEADER 8
+#define SPECTATE_MAX_PAYLOAD (MP_STATE_SIZE + MP_STATE_SIZE / 128 + 2) // Worst case RLE
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    int32_t writer;               // Process id of the game
+    atomic_uint live;             // Cleared when the game closes the feed
+    atomic_uint_fast64_t reserved; // The writer may be overwriting bytes below this
+    atomic_uint_fast64_t written;  // Records before this position are complete
+    atomic_uint_fast64_t keyframe; // Position of the newest keyframe record
+    uint8_t data[];
+} SpectateHeader;
+
+typedef struct {
+    SpectateHeader *header;
+    uint8_t previous[MP_STATE_SIZE]; // Last published state
+    uint32_t tick;                   // Records published
+    uint32_t sinceKeyframe;
+} SpectateWriter;
+
+typedef struct {
+    const SpectateHeader *header;
+    uint64_t position;               // Next record to read
+    bool synced;                     // `state` is valid and `position` follows it
+    uint8_t state[MP_STATE_SIZE];
+} SpectateReader;
+
+static inline size_t spectate_size(void) {
+    return sizeof(SpectateHeader) + SPECTATE_CAPACITY;
+}
+
+// Copy between ring positions and flat buffers, wrapping at the end
+static inline void spectate_ring_write(SpectateHeader *header, uint64_t position, const uint8_t *in, size_t length) {
+    size_t start = (size_t)(position % header->capacity);
+    size_t first = length < header->capacity - start ? length : header->capacity - start;
+    memcpy(header->data + start, in, first);
+    memcpy(header->data, in + first, length - first);
+}
+
+static inline void spectate_ring_read(const SpectateHeader *header, uint64_t position, uint8_t *out, size_t length) {
+    size_t start = (size_t)(position % header->capacity);
+    size_t first = length < header->capacity - start ? length : header->capacity - start;
+    memcpy(out, header->data + start, first);
+    memcpy(out + first, header->data, length - first);
+}
+
+#ifdef SPECTATE_AVAILABLE
+// Create the feed, or take over one left behind by a game that has exited. Returns
+// false if shared memory is unavailable or another running game owns the feed.
+static inline bool spectate_create(SpectateWriter *writer, const char *name) {
+    memset(writer, 0, sizeof(*writer));
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)spectate_size()) != 0) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, spectate_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    SpectateHeader *header = memory;
+    if (header->magic == SPECTATE_MAGIC && atomic_load(&header->live) && header->writer > 0 &&
+        header->writer != (int32_t)getpid() && kill(header->writer, 0) == 0) {
+        munmap(memory, spectate_size());
+        return false;
+    }
+
+    atomic_store(&header->live, 0); // Viewers of a previous game let go first
+    header->writer = (int32_t)getpid();
+    header->magic = SPECTATE_MAGIC;
+    header->version = SPECTATE_VERSION;
+    header->capacity = SPECTATE_CAPACITY;
+    atomic_store(&header->reserved, 0);
+    atomic_store(&header->written, 0);
+    atomic_store(&header->keyframe, 0);
+    atomic_store(&header->live, 1);
+
+    writer->header = header;
+    writer->sinceKeyframe = SPECTATE_KEYFRAME_INTERVAL; // Start with a keyframe
+    return true;
+}
+
+static inline void spectate_close(SpectateWriter *writer, const char *name) {
+    if (writer->header == NULL) return;
+    atomic_store(&writer->header->live, 0);
+    munmap(writer->header, spectate_size());
+    shm_unlink(name);
+    writer->header = NULL;
+}
+
+// Append this tick's record. A few microseconds, and never blocks.
+static inline void spectate_publish(SpectateWriter *writer, const Match *match, int timeLeft, MpPhase phase) {
+    SpectateHeader *header = writer->header;
+    if (header == NULL) return;
+
+    uint8_t state[MP_STATE_SIZE];
+    uint8_t record[SPECTATE_RECORD_HEADER + SPECTATE_MAX_PAYLOAD];
+    MpStateInfo info = {++writer->tick, timeLeft, phase, match->snakeCount};
+    mp_pack_state(match, &info, state);
+
+    bool keyframe = ++writer->sinceKeyframe >= SPECTATE_KEYFRAME_INTERVAL;
+    if (!keyframe) {
+        for (size_t i = 0; i < MP_STATE_SIZE; i++) writer->previous[i] ^= state[i];
+    }
+    size_t length = mp_rle_encode(keyframe ? state : writer->previous, MP_STATE_SIZE,
+                                  record + SPECTATE_RECORD_HEADER, SPECTATE_MAX_PAYLOAD);
+    memcpy(writer->previous, state, MP_STATE_SIZE);
+    if (keyframe) writer->sinceKeyframe = 0;
+
+    mp_put16(record, (uint16_t)length);
+    record[2] = keyframe;
+    record[3] = 0;
+    mp_put32(record + 4, info.tick);
+    length += SPECTATE_RECORD_HEADER;
+
+    // Claim the bytes first, so a reader copying them can tell it was overtaken
+    uint64_t position = atomic_load_explicit(&header->written, memory_order_relaxed);
+    atomic_store_explicit(&header->reserved, position + length, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    spectate_ring_write(header, position, record, length);
+    atomic_store_explicit(&header->written, position + length, memory_order_release);
+    if (keyframe) atomic_store_explicit(&header->keyframe, position, memory_order_release);
+}
+
+// Map a feed for reading. Returns false if no game is publishing one.
+static inline bool spectate_open(SpectateReader *reader, const char *name) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < spectate_size()) {
+        close(fd);
+        return false;
+    }
+    void *memory = mmap(NULL, spectate_size(), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) return false;
+
+    const SpectateHeader *header = memory;
+    if (header->magic != SPECTATE_MAGIC || header->version != SPECTATE_VERSION ||
+        header->capacity != SPECTATE_CAPACITY || !atomic_load(&header->live)) {
+        munmap(memory, spectate_size());
+        return false;
+    }
+    reader->header = header;
+    return true;
+}
+
+static inline void spectate_close_reader(SpectateReader *reader) {
+    if (reader->header) munmap((void *)reader->header, spectate_size());
+    reader->header = NULL;
+}
+
+// Whether the game behind the feed is still running
+static inline bool spectate_live(const SpectateReader *reader) {
+    return reader->header && atomic_load(&reader->header->live);
+}
+
+// Catch up with the writer. Returns true and fills `match` and `info` if the state
+// changed since the last call.
+static inline bool spectate_poll(SpectateReader *reader, Match *match, MpStateInfo *info) {
+    const SpectateHeader *header = reader->header;
+    if (header == NULL) return false;
+
+    bool changed = false;
+    uint64_t written = atomic_load_explicit(&header->written, memory_order_acquire);
+    while (true) {
+        // Start, or start over, from the newest keyframe
+        if (!reader->synced || written - reader->position > header->capacity) {
+            reader->synced = false;
+            reader->position = atomic_load_explicit(&header->keyframe, memory_order_acquire);
+            if (written == 0) return changed;
+        }
+        if (reader->position >= written) break;
+
+        uint8_t record[SPECTATE_RECORD_HEADER + SPECTATE_MAX_PAYLOAD];
+        spectate_ring_read(header, reader->position, record, SPECTATE_RECORD_HEADER);
+        size_t length = mp_get16(record);
+        bool valid = length <= SPECTATE_MAX_PAYLOAD &&
+                     reader->position + SPECTATE_RECORD_HEADER + length <= written;
+        if (valid) spectate_ring_read(header, reader->position + SPECTATE_RECORD_HEADER,
+                                      record + SPECTATE_RECORD_HEADER, length);
+
+        // Anything copied while the writer was already overwriting it is discarded
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t reserved = atomic_load_explicit(&header->reserved, memory_order_relaxed);
+        if (!valid || reserved > reader->position + header->capacity ||
+            (!reader->synced && !record[2])) {
+            reader->synced = false;
+            written = atomic_load_explicit(&header->written, memory_order_acquire);
+            continue;
+        }
+
+        uint8_t delta[MP_STATE_SIZE];
+        if (!mp_rle_decode(record + SPECTATE_RECORD_HEADER, length, delta, MP_STATE_SIZE)) {
+            reader->synced = false;
+            return changed;
+        }
+        if (record[2]) {
+            memcpy(reader->state, delta, MP_STATE_SIZE);
+        } else {
+            for (size_t i = 0; i < MP_STATE_SIZE; i++) reader->state[i] ^= delta[i];
+        }
+        reader->synced = true;
+        reader->position += SPECTATE_RECORD_HEADER + length;
+        changed = true;
+    }
+
+    return changed && mp_unpack_state(reader->state, match, info);
+}
+#else
+// No shared memory: there is no feed, and publishing does nothing
+static inline bool spectate_create(SpectateWriter *writer, const char *name) {
+    (void)name;
+    memset(writer, 0, sizeof(*writer));
+    return false;
+}
+static inline void spectate_close(SpectateWriter *writer, const char *name) { (void)writer; (void)name; }
+static inline void spectate_publish(SpectateWriter *writer, const Match *match, int timeLeft, MpPhase phase) {
+    (void)writer; (void)match; (void)timeLeft; (void)phase;
+}
+static inline bool spectate_open(SpectateReader *reader, const char *name) {
+    (void)name;
+    memset(reader, 0, sizeof(*reader));
+    return false;
+}
+static inline void spectate_close_reader(SpectateReader *reader) { (void)reader; }
+static inline bool spectate_live(const SpectateReader *reader) { (void)reader; return false; }
+static inline bool spectate_poll(SpectateReader *reader, Match *match, MpStateInfo *info) {
+    (void)reader; (void)match; (void)info;
+    return false;
+}
+#endif
+
+#endif
@@ -0,0 +1,590 @@
+// Round-robin tournament between the bot strategies, on multiplayer.c's rules.
+//
+//   gcc -O2 -pthread tournament.c -o tournament -lm
+//   gcc -O1 -g -pthread -fsanitize=address,undefined tournament.c -o tournament -lm  (must exit 0)
+//   ./tournament [-g seeds] [-t threads] [-s seed] [-b bootstrap samples] [-r rollouts]
+//
+// Every pair of bots in `bots[]` plays the same set of seeds, each seed twice with
+// the seats swapped, so neither bot gets the better spawn or fruit sequence. A game
+// is a two-snake match of GAME_DURATION; the higher score wins and equal scores
+// draw, as on the game over screen. Each bot draws its random choices from its own
+// stream seeded by the game seed and its seat, so a result never depends on the
+// thread that played it, and the same arguments give the same table.
+//
+// Games run on a pool of threads. Each thread starts with a contiguous block of
+// the games and takes from the back of its own block; a thread that runs out
+// steals from the front of another's. Games vary from a few ticks to the full two
+// minutes, so a thread that drew short games keeps busy instead of waiting.
+//
+// Ratings are a Bradley-Terry fit on the Elo scale (a 400 point lead means 10:1
+// odds), centred on 1500, with a draw counting as half a win. One virtual draw per
+// pairing keeps a bot that never lost finite. The 95% intervals come from
+// refitting on bootstrap resamples of each pairing's games.
+//
+// The greedy and MCTS bots are the ones the game ships, from mp_bots.h. In the game
+// the tree search thinks for as long as a move takes on every core but one; here it
+// gets a fixed number of rollouts per move (-r), so its games are as repeatable as
+// the others' and take the same time on any machine.
+//
+// To add a bot, write a BotSteer and add it to bots[].
+
+#include "mp_bots.h"
+#include "mp_rules.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOURNAMENT_MAX_THREADS 64
+#define TOURNAMENT_MAX_TICKS (GAME_DURATION / MOVE_INTERVAL)
+#define TOURNAMENT_FIT_ROUNDS 2000
+
+// Set (*dx, *dy), which holds the current heading, to the heading for the next move
+typedef void (*BotSteer)(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy);
+
+typedef struct {
+    const char *name;
+    BotSteer steer;
+} Bot;
+
+// One seat of one seed of one pairing
+typedef struct {
+    int a, b;      // Bots; a plays seat 0 unless swapped
+    uint32_t seed;
+    bool swapped;
+} Game;
+
+typedef struct {
+    int8_t outcome;  // +1 bot a won, 0 draw, -1 bot b won
+    int16_t ticks;
+} GameResult;
+
+// A thread's block of games: the owner takes from `bottom`, thieves from `top`
+typedef struct {
+    int *games;
+    atomic_int top;
+    atomic_int bottom;
+} GameDeque;
+
+typedef struct Tournament Tournament;
+
+typedef struct {
+    Tournament *tournament;
+    int index;
+    pthread_t thread;
+    uint32_t rng;  // Picks steal victims
+    long games;
+    long ticks;
+    long steals;
+} TournamentWorker;
+
+struct Tournament {
+    const Game *games;
+    GameResult *results;
+    atomic_int remaining;
+    int threadCount;
+    GameDeque deques[TOURNAMENT_MAX_THREADS];
+    TournamentWorker workers[TOURNAMENT_MAX_THREADS];
+};
+
+static const int directions[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+
+static bool reverses(const Snake *snake, int dx, int dy) {
+    return dx == -snake->dx && dy == -snake->dy;
+}
+
+// Cells reachable from (x, y) through free cells, counting (x, y) itself
+static int flood_area(const Match *match, int x, int y) {
+    if (cell_blocked(match, x, y)) return 0;
+
+    bool seen[GRID_HEIGHT][GRID_WIDTH] = {{false}};
+    int queue[GRID_WIDTH * GRID_HEIGHT];
+    int head = 0, tail = 0;
+    seen[y][x] = true;
+    queue[tail++] = y * GRID_WIDTH + x;
+    while (head < tail) {
+        int cell = queue[head++];
+        for (int d = 0; d < 4; d++) {
+            int nx = cell % GRID_WIDTH + directions[d][0];
+            int ny = cell / GRID_WIDTH + directions[d][1];
+            if (cell_blocked(match, nx, ny) || seen[ny][nx]) continue;
+            seen[ny][nx] = true;
+            queue[tail++] = ny * GRID_WIDTH + nx;
+        }
+    }
+    return tail;
+}
+
+// Manhattan distance from (x, y) to the nearest fruit
+static int fruit_distance(const Match *match, int x, int y) {
+    int best = GRID_WIDTH + GRID_HEIGHT;
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        if (!match->foods[i].active) continue;
+        int distance = abs(match->foods[i].x - x) + abs(match->foods[i].y - y);
+        if (distance < best) best = distance;
+    }
+    return best;
+}
+
+// Keep going until something is ahead, then turn either way; now and then turn anyway
+static void steer_wanderer(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy) {
+    (void)ticksLeft;
+    const Snake *snake = &match->snakes[player];
+    bool blocked = cell_blocked(match, snake->body[0].x + *dx, snake->body[0].y + *dy);
+    if (!blocked && mp_rand(rng) % 8 != 0) return;
+
+    int turn = mp_rand(rng) % 2 ? 1 : -1;
+    int ndx = -*dy * turn, ndy = *dx * turn;
+    if (cell_blocked(match, snake->body[0].x + ndx, snake->body[0].y + ndy)) {
+        ndx = -ndx;
+        ndy = -ndy;
+    }
+    *dx = ndx;
+    *dy = ndy;
+}
+
+// The game's Bot opponent: mostly the safe move closest to a fruit, otherwise a
+// random safe move
+static void steer_greedy(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy) {
+    (void)ticksLeft;
+    turn_direction(*dx, *dy, bot_action(match, player, rng), dx, dy);
+}
+
+// The game's AI opponent, planning against the other snake. Each thread keeps
+// one node pool for all its searches and frees it when it runs out of games.
+static int mcts_rollouts = 200;
+static _Thread_local MctsNode *mcts_nodes;
+
+static void steer_mcts(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy) {
+    if (mcts_nodes == NULL) {
+        mcts_nodes = malloc(sizeof(MctsNode) * MCTS_MAX_NODES);
+        if (mcts_nodes == NULL) {
+            steer_greedy(match, player, ticksLeft, rng, dx, dy);
+            return;
+        }
+    }
+
+    SimState root;
+    sim_capture(&root, match, ticksLeft * MOVE_INTERVAL);
+    MctsSearch search = {mcts_nodes, 0, mp_rand(rng) | 1, player, player == 0 ? 1 : 0};
+    mcts_reset(&search);
+    for (int i = 0; i < mcts_rollouts; i++) mcts_iterate(&search, &root);
+    turn_direction(*dx, *dy, mcts_best_action(search.nodes[0].visits[0]), dx, dy);
+}
+
+// First step of a shortest path to the nearest fruit; if no fruit can be reached,
+// the move with the most room
+static void steer_hunter(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy) {
+    (void)ticksLeft;
+    (void)rng;
+    const Snake *snake = &match->snakes[player];
+    int8_t first[GRID_HEIGHT][GRID_WIDTH]; // Direction of the first step, -1 unseen
+    memset(first, -1, sizeof(first));
+    int queue[GRID_WIDTH * GRID_HEIGHT];
+    int head = 0, tail = 0;
+
+    for (int d = 0; d < 4; d++) {
+        int x = snake->body[0].x + directions[d][0], y = snake->body[0].y + directions[d][1];
+        if (reverses(snake, directions[d][0], directions[d][1]) || cell_blocked(match, x, y) || first[y][x] >= 0) continue;
+        first[y][x] = (int8_t)d;
+        queue[tail++] = y * GRID_WIDTH + x;
+    }
+
+    bool food[GRID_HEIGHT][GRID_WIDTH] = {{false}};
+    for (int i = 0; i < FOOD_SLOTS; i++) {
+        if (match->foods[i].active) food[match->foods[i].y][match->foods[i].x] = true;
+    }
+
+    while (head < tail) {
+        int cell = queue[head++];
+        int x = cell % GRID_WIDTH, y = cell / GRID_WIDTH;
+        if (food[y][x]) {
+            *dx = directions[first[y][x]][0];
+            *dy = directions[first[y][x]][1];
+            return;
+        }
+        for (int d = 0; d < 4; d++) {
+            int nx = x + directions[d][0], ny = y + directions[d][1];
+            if (cell_blocked(match, nx, ny) || first[ny][nx] >= 0) continue;
+            first[ny][nx] = first[y][x];
+            queue[tail++] = ny * GRID_WIDTH + nx;
+        }
+    }
+
+    int bestArea = 0;
+    for (int d = 0; d < 4; d++) {
+        if (reverses(snake, directions[d][0], directions[d][1])) continue;
+        int area = flood_area(match, snake->body[0].x + directions[d][0], snake->body[0].y + directions[d][1]);
+        if (area > bestArea) {
+            bestArea = area;
+            *dx = directions[d][0];
+            *dy = directions[d][1];
+        }
+    }
+}
+
+// Never into a pocket too small to hold the snake if there is a roomier move, and
+// keep clear of cells another head could also reach; then closest to a fruit
+static void steer_spacer(const Match *match, int player, int ticksLeft, uint32_t *rng, int *dx, int *dy) {
+    (void)ticksLeft;
+    (void)rng;
+    const Snake *snake = &match->snakes[player];
+    long bestScore = -1;
+
+    for (int d = 0; d < 4; d++) {
+        int ndx = directions[d][0], ndy = directions[d][1];
+        int x = snake->body[0].x + ndx, y = snake->body[0].y + ndy;
+        if (reverses(snake, ndx, ndy) || cell_blocked(match, x, y)) continue;
+
+        bool contested = false;
+        for (int p = 0; p < match->snakeCount; p++) {
+            const Snake *other = &match->snakes[p];
+            if (p == player || !other->alive) continue;
+            contested |= abs(other->body[0].x - x) + abs(other->body[0].y - y) == 1;
+        }
+
+        int area = flood_area(match, x, y);
+        long score = (long)(area >= snake->length ? snake->length : area) * 4096 +
+                     (contested ? 0 : 2048) + (GRID_WIDTH + GRID_HEIGHT - fruit_distance(match, x, y));
+        if (score > bestScore) {
+            bestScore = score;
+            *dx = ndx;
+            *dy = ndy;
+        }
+    }
+}
+
+// The registered bots
+static const Bot bots[] = {
+    {"wanderer", steer_wanderer},
+    {"greedy", steer_greedy},
+    {"hunter", steer_hunter},
+    {"spacer", steer_spacer},
+    {"mcts", steer_mcts},
+};
+#define BOT_COUNT ((int)(sizeof(bots) / sizeof(bots[0])))
+
+// Play one game to the end
+static GameResult play_game(const Game *game) {
+    Match match;
+    match_reset(&match, 2, game->seed);
+    int seats[2] = {game->swapped ? game->b : game->a, game->swapped ? game->a : game->b};
+    uint32_t rngs[2];
+    for (int s = 0; s < 2; s++) rngs[s] = ((game->seed * 2654435761u) ^ (0x9e3779b9u * (uint32_t)(s + 1))) | 1;
+
+    int tick = 0;
+    while (tick < TOURNAMENT_MAX_TICKS && !match_over(&match)) {
+        // Both bots decide on the board as it stands, then both move
+        int headings[2][2];
+        for (int s = 0; s < 2; s++) {
+            headings[s][0] = match.snakes[s].dx;
+            headings[s][1] = match.snakes[s].dy;
+            if (match.snakes[s].alive) {
+                bots[seats[s]].steer(&match, s, TOURNAMENT_MAX_TICKS - tick, &rngs[s], &headings[s][0], &headings[s][1]);
+            }
+        }
+        for (int s = 0; s < 2; s++) snake_steer(&match.snakes[s], headings[s][0], headings[s][1]);
+
+        move_snakes(&match);
+        eat_foods(&match);
+        ensure_minimum_fruits(&match);
+        tick++;
+    }
+
+    int scoreA = match.snakes[game->swapped ? 1 : 0].score;
+    int scoreB = match.snakes[game->swapped ? 0 : 1].score;
+    GameResult result = {(int8_t)(scoreA > scoreB ? 1 : scoreA < scoreB ? -1 : 0), (int16_t)tick};
+    return result;
+}
+
+// The owner's next game, from the back of its own block, or -1
+static int deque_take(GameDeque *deque) {
+    int bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return -1;
+    }
+    int game = deque->games[bottom];
+    if (top == bottom) {
+        // Last one: a thief may be after it too
+        bool won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                           memory_order_seq_cst, memory_order_relaxed);
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return won ? game : -1;
+    }
+    return game;
+}
+
+// A game from the front of someone else's block, or -1
+static int deque_steal(GameDeque *deque) {
+    int top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom) return -1;
+
+    int game = deque->games[top];
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst, memory_order_relaxed)) {
+        return -1;
+    }
+    return game;
+}
+
+static void *worker_main(void *data) {
+    TournamentWorker *worker = data;
+    Tournament *tournament = worker->tournament;
+    GameDeque *own = &tournament->deques[worker->index];
+
+    while (atomic_load_explicit(&tournament->remaining, memory_order_acquire) > 0) {
+        int game = deque_take(own);
+        if (game < 0 && tournament->threadCount > 1) {
+            // Out of work: try the others, starting somewhere random
+            int start = (int)(mp_rand(&worker->rng) % (uint32_t)tournament->threadCount);
+            for (int i = 0; i < tournament->threadCount && game < 0; i++) {
+                int victim = (start + i) % tournament->threadCount;
+                if (victim != worker->index) game = deque_steal(&tournament->deques[victim]);
+            }
+            if (game >= 0) worker->steals++;
+        }
+        if (game < 0) {
+            sched_yield(); // The last games are still being played elsewhere
+            continue;
+        }
+
+        GameResult result = play_game(&tournament->games[game]);
+        tournament->results[game] = result;
+        worker->games++;
+        worker->ticks += result.ticks;
+        atomic_fetch_sub_explicit(&tournament->remaining, 1, memory_order_release);
+    }
+
+    free(mcts_nodes);
+    mcts_nodes = NULL;
+    return NULL;
+}
+
+// Wins (a draw counts half) and games of every pairing, in `wins[i][j]` and `played[i][j]`
+typedef struct {
+    double wins[BOT_COUNT][BOT_COUNT];
+    double played[BOT_COUNT][BOT_COUNT];
+} Standings;
+
+// Bradley-Terry ratings on the Elo scale, by minorization-maximization
+static void fit_ratings(const Standings *standings, double ratings[BOT_COUNT]) {
+    double strength[BOT_COUNT];
+    for (int i = 0; i < BOT_COUNT; i++) strength[i] = 1.0;
+
+    for (int round = 0; round < TOURNAMENT_FIT_ROUNDS; round++) {
+        double change = 0;
+        for (int i = 0; i < BOT_COUNT; i++) {
+            double wins = 0, denominator = 0;
+            for (int j = 0; j < BOT_COUNT; j++) {
+                if (j == i) continue;
+                // One virtual draw per pairing
+                wins += standings->wins[i][j] + 0.5;
+                denominator += (standings->played[i][j] + 1.0) / (strength[i] + strength[j]);
+            }
+            double next = wins / denominator;
+            change = fmax(change, fabs(log(next / strength[i])));
+            strength[i] = next;
+        }
+
+        // Only ratios matter; keep the geometric mean at 1
+        double logMean = 0;
+        for (int i = 0; i < BOT_COUNT; i++) logMean += log(strength[i]) / BOT_COUNT;
+        for (int i = 0; i < BOT_COUNT; i++) strength[i] /= exp(logMean);
+        if (change < 1e-10) break;
+    }
+
+    for (int i = 0; i < BOT_COUNT; i++) ratings[i] = 1500.0 + 400.0 * log10(strength[i]);
+}
+
+static void add_result(Standings *standings, int a, int b, int outcome) {
+    standings->played[a][b] += 1;
+    standings->played[b][a] += 1;
+    standings->wins[a][b] += outcome > 0 ? 1.0 : outcome == 0 ? 0.5 : 0.0;
+    standings->wins[b][a] += outcome < 0 ? 1.0 : outcome == 0 ? 0.5 : 0.0;
+}
+
+static int compare_doubles(const void *left, const void *right) {
+    double a = *(const double *)left, b = *(const double *)right;
+    return (a > b) - (a < b);
+}
+
+static double seconds_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    int seedCount = 100;
+    int threadCount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t baseSeed = 1;
+    int bootstrapCount = 1000;
+
+    int option;
+    while ((option = getopt(argc, argv, "g:t:s:b:r:")) != -1) {
+        switch (option) {
+            case 'g': seedCount = atoi(optarg); break;
+            case 't': threadCount = atoi(optarg); break;
+            case 's': baseSeed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            case 'b': bootstrapCount = atoi(optarg); break;
+            case 'r': mcts_rollouts = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-g seeds] [-t threads] [-s seed] [-b bootstrap samples] [-r rollouts]\n",
+                        argv[0]);
+                return 1;
+        }
+    }
+    if (seedCount < 1 || bootstrapCount < 1 || mcts_rollouts < 1) {
+        fprintf(stderr, "seeds, bootstrap samples and rollouts must be >= 1\n");
+        return 1;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > TOURNAMENT_MAX_THREADS) threadCount = TOURNAMENT_MAX_THREADS;
+
+    // Every pairing, every seed, both seatings
+    int pairings = BOT_COUNT * (BOT_COUNT - 1) / 2;
+    int gameCount = pairings * seedCount * 2;
+    Game *games = malloc(sizeof(Game) * (size_t)gameCount);
+    GameResult *results = calloc((size_t)gameCount, sizeof(GameResult));
+    int *order = malloc(sizeof(int) * (size_t)gameCount);
+    static Tournament tournament;
+    if (games == NULL || results == NULL || order == NULL) {
+        fprintf(stderr, "Could not allocate %d games\n", gameCount);
+        return 1;
+    }
+
+    int n = 0;
+    for (int a = 0; a < BOT_COUNT; a++) {
+        for (int b = a + 1; b < BOT_COUNT; b++) {
+            for (int k = 0; k < seedCount; k++) {
+                uint32_t seed = (baseSeed + (uint32_t)k) * 2654435761u | 1;
+                for (int swapped = 0; swapped < 2; swapped++) {
+                    games[n] = (Game){a, b, seed, swapped != 0};
+                    order[n] = n;
+                    n++;
+                }
+            }
+        }
+    }
+
+    // Contiguous blocks, so a thread holding a slow pairing has something to steal
+    tournament.games = games;
+    tournament.results = results;
+    tournament.threadCount = threadCount;
+    atomic_store(&tournament.remaining, gameCount);
+    for (int i = 0; i < threadCount; i++) {
+        GameDeque *deque = &tournament.deques[i];
+        deque->games = order;
+        atomic_store(&deque->top, (int)((long long)gameCount * i / threadCount));
+        atomic_store(&deque->bottom, (int)((long long)gameCount * (i + 1) / threadCount));
+        tournament.workers[i] = (TournamentWorker){&tournament, i, 0, (uint32_t)i * 7919u + 1, 0, 0, 0};
+    }
+
+    printf("%d bots, %d pairings x %d seeds x 2 seats = %d games on %d threads\n", BOT_COUNT, pairings, seedCount,
+           gameCount, threadCount);
+    double start = seconds_now();
+    for (int i = 1; i < threadCount; i++) {
+        if (pthread_create(&tournament.workers[i].thread, NULL, worker_main, &tournament.workers[i]) != 0) {
+            fprintf(stderr, "Could not start thread %d\n", i);
+            return 1;
+        }
+    }
+    worker_main(&tournament.workers[0]);
+    for (int i = 1; i < threadCount; i++) pthread_join(tournament.workers[i].thread, NULL);
+    double elapsed = seconds_now() - start;
+
+    // Ratings from all games
+    static Standings standings;
+    int record[BOT_COUNT][3] = {{0}}; // Wins, draws, losses
+    for (int g = 0; g < gameCount; g++) {
+        int a = games[g].a, b = games[g].b, outcome = results[g].outcome;
+        add_result(&standings, a, b, outcome);
+        record[a][outcome > 0 ? 0 : outcome == 0 ? 1 : 2]++;
+        record[b][outcome < 0 ? 0 : outcome == 0 ? 1 : 2]++;
+    }
+    double ratings[BOT_COUNT];
+    fit_ratings(&standings, ratings);
+
+    // Bootstrap: resample each pairing's games with replacement and refit
+    double *samples = malloc(sizeof(double) * (size_t)bootstrapCount * BOT_COUNT);
+    if (samples == NULL) {
+        fprintf(stderr, "Could not allocate %d bootstrap samples\n", bootstrapCount);
+        return 1;
+    }
+    uint32_t rng = baseSeed * 2654435761u | 1;
+    for (int r = 0; r < bootstrapCount; r++) {
+        static Standings resampled;
+        memset(&resampled, 0, sizeof(resampled));
+        for (int pairing = 0; pairing < pairings; pairing++) {
+            int first = pairing * seedCount * 2;
+            for (int g = 0; g < seedCount * 2; g++) {
+                const Game *game = &games[first + (int)(mp_rand(&rng) % (uint32_t)(seedCount * 2))];
+                add_result(&resampled, game->a, game->b, results[game - games].outcome);
+            }
+        }
+        double resampledRatings[BOT_COUNT];
+        fit_ratings(&resampled, resampledRatings);
+        for (int i = 0; i < BOT_COUNT; i++) samples[i * bootstrapCount + r] = resampledRatings[i];
+    }
+
+    // Best first
+    int rank[BOT_COUNT];
+    for (int i = 0; i < BOT_COUNT; i++) rank[i] = i;
+    for (int i = 1; i < BOT_COUNT; i++) {
+        for (int j = i; j > 0 && ratings[rank[j]] > ratings[rank[j - 1]]; j--) {
+            int swap = rank[j];
+            rank[j] = rank[j - 1];
+            rank[j - 1] = swap;
+        }
+    }
+
+    printf("\n  #  bot          elo    95%% interval       won  drawn   lost\n");
+    for (int position = 0; position < BOT_COUNT; position++) {
+        int i = rank[position];
+        double *sorted = samples + i * bootstrapCount;
+        qsort(sorted, (size_t)bootstrapCount, sizeof(double), compare_doubles);
+        double low = sorted[(int)(bootstrapCount * 0.025)];
+        double high = sorted[(int)(bootstrapCount * 0.975) < bootstrapCount ? (int)(bootstrapCount * 0.975) : bootstrapCount - 1];
+        printf("%3d  %-10s %6.0f  [%6.0f, %6.0f]  %6d %6d %6d\n", position + 1, bots[i].name, ratings[i], low, high,
+               record[i][0], record[i][1], record[i][2]);
+    }
+
+    // Score of each row bot against each column bot
+    printf("\n%-12s", "score %");
+    for (int position = 0; position < BOT_COUNT; position++) printf("%10s", bots[rank[position]].name);
+    printf("\n");
+    for (int row = 0; row < BOT_COUNT; row++) {
+        int i = rank[row];
+        printf("%-12s", bots[i].name);
+        for (int column = 0; column < BOT_COUNT; column++) {
+            int j = rank[column];
+            if (i == j) printf("%10s", "-");
+            else printf("%10.1f", 100.0 * standings.wins[i][j] / standings.played[i][j]);
+        }
+        printf("\n");
+    }
+
+    long ticks = 0, steals = 0;
+    for (int i = 0; i < threadCount; i++) {
+        ticks += tournament.workers[i].ticks;
+        steals += tournament.workers[i].steals;
+    }
+    printf("\n%d games, %ld ticks in %.3fs: %.0f games/s, %.2fM ticks/s, %ld games stolen\n", gameCount, ticks, elapsed,
+           elapsed > 0 ? gameCount / elapsed : 0.0, elapsed > 0 ? ticks / elapsed / 1e6 : 0.0, steals);
+
+    free(samples);
+    free(order);
+    free(results);
+    free(games);
+    return 0;
+}
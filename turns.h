@@ -0,0 +1,129 @@
+#ifndef TURNS_H
+#define TURNS_H
+
+// Buffered steering and input-to-photon latency, shared by attempt.c, challenge.c
+// and multiplayer.c.
+//
+// Arrow keys go into a TurnQueue instead of straight into the snake's heading, and
+// every snake tick takes at most one turn off it. Two quick presses inside one tick
+// become turns on two consecutive ticks instead of the second overwriting the
+// first. Each press is checked against the heading the snake will have once the
+// turns queued before it are taken, so Up then Left while heading right is a
+// proper U-turn over two ticks and never a reversal into the neck.
+//
+// A queued turn keeps the timestamp of its key event. When a frame showing the
+// tick that took it has been presented, the time since the key press goes into a
+// LatencyStats histogram, which latency_format() sums up for the F3 overlay.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define TURN_QUEUE_SIZE 4    // Presses held per snake; more within a few ticks are dropped
+#define LATENCY_BUCKETS 1000 // 1 ms buckets; anything slower lands in the last one
+#define LATENCY_PENDING 16   // Turns taken but not yet on screen
+
+typedef struct {
+    int dx, dy;
+    uint32_t stamp; // Key event time in ms
+} Turn;
+
+typedef struct {
+    Turn turns[TURN_QUEUE_SIZE];
+    int head;
+    int count;
+} TurnQueue;
+
+typedef struct {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t samples;
+    uint32_t max;
+    uint32_t pending[LATENCY_PENDING]; // Stamps of turns waiting for latency_presented()
+    int pendingCount;
+} LatencyStats;
+
+static inline void turn_queue_clear(TurnQueue *queue) {
+    queue->head = queue->count = 0;
+}
+
+// Queue a turn to (dx, dy) for a snake heading (headingDx, headingDy). Presses that
+// would not change the heading left after the queued turns, or would reverse it,
+// are dropped, as are presses beyond TURN_QUEUE_SIZE.
+static inline bool turn_queue_push(TurnQueue *queue, int headingDx, int headingDy, int dx, int dy, uint32_t stamp) {
+    if (queue->count == TURN_QUEUE_SIZE) return false;
+    if (queue->count > 0) {
+        const Turn *last = &queue->turns[(queue->head + queue->count - 1) % TURN_QUEUE_SIZE];
+        headingDx = last->dx;
+        headingDy = last->dy;
+    }
+    if ((dx == headingDx && dy == headingDy) || (dx == -headingDx && dy == -headingDy)) return false;
+
+    Turn *turn = &queue->turns[(queue->head + queue->count) % TURN_QUEUE_SIZE];
+    turn->dx = dx;
+    turn->dy = dy;
+    turn->stamp = stamp;
+    queue->count++;
+    return true;
+}
+
+// Steer (*dx, *dy) by the next queued turn, once per tick. Turns made pointless by
+// a heading set some other way (a bot, a respawn) are skipped. Returns false if no
+// turn was taken; otherwise *stamp is its key press time.
+static inline bool turn_queue_take(TurnQueue *queue, int *dx, int *dy, uint32_t *stamp) {
+    while (queue->count > 0) {
+        Turn turn = queue->turns[queue->head];
+        queue->head = (queue->head + 1) % TURN_QUEUE_SIZE;
+        queue->count--;
+        if ((turn.dx == *dx && turn.dy == *dy) || (turn.dx == -*dx && turn.dy == -*dy)) continue;
+
+        *dx = turn.dx;
+        *dy = turn.dy;
+        *stamp = turn.stamp;
+        return true;
+    }
+    return false;
+}
+
+static inline void latency_record(LatencyStats *stats, uint32_t ms) {
+    stats->counts[ms < LATENCY_BUCKETS ? ms : LATENCY_BUCKETS - 1]++;
+    stats->samples++;
+    if (ms > stats->max) stats->max = ms;
+}
+
+// A turn pressed at `stamp` has been simulated; it counts once it is on screen
+static inline void latency_turn_taken(LatencyStats *stats, uint32_t stamp) {
+    if (stats->pendingCount < LATENCY_PENDING) stats->pending[stats->pendingCount++] = stamp;
+}
+
+// A frame showing every turn taken so far was presented at `now`
+static inline void latency_presented(LatencyStats *stats, uint32_t now) {
+    for (int i = 0; i < stats->pendingCount; i++) {
+        latency_record(stats, now - stats->pending[i]);
+    }
+    stats->pendingCount = 0;
+}
+
+// Smallest whole ms that at least `fraction` of the samples do not exceed
+static inline uint32_t latency_percentile(const LatencyStats *stats, double fraction) {
+    uint32_t wanted = (uint32_t)(stats->samples * fraction + 0.5);
+    if (wanted == 0) wanted = 1;
+    uint32_t seen = 0;
+    for (uint32_t ms = 0; ms < LATENCY_BUCKETS; ms++) {
+        seen += stats->counts[ms];
+        if (seen >= wanted) return ms;
+    }
+    return LATENCY_BUCKETS - 1;
+}
+
+// One overlay line, e.g. "input to photon  p50 41  p95 152  p99 160  max 171 ms  (58)"
+static inline void latency_format(const LatencyStats *stats, const char *label, char *text, size_t size) {
+    if (stats->samples == 0) {
+        snprintf(text, size, "%s  -", label);
+        return;
+    }
+    snprintf(text, size, "%s  p50 %u  p95 %u  p99 %u  max %u ms  (%u)", label,
+             latency_percentile(stats, 0.50), latency_percentile(stats, 0.95),
+             latency_percentile(stats, 0.99), stats->max, stats->samples);
+}
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+// Zobrist hashing: a game state hashes to the XOR of one 64-bit key per feature
+// (this snake's segment on that cell, that fruit slot holding that cell, ...), so
+// a move updates the hash by XORing the keys that left and the keys that arrived.
+//
+// Keys are not kept in a table. zobrist_key() derives each one from its feature
+// with the splitmix64 finalizer: nothing to initialize or share between threads,
+// and every process and machine agrees on every key, which is what lets two
+// peers, or a replay and the game it recorded, compare hashes.
+
+#include <stdint.h>
+
+// Feature kinds; `index` below is the snake, fruit slot or obstacle
+enum {
+    ZOBRIST_BODY = 1,         // A segment of a snake on (x, y); see zobrist_link()
+    ZOBRIST_HEAD,             // Head of snake `index` on (x, y)
+    ZOBRIST_HEADING,          // Snake `index` heading (x, y) = (dx, dy)
+    ZOBRIST_ALIVE,            // Snake `index` is alive
+    ZOBRIST_SCORE,            // Snake `index` has score x
+    ZOBRIST_FOOD,             // Fruit slot `index` holds a fruit on (x, y)
+    ZOBRIST_OBSTACLE,         // Obstacle `index` on (x, y)
+    ZOBRIST_RNG,              // Random generator state, `index` counts 32 bits, (x, y) = (high, low) 16 bits
+    ZOBRIST_FOOD_HEADING,     // Fruit slot `index` moving (x, y) = (dx, dy)
+    ZOBRIST_OBSTACLE_HEADING, // Obstacle `index` moving (x, y) = (dx, dy)
+    ZOBRIST_TIME_LEFT         // x seconds left in a timed round
+};
+
+static inline uint64_t zobrist_mix(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Key of one feature. Coordinates may lie off the board (a crashed head does).
+static inline uint64_t zobrist_key(int kind, int index, int x, int y) {
+    return zobrist_mix((uint64_t)(uint8_t)kind << 56 | (uint64_t)(uint16_t)index << 40 |
+                       (uint64_t)((uint32_t)x & 0xffffff) << 16 | (uint64_t)(uint16_t)y);
+}
+
+// Key of a segment of snake `index` on (x, y) whose next segment towards the tail is
+// on (nextX, nextY), a neighbour or, for a tail that has just grown, the same cell.
+// A body hashes as the key of its head plus one of these per segment but the tail.
+// Keying the cells alone would let the doubled cell of a grown tail cancel out, and
+// two bodies over the same cells in a different order hash the same; the links
+// leave one path from the head.
+static inline uint64_t zobrist_link(int index, int x, int y, int nextX, int nextY) {
+    int direction = (nextX - x + 1) * 3 + (nextY - y + 1);
+    return zobrist_key(ZOBRIST_BODY, index << 4 | direction, x, y);
+}
+
+#endif